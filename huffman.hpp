@@ -53,26 +53,47 @@
 // for quick-n'-easy compression/decompression of raw data
 // buffers.
 //
-// The size of a Huffman code is limited to 64 bits (to fit
-// inside a uint64) and no additional handing is done if this
-// size is overflowed. It will just log an error and ignore
-// further bits.
+// The size of a Huffman code is limited to MaxFastBits (57) bits,
+// what the decoder reads with one 64-bit load. The encoder reports
+// an error for a longer code, but it would take a Fibonacci-shaped
+// histogram of more than 2^31 symbols to get one.
 //
 // Symbols are byte-sized so that we can limit the number of leaf
 // nodes to 256. There is an extra of 512 nodes for inner nodes,
 // but again if that size is exceeded we just log an error and
 // ignore.
 //
+// easyEncodeSegmented() splits the data codes in independently
+// decodable segments sharing the same tree, with a jump table of
+// their sizes, so that easyDecodeParallel() can decode a large
+// payload with several threads. easyDecode() reads both layouts.
+// #define HUFFMAN_NO_THREADS to make easyDecodeParallel() sequential.
+//
+// For data with a well-known distribution, a StaticTable built once
+// from a fixed frequency table codes streams with no tree prefix at all
+// (easyEncodeStatic()/easyDecodeStatic()). getAsciiTextTable() is a
+// built-in one for English text.
+//
+// The bit stream kernels are selected at runtime from the detected
+// CPU features (see getCpuFeatures()), so one binary can run on
+// machines with different instruction sets.
+// #define HUFFMAN_NO_SIMD to always use the portable scalar code.
+//
 // You can override the HUFFMAN_ERROR() macro to supply your
 // own error handling strategy. The default simply writes to
 // stderr and calls std::abort().
 //
 // Memory allocated explicitly by the bit streams will be sourced
 // from HUFFMAN_MALLOC/HUFFMAN_MFREE, so you can override the macros
-// to add custom memory management. Current that's all the memory
-// we allocate directly, but we also use std::priority_queue<> to
-// build the Huffman tree and the queue will allocate memory from
-// the global heap, so you won't be able to catch that, unfortunately.
+// to add custom memory management. The Encoder builds its tree in
+// fixed arrays, with no allocations. Segmented streams, the parallel
+// decoder and StaticTable construction use std::vector/std::thread
+// and allocate from the global heap.
+//
+// The Encoder (about 26KB) and Decoder (about 24KB) are too big for a
+// small stack. The easyEncode()/easyDecode() overloads that take a
+// workspace of workspaceSize() bytes construct them there and write
+// to caller buffers instead, with no heap use (low-memory profile).
 //
 // The huffman::Node struct is not very optimized for size.
 // We use full signed integers for the value and child indexes,
@@ -130,6 +151,52 @@ namespace huffman
     #define HUFFMAN_ERROR(message) ::huffman::fatalError(message)
 #endif // HUFFMAN_ERROR
 
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+// The code peek/poke kernels use BMI2 (with BMI1) when present. Detected
+// once; false with HUFFMAN_NO_SIMD or when not compiling for x86/x64.
+struct CpuFeatures
+{
+    bool bmi2 = false;
+};
+
+// Whether the BMI2 peek/poke kernels are in use.
+const CpuFeatures & getCpuFeatures();
+
+// Can only turn the detected BMI2 path off, e.g. to compare it with the
+// portable kernels. Not thread safe; call it before encoding or decoding.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Where the time goes in the encoder and decoder (tree build, prefix, data),
+// counted when HUFFMAN_ENABLE_STATS is defined next to HUFFMAN_IMPLEMENTATION.
+// The counters stay at zero otherwise. Each thread has its own set.
+struct Stats
+{
+    std::uint64_t encodeCalls       = 0; // Encoder instances created.
+    std::uint64_t decodeCalls       = 0; // Decoder::decode() calls.
+    std::uint64_t bytesEncoded      = 0; // Uncompressed bytes consumed by the encoder.
+    std::uint64_t bytesDecoded      = 0; // Uncompressed bytes produced by the decoder.
+    std::uint64_t bitsWritten       = 0; // Compressed bits output by the encoder, tree prefix included.
+    std::uint64_t bitsRead          = 0; // Compressed bits consumed by the decoder, tree prefix included.
+    std::uint64_t treeBuildNanos    = 0; // Histogram, tree build and code assignment time.
+    std::uint64_t treeWriteNanos    = 0; // Time spent writing the tree prefix.
+    std::uint64_t dataEmitNanos     = 0; // Time spent writing the data codes.
+    std::uint64_t headerParseNanos  = 0; // Time the decoder spent reading the tree prefix.
+    std::uint64_t dataDecodeNanos   = 0; // Time spent in Decoder::decode().
+    std::uint64_t decodeTableMisses = 0; // Codes too long for the decode table, resolved by the slower search.
+    std::uint64_t allocatorGrowths  = 0; // Reallocations of a BitStreamWriter buffer in allocate().
+};
+
+// This thread's counters; resetStats() zeroes them.
+const Stats & getStats();
+void resetStats();
+
 // ========================================================
 // class Code:
 // ========================================================
@@ -222,6 +289,10 @@ public:
     BitStreamWriter();
     explicit BitStreamWriter(int initialSizeInBits, int growthGranularity = 2);
 
+    // Writes to a fixed caller buffer, which is never grown nor freed. Bits that
+    // don't fit are dropped and hasOverflowed() becomes true.
+    BitStreamWriter(std::uint8_t * buffer, int bufferSizeBytes);
+
     void allocate(int bitsWanted);
     void setGranularity(int growthGranularity);
     std::uint8_t * release();
@@ -238,6 +309,7 @@ public:
     int getByteCount() const;
     int getBitCount()  const;
     const std::uint8_t * getBitStream() const;
+    bool hasOverflowed() const { return overflowed; }
 
     ~BitStreamWriter();
 
@@ -246,7 +318,9 @@ private:
     void internalInit();
     static std::uint8_t * allocBytes(int bytesWanted, std::uint8_t * oldPtr, int oldSize);
 
-    std::uint8_t * stream; // Growable buffer to store our bits. Heap allocated & owned by the class instance.
+    std::uint8_t * stream; // Growable buffer to store our bits. Heap allocated & owned by the class instance,
+                           // unless it is a fixed caller buffer (granularity is then zero).
+    bool overflowed;       // A fixed buffer ran out of space.
     int bytesAllocated;    // Current size of heap-allocated stream buffer *in bytes*.
     int granularity;       // Amount bytesAllocated multiplies by when auto-resizing in appendBit().
     int currBytePos;       // Current byte being written to, from 0 to bytesAllocated-1.
@@ -273,9 +347,16 @@ public:
     bool readNextBit();
     std::uint64_t readBitsU64(int bitCount);
 
+    // Returns the next bitCount bits (up to 57) without consuming them.
+    // Bits past the end of the stream read as zero.
+    std::uint64_t peekBitsU64(int bitCount) const;
+    void skipBits(int bitCount);
+
     // Basic stream info:
     int getByteCount() const { return sizeInBytes; }
     int getBitCount()  const { return sizeInBits;  }
+    int getBitsRead()  const { return numBitsRead; }
+    int getBitsLeft()  const { return sizeInBits - numBitsRead; }
     const std::uint8_t * getBitStream() const { return stream; }
 
     // Current Huffman code being read from the stream:
@@ -302,6 +383,9 @@ constexpr int Nil        = -1;
 constexpr int MaxSymbols = 256;
 constexpr int MaxNodes   = MaxSymbols + 512;
 
+// Set in the number of codes field of segmented streams.
+constexpr int SegmentedStreamTag = 0x8000;
+
 struct Node final
 {
     int frequency  = Nil; // Occurrence count; Nil if not in use.
@@ -329,7 +413,14 @@ public:
     // Constructor will start the encoding process,
     // building the Huffman tree and creating the output stream.
     // Call getBitStreamWriter() to fetch the results.
-    Encoder(const std::uint8_t * data, int dataSizeBytes, bool prependTreeToBitStream);
+    // A nonzero segmentSizeBytes splits the data codes in segments
+    // that can be decoded independently (requires the tree prefix).
+    Encoder(const std::uint8_t * data, int dataSizeBytes, bool prependTreeToBitStream, int segmentSizeBytes = 0);
+
+    // Same, but writes to a fixed caller buffer instead of the heap
+    // (see BitStreamWriter::hasOverflowed() if it might be too small).
+    Encoder(const std::uint8_t * data, int dataSizeBytes, bool prependTreeToBitStream,
+            std::uint8_t * outputBuffer, int outputBufferSizeBytes);
 
     // Find node can be used by a decoder to reconstruct
     // the original data from a bit stream of Huffman codes.
@@ -358,13 +449,12 @@ private:
         }
     };
 
-    // Queue stores pointers into the nodes[] array below.
-    using PQueue = std::priority_queue<Node *, std::vector<Node *>, NodeCmp>;
-
     // Internal helpers:
+    void encode(const std::uint8_t * data, int dataSizeBytes, bool prependTreeToBitStream);
     void buildHuffmanTree();
     void writeTreeBitStream();
     void writeDataBitStream(const std::uint8_t * data, int dataSizeBytes);
+    void writeSegmentedDataBitStream(const std::uint8_t * data, int dataSizeBytes);
     void countFrequencies(const std::uint8_t * data, int dataSizeBytes);
     void recursiveAssignCodes(Node * node, const Node * parent, int bit);
     const Node * recursiveFindLeaf(const Node * node, Code code) const;
@@ -377,9 +467,112 @@ private:
 
     Node * treeRoot;
     int treePrefixBits;
+    int segmentSize;
 
     // Fixed-size pool of nodes. We don't explicitly allocate memory in the encoder.
     std::array<Node, MaxNodes> nodes;
+
+    // Binary heap of pointers into nodes[] used as the priority queue while
+    // building the tree. The queue never holds more than one node per symbol.
+    std::array<Node *, MaxSymbols> queue;
+};
+
+// ========================================================
+// Huffman decode table:
+// ========================================================
+
+class DecodeTable final
+{
+public:
+
+    // Codes up to this length are resolved with a single table
+    // lookup on the next TableBits bits of the stream. Longer codes
+    // are rare and fall back to a search of the long code list.
+    static constexpr int TableBits = 11;
+    static constexpr int TableSize = 1 << TableBits;
+
+    // The optional pair table is indexed by the next PairTableBits
+    // bits and yields two symbols when both codes fit in that window.
+    static constexpr int PairTableBits = 12;
+    static constexpr int PairTableSize = 1 << PairTableBits;
+
+    struct Entry
+    {
+        std::uint8_t symbol; // Decoded byte.
+        std::uint8_t length; // Code length in bits; zero if the code is not in the table.
+    };
+
+    struct PairEntry
+    {
+        std::uint8_t symbols[2]; // Decoded bytes. The second is only valid if count is 2.
+        std::uint8_t length;     // Total bits consumed by the entry.
+        std::uint8_t count;      // Number of symbols decoded; zero if not resolved by this table.
+    };
+
+    DecodeTable() { clear(); }
+
+    void clear();
+    void addCode(int symbol, std::uint64_t codeBits, int codeLength);
+
+    // Builds the pair table once all codes were added. That's a pass
+    // over 4096 entries, so it is only worth it for larger outputs.
+    void addSymbolPairs();
+    bool hasSymbolPairs() const { return pairedEntries; }
+
+    // Raw entry lookups for the decode loop.
+    const Entry & getEntry(const std::uint64_t bits) const
+    {
+        return entries[bits & (TableSize - 1)];
+    }
+    const PairEntry & getPairEntry(const std::uint64_t bits) const
+    {
+        return pairs[bits & (PairTableSize - 1)];
+    }
+
+    // Finds the code that prefixes 'bits' (the next bits in the stream,
+    // first bit in the LSB). Returns its length in bits and the symbol
+    // in 'symbol', or zero if no code matches.
+    int decodeSymbol(std::uint64_t bits, int * symbol) const
+    {
+        const Entry entry = getEntry(bits);
+        if (entry.length != 0)
+        {
+            *symbol = entry.symbol;
+            return entry.length;
+        }
+        return findLongCode(bits, symbol);
+    }
+
+    int getLongCodeCount() const { return longCodeCount; }
+
+private:
+
+    int findLongCode(std::uint64_t bits, int * symbol) const;
+
+    // Directly indexed by the next TableBits bits of the stream.
+    std::array<Entry, TableSize> entries;
+
+    // Directly indexed by the next PairTableBits bits of the stream.
+    // Left uninitialized until addSymbolPairs().
+    std::array<PairEntry, PairTableSize> pairs;
+
+    // Codes longer than TableBits.
+    std::array<std::uint64_t, MaxSymbols> longCodeBits;
+    std::array<std::uint8_t,  MaxSymbols> longCodeLengths;
+    std::array<std::uint8_t,  MaxSymbols> longCodeSymbols;
+    int longCodeCount;
+    bool pairedEntries;
+};
+
+// ========================================================
+// Scatter/gather output:
+// ========================================================
+
+// One piece of a scatter/gather output buffer, like a POSIX iovec.
+struct OutputSegment
+{
+    std::uint8_t * data;
+    int sizeBytes;
 };
 
 // ========================================================
@@ -403,20 +596,73 @@ public:
     // from dataSizeBytes if there is an error or size mismatch.
     int decode(std::uint8_t * data, int dataSizeBytes);
 
+    // Same as decode(), but writes to a list of buffers that are
+    // filled in order as if they were a single contiguous buffer.
+    int decode(const OutputSegment * outputSegments, int outputSegmentCount);
+
+    // Same as decode(), but the segments of a segmented stream are
+    // spread over threadCount threads (0 = one per hardware thread).
+    // Large single stream inputs are split speculatively (see below).
+    int decodeParallel(std::uint8_t * data, int dataSizeBytes, int threadCount);
+
+    // Decodes the next windowSize bytes, resuming from where the previous
+    // call stopped. Returns less than windowSize only at the end of the data.
+    int decodeWindow(std::uint8_t * window, int windowSize);
+
+    // Number of independently decodable segments; 1 for a single stream.
+    int getSegmentCount() const { return segments.empty() ? 1 : static_cast<int>(segments.size()); }
+
 private:
 
+    // Entry of the jump table that follows the tree in segmented streams.
+    struct Segment
+    {
+        int decodedBytes; // Uncompressed size of the segment.
+        int sizeInBits;   // Compressed size, not including the padding to a byte.
+        int byteOffset;   // Start of the segment in the bit stream (always at a byte boundary).
+        int outputOffset; // Start of the segment in the uncompressed data.
+    };
+
+    // A slice of a single stream decoded speculatively from an arbitrary
+    // bit offset, for decodeParallel(). Remembers where its codes start.
+    struct SpeculativeChunk
+    {
+        int startBit;     // First bit of the chunk. Most likely not the start of a code.
+        int endBit;       // One past the last bit. The last code may run past it.
+        int exitBit;      // Start of the first code at or after endBit.
+        int symbolCount;  // Symbols decoded between startBit and exitBit.
+        std::vector<std::uint64_t> codeStarts; // One bit per chunk bit, set where a code starts.
+
+        bool isCodeStart(const int bit) const
+        {
+            const int i = bit - startBit;
+            return (codeStarts[i >> 6] >> (i & 63)) & 1;
+        }
+    };
+
     // Internal helpers:
     void readPrefixData();
-    int findMatchingCode(const Code code) const;
+    void readJumpTable();
+    int decodeSpeculative(std::uint8_t * data, int dataSizeBytes, int threadCount);
+    void speculateChunk(SpeculativeChunk & chunk) const;
+    void prepareDecodeTable(int dataSizeBytes);
+    int decodeSegment(int segmentIndex, std::uint8_t * data, int dataSizeBytes) const;
+    int decodeBits(BitStreamReader & reader, std::uint8_t * data, int dataSizeBytes, bool stopWhenFull = false) const;
 
     // Helps us manipulate the external raw buffer.
     BitStreamReader bitStream;
 
-    // Assume the output is only storing the leaf nodes.
-    // We also don't need to store a full Node here, just
-    // its code, since the value/symbol is implicit by the
-    // position within the array.
-    std::array<Code, MaxSymbols> codes;
+    // Empty unless the stream is segmented.
+    std::vector<Segment> segments;
+
+    // Where decodeWindow() resumes in a segmented stream.
+    int windowSegment; // Segment to decode from.
+    int windowBitPos;  // Bits of that segment already consumed.
+
+    // Built straight from the (code_length, code_bits) pairs of the
+    // stream prefix. The symbol of each code is implicit by its
+    // position in the prefix, so we don't need to keep the codes.
+    DecodeTable decodeTable;
 };
 
 // ========================================================
@@ -436,6 +682,142 @@ void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
 int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
                std::uint8_t * uncompressed, int uncompressedSizeBytes);
 
+// Decompress straight into a list of buffers (e.g. network buffers or pages),
+// which are filled in order as if they were a single contiguous buffer.
+// Accepts both single and segmented streams. Same return value as easyDecode().
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               const OutputSegment * outputSegments, int outputSegmentCount);
+
+// Default segment size for easyEncodeSegmented().
+constexpr int DefaultSegmentSizeBytes = 256 * 1024;
+
+// Same as easyEncode(), but the data codes are split in independently
+// decodable segments of segmentSizeBytes uncompressed bytes each,
+// so the output can be decoded with easyDecodeParallel(). Costs 32
+// bits for the segment count plus 64 bits and some padding per segment.
+void easyEncodeSegmented(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                         std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits,
+                         int segmentSizeBytes = DefaultSegmentSizeBytes);
+
+// Decompress the output of easyEncodeSegmented() with up to threadCount
+// threads (0 = one per hardware thread). Also accepts easyEncode() output,
+// which is split at arbitrary bit offsets and resynchronized (large inputs
+// only, the small ones are decoded sequentially). Same return value as easyDecode().
+int easyDecodeParallel(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+                       std::uint8_t * uncompressed, int uncompressedSizeBytes, int threadCount = 0);
+
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+// For small stacks and no heap at all (e.g. thousands of fibers with 16KB
+// stacks), the overloads below write to caller buffers and construct the
+// Encoder/Decoder in a caller-provided workspace of workspaceSize() bytes.
+// They never call HUFFMAN_MALLOC and use about 5KB of stack, most of it the
+// split histogram. The output of easyEncode() is never larger than the input
+// plus MaxTreePrefixBytes.
+constexpr int MaxTreePrefixBytes = 2 + 2 + MaxSymbols * (2 + 8);
+int workspaceSize();
+
+// Returns the compressed size in bytes, or zero if the output buffer or the
+// workspace was too small (HUFFMAN_ERROR() is called first). Same stream as
+// the heap-allocating easyEncode().
+int easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+               std::uint8_t * compressed, int compressedCapacityBytes, int * compressedSizeBits,
+               void * workspace, int workspaceSizeBytes);
+
+// Same as the contiguous easyDecode(), with the Decoder in the workspace.
+// Segmented streams are refused, since their jump table lives on the heap.
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               std::uint8_t * uncompressed, int uncompressedSizeBytes,
+               void * workspace, int workspaceSizeBytes);
+
+// ========================================================
+// class WindowDecoder:
+// ========================================================
+
+// Decodes the output of easyEncode() or easyEncodeSegmented() one
+// fixed-size window at a time, so the data can be consumed while it is
+// decoded and only a window of it has to be kept in memory, instead of
+// the whole uncompressed size.
+class WindowDecoder final
+{
+public:
+
+    static constexpr int DefaultWindowSizeBytes = 64 * 1024;
+
+    // No copy/assignment.
+    WindowDecoder(const WindowDecoder &) = delete;
+    WindowDecoder & operator = (const WindowDecoder &) = delete;
+
+    WindowDecoder(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+                  int windowSizeBytes = DefaultWindowSizeBytes);
+    ~WindowDecoder();
+
+    // Decodes the next window and points *window to it. Returns its size
+    // in bytes, which is only less than the window size for the last one,
+    // and 0 once the stream is over. The data stays valid until the next call.
+    int next(const std::uint8_t ** window);
+
+    // Total bytes returned by next() so far.
+    int getBytesDecoded() const { return bytesDecoded; }
+
+private:
+
+    Decoder decoder;
+    std::uint8_t * buffer;
+    const int windowSize;
+    int bytesDecoded;
+};
+
+// ========================================================
+// class StaticTable:
+// ========================================================
+
+// Longest code a StaticTable assigns. Rare symbols get their
+// frequencies flattened until the tree fits in this depth.
+constexpr int MaxStaticCodeBits = 16;
+
+// A code table built once from a fixed table of symbol frequencies, for
+// data that follows a well-known distribution (text, a given protocol).
+// Streams coded with it have no tree prefix, so there's no histogram,
+// tree or header work per call. Symbols with a zero frequency still get
+// a (long) code, so any input can be encoded. The codes are canonical,
+// so the same frequencies always produce the same table. Build it once
+// and share it, e.g.: static const huffman::StaticTable table(myFrequencies);
+class StaticTable final
+{
+public:
+
+    // No copy/assignment.
+    StaticTable(const StaticTable &) = delete;
+    StaticTable & operator = (const StaticTable &) = delete;
+
+    // 'frequencies' has one entry per byte value (MaxSymbols).
+    explicit StaticTable(const std::uint32_t * frequencies);
+
+    const Code & getCode(const int symbol) const { return codes[symbol]; }
+    const DecodeTable & getDecodeTable() const { return decodeTable; }
+
+private:
+
+    Code codes[MaxSymbols];
+    DecodeTable decodeTable;
+};
+
+// Built-in table for English/ASCII text. Built on first use.
+const StaticTable & getAsciiTextTable();
+
+// Header-less compression with a StaticTable. Output compressed data is heap
+// allocated with HUFFMAN_MALLOC() and should be later freed with HUFFMAN_MFREE().
+void easyEncodeStatic(const StaticTable & table, const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                      std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits);
+
+// Decompress back the output of easyEncodeStatic(), using the same table.
+// Same return value as easyDecode().
+int easyDecodeStatic(const StaticTable & table, const std::uint8_t * compressed, int compressedSizeBytes,
+                     int compressedSizeBits, std::uint8_t * uncompressed, int uncompressedSizeBytes);
+
 } // namespace huffman {}
 
 // ================== End of header file ==================
@@ -454,8 +836,35 @@ int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int com
     #include <cstdio> // For the default error handler
 #endif // HUFFMAN_USING_DEFAULT_ERROR_HANDLER
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstring>
+#include <functional>
+#include <new>
+#include <utility>
+
+#ifndef HUFFMAN_NO_THREADS
+    #include <thread>
+#endif // HUFFMAN_NO_THREADS
+
+#if !defined(HUFFMAN_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define HUFFMAN_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define HUFFMAN_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define HUFFMAN_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define HUFFMAN_X86_SIMD 0
+#endif // x86
+
+#ifdef HUFFMAN_ENABLE_STATS
+    #include <chrono>
+#endif // HUFFMAN_ENABLE_STATS
 
 namespace huffman
 {
@@ -490,6 +899,23 @@ static int bitsForInteger(int num)
     return bits;
 }
 
+#ifndef HUFFMAN_NO_THREADS
+
+// Number of bits set in a long word.
+static int popCount64(std::uint64_t num)
+{
+    #if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(num);
+    #else // Portable SWAR version
+    num = num - ((num >> 1) & 0x5555555555555555ULL);
+    num = (num & 0x3333333333333333ULL) + ((num >> 2) & 0x3333333333333333ULL);
+    num = (num + (num >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((num * 0x0101010101010101ULL) >> 56);
+    #endif // __GNUC__ || __clang__
+}
+
+#endif // HUFFMAN_NO_THREADS
+
 // ========================================================
 
 #ifdef HUFFMAN_USING_DEFAULT_ERROR_HANDLER
@@ -506,6 +932,267 @@ void fatalError(const char * const message)
 
 #endif // HUFFMAN_USING_DEFAULT_ERROR_HANDLER
 
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef HUFFMAN_ENABLE_STATS
+
+// Adds its own lifetime in nanoseconds to one of the Stats counters.
+class StatsTimer final
+{
+public:
+
+    // No copy/assignment.
+    StatsTimer(const StatsTimer &) = delete;
+    StatsTimer & operator = (const StatsTimer &) = delete;
+
+    explicit StatsTimer(std::uint64_t & counter)
+        : nanoseconds(counter)
+        , startTime(std::chrono::steady_clock::now())
+    { }
+
+    ~StatsTimer()
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - startTime;
+        nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+private:
+
+    std::uint64_t & nanoseconds;
+    const std::chrono::steady_clock::time_point startTime;
+};
+
+    #define HUFFMAN_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+    #define HUFFMAN_STATS_TIMER(counter) const StatsTimer statsTimer_##counter(statsInstance().counter)
+#else // !HUFFMAN_ENABLE_STATS
+    #define HUFFMAN_STATS_ADD(counter, amount) ((void)0)
+    #define HUFFMAN_STATS_TIMER(counter) ((void)0)
+#endif // HUFFMAN_ENABLE_STATS
+
+#ifndef HUFFMAN_NO_THREADS
+
+// Decoding threads count into their own thread_local Stats, which go away
+// with the thread. The thread that joins them adds their counts with this.
+static void addDecodeStats(const Stats & threadStats)
+{
+    HUFFMAN_STATS_ADD(bitsRead,          threadStats.bitsRead);
+    HUFFMAN_STATS_ADD(bytesDecoded,      threadStats.bytesDecoded);
+    HUFFMAN_STATS_ADD(decodeTableMisses, threadStats.decodeTableMisses);
+    (void)threadStats;
+}
+
+#endif // HUFFMAN_NO_THREADS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if HUFFMAN_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+#endif // HUFFMAN_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if HUFFMAN_X86_SIMD
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.bmi2 = (regs[1] & (1u << 3)) != 0 && (regs[1] & (1u << 8)) != 0; // BMI1 + BMI2
+    }
+    #endif // HUFFMAN_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Histogram:
+// ========================================================
+
+// Counts the occurrences of each byte value. Four interleaved sub-histograms
+// break the store-to-load dependency on repeated symbols (long runs of the
+// same byte would otherwise serialize on a single counter). There's no AVX2
+// or AVX-512 variant since scatter/gather based histograms are no faster.
+static void histogramScalar(const std::uint8_t * data, const int dataSizeBytes, std::uint32_t * counts)
+{
+    std::uint32_t banks[4][256];
+    std::memset(banks, 0, sizeof(banks));
+
+    int i = 0;
+    for (; i + 4 <= dataSizeBytes; i += 4)
+    {
+        ++banks[0][data[i + 0]];
+        ++banks[1][data[i + 1]];
+        ++banks[2][data[i + 2]];
+        ++banks[3][data[i + 3]];
+    }
+    for (; i < dataSizeBytes; ++i)
+    {
+        ++banks[0][data[i]];
+    }
+
+    for (int s = 0; s < 256; ++s)
+    {
+        counts[s] = banks[0][s] + banks[1][s] + banks[2][s] + banks[3][s];
+    }
+}
+
+// ========================================================
+// Bit packing kernels:
+// ========================================================
+
+// Bit streams are filled from the least significant bit of each byte,
+// so an unaligned little-endian 64-bit load lines up a window of bits
+// we can shift and mask in one go rather than looping bit by bit.
+// The kernels handle up to MaxFastBits bits per call and need 8 valid
+// bytes starting at the byte that contains bitPos. This is also the longest
+// code the decoder accepts, so the encoder must not write longer ones.
+constexpr int MaxFastBits = 57;
+
+static std::uint64_t loadU64(const std::uint8_t * bytes)
+{
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    return word;
+}
+
+static void storeU64(std::uint8_t * bytes, std::uint64_t word)
+{
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    std::memcpy(bytes, &word, sizeof(word));
+}
+
+static std::uint64_t peekBitsScalar(const std::uint8_t * stream, const int bitPos, const int bitCount)
+{
+    const std::uint64_t word = loadU64(stream + (bitPos >> 3)) >> (bitPos & 7);
+    return word & ((std::uint64_t(1) << bitCount) - 1);
+}
+
+static void pokeBitsScalar(std::uint8_t * stream, const int bitPos, const std::uint64_t num, const int bitCount)
+{
+    const int shift = bitPos & 7;
+    const std::uint64_t mask = ((std::uint64_t(1) << bitCount) - 1) << shift;
+    std::uint8_t * bytes = stream + (bitPos >> 3);
+    storeU64(bytes, (loadU64(bytes) & ~mask) | ((num << shift) & mask));
+}
+
+#if HUFFMAN_X86_SIMD && (defined(__x86_64__) || defined(_M_X64))
+
+// Same as above, but bzhi does the masking and the variable
+// shifts compile to shrx/shlx (no flags, no CL register).
+HUFFMAN_TARGET("bmi,bmi2")
+static std::uint64_t peekBitsBMI2(const std::uint8_t * stream, const int bitPos, const int bitCount)
+{
+    const std::uint64_t word = loadU64(stream + (bitPos >> 3));
+    return _bzhi_u64(word >> (bitPos & 7), static_cast<unsigned>(bitCount));
+}
+
+HUFFMAN_TARGET("bmi,bmi2")
+static void pokeBitsBMI2(std::uint8_t * stream, const int bitPos, const std::uint64_t num, const int bitCount)
+{
+    const int shift = bitPos & 7;
+    const std::uint64_t mask = _bzhi_u64(~std::uint64_t(0), static_cast<unsigned>(bitCount)) << shift;
+    std::uint8_t * bytes = stream + (bitPos >> 3);
+    storeU64(bytes, (loadU64(bytes) & ~mask) | (_bzhi_u64(num, static_cast<unsigned>(bitCount)) << shift));
+}
+
+#endif // HUFFMAN_X86_SIMD && x64
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+struct Kernels
+{
+    std::uint64_t (*peekBits)(const std::uint8_t * stream, int bitPos, int bitCount);
+    void (*pokeBits)(std::uint8_t * stream, int bitPos, std::uint64_t num, int bitCount);
+};
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.peekBits = &peekBitsScalar;
+    kernels.pokeBits = &pokeBitsScalar;
+
+    #if HUFFMAN_X86_SIMD && (defined(__x86_64__) || defined(_M_X64))
+    if (features.bmi2)
+    {
+        kernels.peekBits = &peekBitsBMI2;
+        kernels.pokeBits = &pokeBitsBMI2;
+    }
+    #else // !x64
+    (void)features;
+    #endif // HUFFMAN_X86_SIMD && x64
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.bmi2 = features.bmi2 && detected.bmi2;
+
+    kernelsInstance() = selectKernels(current);
+}
+
 // ========================================================
 // class BitStreamWriter:
 // ========================================================
@@ -525,9 +1212,17 @@ BitStreamWriter::BitStreamWriter(const int initialSizeInBits, const int growthGr
     allocate(initialSizeInBits);
 }
 
+BitStreamWriter::BitStreamWriter(std::uint8_t * buffer, const int bufferSizeBytes)
+{
+    internalInit();
+    stream         = buffer;
+    bytesAllocated = (buffer != nullptr && bufferSizeBytes > 0) ? bufferSizeBytes : 0;
+    granularity    = 0;
+}
+
 BitStreamWriter::~BitStreamWriter()
 {
-    if (stream != nullptr)
+    if (stream != nullptr && granularity != 0)
     {
         HUFFMAN_MFREE(stream);
     }
@@ -536,6 +1231,7 @@ BitStreamWriter::~BitStreamWriter()
 void BitStreamWriter::internalInit()
 {
     stream         = nullptr;
+    overflowed     = false;
     bytesAllocated = 0;
     granularity    = 2;
     currBytePos    = 0;
@@ -563,13 +1259,26 @@ void BitStreamWriter::allocate(int bitsWanted)
     {
         return;
     }
+    if (granularity == 0)
+    {
+        overflowed = true;
+        return;
+    }
 
+    HUFFMAN_STATS_ADD(allocatorGrowths, stream != nullptr);
     stream = allocBytes(sizeInBytes, stream, bytesAllocated);
     bytesAllocated = sizeInBytes;
 }
 
 void BitStreamWriter::appendBit(const int bit)
 {
+    // Only a fixed buffer can be full here.
+    if (currBytePos == bytesAllocated)
+    {
+        overflowed = true;
+        return;
+    }
+
     const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
     stream[currBytePos] = (stream[currBytePos] & ~mask) | (-bit & mask);
     ++numBitsWritten;
@@ -577,7 +1286,7 @@ void BitStreamWriter::appendBit(const int bit)
     if (++nextBitPos == 8)
     {
         nextBitPos = 0;
-        if (++currBytePos == bytesAllocated)
+        if (++currBytePos == bytesAllocated && granularity != 0)
         {
             allocate(bytesAllocated * granularity * 8);
         }
@@ -587,20 +1296,39 @@ void BitStreamWriter::appendBit(const int bit)
 void BitStreamWriter::appendBitsU64(const std::uint64_t num, const int bitCount)
 {
     assert(bitCount <= 64);
-    for (int b = 0; b < bitCount; ++b)
+    if (bitCount > MaxFastBits)
     {
-        const std::uint64_t mask = std::uint64_t(1) << b;
-        const int bit = !!(num & mask);
-        appendBit(bit);
+        // Split it so each half fits a single kernel call.
+        appendBitsU64(num & 0xFFFFFFFF, 32);
+        appendBitsU64(num >> 32, bitCount - 32);
+        return;
     }
-}
 
-void BitStreamWriter::appendCode(const Code code)
-{
-    for (int b = 0; b < code.getLength(); ++b)
+    // The kernel touches 8 bytes, and appendBit() expects
+    // the current byte to be valid afterwards, so need 9.
+    while (currBytePos + 9 > bytesAllocated)
     {
-        appendBit(code.getBit(b));
-    }
+        if (granularity == 0)
+        {
+            // Last few bytes of a fixed buffer.
+            for (int b = 0; b < bitCount; ++b)
+            {
+                appendBit(static_cast<int>((num >> b) & 1));
+            }
+            return;
+        }
+        allocate(bytesAllocated * granularity * 8);
+    }
+
+    kernelsInstance().pokeBits(stream, numBitsWritten, num, bitCount);
+    numBitsWritten += bitCount;
+    currBytePos = numBitsWritten >> 3;
+    nextBitPos  = numBitsWritten & 7;
+}
+
+void BitStreamWriter::appendCode(const Code code)
+{
+    appendBitsU64(code.getAsU64(), code.getLength());
 }
 
 #ifndef HUFFMAN_NO_STD_STRING
@@ -648,7 +1376,10 @@ std::uint8_t * BitStreamWriter::release()
 
 void BitStreamWriter::setGranularity(const int growthGranularity)
 {
-    granularity = (growthGranularity >= 2) ? growthGranularity : 2;
+    if (granularity != 0)
+    {
+        granularity = (growthGranularity >= 2) ? growthGranularity : 2;
+    }
 }
 
 int BitStreamWriter::getByteCount() const
@@ -732,6 +1463,18 @@ std::uint64_t BitStreamReader::readBitsU64(const int bitCount)
 {
     assert(bitCount <= 64);
 
+    // Fast path: grab the whole thing with a single kernel call
+    // when there are enough bytes left for its 64-bit load.
+    if (bitCount <= MaxFastBits && numBitsRead + bitCount <= sizeInBits && currBytePos + 8 <= sizeInBytes)
+    {
+        currCode.setAsU64(kernelsInstance().peekBits(stream, numBitsRead, bitCount));
+        currCode.setLength(bitCount);
+        numBitsRead += bitCount;
+        currBytePos = numBitsRead >> 3;
+        nextBitPos  = numBitsRead & 7;
+        return currCode.getAsU64();
+    }
+
     // We can reuse the Code reading infrastructure for this.
     // This is arguably a little hackish, but gets the job done...
     currCode.clear();
@@ -746,6 +1489,34 @@ std::uint64_t BitStreamReader::readBitsU64(const int bitCount)
     return currCode.getAsU64();
 }
 
+std::uint64_t BitStreamReader::peekBitsU64(const int bitCount) const
+{
+    assert(bitCount <= MaxFastBits);
+
+    // This runs once per decoded symbol, so we call the scalar kernel
+    // directly; inlined it is cheaper than an indirect call to BMI2.
+    if (currBytePos + 8 <= sizeInBytes)
+    {
+        return peekBitsScalar(stream, numBitsRead, bitCount);
+    }
+
+    // Near the end of the buffer: assemble the bits one byte at
+    // a time so we never touch memory past sizeInBytes.
+    std::uint64_t word = 0;
+    for (int b = 0; b < 8 && currBytePos + b < sizeInBytes; ++b)
+    {
+        word |= std::uint64_t(stream[currBytePos + b]) << (b * 8);
+    }
+    return (word >> nextBitPos) & ((std::uint64_t(1) << bitCount) - 1);
+}
+
+void BitStreamReader::skipBits(const int bitCount)
+{
+    numBitsRead = (numBitsRead + bitCount < sizeInBits) ? numBitsRead + bitCount : sizeInBits;
+    currBytePos = numBitsRead >> 3;
+    nextBitPos  = numBitsRead & 7;
+}
+
 void BitStreamReader::reset()
 {
     currBytePos = 0;
@@ -758,31 +1529,84 @@ void BitStreamReader::reset()
 // class Encoder:
 // ========================================================
 
-Encoder::Encoder(const std::uint8_t * data, const int dataSizeBytes, const bool prependTreeToBitStream)
+Encoder::Encoder(const std::uint8_t * data, const int dataSizeBytes,
+                 const bool prependTreeToBitStream, const int segmentSizeBytes)
     : treeRoot(nullptr)
     , treePrefixBits(0)
+    , segmentSize(segmentSizeBytes)
+{
+    if (segmentSize != 0 && (segmentSize < 0 || !prependTreeToBitStream))
+    {
+        HUFFMAN_ERROR("Segmented streams need a positive segment size and the tree prefix!");
+        segmentSize = 0;
+    }
+
+    encode(data, dataSizeBytes, prependTreeToBitStream);
+}
+
+Encoder::Encoder(const std::uint8_t * data, const int dataSizeBytes, const bool prependTreeToBitStream,
+                 std::uint8_t * outputBuffer, const int outputBufferSizeBytes)
+    : bitStream(outputBuffer, outputBufferSizeBytes)
+    , treeRoot(nullptr)
+    , treePrefixBits(0)
+    , segmentSize(0)
+{
+    encode(data, dataSizeBytes, prependTreeToBitStream);
+}
+
+void Encoder::encode(const std::uint8_t * data, const int dataSizeBytes, const bool prependTreeToBitStream)
 {
-    countFrequencies(data, dataSizeBytes);
-    buildHuffmanTree();
+    HUFFMAN_STATS_ADD(encodeCalls, 1);
+    HUFFMAN_STATS_ADD(bytesEncoded, dataSizeBytes);
+
+    {
+        HUFFMAN_STATS_TIMER(treeBuildNanos);
+        countFrequencies(data, dataSizeBytes);
+        buildHuffmanTree();
+    }
 
     if (prependTreeToBitStream)
     {
+        HUFFMAN_STATS_TIMER(treeWriteNanos);
         writeTreeBitStream();
     }
 
-    writeDataBitStream(data, dataSizeBytes);
+    {
+        HUFFMAN_STATS_TIMER(dataEmitNanos);
+        if (segmentSize != 0)
+        {
+            writeSegmentedDataBitStream(data, dataSizeBytes);
+        }
+        else
+        {
+            writeDataBitStream(data, dataSizeBytes);
+        }
+    }
+
+    HUFFMAN_STATS_ADD(bitsWritten, bitStream.getBitCount());
 }
 
 void Encoder::buildHuffmanTree()
 {
-    PQueue pQueue;
+    // Same heap operations std::priority_queue would do, on a fixed array.
+    int queueSize = 0;
+    const auto push = [this, &queueSize](Node * node)
+    {
+        queue[queueSize++] = node;
+        std::push_heap(queue.begin(), queue.begin() + queueSize, NodeCmp{});
+    };
+    const auto pop = [this, &queueSize]()
+    {
+        std::pop_heap(queue.begin(), queue.begin() + queueSize, NodeCmp{});
+        return queue[--queueSize];
+    };
 
     // Put each symbol node into a priority queue:
     for (int s = 0; s < MaxSymbols; ++s)
     {
         if (nodes[s].isValid())
         {
-            pQueue.push(&nodes[s]);
+            push(&nodes[s]);
         }
     }
 
@@ -797,20 +1621,16 @@ void Encoder::buildHuffmanTree()
     //
     // The remaining node is the root node and the tree is complete.
     //
-    while (pQueue.size() > 1)
+    while (queueSize > 1)
     {
-        const auto child0 = pQueue.top();
-        pQueue.pop();
-
-        const auto child1 = pQueue.top();
-        pQueue.pop();
-
-        pQueue.push(addInnerNode(child0->frequency + child1->frequency, child0->value, child1->value));
+        const auto child0 = pop();
+        const auto child1 = pop();
+        push(addInnerNode(child0->frequency + child1->frequency, child0->value, child1->value));
     }
 
     // Now we can assign the binary codes, starting from 0 at the root:
-    assert(!pQueue.empty());
-    treeRoot = pQueue.top();
+    assert(queueSize == 1);
+    treeRoot = queue[0];
     recursiveAssignCodes(treeRoot, nullptr, 0);
 }
 
@@ -859,22 +1679,18 @@ void Encoder::recursiveAssignCodes(Node * node, const Node * parent, const int b
     }
 }
 
-void Encoder::countFrequencies(const std::uint8_t * data, int dataSizeBytes)
+void Encoder::countFrequencies(const std::uint8_t * data, const int dataSizeBytes)
 {
-    for (; dataSizeBytes > 0; --dataSizeBytes, ++data)
-    {
-        // We'll use the value of each byte as the symbol index, since our table has 256+ entries.
-        const int nodeIndex = *data;
+    std::uint32_t counts[MaxSymbols];
+    histogramScalar(data, dataSizeBytes, counts);
 
-        // First occurrence?
-        if (!nodes[nodeIndex].isValid())
-        {
-            nodes[nodeIndex].frequency = 1;
-            nodes[nodeIndex].value = *data;
-        }
-        else // Recurrent symbol:
+    // We'll use the value of each byte as the symbol index, since our table has 256+ entries.
+    for (int s = 0; s < MaxSymbols; ++s)
+    {
+        if (counts[s] != 0)
         {
-            nodes[nodeIndex].frequency++;
+            nodes[s].frequency = static_cast<int>(counts[s]);
+            nodes[s].value = s;
         }
     }
 }
@@ -892,6 +1708,59 @@ void Encoder::writeDataBitStream(const std::uint8_t * data, int dataSizeBytes)
     }
 }
 
+void Encoder::writeSegmentedDataBitStream(const std::uint8_t * data, const int dataSizeBytes)
+{
+    //
+    // A segmented stream follows the tree prefix with a jump table:
+    //
+    // +---------------+--------------------------------+
+    // | segment_count | segment_count * (bytes, bits)  |
+    // +---------------+--------------------------------+
+    //   ^-- 32 bits     ^-- 32 bits each: uncompressed bytes
+    //                       and code bits of every segment
+    //
+    // Then the segments themselves, each starting at a byte boundary,
+    // so the decoder can find any of them from the table alone.
+    //
+    const int segmentCount = (dataSizeBytes + segmentSize - 1) / segmentSize;
+    bitStream.appendBitsU64(segmentCount, 32);
+
+    for (int seg = 0; seg < segmentCount; ++seg)
+    {
+        const int segmentStart = seg * segmentSize;
+        const int segmentBytes = (dataSizeBytes - segmentStart < segmentSize) ? dataSizeBytes - segmentStart : segmentSize;
+
+        // Sum the code lengths up front so the table can be written first.
+        std::uint64_t segmentBits = 0;
+        for (int b = segmentStart; b < segmentStart + segmentBytes; ++b)
+        {
+            segmentBits += nodes[data[b]].code.getLength();
+        }
+        if (segmentBits > 0xFFFFFFFF)
+        {
+            HUFFMAN_ERROR("Segment too big! Use a smaller segment size.");
+            return;
+        }
+
+        bitStream.appendBitsU64(segmentBytes, 32);
+        bitStream.appendBitsU64(segmentBits,  32);
+    }
+
+    for (int seg = 0; seg < segmentCount; ++seg)
+    {
+        const int segmentStart = seg * segmentSize;
+        const int segmentBytes = (dataSizeBytes - segmentStart < segmentSize) ? dataSizeBytes - segmentStart : segmentSize;
+
+        writeDataBitStream(data + segmentStart, segmentBytes);
+
+        // Pad to a full byte if needed:
+        while ((bitStream.getBitCount() % 8) != 0)
+        {
+            bitStream.appendBit(0);
+        }
+    }
+}
+
 void Encoder::writeTreeBitStream()
 {
     assert(treeRoot != nullptr);
@@ -925,15 +1794,16 @@ void Encoder::writeTreeBitStream()
         }
     }
 
-    // Code length is currently limited to uint64!
-    if (maxCodeLengthInBits <= 0 || maxCodeLengthInBits > Code::MaxBits)
+    // Longer codes would fit the uint64, but the decoder rejects them.
+    if (maxCodeLengthInBits <= 0 || maxCodeLengthInBits > MaxFastBits)
     {
-        HUFFMAN_ERROR("Unexpected code length! Should be <= Code::MaxBits.");
+        HUFFMAN_ERROR("Unexpected code length! Should be <= MaxFastBits.");
         return;
     }
 
-    // Write the counts:
-    const int numberOfCodes   = MaxSymbols;
+    // Write the counts. Segmented streams have the SegmentedStreamTag
+    // bit set in the number of codes so the decoder can tell them apart.
+    const int numberOfCodes   = MaxSymbols | (segmentSize != 0 ? SegmentedStreamTag : 0);
     const int codeLengthWidth = bitsForInteger(maxCodeLengthInBits);
     bitStream.appendBitsU64(numberOfCodes,   16);
     bitStream.appendBitsU64(codeLengthWidth, 16);
@@ -1010,94 +1880,367 @@ int Encoder::getTreePrefixBits() const
     return treePrefixBits;
 }
 
+// ========================================================
+// class DecodeTable:
+// ========================================================
+
+// Smallest single stream chunk Decoder::decodeParallel() hands to a thread.
+// Smaller chunks would spend more time resynchronizing than decoding.
+constexpr int MinSpeculativeChunkBits = 1 << 16;
+
+// Smallest output for which Decoder::decode() builds the pair table.
+// Below that the single symbol table alone is faster overall.
+constexpr int MultiSymbolMinBytes = 4096;
+
+void DecodeTable::clear()
+{
+    std::memset(entries.data(), 0, sizeof(entries));
+    longCodeCount = 0;
+    pairedEntries = false;
+}
+
+void DecodeTable::addCode(const int symbol, const std::uint64_t codeBits, const int codeLength)
+{
+    assert(symbol >= 0 && symbol < MaxSymbols);
+    assert(codeLength > 0 && codeLength <= MaxFastBits);
+
+    if (codeLength > TableBits)
+    {
+        longCodeBits[longCodeCount]    = codeBits;
+        longCodeLengths[longCodeCount] = static_cast<std::uint8_t>(codeLength);
+        longCodeSymbols[longCodeCount] = static_cast<std::uint8_t>(symbol);
+        ++longCodeCount;
+        return;
+    }
+
+    //
+    // Our codes come straight from the tree rather than being canonical,
+    // and the first bit of a code is the least significant bit in the
+    // stream, so the entries sharing a code are not a contiguous range.
+    // They are every index whose low codeLength bits equal the code,
+    // which we fill with a stride of 1 << codeLength.
+    //
+    const Entry entry = { static_cast<std::uint8_t>(symbol), static_cast<std::uint8_t>(codeLength) };
+    const int stride = 1 << codeLength;
+    for (int i = static_cast<int>(codeBits); i < TableSize; i += stride)
+    {
+        entries[i] = entry;
+    }
+}
+
+void DecodeTable::addSymbolPairs()
+{
+    assert(!pairedEntries);
+
+    //
+    // The bits after the first code of pair entry i are i >> length,
+    // with the top 'length' bits of the window unknown. The single
+    // entry at that index is a valid second code if it ends within
+    // the known bits. Codes longer than TableBits get a count of zero
+    // and are left to the single symbol path.
+    //
+    for (int i = 0; i < PairTableSize; ++i)
+    {
+        PairEntry & pair = pairs[i];
+        const Entry first = entries[i & (TableSize - 1)];
+        if (first.length == 0)
+        {
+            pair = PairEntry{ { 0, 0 }, 0, 0 };
+            continue;
+        }
+
+        const Entry second = entries[(i >> first.length) & (TableSize - 1)];
+        if (second.length != 0 && first.length + second.length <= PairTableBits)
+        {
+            pair = PairEntry{ { first.symbol, second.symbol }, static_cast<std::uint8_t>(first.length + second.length), 2 };
+        }
+        else
+        {
+            pair = PairEntry{ { first.symbol, 0 }, first.length, 1 };
+        }
+    }
+    pairedEntries = true;
+}
+
+int DecodeTable::findLongCode(const std::uint64_t bits, int * symbol) const
+{
+    for (int c = 0; c < longCodeCount; ++c)
+    {
+        const std::uint64_t mask = (std::uint64_t(1) << longCodeLengths[c]) - 1;
+        if ((bits & mask) == longCodeBits[c])
+        {
+            *symbol = longCodeSymbols[c];
+            return longCodeLengths[c];
+        }
+    }
+    return 0; // Not found.
+}
+
+// ========================================================
+// Scatter/gather output:
+// ========================================================
+
+// Lends Decoder::decode() the free part of one OutputSegment at a time,
+// so the decode loop writes to plain memory. Empty segments are skipped.
+class SegmentWriter final
+{
+public:
+
+    // No copy/assignment.
+    SegmentWriter(const SegmentWriter &) = delete;
+    SegmentWriter & operator = (const SegmentWriter &) = delete;
+
+    SegmentWriter(const OutputSegment * outputSegments, const int outputSegmentCount)
+        : segments(outputSegments)
+        , segmentCount(outputSegmentCount)
+        , nextSegment(0)
+        , segmentStart(nullptr)
+        , cursor(nullptr)
+        , segmentEnd(nullptr)
+        , bytesBefore(0)
+    { }
+
+    // Sum of the segment sizes, or -1 if a segment is malformed.
+    static int countBytes(const OutputSegment * outputSegments, const int outputSegmentCount)
+    {
+        std::int64_t total = 0;
+        for (int s = 0; s < outputSegmentCount; ++s)
+        {
+            if (outputSegments[s].sizeBytes < 0 || (outputSegments[s].sizeBytes > 0 && outputSegments[s].data == nullptr))
+            {
+                return -1;
+            }
+            total += outputSegments[s].sizeBytes;
+        }
+        return (total <= 0x7FFFFFFF) ? static_cast<int>(total) : -1;
+    }
+
+    // Free space left in the current segment, moving to the next
+    // one if it is full. Write there, then call commit() with the
+    // number of bytes written. Null if all the segments are full.
+    std::uint8_t * getWindow(int & windowSize)
+    {
+        if (cursor == segmentEnd && !advance())
+        {
+            windowSize = 0;
+            return nullptr;
+        }
+        windowSize = static_cast<int>(segmentEnd - cursor);
+        return cursor;
+    }
+    void commit(const int bytesWritten)
+    {
+        assert(bytesWritten <= segmentEnd - cursor);
+        cursor += bytesWritten;
+    }
+
+    int getBytesWritten() const
+    {
+        return bytesBefore + static_cast<int>(cursor - segmentStart);
+    }
+
+private:
+
+    bool advance()
+    {
+        while (nextSegment < segmentCount)
+        {
+            const OutputSegment & segment = segments[nextSegment++];
+            if (segment.sizeBytes > 0)
+            {
+                bytesBefore += static_cast<int>(segmentEnd - segmentStart);
+                segmentStart = segment.data;
+                cursor       = segment.data;
+                segmentEnd   = segment.data + segment.sizeBytes;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const OutputSegment * segments;
+    const int segmentCount;
+    int nextSegment;             // Index of the segment after the current one.
+    std::uint8_t * segmentStart; // Current segment being written to.
+    std::uint8_t * cursor;
+    std::uint8_t * segmentEnd;
+    int bytesBefore;             // Bytes written to the segments before the current one.
+};
+
 // ========================================================
 // class Decoder:
 // ========================================================
 
 Decoder::Decoder(const BitStreamWriter & encodedBitStream)
     : bitStream(encodedBitStream)
+    , windowSegment(0)
+    , windowBitPos(0)
 {
     readPrefixData();
 }
 
 Decoder::Decoder(const std::uint8_t * encodedData, const int encodedSizeBytes, const int encodedSizeBits)
     : bitStream(encodedData, encodedSizeBytes, encodedSizeBits)
+    , windowSegment(0)
+    , windowBitPos(0)
 {
     readPrefixData();
 }
 
 void Decoder::readPrefixData()
 {
+    HUFFMAN_STATS_TIMER(headerParseNanos);
+
     // First two 16-bits words in the stream are
     // the number of codes, which must be 256, and
     // the width in bits of each code_length field.
-    const std::uint64_t numberOfCodes   = bitStream.readBitsU64(16);
+    // The number of codes is tagged in segmented streams.
+    const std::uint64_t codesField      = bitStream.readBitsU64(16);
     const std::uint64_t codeLengthWidth = bitStream.readBitsU64(16);
-    int treePrefixBits = 32; // The 16 bits read above.
+    const std::uint64_t numberOfCodes   = codesField & ~std::uint64_t(SegmentedStreamTag);
 
     if (numberOfCodes != MaxSymbols)
     {
         HUFFMAN_ERROR("Unexpected code count in input bit stream! Should be 256.");
         return;
     }
+    if (codeLengthWidth > 16)
+    {
+        HUFFMAN_ERROR("Unexpected code length width in input bit stream!");
+        return;
+    }
+
+    // 256/MaxSymbols codes follow. Each goes straight into the
+    // decode table as soon as it is read, so the header is parsed
+    // in a single pass. A code_length field and the code after it
+    // are fetched together with a single 64-bit load, keeping the
+    // read position in a local, since this loop is the bulk of the
+    // work when decoding small messages.
+    const std::uint8_t * const bytes = bitStream.getBitStream();
+    const int sizeInBytes = bitStream.getByteCount();
+    const int sizeInBits  = bitStream.getBitCount();
+    const int lengthWidth = static_cast<int>(codeLengthWidth);
+    const std::uint64_t lengthMask = (std::uint64_t(1) << lengthWidth) - 1;
+    int bitPos = bitStream.getBitsRead();
 
-    // 256/MaxSymbols codes follow:
-    for (std::uint64_t c = 0; c < numberOfCodes; ++c)
+    for (int c = 0; c < MaxSymbols; ++c)
     {
-        //
         // Read the code_length field, fixed bit-width:
-        //
-        bitStream.clearCode();
-        for (std::uint64_t l = 0; l < codeLengthWidth; ++l)
+        if (bitPos + lengthWidth > sizeInBits)
         {
-            if (!bitStream.readNextBit())
-            {
-                HUFFMAN_ERROR("Failed to read code length from stream! Unexpected end.");
-                return;
-            }
+            HUFFMAN_ERROR("Failed to read code length from stream! Unexpected end.");
+            return;
         }
-        treePrefixBits += codeLengthWidth;
-        const std::uint64_t codeBitsWidth = bitStream.getCode().getAsU64();
-        assert(codeBitsWidth <= Code::MaxBits);
 
-        //
-        // Now read the code bits using the just acquired length:
-        //
-        bitStream.clearCode();
-        for (std::uint64_t l = 0; l < codeBitsWidth; ++l)
+        std::uint64_t fields;
+        if ((bitPos >> 3) + 8 <= sizeInBytes)
         {
-            if (!bitStream.readNextBit())
-            {
-                HUFFMAN_ERROR("Failed to read code bits from stream! Unexpected end.");
-                return;
-            }
+            fields = peekBitsScalar(bytes, bitPos, MaxFastBits);
+        }
+        else
+        {
+            bitStream.skipBits(bitPos - bitStream.getBitsRead());
+            fields = bitStream.peekBitsU64(MaxFastBits);
+        }
+
+        const int codeLength = static_cast<int>(fields & lengthMask);
+        bitPos += lengthWidth;
+
+        if (codeLength == 0)
+        {
+            continue; // Symbol not present in the data.
+        }
+
+        // The encoder can't produce codes this long for any input that
+        // fits in an int (that would take a Fibonacci-sized histogram).
+        if (codeLength > MaxFastBits)
+        {
+            HUFFMAN_ERROR("Code length in input bit stream is too long!");
+            return;
+        }
+        if (bitPos + codeLength > sizeInBits)
+        {
+            HUFFMAN_ERROR("Failed to read code bits from stream! Unexpected end.");
+            return;
+        }
+
+        // Now the code bits, using the just acquired length:
+        const std::uint64_t codeMask = (std::uint64_t(1) << codeLength) - 1;
+        std::uint64_t codeBits = (fields >> lengthWidth) & codeMask;
+        if (lengthWidth + codeLength > MaxFastBits)
+        {
+            bitStream.skipBits(bitPos - bitStream.getBitsRead());
+            codeBits = bitStream.peekBitsU64(codeLength);
         }
-        treePrefixBits += codeBitsWidth;
+        bitPos += codeLength;
 
-        // Store the new code:
-        codes[c] = bitStream.getCode();
+        decodeTable.addCode(c, codeBits, codeLength);
     }
+    bitStream.skipBits(bitPos - bitStream.getBitsRead());
 
     // There might be some padding left that must be skipped:
+    bitStream.skipBits((8 - (bitStream.getBitsRead() & 7)) & 7);
     bitStream.clearCode();
-    while ((treePrefixBits % 8) != 0)
+
+    if (codesField & SegmentedStreamTag)
     {
-        bitStream.readNextBit();
-        ++treePrefixBits;
+        readJumpTable();
     }
-    bitStream.clearCode();
 }
 
-int Decoder::findMatchingCode(const Code code) const
+void Decoder::readJumpTable()
 {
-    for (int c = 0; c < MaxSymbols; ++c)
+    if (bitStream.getBitsLeft() < 32)
+    {
+        HUFFMAN_ERROR("Failed to read the segment count from stream! Unexpected end.");
+        return;
+    }
+
+    const std::uint64_t segmentCount = bitStream.readBitsU64(32);
+    if (segmentCount == 0 || segmentCount * 64 > std::uint64_t(bitStream.getBitsLeft()))
+    {
+        HUFFMAN_ERROR("Bad segment count in input bit stream!");
+        return;
+    }
+
+    // Segments follow the table, each one starting at a byte
+    // boundary, so their offsets are just running sums.
+    const int tableEndBytes = (bitStream.getBitsRead() + static_cast<int>(segmentCount) * 64) / 8;
+    std::int64_t byteOffset   = tableEndBytes;
+    std::int64_t outputOffset = 0;
+
+    segments.resize(static_cast<std::size_t>(segmentCount));
+    for (auto & segment : segments)
     {
-        if (code == codes[c])
+        const std::uint64_t decodedBytes = bitStream.readBitsU64(32);
+        const std::uint64_t sizeInBits   = bitStream.readBitsU64(32);
+
+        if (byteOffset + std::int64_t((sizeInBits + 7) / 8) > bitStream.getByteCount() ||
+            outputOffset + std::int64_t(decodedBytes) > 0x7FFFFFFF)
         {
-            return c;
+            HUFFMAN_ERROR("Bad segment size in input bit stream!");
+            segments.clear();
+            return;
         }
+
+        segment.decodedBytes = static_cast<int>(decodedBytes);
+        segment.sizeInBits   = static_cast<int>(sizeInBits);
+        segment.byteOffset   = static_cast<int>(byteOffset);
+        segment.outputOffset = static_cast<int>(outputOffset);
+
+        byteOffset   += (sizeInBits + 7) / 8;
+        outputOffset += decodedBytes;
+    }
+}
+
+void Decoder::prepareDecodeTable(const int dataSizeBytes)
+{
+    // Building the symbol pairs is a pass over the whole table,
+    // which only pays off if there are enough symbols to decode.
+    if (dataSizeBytes >= MultiSymbolMinBytes && !decodeTable.hasSymbolPairs())
+    {
+        decodeTable.addSymbolPairs();
     }
-    return Nil; // Not found.
 }
 
 int Decoder::decode(std::uint8_t * data, const int dataSizeBytes)
@@ -1105,57 +2248,564 @@ int Decoder::decode(std::uint8_t * data, const int dataSizeBytes)
     assert(data != nullptr);
     assert(dataSizeBytes != 0);
 
-    int bytesDecoded = 0;
-    while (bitStream.readNextBit())
-    {
-        // See if the current code is valid:
-        const int codeIndex = findMatchingCode(bitStream.getCode());
-        if (codeIndex == Nil)
-        {
-            continue;
-        }
-
-        if (bytesDecoded == dataSizeBytes)
-        {
-            HUFFMAN_ERROR("Decoder output buffer too small!");
-            break;
-        }
+    HUFFMAN_STATS_TIMER(dataDecodeNanos);
+    HUFFMAN_STATS_ADD(decodeCalls, 1);
 
-        *data++ = static_cast<std::uint8_t>(codeIndex);
-        ++bytesDecoded;
+    prepareDecodeTable(dataSizeBytes);
+    HUFFMAN_STATS_ADD(bitsRead, bitStream.getBitsRead()); // Tree prefix and jump table.
 
-        bitStream.clearCode();
+    if (segments.empty())
+    {
+        return decodeBits(bitStream, data, dataSizeBytes);
     }
 
+    int bytesDecoded = 0;
+    for (int seg = 0; seg < static_cast<int>(segments.size()); ++seg)
+    {
+        bytesDecoded += decodeSegment(seg, data, dataSizeBytes);
+    }
     return bytesDecoded;
 }
 
-// ========================================================
-// easyEncode() implementation:
-// ========================================================
-
-void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
-                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits)
+int Decoder::decode(const OutputSegment * outputSegments, const int outputSegmentCount)
 {
-    if (uncompressed == nullptr || compressed == nullptr)
+    const int dataSizeBytes = SegmentWriter::countBytes(outputSegments, outputSegmentCount);
+    if (dataSizeBytes <= 0)
     {
-        HUFFMAN_ERROR("huffman::easyEncode(): Null data pointer(s)!");
-        return;
+        HUFFMAN_ERROR("Bad output segments!");
+        return 0;
     }
 
-    if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
+    HUFFMAN_STATS_TIMER(dataDecodeNanos);
+    HUFFMAN_STATS_ADD(decodeCalls, 1);
+
+    prepareDecodeTable(dataSizeBytes);
+    SegmentWriter output(outputSegments, outputSegmentCount);
+
+    // Decodes one stream into as many output segments as needed,
+    // picking up from the same bit position when a segment fills.
+    const auto decodeStream = [this, &output](BitStreamReader & reader) -> bool
     {
-        HUFFMAN_ERROR("huffman::easyEncode(): Bad in/out sizes!");
-        return;
-    }
+        while (reader.getBitsLeft() > 0)
+        {
+            int windowSize = 0;
+            std::uint8_t * window = output.getWindow(windowSize);
+            if (window == nullptr)
+            {
+                // Out of space. Fine if only a partial code was left.
+                int symbol = 0;
+                const int codeLength = decodeTable.decodeSymbol(reader.peekBitsU64(MaxFastBits), &symbol);
+                if (codeLength == 0 || codeLength > reader.getBitsLeft())
+                {
+                    break;
+                }
+                HUFFMAN_ERROR("Decoder output buffer too small!");
+                return false;
+            }
 
-    Encoder encoder(uncompressed, uncompressedSizeBytes, /* prependTreeToBitStream = */ true);
-    auto & bitStream = encoder.getBitStreamWriter();
+            const int bytesDecoded = decodeBits(reader, window, windowSize, /* stopWhenFull = */ true);
+            output.commit(bytesDecoded);
 
-    // Pass ownership of the compressed data buffer to the user pointer:
-    *compressedSizeBytes = bitStream.getByteCount();
-    *compressedSizeBits  = bitStream.getBitCount();
-    *compressed          = bitStream.release();
+            if (bytesDecoded < windowSize)
+            {
+                break; // End of the stream, or a bad code.
+            }
+        }
+        return true;
+    };
+
+    HUFFMAN_STATS_ADD(bitsRead, bitStream.getBitsRead()); // Tree prefix and jump table.
+
+    if (segments.empty())
+    {
+        decodeStream(bitStream);
+        return output.getBytesWritten();
+    }
+
+    // The stream segments are contiguous in the output, so just decode them in order.
+    for (const Segment & segment : segments)
+    {
+        BitStreamReader reader(bitStream.getBitStream() + segment.byteOffset,
+                               bitStream.getByteCount() - segment.byteOffset,
+                               segment.sizeInBits);
+        if (!decodeStream(reader))
+        {
+            break;
+        }
+    }
+    return output.getBytesWritten();
+}
+
+int Decoder::decodeWindow(std::uint8_t * window, const int windowSize)
+{
+    assert(window != nullptr);
+    assert(windowSize > 0);
+
+    HUFFMAN_STATS_TIMER(dataDecodeNanos);
+    prepareDecodeTable(windowSize);
+
+    if (segments.empty())
+    {
+        // The member reader already remembers where we stopped.
+        return decodeBits(bitStream, window, windowSize, /* stopWhenFull = */ true);
+    }
+
+    int bytesDecoded = 0;
+    while (bytesDecoded < windowSize && windowSegment < static_cast<int>(segments.size()))
+    {
+        const Segment & segment = segments[windowSegment];
+        BitStreamReader reader(bitStream.getBitStream() + segment.byteOffset,
+                               bitStream.getByteCount() - segment.byteOffset,
+                               segment.sizeInBits);
+        reader.skipBits(windowBitPos);
+
+        const int wanted = windowSize - bytesDecoded;
+        const int count  = decodeBits(reader, window + bytesDecoded, wanted, /* stopWhenFull = */ true);
+        bytesDecoded += count;
+
+        if (count < wanted)
+        {
+            // End of the segment (or a bad code); carry on with the next one.
+            ++windowSegment;
+            windowBitPos = 0;
+        }
+        else
+        {
+            windowBitPos = reader.getBitsRead();
+        }
+    }
+    return bytesDecoded;
+}
+
+int Decoder::decodeParallel(std::uint8_t * data, const int dataSizeBytes, int threadCount)
+{
+    assert(data != nullptr);
+    assert(dataSizeBytes != 0);
+
+    #ifdef HUFFMAN_NO_THREADS
+    (void)threadCount;
+    return decode(data, dataSizeBytes);
+    #else // !HUFFMAN_NO_THREADS
+    if (threadCount <= 0)
+    {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (segments.empty())
+    {
+        return decodeSpeculative(data, dataSizeBytes, threadCount);
+    }
+    if (threadCount > static_cast<int>(segments.size()))
+    {
+        threadCount = static_cast<int>(segments.size());
+    }
+    if (threadCount <= 1)
+    {
+        return decode(data, dataSizeBytes);
+    }
+
+    HUFFMAN_STATS_TIMER(dataDecodeNanos);
+    HUFFMAN_STATS_ADD(decodeCalls, 1);
+    HUFFMAN_STATS_ADD(bitsRead, bitStream.getBitsRead()); // Tree prefix and jump table.
+
+    // The table is shared read-only by all threads from here on.
+    prepareDecodeTable(dataSizeBytes);
+
+    // Thread t decodes segments t, t + threadCount, t + 2 * threadCount...
+    // Segments are all the same size save for the last, so that's even enough.
+    // The calling thread takes the first share.
+    const int segmentCount = static_cast<int>(segments.size());
+    std::vector<int> threadBytes(threadCount, 0);
+    std::vector<Stats> threadStats(threadCount);
+
+    const auto decodeShare = [this, data, dataSizeBytes, segmentCount, threadCount, &threadBytes, &threadStats](const int t)
+    {
+        for (int seg = t; seg < segmentCount; seg += threadCount)
+        {
+            threadBytes[t] += decodeSegment(seg, data, dataSizeBytes);
+        }
+        if (t != 0)
+        {
+            threadStats[t] = getStats(); // A new thread, so only this share.
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (int t = 1; t < threadCount; ++t)
+    {
+        threads.emplace_back(decodeShare, t);
+    }
+
+    decodeShare(0);
+
+    int bytesDecoded = 0;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        if (t != 0)
+        {
+            threads[t - 1].join();
+            addDecodeStats(threadStats[t]);
+        }
+        bytesDecoded += threadBytes[t];
+    }
+    return bytesDecoded;
+    #endif // HUFFMAN_NO_THREADS
+}
+
+#ifndef HUFFMAN_NO_THREADS
+
+int Decoder::decodeSpeculative(std::uint8_t * data, const int dataSizeBytes, int threadCount)
+{
+    //
+    // Without a jump table we don't know where the codes of a single
+    // stream start, but Huffman codes tend to self-synchronize: decoding
+    // from a wrong bit offset yields garbage for a few symbols and then
+    // falls in step with the real code boundaries. So:
+    //
+    // 1. Cut the data bits in one chunk per thread and decode them all
+    //    in parallel from their first bit, only counting symbols and
+    //    marking where each decoded code starts.
+    // 2. Walk the chunks in order. The exit point of a chunk is the real
+    //    entry of the next; decode from there until reaching a code start
+    //    marked by the speculative pass. From that point on the speculative
+    //    results are right, so the symbol count follows from the marks.
+    //    This is usually a handful of symbols per chunk.
+    // 3. Prefix sums of the counts give every chunk its output offset,
+    //    then the chunks are decoded in parallel for real.
+    //
+    const int dataStartBit = bitStream.getBitsRead();
+    const int dataBits = bitStream.getBitCount() - dataStartBit;
+
+    if (threadCount > dataBits / MinSpeculativeChunkBits)
+    {
+        threadCount = dataBits / MinSpeculativeChunkBits;
+    }
+    if (threadCount <= 1)
+    {
+        return decode(data, dataSizeBytes);
+    }
+
+    HUFFMAN_STATS_TIMER(dataDecodeNanos);
+    HUFFMAN_STATS_ADD(decodeCalls, 1);
+    prepareDecodeTable(dataSizeBytes);
+
+    std::vector<SpeculativeChunk> chunks(threadCount);
+    for (int t = 0; t < threadCount; ++t)
+    {
+        chunks[t].startBit = dataStartBit + static_cast<int>(std::int64_t(dataBits) * t / threadCount);
+        chunks[t].endBit   = dataStartBit + static_cast<int>(std::int64_t(dataBits) * (t + 1) / threadCount);
+    }
+
+    // 1. Speculative pass. The calling thread takes the first chunk.
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (int t = 1; t < threadCount; ++t)
+    {
+        threads.emplace_back(&Decoder::speculateChunk, this, std::ref(chunks[t]));
+    }
+    speculateChunk(chunks[0]);
+    for (auto & thread : threads)
+    {
+        thread.join();
+    }
+
+    // 2. Sequential resync. The first chunk starts at a real code boundary.
+    std::vector<int> entryBits(threadCount);
+    std::vector<int> exitBits(threadCount);
+    std::vector<int> symbolCounts(threadCount);
+    entryBits[0]    = chunks[0].startBit;
+    exitBits[0]     = chunks[0].exitBit;
+    symbolCounts[0] = chunks[0].symbolCount;
+
+    std::int64_t totalSymbols = symbolCounts[0];
+    BitStreamReader reader(bitStream.getBitStream(), bitStream.getByteCount(), bitStream.getBitCount());
+
+    for (int t = 1; t < threadCount; ++t)
+    {
+        const SpeculativeChunk & chunk = chunks[t];
+        int bit = exitBits[t - 1];
+        int extraSymbols = 0;
+
+        reader.reset();
+        reader.skipBits(bit);
+        while (bit < chunk.endBit && !chunk.isCodeStart(bit))
+        {
+            int symbol = 0;
+            const int codeLength = decodeTable.decodeSymbol(reader.peekBitsU64(MaxFastBits), &symbol);
+            if (codeLength == 0 || codeLength > reader.getBitsLeft())
+            {
+                // Bad code or end of data: leave it to the sequential decoder.
+                return decode(data, dataSizeBytes);
+            }
+            reader.skipBits(codeLength);
+            bit += codeLength;
+            ++extraSymbols;
+        }
+
+        entryBits[t] = exitBits[t - 1];
+        if (bit >= chunk.endBit)
+        {
+            // Never synchronized (or the previous code spanned the chunk).
+            exitBits[t]     = bit;
+            symbolCounts[t] = extraSymbols;
+        }
+        else
+        {
+            // Synchronized at 'bit': drop the speculative symbols before it.
+            int symbolsBefore = 0;
+            const int bitsBefore = bit - chunk.startBit;
+            for (int w = 0; w < (bitsBefore >> 6); ++w)
+            {
+                symbolsBefore += popCount64(chunk.codeStarts[w]);
+            }
+            if (bitsBefore & 63)
+            {
+                symbolsBefore += popCount64(chunk.codeStarts[bitsBefore >> 6] & ((std::uint64_t(1) << (bitsBefore & 63)) - 1));
+            }
+
+            exitBits[t]     = chunk.exitBit;
+            symbolCounts[t] = extraSymbols + chunk.symbolCount - symbolsBefore;
+        }
+        totalSymbols += symbolCounts[t];
+    }
+
+    // Output too small; the sequential decoder handles the error.
+    if (totalSymbols > dataSizeBytes)
+    {
+        return decode(data, dataSizeBytes);
+    }
+
+    // 3. Real decoding, each chunk bounded by its entry and exit bits.
+    std::vector<int> outputOffsets(threadCount, 0);
+    for (int t = 1; t < threadCount; ++t)
+    {
+        outputOffsets[t] = outputOffsets[t - 1] + symbolCounts[t - 1];
+    }
+
+    std::vector<int> threadBytes(threadCount, 0);
+    std::vector<Stats> threadStats(threadCount);
+    const auto decodeChunk = [this, data, &entryBits, &exitBits, &symbolCounts, &outputOffsets,
+                              &threadBytes, &threadStats](const int t)
+    {
+        if (symbolCounts[t] == 0)
+        {
+            return;
+        }
+        BitStreamReader chunkReader(bitStream.getBitStream(), bitStream.getByteCount(), exitBits[t]);
+        chunkReader.skipBits(entryBits[t]);
+        threadBytes[t] = decodeBits(chunkReader, data + outputOffsets[t], symbolCounts[t]);
+        if (t != 0)
+        {
+            threadStats[t] = getStats(); // A new thread, so only this chunk.
+        }
+    };
+
+    threads.clear();
+    for (int t = 1; t < threadCount; ++t)
+    {
+        threads.emplace_back(decodeChunk, t);
+    }
+    decodeChunk(0);
+
+    int bytesDecoded = threadBytes[0];
+    for (int t = 1; t < threadCount; ++t)
+    {
+        threads[t - 1].join();
+        addDecodeStats(threadStats[t]);
+        bytesDecoded += threadBytes[t];
+    }
+
+    HUFFMAN_STATS_ADD(bitsRead, dataStartBit); // Tree prefix.
+    return bytesDecoded;
+}
+
+void Decoder::speculateChunk(SpeculativeChunk & chunk) const
+{
+    const int chunkBits = chunk.endBit - chunk.startBit;
+    chunk.codeStarts.assign((chunkBits + 63) / 64, 0);
+    chunk.symbolCount = 0;
+
+    BitStreamReader reader(bitStream.getBitStream(), bitStream.getByteCount(), bitStream.getBitCount());
+    reader.skipBits(chunk.startBit);
+
+    int bit = chunk.startBit;
+    while (bit < chunk.endBit)
+    {
+        int symbol = 0;
+        const int codeLength = decodeTable.decodeSymbol(reader.peekBitsU64(MaxFastBits), &symbol);
+        if (codeLength == 0)
+        {
+            // Not a code for an incomplete tree (e.g. a single symbol).
+            // Can only happen while out of sync; move on one bit.
+            reader.skipBits(1);
+            ++bit;
+            continue;
+        }
+        if (codeLength > reader.getBitsLeft())
+        {
+            break; // Partial code at the end of the stream.
+        }
+
+        const int i = bit - chunk.startBit;
+        chunk.codeStarts[i >> 6] |= std::uint64_t(1) << (i & 63);
+        ++chunk.symbolCount;
+
+        reader.skipBits(codeLength);
+        bit += codeLength;
+    }
+    chunk.exitBit = bit;
+}
+
+#endif // HUFFMAN_NO_THREADS
+
+int Decoder::decodeSegment(const int segmentIndex, std::uint8_t * data, const int dataSizeBytes) const
+{
+    const Segment & segment = segments[segmentIndex];
+
+    // The output might be too small for the whole data.
+    const int outputBytes = (dataSizeBytes - segment.outputOffset < segment.decodedBytes) ?
+                             dataSizeBytes - segment.outputOffset : segment.decodedBytes;
+    if (outputBytes <= 0)
+    {
+        return 0;
+    }
+
+    // The reader may load past the end of the segment on the
+    // fast path, so give it the rest of the buffer to look at.
+    BitStreamReader reader(bitStream.getBitStream() + segment.byteOffset,
+                           bitStream.getByteCount() - segment.byteOffset,
+                           segment.sizeInBits);
+
+    return decodeBits(reader, data + segment.outputOffset, outputBytes);
+}
+
+// The decode loop proper, shared by Decoder and the header-less
+// StaticTable streams, which have no Decoder instance.
+static int decodeCodes(const DecodeTable & decodeTable, BitStreamReader & reader,
+                       std::uint8_t * data, const int dataSizeBytes, const bool stopWhenFull)
+{
+    #ifdef HUFFMAN_ENABLE_STATS
+    const int startBitsRead = reader.getBitsRead(); // The reader may be resuming.
+    #endif // HUFFMAN_ENABLE_STATS
+
+    int bytesDecoded = 0;
+    while (reader.getBitsLeft() > 0)
+    {
+        const int bitsLeft = reader.getBitsLeft();
+        std::uint64_t bits = reader.peekBitsU64(MaxFastBits);
+
+        //
+        // Fast path: several table lookups out of a single peek,
+        // each yielding one or two symbols. Stops at long codes,
+        // at the end of the stream or near the end of the output,
+        // which are left to the single symbol step below.
+        //
+        int consumed = 0;
+        if (decodeTable.hasSymbolPairs())
+        {
+            while (consumed + DecodeTable::PairTableBits <= MaxFastBits && bytesDecoded + 2 <= dataSizeBytes)
+            {
+                const DecodeTable::PairEntry pair = decodeTable.getPairEntry(bits);
+                if (pair.count == 0 || pair.length > bitsLeft - consumed)
+                {
+                    break;
+                }
+
+                data[bytesDecoded]     = pair.symbols[0];
+                data[bytesDecoded + 1] = pair.symbols[1];
+                bytesDecoded += pair.count;
+
+                bits >>= pair.length;
+                consumed += pair.length;
+            }
+        }
+        else
+        {
+            while (consumed + DecodeTable::TableBits <= MaxFastBits && bytesDecoded < dataSizeBytes)
+            {
+                const DecodeTable::Entry entry = decodeTable.getEntry(bits);
+                if (entry.length == 0 || entry.length > bitsLeft - consumed)
+                {
+                    break;
+                }
+
+                data[bytesDecoded++] = entry.symbol;
+                bits >>= entry.length;
+                consumed += entry.length;
+            }
+        }
+
+        if (consumed != 0)
+        {
+            reader.skipBits(consumed);
+            continue;
+        }
+
+        // One symbol at a time. We peeked enough bits for the longest code
+        // we accept, and the table tells how many of them make up the code.
+        int symbol = 0;
+        const int codeLength = decodeTable.decodeSymbol(bits, &symbol);
+        if (codeLength > DecodeTable::TableBits)
+        {
+            HUFFMAN_STATS_ADD(decodeTableMisses, 1);
+        }
+
+        // An unknown code or a partial one at the end of the stream.
+        if (codeLength == 0 || codeLength > bitsLeft)
+        {
+            break;
+        }
+
+        if (bytesDecoded == dataSizeBytes)
+        {
+            if (!stopWhenFull)
+            {
+                HUFFMAN_ERROR("Decoder output buffer too small!");
+            }
+            break;
+        }
+
+        data[bytesDecoded++] = static_cast<std::uint8_t>(symbol);
+        reader.skipBits(codeLength);
+    }
+
+    HUFFMAN_STATS_ADD(bitsRead, reader.getBitsRead() - startBitsRead);
+    HUFFMAN_STATS_ADD(bytesDecoded, bytesDecoded);
+    return bytesDecoded;
+}
+
+int Decoder::decodeBits(BitStreamReader & reader, std::uint8_t * data,
+                        const int dataSizeBytes, const bool stopWhenFull) const
+{
+    return decodeCodes(decodeTable, reader, data, dataSizeBytes, stopWhenFull);
+}
+
+// ========================================================
+// easyEncode() implementation:
+// ========================================================
+
+void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits)
+{
+    if (uncompressed == nullptr || compressed == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncode(): Null data pointer(s)!");
+        return;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncode(): Bad in/out sizes!");
+        return;
+    }
+
+    Encoder encoder(uncompressed, uncompressedSizeBytes, /* prependTreeToBitStream = */ true);
+    auto & bitStream = encoder.getBitStreamWriter();
+
+    // Pass ownership of the compressed data buffer to the user pointer:
+    *compressedSizeBytes = bitStream.getByteCount();
+    *compressedSizeBits  = bitStream.getBitCount();
+    *compressed          = bitStream.release();
 }
 
 // ========================================================
@@ -1181,6 +2831,405 @@ int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, c
     return decoder.decode(uncompressed, uncompressedSizeBytes);
 }
 
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+constexpr std::size_t WorkspaceAlignment = alignof(std::max_align_t);
+
+int workspaceSize()
+{
+    const std::size_t stateSize = (sizeof(Encoder) > sizeof(Decoder)) ? sizeof(Encoder) : sizeof(Decoder);
+    return static_cast<int>(stateSize + WorkspaceAlignment - 1);
+}
+
+// Where the Encoder/Decoder goes in the caller's workspace, or null if it is too small.
+static void * alignWorkspace(void * workspace, const int workspaceSizeBytes)
+{
+    if (workspace == nullptr || workspaceSizeBytes < workspaceSize())
+    {
+        return nullptr;
+    }
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(workspace);
+    return reinterpret_cast<void *>((address + WorkspaceAlignment - 1) & ~(WorkspaceAlignment - 1));
+}
+
+int easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+               std::uint8_t * compressed, const int compressedCapacityBytes, int * compressedSizeBits,
+               void * workspace, const int workspaceSizeBytes)
+{
+    if (uncompressed == nullptr || compressed == nullptr || compressedSizeBits == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedCapacityBytes <= 0)
+    {
+        HUFFMAN_ERROR("huffman::easyEncode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    void * const state = alignWorkspace(workspace, workspaceSizeBytes);
+    if (state == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncode(): Workspace too small!");
+        return 0;
+    }
+
+    Encoder * encoder = new (state) Encoder(uncompressed, uncompressedSizeBytes, /* prependTreeToBitStream = */ true,
+                                            compressed, compressedCapacityBytes);
+    const BitStreamWriter & bitStream = encoder->getBitStreamWriter();
+
+    int compressedSizeBytes = 0;
+    if (bitStream.hasOverflowed())
+    {
+        HUFFMAN_ERROR("huffman::easyEncode(): Output buffer too small!");
+    }
+    else
+    {
+        compressedSizeBytes = bitStream.getByteCount();
+        *compressedSizeBits = bitStream.getBitCount();
+    }
+
+    encoder->~Encoder();
+    return compressedSizeBytes;
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+               void * workspace, const int workspaceSizeBytes)
+{
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits < 16 || uncompressedSizeBytes <= 0)
+    {
+        HUFFMAN_ERROR("huffman::easyDecode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    void * const state = alignWorkspace(workspace, workspaceSizeBytes);
+    if (state == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyDecode(): Workspace too small!");
+        return 0;
+    }
+
+    // The code count field comes first, tagged in segmented streams.
+    if (compressed[1] & (SegmentedStreamTag >> 8))
+    {
+        HUFFMAN_ERROR("huffman::easyDecode(): Segmented streams need the heap!");
+        return 0;
+    }
+
+    Decoder * decoder = new (state) Decoder(compressed, compressedSizeBytes, compressedSizeBits);
+    const int bytesDecoded = decoder->decode(uncompressed, uncompressedSizeBytes);
+    decoder->~Decoder();
+    return bytesDecoded;
+}
+
+// ========================================================
+// easyEncodeSegmented() / easyDecodeParallel() implementation:
+// ========================================================
+
+void easyEncodeSegmented(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                         std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits,
+                         const int segmentSizeBytes)
+{
+    if (uncompressed == nullptr || compressed == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncodeSegmented(): Null data pointer(s)!");
+        return;
+    }
+
+    if (uncompressedSizeBytes <= 0 || segmentSizeBytes <= 0 ||
+        compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncodeSegmented(): Bad in/out sizes!");
+        return;
+    }
+
+    Encoder encoder(uncompressed, uncompressedSizeBytes, /* prependTreeToBitStream = */ true, segmentSizeBytes);
+    auto & bitStream = encoder.getBitStreamWriter();
+
+    // Pass ownership of the compressed data buffer to the user pointer:
+    *compressedSizeBytes = bitStream.getByteCount();
+    *compressedSizeBits  = bitStream.getBitCount();
+    *compressed          = bitStream.release();
+}
+
+int easyDecodeParallel(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+                       std::uint8_t * uncompressed, const int uncompressedSizeBytes, const int threadCount)
+{
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyDecodeParallel(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || uncompressedSizeBytes <= 0)
+    {
+        HUFFMAN_ERROR("huffman::easyDecodeParallel(): Bad in/out sizes!");
+        return 0;
+    }
+
+    Decoder decoder(compressed, compressedSizeBytes, compressedSizeBits);
+    return decoder.decodeParallel(uncompressed, uncompressedSizeBytes, threadCount);
+}
+
+// ========================================================
+// Scatter/gather easyDecode() implementation:
+// ========================================================
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               const OutputSegment * outputSegments, const int outputSegmentCount)
+{
+    if (compressed == nullptr || outputSegments == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 ||
+        SegmentWriter::countBytes(outputSegments, outputSegmentCount) <= 0)
+    {
+        HUFFMAN_ERROR("huffman::easyDecode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    Decoder decoder(compressed, compressedSizeBytes, compressedSizeBits);
+    return decoder.decode(outputSegments, outputSegmentCount);
+}
+
+// ========================================================
+// class WindowDecoder:
+// ========================================================
+
+WindowDecoder::WindowDecoder(const std::uint8_t * compressed, const int compressedSizeBytes,
+                             const int compressedSizeBits, const int windowSizeBytes)
+    : decoder(compressed, compressedSizeBytes, compressedSizeBits)
+    , buffer(nullptr)
+    , windowSize(windowSizeBytes > 0 ? windowSizeBytes : DefaultWindowSizeBytes)
+    , bytesDecoded(0)
+{
+    buffer = static_cast<std::uint8_t *>(HUFFMAN_MALLOC(windowSize));
+    HUFFMAN_STATS_ADD(decodeCalls, 1);
+}
+
+WindowDecoder::~WindowDecoder()
+{
+    HUFFMAN_MFREE(buffer);
+}
+
+int WindowDecoder::next(const std::uint8_t ** window)
+{
+    assert(window != nullptr);
+
+    const int windowBytes = decoder.decodeWindow(buffer, windowSize);
+    bytesDecoded += windowBytes;
+
+    *window = buffer;
+    return windowBytes;
+}
+
+// ========================================================
+// class StaticTable:
+// ========================================================
+
+// Code lengths of a Huffman tree over all the byte values, no deeper
+// than MaxStaticCodeBits. If the tree comes out too deep, halving the
+// weights (keeping them nonzero) flattens it, and we try again.
+static void buildStaticCodeLengths(const std::uint32_t * frequencies, int * lengths)
+{
+    using WeightedNode = std::pair<std::uint64_t, int>; // (weight, node index)
+
+    std::uint64_t weights[MaxSymbols];
+    for (int s = 0; s < MaxSymbols; ++s)
+    {
+        weights[s] = (frequencies[s] != 0) ? frequencies[s] : 1;
+    }
+
+    for (;;)
+    {
+        // Leaves are nodes 0 to 255, inner nodes follow. Ties are
+        // broken by node index, so the result is deterministic.
+        std::priority_queue<WeightedNode, std::vector<WeightedNode>, std::greater<WeightedNode>> queue;
+        int parents[MaxSymbols * 2];
+        for (int s = 0; s < MaxSymbols; ++s)
+        {
+            queue.push(WeightedNode(weights[s], s));
+        }
+
+        int nextNode = MaxSymbols;
+        while (queue.size() > 1)
+        {
+            const WeightedNode a = queue.top(); queue.pop();
+            const WeightedNode b = queue.top(); queue.pop();
+            parents[a.second] = nextNode;
+            parents[b.second] = nextNode;
+            queue.push(WeightedNode(a.first + b.first, nextNode++));
+        }
+
+        const int root = nextNode - 1;
+        int maxLength = 0;
+        for (int s = 0; s < MaxSymbols; ++s)
+        {
+            int length = 0;
+            for (int n = s; n != root; n = parents[n])
+            {
+                ++length;
+            }
+            lengths[s] = length;
+            maxLength  = (length > maxLength) ? length : maxLength;
+        }
+
+        if (maxLength <= MaxStaticCodeBits)
+        {
+            return;
+        }
+        for (int s = 0; s < MaxSymbols; ++s)
+        {
+            weights[s] = (weights[s] >> 1) | 1;
+        }
+    }
+}
+
+StaticTable::StaticTable(const std::uint32_t * frequencies)
+{
+    assert(frequencies != nullptr);
+
+    int lengths[MaxSymbols];
+    buildStaticCodeLengths(frequencies, lengths);
+
+    //
+    // Canonical codes: ordered by length, then by symbol. A canonical
+    // code has its first bit in the MSB, but our streams are read from
+    // the LSB up, so each code is appended to the Code bit by bit.
+    //
+    std::uint32_t nextCode = 0;
+    for (int length = 1; length <= MaxStaticCodeBits; ++length)
+    {
+        for (int s = 0; s < MaxSymbols; ++s)
+        {
+            if (lengths[s] != length)
+            {
+                continue;
+            }
+            for (int b = length - 1; b >= 0; --b)
+            {
+                codes[s].appendBit((nextCode >> b) & 1);
+            }
+            decodeTable.addCode(s, codes[s].getAsU64(), length);
+            ++nextCode;
+        }
+        nextCode <<= 1;
+    }
+
+    // Built once, so the pair table is always worth it.
+    decodeTable.addSymbolPairs();
+}
+
+// Byte frequencies of English prose (per ~100K characters).
+// Control and non-ASCII bytes are left at zero.
+static const std::uint32_t asciiTextFrequencies[MaxSymbols] = {
+        0,     0,     0,     0,     0,     0,     0,     0,     0,    20,   400,     0,     0,    20,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+    17000,    40,   200,     5,     5,     5,     5,   200,    30,    30,     5,     5,   600,   150,   650,    20,
+      150,   150,   100,   100,   100,   100,   100,   100,   100,   100,    60,    40,     3,     5,     3,    50,
+        5,   246,    45,    84,   129,   381,    66,    60,   183,   210,     4,    24,   120,    72,   201,   225,
+       57,     3,   180,   189,   273,    84,    30,    72,     4,    60,     2,     5,     2,     5,     1,    10,
+        2,  6396,  1170,  2184,  3354,  9906,  1716,  1560,  4758,  5460,   117,   624,  3120,  1872,  5226,  5850,
+     1482,    78,  4680,  4914,  7098,  2184,   780,  1872,   117,  1560,    55,     3,     2,     3,     2,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+        0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0
+};
+
+const StaticTable & getAsciiTextTable()
+{
+    static const StaticTable table(asciiTextFrequencies);
+    return table;
+}
+
+// ========================================================
+// easyEncodeStatic() / easyDecodeStatic() implementation:
+// ========================================================
+
+void easyEncodeStatic(const StaticTable & table, const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                      std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits)
+{
+    if (uncompressed == nullptr || compressed == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncodeStatic(): Null data pointer(s)!");
+        return;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyEncodeStatic(): Bad in/out sizes!");
+        return;
+    }
+
+    // Size the stream up front, so it never has to grow.
+    std::uint64_t totalBits = 0;
+    for (int b = 0; b < uncompressedSizeBytes; ++b)
+    {
+        totalBits += table.getCode(uncompressed[b]).getLength();
+    }
+    if (totalBits > 0x7FFFFFFF - 128)
+    {
+        HUFFMAN_ERROR("huffman::easyEncodeStatic(): Input too big!");
+        return;
+    }
+
+    // Plus the 8 bytes touched past the end by the word writes.
+    BitStreamWriter bitStream(static_cast<int>(totalBits) + 72);
+    for (int b = 0; b < uncompressedSizeBytes; ++b)
+    {
+        bitStream.appendCode(table.getCode(uncompressed[b]));
+    }
+
+    HUFFMAN_STATS_ADD(encodeCalls, 1);
+    HUFFMAN_STATS_ADD(bytesEncoded, uncompressedSizeBytes);
+    HUFFMAN_STATS_ADD(bitsWritten, bitStream.getBitCount());
+
+    // Pass ownership of the compressed data buffer to the user pointer:
+    *compressedSizeBytes = bitStream.getByteCount();
+    *compressedSizeBits  = bitStream.getBitCount();
+    *compressed          = bitStream.release();
+}
+
+int easyDecodeStatic(const StaticTable & table, const std::uint8_t * compressed, const int compressedSizeBytes,
+                     const int compressedSizeBits, std::uint8_t * uncompressed, const int uncompressedSizeBytes)
+{
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        HUFFMAN_ERROR("huffman::easyDecodeStatic(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || uncompressedSizeBytes <= 0)
+    {
+        HUFFMAN_ERROR("huffman::easyDecodeStatic(): Bad in/out sizes!");
+        return 0;
+    }
+
+    HUFFMAN_STATS_TIMER(dataDecodeNanos);
+    HUFFMAN_STATS_ADD(decodeCalls, 1);
+
+    BitStreamReader reader(compressed, compressedSizeBytes, compressedSizeBits);
+    return decodeCodes(table.getDecodeTable(), reader, uncompressed, uncompressedSizeBytes, /* stopWhenFull = */ false);
+}
+
 } // namespace huffman {}
 
 // ================ End of implementation =================
@@ -0,0 +1,652 @@
+// ================================================================================================
+// -*- C++ -*-
+// File: imagefilter.hpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: PNG-style image prediction filters, a pre-transform for the byte codecs.
+//        https://www.w3.org/TR/png/#9Filters
+// ================================================================================================
+
+#ifndef IMAGEFILTER_HPP
+#define IMAGEFILTER_HPP
+
+// ---------
+//  LICENSE
+// ---------
+// This software is in the public domain. Where that dedication is not recognized,
+// you are granted a perpetual, irrevocable license to copy, distribute, and modify
+// this file as you see fit.
+//
+// The source code is provided "as is", without warranty of any kind, express or implied.
+// No attribution is required, but a mention about the author is appreciated.
+//
+// -------
+//  SETUP
+// -------
+// #define IMAGEFILTER_IMPLEMENTATION in one source file before including
+// this file, then use imagefilter.hpp as a normal header file elsewhere.
+//
+// The unfiltering loops are dispatched at runtime to SSSE3 versions
+// when the CPU supports them, so a single binary built without -march
+// flags still uses them.
+// #define IMAGEFILTER_NO_SIMD to always use the portable scalar code.
+//
+// ----------
+//  OVERVIEW
+// ----------
+// The codecs in this repository see an image as a flat string of bytes,
+// so they can't make use of neighbouring pixels being alike. Filtering
+// replaces each byte by its difference from a prediction made from the
+// pixel to its left (a), above it (b) and above-left (c), as PNG does:
+//
+//   None    : 0
+//   Sub     : a
+//   Up      : b
+//   Average : (a + b) / 2
+//   Paeth   : whichever of a, b, c is closest to a + b - c
+//
+// In smooth areas the residuals cluster around 0 (and 255, for small
+// negative differences), which is what the entropy coders (Huffman,
+// Rice) and RLE want. The output is the same size as the image plus a
+// byte per row naming the filter used on that row, and goes to any of
+// the codecs as it is. Adaptive picks a filter per row, the one with
+// the smallest sum of residuals taken as signed bytes.
+//
+// Rows are stored top to bottom, width * channels bytes each, with no
+// padding. Any channel count from 1 to 8 bytes per pixel works.
+
+#include <cstdint>
+
+namespace imagefilter
+{
+
+// Unfiltering rows (the decoder side) has an SSSE3 kernel. False
+// with IMAGEFILTER_NO_SIMD or when not compiling for x86/x64.
+struct CpuFeatures
+{
+    bool ssse3 = false;
+};
+
+// Whether the SSSE3 unfilter kernel is in use.
+const CpuFeatures & getCpuFeatures();
+
+// Clearing ssse3 forces the scalar unfilter (it can't be forced on).
+// Not thread safe; call it before decoding.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Row counts per filter, to see what Adaptive picks. Only updated when
+// IMAGEFILTER_ENABLE_STATS is defined with IMAGEFILTER_IMPLEMENTATION.
+// Each thread counts its own rows.
+struct Stats
+{
+    std::uint64_t encodeCalls    = 0; // easyEncode() calls.
+    std::uint64_t decodeCalls    = 0; // easyDecode() calls.
+    std::uint64_t rowsFiltered   = 0; // Rows written by the encoder.
+    std::uint64_t rowsUnfiltered = 0; // Rows restored by the decoder.
+    std::uint64_t filterRows[5]  = {}; // Rows written with each Filter, None to Paeth; shows what Adaptive picks.
+};
+
+// Counters of the calling thread (zero unless stats are enabled).
+const Stats & getStats();
+void resetStats();
+
+// Prediction used on a row. The values are the ones stored in the filtered data.
+enum class Filter : std::uint8_t
+{
+    None     = 0,
+    Sub      = 1,
+    Up       = 2,
+    Average  = 3,
+    Paeth    = 4,
+    Adaptive = 5 // Encoder only: the best of the above, chosen for each row.
+};
+
+// Size of the output of easyEncode() for an image: a filter byte per row
+// plus the pixels. -1 if the dimensions are not valid or too large.
+int filteredSize(int width, int height, int channels);
+
+// Filters the image in 'pixels' (height rows of width * channels bytes) into
+// 'output', which needs room for filteredSize() bytes. Returns the bytes
+// written or -1 on error.
+int easyEncode(const std::uint8_t * pixels, int width, int height, int channels,
+               std::uint8_t * output, int outSizeBytes, Filter filter = Filter::Adaptive);
+
+// Restores the image from the output of easyEncode(), with the same dimensions.
+// Returns the bytes written to 'pixels' or -1 if the input is not valid.
+int easyDecode(const std::uint8_t * input, int inSizeBytes, int width, int height, int channels,
+               std::uint8_t * pixels, int pixelsSizeBytes);
+
+// The two functions above allocate a row or two of scratch memory on the heap.
+// For the low-memory profile, these overloads take it from a caller workspace
+// of workspaceSize() bytes instead (-1 if the dimensions are not valid).
+// The Adaptive size is enough for any filter and for decoding.
+int workspaceSize(int width, int channels, Filter filter = Filter::Adaptive);
+
+int easyEncode(const std::uint8_t * pixels, int width, int height, int channels,
+               std::uint8_t * output, int outSizeBytes, Filter filter,
+               void * workspace, int workspaceSizeBytes);
+
+int easyDecode(const std::uint8_t * input, int inSizeBytes, int width, int height, int channels,
+               std::uint8_t * pixels, int pixelsSizeBytes, void * workspace, int workspaceSizeBytes);
+
+} // namespace imagefilter {}
+
+// ================== End of header file ==================
+#endif // IMAGEFILTER_HPP
+// ================== End of header file ==================
+
+// ================================================================================================
+//
+//                                  Image Filter Implementation
+//
+// ================================================================================================
+
+#ifdef IMAGEFILTER_IMPLEMENTATION
+
+#include <cstring>
+#include <vector>
+
+#if !defined(IMAGEFILTER_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define IMAGEFILTER_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define IMAGEFILTER_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define IMAGEFILTER_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define IMAGEFILTER_X86_SIMD 0
+#endif // x86
+
+namespace imagefilter
+{
+
+constexpr int MaxChannels = 8;
+constexpr int FilterCount = 5;
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef IMAGEFILTER_ENABLE_STATS
+    #define IMAGEFILTER_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !IMAGEFILTER_ENABLE_STATS
+    #define IMAGEFILTER_STATS_ADD(counter, amount) ((void)0)
+#endif // IMAGEFILTER_ENABLE_STATS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if IMAGEFILTER_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+#endif // IMAGEFILTER_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if IMAGEFILTER_X86_SIMD
+    unsigned regs[4];
+    cpuid(1, 0, regs);
+    features.ssse3 = (regs[2] & (1u << 9)) != 0;
+    #endif // IMAGEFILTER_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Predictors:
+// ========================================================
+
+static int paethPredictor(const int a, const int b, const int c)
+{
+    const int p  = a + b - c;
+    const int pa = (p > a) ? p - a : a - p;
+    const int pb = (p > b) ? p - b : b - p;
+    const int pc = (p > c) ? p - c : c - p;
+
+    // Ties are broken in the order a, b, c.
+    if (pa <= pb && pa <= pc)
+    {
+        return a;
+    }
+    return (pb <= pc) ? b : c;
+}
+
+// Byte 'i' of the prediction for a row, given the row's own bytes (the
+// original ones) and the row above. 'bpp' is the bytes per pixel.
+static int predict(const Filter filter, const std::uint8_t * row, const std::uint8_t * prior,
+                   const int i, const int bpp)
+{
+    const int a = (i >= bpp) ? row[i - bpp]   : 0;
+    const int b = prior[i];
+    const int c = (i >= bpp) ? prior[i - bpp] : 0;
+
+    switch (filter)
+    {
+    case Filter::Sub     : return a;
+    case Filter::Up      : return b;
+    case Filter::Average : return (a + b) >> 1;
+    case Filter::Paeth   : return paethPredictor(a, b, c);
+    default              : return 0;
+    } // switch
+}
+
+// ========================================================
+// Filtering (encoder side):
+// ========================================================
+
+// Writes the residuals of one row. Returns the sum of their magnitudes
+// as signed bytes, the usual heuristic for how well they'll compress.
+static std::uint32_t filterRow(const Filter filter, const std::uint8_t * row, const std::uint8_t * prior,
+                               const int rowBytes, const int bpp, std::uint8_t * output)
+{
+    std::uint32_t cost = 0;
+    for (int i = 0; i < rowBytes; ++i)
+    {
+        const std::uint8_t residual = static_cast<std::uint8_t>(row[i] - predict(filter, row, prior, i, bpp));
+        output[i] = residual;
+        cost += (residual < 128) ? residual : 256 - residual;
+    }
+    return cost;
+}
+
+// ========================================================
+// Unfiltering kernels (decoder side):
+// ========================================================
+
+//
+// Each restores one row in place: on entry 'row' holds the residuals,
+// on exit the pixels. 'prior' is the restored row above (zeros for the
+// first row). Sub, Average and Paeth depend on the pixel to the left,
+// so those go a pixel at a time; Up has no such dependency.
+//
+using UnfilterRowFunc = void (*)(Filter filter, std::uint8_t * row, const std::uint8_t * prior, int rowBytes, int bpp);
+
+static void unfilterRowScalar(const Filter filter, std::uint8_t * row, const std::uint8_t * prior,
+                              const int rowBytes, const int bpp)
+{
+    switch (filter)
+    {
+    case Filter::Sub :
+        for (int i = bpp; i < rowBytes; ++i)
+        {
+            row[i] = static_cast<std::uint8_t>(row[i] + row[i - bpp]);
+        }
+        break;
+    case Filter::Up :
+        for (int i = 0; i < rowBytes; ++i)
+        {
+            row[i] = static_cast<std::uint8_t>(row[i] + prior[i]);
+        }
+        break;
+    case Filter::Average :
+    case Filter::Paeth :
+        for (int i = 0; i < rowBytes; ++i)
+        {
+            row[i] = static_cast<std::uint8_t>(row[i] + predict(filter, row, prior, i, bpp));
+        }
+        break;
+    default :
+        break;
+    } // switch
+}
+
+#if IMAGEFILTER_X86_SIMD
+
+// A pixel of 3 or 4 bytes in the low lanes of a register, and back.
+IMAGEFILTER_TARGET("ssse3")
+static __m128i loadPixel(const std::uint8_t * pixel, const int bpp)
+{
+    std::uint32_t bytes = 0;
+    std::memcpy(&bytes, pixel, bpp);
+    return _mm_cvtsi32_si128(static_cast<int>(bytes));
+}
+
+IMAGEFILTER_TARGET("ssse3")
+static void storePixel(std::uint8_t * pixel, const __m128i value, const int bpp)
+{
+    const std::uint32_t bytes = static_cast<std::uint32_t>(_mm_cvtsi128_si32(value));
+    std::memcpy(pixel, &bytes, bpp);
+}
+
+// The same as the PNG reference decoder, a pixel per step for 3 and 4 byte
+// pixels (RGB/RGBA), with Paeth in 16-bit lanes to have room for a + b - c.
+// Other pixel sizes only get the vector Up filter.
+IMAGEFILTER_TARGET("ssse3")
+static void unfilterRowSSSE3(const Filter filter, std::uint8_t * row, const std::uint8_t * prior,
+                             const int rowBytes, const int bpp)
+{
+    if (filter == Filter::Up)
+    {
+        int i = 0;
+        for (; i + 16 <= rowBytes; i += 16)
+        {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prior + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(row + i), _mm_add_epi8(x, b));
+        }
+        for (; i < rowBytes; ++i)
+        {
+            row[i] = static_cast<std::uint8_t>(row[i] + prior[i]);
+        }
+        return;
+    }
+
+    if ((bpp != 3 && bpp != 4) || filter == Filter::None)
+    {
+        unfilterRowScalar(filter, row, prior, rowBytes, bpp);
+        return;
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+    __m128i a = zero; // Pixel to the left.
+    __m128i c = zero; // Pixel above-left.
+
+    switch (filter)
+    {
+    case Filter::Sub :
+        for (int i = 0; i < rowBytes; i += bpp)
+        {
+            a = _mm_add_epi8(a, loadPixel(row + i, bpp));
+            storePixel(row + i, a, bpp);
+        }
+        break;
+
+    case Filter::Average :
+        for (int i = 0; i < rowBytes; i += bpp)
+        {
+            // pavgb rounds up, (a + b) / 2 rounds down: take the odd bit back out.
+            const __m128i b = loadPixel(prior + i, bpp);
+            const __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(loadPixel(row + i, bpp), average);
+            storePixel(row + i, a, bpp);
+        }
+        break;
+
+    case Filter::Paeth :
+        for (int i = 0; i < rowBytes; i += bpp)
+        {
+            const __m128i b = _mm_unpacklo_epi8(loadPixel(prior + i, bpp), zero);
+            const __m128i a16 = _mm_unpacklo_epi8(a, zero);
+
+            // pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+            const __m128i pa = _mm_abs_epi16(_mm_sub_epi16(b, c));
+            const __m128i pb = _mm_abs_epi16(_mm_sub_epi16(a16, c));
+            const __m128i pc = _mm_abs_epi16(_mm_sub_epi16(_mm_add_epi16(a16, b), _mm_add_epi16(c, c)));
+
+            // a if pa <= pb and pa <= pc, else b if pb <= pc, else c.
+            const __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+            const __m128i notB = _mm_cmpgt_epi16(pb, pc);
+            const __m128i bOrC = _mm_or_si128(_mm_andnot_si128(notB, b), _mm_and_si128(notB, c));
+            const __m128i prediction = _mm_or_si128(_mm_andnot_si128(notA, a16), _mm_and_si128(notA, bOrC));
+
+            a = _mm_add_epi8(loadPixel(row + i, bpp), _mm_packus_epi16(prediction, prediction));
+            storePixel(row + i, a, bpp);
+            c = b;
+        }
+        break;
+
+    default :
+        break;
+    } // switch
+}
+
+#endif // IMAGEFILTER_X86_SIMD
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+struct Kernels
+{
+    UnfilterRowFunc unfilterRow;
+};
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.unfilterRow = &unfilterRowScalar;
+
+    #if IMAGEFILTER_X86_SIMD
+    if (features.ssse3)
+    {
+        kernels.unfilterRow = &unfilterRowSSSE3;
+    }
+    #else // !IMAGEFILTER_X86_SIMD
+    (void)features;
+    #endif // IMAGEFILTER_X86_SIMD
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.ssse3 = features.ssse3 && detected.ssse3;
+
+    kernelsInstance() = selectKernels(current);
+}
+
+// ========================================================
+// easyEncode() / easyDecode():
+// ========================================================
+
+int filteredSize(const int width, const int height, const int channels)
+{
+    if (width <= 0 || height <= 0 || channels <= 0 || channels > MaxChannels)
+    {
+        return -1;
+    }
+
+    const std::int64_t size = static_cast<std::int64_t>(height) * (1 + static_cast<std::int64_t>(width) * channels);
+    return (size <= 0x7FFFFFFF) ? static_cast<int>(size) : -1;
+}
+
+int workspaceSize(const int width, const int channels, const Filter filter)
+{
+    if (width <= 0 || channels <= 0 || channels > MaxChannels ||
+        static_cast<std::int64_t>(width) * channels * 2 > 0x7FFFFFFF)
+    {
+        return -1;
+    }
+    return width * channels * ((filter == Filter::Adaptive) ? 2 : 1);
+}
+
+int easyEncode(const std::uint8_t * pixels, const int width, const int height, const int channels,
+               std::uint8_t * output, const int outSizeBytes, const Filter filter)
+{
+    const int scratchSize = workspaceSize(width, channels, filter);
+    if (scratchSize < 0)
+    {
+        return -1;
+    }
+    std::vector<std::uint8_t> workspace(scratchSize);
+    return easyEncode(pixels, width, height, channels, output, outSizeBytes, filter, workspace.data(), scratchSize);
+}
+
+int easyEncode(const std::uint8_t * pixels, const int width, const int height, const int channels,
+               std::uint8_t * output, const int outSizeBytes, const Filter filter,
+               void * workspace, const int workspaceSizeBytes)
+{
+    const int outputSize = filteredSize(width, height, channels);
+    if (pixels == nullptr || output == nullptr || outputSize < 0 || outSizeBytes < outputSize)
+    {
+        return -1;
+    }
+    if (static_cast<int>(filter) > static_cast<int>(Filter::Adaptive))
+    {
+        return -1;
+    }
+    if (workspace == nullptr || workspaceSizeBytes < workspaceSize(width, channels, filter))
+    {
+        return -1;
+    }
+
+    IMAGEFILTER_STATS_ADD(encodeCalls, 1);
+
+    // The row above the first one is all zeros. Adaptive tries the filters in the second row.
+    const int rowBytes = width * channels;
+    std::uint8_t * const zeroRow   = static_cast<std::uint8_t *>(workspace);
+    std::uint8_t * const candidate = zeroRow + rowBytes;
+    std::memset(zeroRow, 0, rowBytes);
+
+    const std::uint8_t * prior = zeroRow;
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint8_t * row = pixels + static_cast<std::int64_t>(y) * rowBytes;
+        std::uint8_t * out = output + static_cast<std::int64_t>(y) * (1 + rowBytes);
+
+        Filter rowFilter = filter;
+        if (filter == Filter::Adaptive)
+        {
+            // Try every filter, keeping the cheapest in the output row.
+            std::uint32_t bestCost = filterRow(Filter::None, row, prior, rowBytes, channels, out + 1);
+            rowFilter = Filter::None;
+            for (int f = 1; f < FilterCount; ++f)
+            {
+                const std::uint32_t cost = filterRow(static_cast<Filter>(f), row, prior, rowBytes, channels, candidate);
+                if (cost < bestCost)
+                {
+                    bestCost  = cost;
+                    rowFilter = static_cast<Filter>(f);
+                    std::memcpy(out + 1, candidate, rowBytes);
+                }
+            }
+        }
+        else
+        {
+            filterRow(filter, row, prior, rowBytes, channels, out + 1);
+        }
+
+        out[0] = static_cast<std::uint8_t>(rowFilter);
+        prior  = row;
+
+        IMAGEFILTER_STATS_ADD(rowsFiltered, 1);
+        IMAGEFILTER_STATS_ADD(filterRows[static_cast<int>(rowFilter)], 1);
+    }
+
+    return outputSize;
+}
+
+int easyDecode(const std::uint8_t * input, const int inSizeBytes, const int width, const int height,
+               const int channels, std::uint8_t * pixels, const int pixelsSizeBytes)
+{
+    const int scratchSize = workspaceSize(width, channels, Filter::None);
+    if (scratchSize < 0)
+    {
+        return -1;
+    }
+    std::vector<std::uint8_t> workspace(scratchSize);
+    return easyDecode(input, inSizeBytes, width, height, channels, pixels, pixelsSizeBytes, workspace.data(), scratchSize);
+}
+
+int easyDecode(const std::uint8_t * input, const int inSizeBytes, const int width, const int height,
+               const int channels, std::uint8_t * pixels, const int pixelsSizeBytes,
+               void * workspace, const int workspaceSizeBytes)
+{
+    const int inputSize = filteredSize(width, height, channels);
+    if (input == nullptr || pixels == nullptr || inputSize < 0 || inSizeBytes < inputSize)
+    {
+        return -1;
+    }
+
+    const int rowBytes = width * channels;
+    const int imageBytes = inputSize - height;
+    if (pixelsSizeBytes < imageBytes)
+    {
+        return -1;
+    }
+    if (workspace == nullptr || workspaceSizeBytes < rowBytes)
+    {
+        return -1;
+    }
+
+    IMAGEFILTER_STATS_ADD(decodeCalls, 1);
+
+    const auto unfilterRow = kernelsInstance().unfilterRow;
+    std::uint8_t * const zeroRow = static_cast<std::uint8_t *>(workspace);
+    std::memset(zeroRow, 0, rowBytes);
+
+    const std::uint8_t * prior = zeroRow;
+    int result = imageBytes;
+    for (int y = 0; y < height; ++y)
+    {
+        const std::uint8_t * in = input + static_cast<std::int64_t>(y) * (1 + rowBytes);
+        std::uint8_t * row = pixels + static_cast<std::int64_t>(y) * rowBytes;
+
+        if (in[0] >= FilterCount)
+        {
+            result = -1;
+            break;
+        }
+
+        std::memcpy(row, in + 1, rowBytes);
+        unfilterRow(static_cast<Filter>(in[0]), row, prior, rowBytes, channels);
+        prior = row;
+
+        IMAGEFILTER_STATS_ADD(rowsUnfiltered, 1);
+    }
+
+    return result;
+}
+
+} // namespace imagefilter {}
+
+// ================ End of implementation =================
+#endif // IMAGEFILTER_IMPLEMENTATION
+// ================ End of implementation =================
@@ -26,6 +26,9 @@
 // #define LZW_IMPLEMENTATION in one source file before including
 // this file, then use lzw.hpp as a normal header file elsewhere.
 //
+// The bit stream reader/writer use BMI2 kernels when the CPU has
+// them, picked at runtime. #define LZW_NO_SIMD to disable that.
+//
 // ----------
 //  OVERVIEW
 // ----------
@@ -54,6 +57,14 @@
 // must match perfectly, since the lengths of the codes will not be specified with
 // the data itself.
 //
+// Every dictionary reset leaves the decoder in the same state it starts
+// in, so the codes between two resets can be decoded with no knowledge of
+// the ones before them. The easyEncode() overload that takes a ResetPoint
+// list records where each reset falls in the code and output streams, and
+// easyDecodeParallel() hands those segments out to several threads. The
+// code stream is the same either way; the list is kept by the caller.
+// #define LZW_NO_THREADS to make easyDecodeParallel() sequential.
+//
 // --------------
 //  USEFUL LINKS
 // --------------
@@ -91,6 +102,50 @@ namespace lzw
     #define LZW_ERROR(message) ::lzw::fatalError(message)
 #endif // LZW_ERROR
 
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+// BMI2 (with BMI1) lets the bit stream reader/writer shift and mask
+// codes without branches. False with LZW_NO_SIMD or off x86/x64.
+struct CpuFeatures
+{
+    bool bmi2 = false;
+};
+
+// Whether the BMI2 bit stream kernels are in use.
+const CpuFeatures & getCpuFeatures();
+
+// Clearing bmi2 forces the portable bit stream code, e.g. in tests. A feature
+// the CPU lacks stays off. Not thread safe; call it before any coding.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Code and dictionary counters (probes, resets) for tuning the encoder.
+// Built in only when LZW_ENABLE_STATS is defined with LZW_IMPLEMENTATION,
+// all zero otherwise. Every thread counts its own work.
+struct Stats
+{
+    std::uint64_t encodeCalls      = 0; // easyEncode() calls.
+    std::uint64_t decodeCalls      = 0; // easyDecode() calls.
+    std::uint64_t bytesEncoded     = 0; // Uncompressed bytes consumed by the encoder.
+    std::uint64_t bytesDecoded     = 0; // Uncompressed bytes produced by the decoder.
+    std::uint64_t bitsWritten      = 0; // Compressed bits output by the encoder.
+    std::uint64_t bitsRead         = 0; // Compressed bits consumed by the decoder.
+    std::uint64_t codesWritten     = 0; // Dictionary codes output by the encoder.
+    std::uint64_t codesRead        = 0; // Dictionary codes consumed by the decoder.
+    std::uint64_t dictionaryProbes = 0; // Entries visited by Dictionary::findIndex() and phrase match searches.
+    std::uint64_t dictionaryResets = 0; // Dictionary clears (encoder and decoder both count).
+    std::uint64_t allocatorGrowths = 0; // Reallocations of a BitStreamWriter buffer in allocate().
+};
+
+// The calling thread's counters since startup or the last resetStats().
+const Stats & getStats();
+void resetStats();
+
 // ========================================================
 // class BitStreamWriter:
 // ========================================================
@@ -106,6 +161,10 @@ public:
     BitStreamWriter();
     explicit BitStreamWriter(int initialSizeInBits, int growthGranularity = 2);
 
+    // Writes to a fixed caller buffer, which is never grown nor freed. Bits that
+    // don't fit are dropped and hasOverflowed() becomes true.
+    BitStreamWriter(std::uint8_t * buffer, int bufferSizeBytes);
+
     void allocate(int bitsWanted);
     void setGranularity(int growthGranularity);
     std::uint8_t * release();
@@ -121,6 +180,7 @@ public:
     int getByteCount() const;
     int getBitCount()  const;
     const std::uint8_t * getBitStream() const;
+    bool hasOverflowed() const { return overflowed; }
 
     ~BitStreamWriter();
 
@@ -129,7 +189,9 @@ private:
     void internalInit();
     static std::uint8_t * allocBytes(int bytesWanted, std::uint8_t * oldPtr, int oldSize);
 
-    std::uint8_t * stream; // Growable buffer to store our bits. Heap allocated & owned by the class instance.
+    std::uint8_t * stream; // Growable buffer to store our bits. Heap allocated & owned by the class instance,
+                           // unless it is a fixed caller buffer (granularity is then zero).
+    bool overflowed;       // A fixed buffer ran out of space.
     int bytesAllocated;    // Current size of heap-allocated stream buffer *in bytes*.
     int granularity;       // Amount bytesAllocated multiplies by when auto-resizing in appendBit().
     int currBytePos;       // Current byte being written to, from 0 to bytesAllocated-1.
@@ -156,6 +218,9 @@ public:
     bool readNextBit(int & bitOut);
     std::uint64_t readBitsU64(int bitCount);
     void reset();
+    void seek(int bitPos);
+
+    int getBitsRead() const { return numBitsRead; }
 
 private:
 
@@ -191,7 +256,12 @@ public:
     int size;
     Entry entries[MaxDictEntries];
 
+    // Decoder scratch for a sequence being reversed. Kept here rather
+    // than on the stack, which may be small (see the low-memory profile).
+    std::uint8_t sequence[MaxDictEntries];
+
     Dictionary();
+    void reset();
     int findIndex(int code, int value) const;
     bool add(int code, int value);
     bool flush(int & codeBitsWidth);
@@ -206,6 +276,21 @@ public:
 void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
                 std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits);
 
+// A point where the encoder cleared its dictionary. Decoding can start over
+// here, with a fresh dictionary, and carry on independently of what came before.
+struct ResetPoint
+{
+    int bitOffset;  // Offset of the first code after the reset in the compressed bit stream.
+    int byteOffset; // Offset in the uncompressed data of the first byte that code expands to.
+};
+
+// Same as easyEncode(), with the same output, also listing every dictionary reset
+// in order. The list is heap allocated with LZW_MALLOC() and should be later freed
+// with LZW_MFREE(). It is null, with a count of zero, if the dictionary never filled.
+void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits,
+                ResetPoint ** resetPoints, int * resetPointCount);
+
 // Decompress back the output of easyEncode().
 // The uncompressed output buffer is assumed to be big enough to hold the uncompressed data,
 // if it happens to be smaller, the decoder will return a partial output and the return value
@@ -213,6 +298,145 @@ void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
 int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
                std::uint8_t * uncompressed, int uncompressedSizeBytes);
 
+// One piece of a scatter/gather output buffer, like a POSIX iovec.
+struct OutputSegment
+{
+    std::uint8_t * data;
+    int sizeBytes;
+};
+
+// Decompress straight into a list of buffers (e.g. network buffers or pages),
+// which are filled in order as if they were a single contiguous buffer.
+// Same return value as the contiguous easyDecode().
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               const OutputSegment * outputSegments, int outputSegmentCount);
+
+// Decompress the output of easyEncode() with up to threadCount threads (0 = one per
+// hardware thread), each taking some of the segments between the given reset points.
+// Same return value as easyDecode().
+int easyDecodeParallel(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+                       const ResetPoint * resetPoints, int resetPointCount,
+                       std::uint8_t * uncompressed, int uncompressedSizeBytes, int threadCount = 0);
+
+// ========================================================
+// LZMW / LZAP variants:
+// ========================================================
+
+// How the dictionary grows after each code. Classic LZW adds the previous
+// phrase plus one byte, so a repeat of length N takes N codes to learn.
+// LZMW adds the previous phrase followed by the whole current one, and
+// LZAP adds the previous phrase followed by every prefix of the current
+// one, so long repeats are learned in a few steps. These two modes use up
+// to 14-bit codes and keep about 256KB of dictionary on the heap while
+// running. The mode is not stored in the stream; the decoder must be
+// given the one used by the encoder.
+enum class Mode
+{
+    LZW,
+    LZMW,
+    LZAP
+};
+
+// Same as easyEncode(), with the given dictionary growth mode.
+// Mode::LZW produces the same stream as the plain overload.
+void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits,
+                Mode mode);
+
+// Decompress the output of the easyEncode() overload above, encoded with the same mode.
+// LZMW/LZAP phrases are copied from the bytes already decoded, so they need a
+// contiguous output buffer. Same return value as the other easyDecode() overloads.
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               std::uint8_t * uncompressed, int uncompressedSizeBytes, Mode mode);
+
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+// For small stacks and no heap at all (e.g. thousands of fibers with 16KB
+// stacks), the overloads below write to caller buffers and keep the dictionary
+// in a caller-provided workspace of workspaceSize() bytes. They never call
+// LZW_MALLOC and use well under 1KB of stack. Codes take up to 12 bits in
+// Mode::LZW and 14 bits in the others, so an output buffer of twice the input
+// size always fits.
+int workspaceSize(Mode mode = Mode::LZW);
+
+// Returns the compressed size in bytes, or zero if the output buffer or the
+// workspace was too small (LZW_ERROR() is called first). Same stream as the
+// heap-allocating easyEncode() for the mode.
+int easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+               std::uint8_t * compressed, int compressedCapacityBytes, int * compressedSizeBits,
+               void * workspace, int workspaceSizeBytes, Mode mode = Mode::LZW);
+
+// Same as the easyDecode() for the mode, with the dictionary in the workspace.
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               std::uint8_t * uncompressed, int uncompressedSizeBytes,
+               void * workspace, int workspaceSizeBytes, Mode mode = Mode::LZW);
+
+// ========================================================
+// In-place decoding:
+// ========================================================
+
+// Store the output of easyEncode() at the very end of the destination buffer
+// and decode it into the same buffer, so large payloads don't need a separate
+// input copy. The buffer must hold the decoded size plus inPlaceMargin() bytes.
+// Every code expands to at least one byte and takes at most 12 bits (14 bits
+// for LZMW/LZAP), so the output can only gain on the codes not read yet by a
+// third (three sevenths) of the compressed size, which bounds the margin.
+int inPlaceMargin(int compressedSizeBytes, Mode mode = Mode::LZW);
+
+// Decodes the compressedSizeBytes at the end of the buffer to its start.
+// Output past bufferSizeBytes minus the margin is an error, reported like
+// a too small buffer in easyDecode(), so unread codes are never overwritten.
+int easyDecodeInPlace(std::uint8_t * buffer, int bufferSizeBytes, int compressedSizeBytes,
+                      int compressedSizeBits, Mode mode = Mode::LZW);
+
+// ========================================================
+// class WindowDecoder:
+// ========================================================
+
+// Decodes the output of easyEncode() one fixed-size window at a time,
+// so the data can be consumed while it is decoded and only a window of
+// it has to be kept in memory, instead of the whole uncompressed size.
+class WindowDecoder final
+{
+public:
+
+    static constexpr int DefaultWindowSizeBytes = 64 * 1024;
+
+    // No copy/assignment.
+    WindowDecoder(const WindowDecoder &) = delete;
+    WindowDecoder & operator = (const WindowDecoder &) = delete;
+
+    WindowDecoder(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+                  int windowSizeBytes = DefaultWindowSizeBytes);
+    ~WindowDecoder();
+
+    // Decodes the next window and points *window to it. Returns its size
+    // in bytes, which is only less than the window size for the last one,
+    // and 0 once the stream is over. The data stays valid until the next call.
+    int next(const std::uint8_t ** window);
+
+    // Total bytes returned by next() so far.
+    int getBytesDecoded() const { return bytesDecoded; }
+
+private:
+
+    BitStreamReader bitStream;
+    Dictionary dictionary;
+    int prevCode;
+    int firstByte;
+    int codeBitsWidth;
+
+    // A code can expand to a whole dictionary sequence, so the buffer has room
+    // for one window plus the longest sequence. What doesn't fit in the window
+    // is carried over to the start of the next one.
+    std::uint8_t * buffer;
+    const int windowSize;
+    int carryBytes;
+    int bytesDecoded;
+};
+
 } // namespace lzw {}
 
 // ================== End of header file ==================
@@ -232,7 +456,29 @@ int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int com
 #endif // LZW_USING_DEFAULT_ERROR_HANDLER
 
 #include <cassert>
+#include <cstddef>
 #include <cstring>
+#include <new>
+
+#ifndef LZW_NO_THREADS
+    #include <functional>
+    #include <thread>
+    #include <vector>
+#endif // LZW_NO_THREADS
+
+#if !defined(LZW_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define LZW_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define LZW_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define LZW_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define LZW_X86_SIMD 0
+#endif // x86
 
 namespace lzw
 {
@@ -266,6 +512,191 @@ void fatalError(const char * const message)
 
 #endif // LZW_USING_DEFAULT_ERROR_HANDLER
 
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef LZW_ENABLE_STATS
+    #define LZW_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !LZW_ENABLE_STATS
+    #define LZW_STATS_ADD(counter, amount) ((void)0)
+#endif // LZW_ENABLE_STATS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if LZW_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+#endif // LZW_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if LZW_X86_SIMD
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.bmi2 = (regs[1] & (1u << 3)) != 0 && (regs[1] & (1u << 8)) != 0; // BMI1 + BMI2
+    }
+    #endif // LZW_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Bit packing kernels:
+// ========================================================
+
+// Bit streams are filled from the least significant bit of each byte,
+// so an unaligned little-endian 64-bit load lines up a window of bits
+// we can shift and mask in one go rather than looping bit by bit.
+// The kernels handle up to MaxFastBits bits per call and need 8 valid
+// bytes starting at the byte that contains bitPos.
+constexpr int MaxFastBits = 57;
+
+static std::uint64_t loadU64(const std::uint8_t * bytes)
+{
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    return word;
+}
+
+static void storeU64(std::uint8_t * bytes, std::uint64_t word)
+{
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    std::memcpy(bytes, &word, sizeof(word));
+}
+
+static std::uint64_t peekBitsScalar(const std::uint8_t * stream, const int bitPos, const int bitCount)
+{
+    const std::uint64_t word = loadU64(stream + (bitPos >> 3)) >> (bitPos & 7);
+    return word & ((std::uint64_t(1) << bitCount) - 1);
+}
+
+static void pokeBitsScalar(std::uint8_t * stream, const int bitPos, const std::uint64_t num, const int bitCount)
+{
+    const int shift = bitPos & 7;
+    const std::uint64_t mask = ((std::uint64_t(1) << bitCount) - 1) << shift;
+    std::uint8_t * bytes = stream + (bitPos >> 3);
+    storeU64(bytes, (loadU64(bytes) & ~mask) | ((num << shift) & mask));
+}
+
+#if LZW_X86_SIMD && (defined(__x86_64__) || defined(_M_X64))
+
+// Same as above, but bzhi does the masking and the variable
+// shifts compile to shrx/shlx (no flags, no CL register).
+LZW_TARGET("bmi,bmi2")
+static std::uint64_t peekBitsBMI2(const std::uint8_t * stream, const int bitPos, const int bitCount)
+{
+    const std::uint64_t word = loadU64(stream + (bitPos >> 3));
+    return _bzhi_u64(word >> (bitPos & 7), static_cast<unsigned>(bitCount));
+}
+
+LZW_TARGET("bmi,bmi2")
+static void pokeBitsBMI2(std::uint8_t * stream, const int bitPos, const std::uint64_t num, const int bitCount)
+{
+    const int shift = bitPos & 7;
+    const std::uint64_t mask = _bzhi_u64(~std::uint64_t(0), static_cast<unsigned>(bitCount)) << shift;
+    std::uint8_t * bytes = stream + (bitPos >> 3);
+    storeU64(bytes, (loadU64(bytes) & ~mask) | (_bzhi_u64(num, static_cast<unsigned>(bitCount)) << shift));
+}
+
+#endif // LZW_X86_SIMD && x64
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+struct Kernels
+{
+    std::uint64_t (*peekBits)(const std::uint8_t * stream, int bitPos, int bitCount);
+    void (*pokeBits)(std::uint8_t * stream, int bitPos, std::uint64_t num, int bitCount);
+};
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.peekBits = &peekBitsScalar;
+    kernels.pokeBits = &pokeBitsScalar;
+
+    #if LZW_X86_SIMD && (defined(__x86_64__) || defined(_M_X64))
+    if (features.bmi2)
+    {
+        kernels.peekBits = &peekBitsBMI2;
+        kernels.pokeBits = &pokeBitsBMI2;
+    }
+    #else // !x64
+    (void)features;
+    #endif // LZW_X86_SIMD && x64
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.bmi2 = features.bmi2 && detected.bmi2;
+
+    kernelsInstance() = selectKernels(current);
+}
+
 // ========================================================
 // class BitStreamWriter:
 // ========================================================
@@ -285,9 +716,17 @@ BitStreamWriter::BitStreamWriter(const int initialSizeInBits, const int growthGr
     allocate(initialSizeInBits);
 }
 
+BitStreamWriter::BitStreamWriter(std::uint8_t * buffer, const int bufferSizeBytes)
+{
+    internalInit();
+    stream         = buffer;
+    bytesAllocated = (buffer != nullptr && bufferSizeBytes > 0) ? bufferSizeBytes : 0;
+    granularity    = 0;
+}
+
 BitStreamWriter::~BitStreamWriter()
 {
-    if (stream != nullptr)
+    if (stream != nullptr && granularity != 0)
     {
         LZW_MFREE(stream);
     }
@@ -296,6 +735,7 @@ BitStreamWriter::~BitStreamWriter()
 void BitStreamWriter::internalInit()
 {
     stream         = nullptr;
+    overflowed     = false;
     bytesAllocated = 0;
     granularity    = 2;
     currBytePos    = 0;
@@ -323,13 +763,26 @@ void BitStreamWriter::allocate(int bitsWanted)
     {
         return;
     }
+    if (granularity == 0)
+    {
+        overflowed = true;
+        return;
+    }
 
+    LZW_STATS_ADD(allocatorGrowths, stream != nullptr);
     stream = allocBytes(sizeInBytes, stream, bytesAllocated);
     bytesAllocated = sizeInBytes;
 }
 
 void BitStreamWriter::appendBit(const int bit)
 {
+    // Only a fixed buffer can be full here.
+    if (currBytePos == bytesAllocated)
+    {
+        overflowed = true;
+        return;
+    }
+
     const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
     stream[currBytePos] = (stream[currBytePos] & ~mask) | (-bit & mask);
     ++numBitsWritten;
@@ -337,7 +790,7 @@ void BitStreamWriter::appendBit(const int bit)
     if (++nextBitPos == 8)
     {
         nextBitPos = 0;
-        if (++currBytePos == bytesAllocated)
+        if (++currBytePos == bytesAllocated && granularity != 0)
         {
             allocate(bytesAllocated * granularity * 8);
         }
@@ -347,12 +800,34 @@ void BitStreamWriter::appendBit(const int bit)
 void BitStreamWriter::appendBitsU64(const std::uint64_t num, const int bitCount)
 {
     assert(bitCount <= 64);
-    for (int b = 0; b < bitCount; ++b)
+    if (bitCount > MaxFastBits)
     {
-        const std::uint64_t mask = std::uint64_t(1) << b;
-        const int bit = !!(num & mask);
-        appendBit(bit);
+        // Split it so each half fits a single kernel call.
+        appendBitsU64(num & 0xFFFFFFFF, 32);
+        appendBitsU64(num >> 32, bitCount - 32);
+        return;
+    }
+
+    // The kernel touches 8 bytes, and appendBit() expects
+    // the current byte to be valid afterwards, so need 9.
+    while (currBytePos + 9 > bytesAllocated)
+    {
+        if (granularity == 0)
+        {
+            // Last few bytes of a fixed buffer.
+            for (int b = 0; b < bitCount; ++b)
+            {
+                appendBit(static_cast<int>((num >> b) & 1));
+            }
+            return;
+        }
+        allocate(bytesAllocated * granularity * 8);
     }
+
+    kernelsInstance().pokeBits(stream, numBitsWritten, num, bitCount);
+    numBitsWritten += bitCount;
+    currBytePos = numBitsWritten >> 3;
+    nextBitPos  = numBitsWritten & 7;
 }
 
 #ifndef LZW_NO_STD_STRING
@@ -400,7 +875,10 @@ std::uint8_t * BitStreamWriter::release()
 
 void BitStreamWriter::setGranularity(const int growthGranularity)
 {
-    granularity = (growthGranularity >= 2) ? growthGranularity : 2;
+    if (granularity != 0)
+    {
+        granularity = (growthGranularity >= 2) ? growthGranularity : 2;
+    }
 }
 
 int BitStreamWriter::getByteCount() const
@@ -482,6 +960,17 @@ std::uint64_t BitStreamReader::readBitsU64(const int bitCount)
 {
     assert(bitCount <= 64);
 
+    // Fast path: grab the whole thing with a single kernel call
+    // when there are enough bytes left for its 64-bit load.
+    if (bitCount <= MaxFastBits && numBitsRead + bitCount <= sizeInBits && currBytePos + 8 <= sizeInBytes)
+    {
+        const std::uint64_t num = kernelsInstance().peekBits(stream, numBitsRead, bitCount);
+        numBitsRead += bitCount;
+        currBytePos = numBitsRead >> 3;
+        nextBitPos  = numBitsRead & 7;
+        return num;
+    }
+
     std::uint64_t num = 0;
     for (int b = 0; b < bitCount; ++b)
     {
@@ -508,6 +997,14 @@ void BitStreamReader::reset()
     numBitsRead = 0;
 }
 
+void BitStreamReader::seek(const int bitPos)
+{
+    assert(bitPos >= 0 && bitPos <= sizeInBits);
+    numBitsRead = bitPos;
+    currBytePos = bitPos >> 3;
+    nextBitPos  = bitPos & 7;
+}
+
 bool BitStreamReader::isEndOfStream() const
 {
     return numBitsRead >= sizeInBits;
@@ -518,6 +1015,11 @@ bool BitStreamReader::isEndOfStream() const
 // ========================================================
 
 Dictionary::Dictionary()
+{
+    reset();
+}
+
+void Dictionary::reset()
 {
     // First 256 dictionary entries are reserved to the byte/ASCII
     // range. Additional entries follow for the character sequences
@@ -543,10 +1045,12 @@ int Dictionary::findIndex(const int code, const int value) const
     {
         if (entries[i].code == code && entries[i].value == value)
         {
+            LZW_STATS_ADD(dictionaryProbes, i + 1);
             return i;
         }
     }
 
+    LZW_STATS_ADD(dictionaryProbes, size);
     return Nil;
 }
 
@@ -574,6 +1078,7 @@ bool Dictionary::flush(int & codeBitsWidth)
             // Clear the dictionary (except the first 256 byte entries).
             codeBitsWidth = StartBits;
             size = FirstCode;
+            LZW_STATS_ADD(dictionaryResets, 1);
             return true;
         }
     }
@@ -584,29 +1089,22 @@ bool Dictionary::flush(int & codeBitsWidth)
 // easyEncode() implementation:
 // ========================================================
 
-void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
-                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits)
+// The encoding loop shared by the easyEncode() overloads.
+static void encodeCodes(const std::uint8_t * uncompressed, int uncompressedSizeBytes, Dictionary & dictionary,
+                        BitStreamWriter & bitStream, ResetPoint ** resetPoints, int * resetPointCount)
 {
-    if (uncompressed == nullptr || compressed == nullptr)
-    {
-        LZW_ERROR("lzw::easyEncode(): Null data pointer(s)!");
-        return;
-    }
-
-    if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
-    {
-        LZW_ERROR("lzw::easyEncode(): Bad in/out sizes!");
-        return;
-    }
+    LZW_STATS_ADD(bytesEncoded, uncompressedSizeBytes);
 
     // LZW encoding context:
     int code = Nil;
     int codeBitsWidth = StartBits;
-    Dictionary dictionary;
+    dictionary.reset();
 
-    // Output bit stream we write to. This will allocate
-    // memory as needed to accommodate the encoded data.
-    BitStreamWriter bitStream;
+    // Optional reset point list, grown by doubling.
+    const std::uint8_t * const uncompressedStart = uncompressed;
+    ResetPoint * points = nullptr;
+    int pointCount = 0;
+    int pointCapacity = 0;
 
     for (; uncompressedSizeBytes > 0; --uncompressedSizeBytes, ++uncompressed)
     {
@@ -621,6 +1119,7 @@ void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
 
         // Write the dictionary code using the minimum bit-with:
         bitStream.appendBitsU64(code, codeBitsWidth);
+        LZW_STATS_ADD(codesWritten, 1);
 
         // Flush it when full so we can restart the sequences.
         if (!dictionary.flush(codeBitsWidth))
@@ -628,6 +1127,24 @@ void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
             // There's still space for this sequence.
             dictionary.add(code, value);
         }
+        else if (resetPoints != nullptr)
+        {
+            // The next code starts a new segment, at this byte.
+            if (pointCount == pointCapacity)
+            {
+                pointCapacity = (pointCapacity > 0) ? pointCapacity * 2 : 16;
+                ResetPoint * newPoints = static_cast<ResetPoint *>(LZW_MALLOC(pointCapacity * sizeof(ResetPoint)));
+                if (points != nullptr)
+                {
+                    std::memcpy(newPoints, points, pointCount * sizeof(ResetPoint));
+                    LZW_MFREE(points);
+                }
+                points = newPoints;
+            }
+            points[pointCount].bitOffset  = bitStream.getBitCount();
+            points[pointCount].byteOffset = static_cast<int>(uncompressed - uncompressedStart);
+            ++pointCount;
+        }
         code = value;
     }
 
@@ -635,84 +1152,238 @@ void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
     if (code != Nil)
     {
         bitStream.appendBitsU64(code, codeBitsWidth);
+        LZW_STATS_ADD(codesWritten, 1);
     }
 
-    // Pass ownership of the compressed data buffer to the user pointer:
-    *compressedSizeBytes = bitStream.getByteCount();
-    *compressedSizeBits  = bitStream.getBitCount();
-    *compressed          = bitStream.release();
-}
-
-// ========================================================
-// easyDecode() and helpers:
-// ========================================================
+    LZW_STATS_ADD(encodeCalls, 1);
+    LZW_STATS_ADD(bitsWritten, bitStream.getBitCount());
 
-static bool outputByte(int code, std::uint8_t *& output, int outputSizeBytes, int & bytesDecodedSoFar)
-{
-    if (bytesDecodedSoFar >= outputSizeBytes)
+    if (resetPoints != nullptr)
     {
-        LZW_ERROR("Decoder output buffer too small!");
-        return false;
+        *resetPoints     = points;
+        *resetPointCount = pointCount;
     }
+}
 
-    assert(code >= 0 && code < 256);
-    *output++ = static_cast<std::uint8_t>(code);
-    ++bytesDecodedSoFar;
-    return true;
+void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits)
+{
+    easyEncode(uncompressed, uncompressedSizeBytes, compressed, compressedSizeBytes, compressedSizeBits, nullptr, nullptr);
 }
 
-static bool outputSequence(const Dictionary & dict, int code,
-                           std::uint8_t *& output, int outputSizeBytes,
-                           int & bytesDecodedSoFar, int & firstByte)
+void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits,
+                ResetPoint ** resetPoints, int * resetPointCount)
 {
-    // A sequence is stored backwards, so we have to write
-    // it to a temp then output the buffer in reverse.
-    int i = 0;
-    std::uint8_t sequence[MaxDictEntries];
-    do
+    if (uncompressed == nullptr || compressed == nullptr)
     {
-        assert(i < MaxDictEntries - 1 && code >= 0);
-        sequence[i++] = dict.entries[code].value;
-        code = dict.entries[code].code;
+        LZW_ERROR("lzw::easyEncode(): Null data pointer(s)!");
+        return;
     }
-    while (code >= 0);
 
-    firstByte = sequence[--i];
-    for (; i >= 0; --i)
+    if ((resetPoints == nullptr) != (resetPointCount == nullptr))
     {
-        if (!outputByte(sequence[i], output, outputSizeBytes, bytesDecodedSoFar))
-        {
-            return false;
-        }
+        LZW_ERROR("lzw::easyEncode(): Need both the reset point list and its count!");
+        return;
     }
-    return true;
-}
 
-int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
-               std::uint8_t * uncompressed, const int uncompressedSizeBytes)
-{
-    if (compressed == nullptr || uncompressed == nullptr)
+    if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
     {
-        LZW_ERROR("lzw::easyDecode(): Null data pointer(s)!");
-        return 0;
+        LZW_ERROR("lzw::easyEncode(): Bad in/out sizes!");
+        return;
     }
 
-    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || uncompressedSizeBytes <= 0)
-    {
-        LZW_ERROR("lzw::easyDecode(): Bad in/out sizes!");
-        return 0;
+    // Output bit stream we write to. This will allocate
+    // memory as needed to accommodate the encoded data.
+    BitStreamWriter bitStream;
+    Dictionary dictionary;
+    encodeCodes(uncompressed, uncompressedSizeBytes, dictionary, bitStream, resetPoints, resetPointCount);
+
+    // Pass ownership of the compressed data buffer to the user pointer:
+    *compressedSizeBytes = bitStream.getByteCount();
+    *compressedSizeBits  = bitStream.getBitCount();
+    *compressed          = bitStream.release();
+}
+
+// ========================================================
+// Scatter/gather output:
+// ========================================================
+
+// Byte sink over the caller's OutputSegments, skipping empty ones.
+// Sequences come out of the dictionary one byte at a time anyway.
+class SegmentWriter final
+{
+public:
+
+    // No copy/assignment.
+    SegmentWriter(const SegmentWriter &) = delete;
+    SegmentWriter & operator = (const SegmentWriter &) = delete;
+
+    SegmentWriter(const OutputSegment * outputSegments, const int outputSegmentCount)
+        : segments(outputSegments)
+        , segmentCount(outputSegmentCount)
+        , nextSegment(0)
+        , segmentStart(nullptr)
+        , cursor(nullptr)
+        , segmentEnd(nullptr)
+        , bytesBefore(0)
+    { }
+
+    // Sum of the segment sizes, or -1 if a segment is malformed.
+    static int countBytes(const OutputSegment * outputSegments, const int outputSegmentCount)
+    {
+        std::int64_t total = 0;
+        for (int s = 0; s < outputSegmentCount; ++s)
+        {
+            if (outputSegments[s].sizeBytes < 0 || (outputSegments[s].sizeBytes > 0 && outputSegments[s].data == nullptr))
+            {
+                return -1;
+            }
+            total += outputSegments[s].sizeBytes;
+        }
+        return (total <= 0x7FFFFFFF) ? static_cast<int>(total) : -1;
+    }
+
+    // Writes one byte. False if all the segments are full.
+    bool put(const std::uint8_t value)
+    {
+        if (cursor == segmentEnd && !advance())
+        {
+            return false;
+        }
+        *cursor++ = value;
+        return true;
     }
 
-    int code          = Nil;
+    int getBytesWritten() const
+    {
+        return bytesBefore + static_cast<int>(cursor - segmentStart);
+    }
+
+private:
+
+    bool advance()
+    {
+        while (nextSegment < segmentCount)
+        {
+            const OutputSegment & segment = segments[nextSegment++];
+            if (segment.sizeBytes > 0)
+            {
+                bytesBefore += static_cast<int>(segmentEnd - segmentStart);
+                segmentStart = segment.data;
+                cursor       = segment.data;
+                segmentEnd   = segment.data + segment.sizeBytes;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const OutputSegment * segments;
+    const int segmentCount;
+    int nextSegment;             // Index of the segment after the current one.
+    std::uint8_t * segmentStart; // Current segment being written to.
+    std::uint8_t * cursor;
+    std::uint8_t * segmentEnd;
+    int bytesBefore;             // Bytes written to the segments before the current one.
+};
+
+// ========================================================
+// easyDecode() and helpers:
+// ========================================================
+
+static bool outputByte(int code, SegmentWriter & output)
+{
+    assert(code >= 0 && code < 256);
+    if (!output.put(static_cast<std::uint8_t>(code)))
+    {
+        LZW_ERROR("Decoder output buffer too small!");
+        return false;
+    }
+    return true;
+}
+
+static bool outputSequence(Dictionary & dict, int code, SegmentWriter & output, int & firstByte)
+{
+    // A sequence is stored backwards, so we have to write
+    // it to a temp then output the buffer in reverse.
+    int i = 0;
+    std::uint8_t * const sequence = dict.sequence;
+    do
+    {
+        assert(i < MaxDictEntries - 1 && code >= 0);
+        sequence[i++] = dict.entries[code].value;
+        code = dict.entries[code].code;
+    }
+    while (code >= 0);
+
+    firstByte = sequence[--i];
+    for (; i >= 0; --i)
+    {
+        if (!outputByte(sequence[i], output))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Outputs the sequence of one code and updates the dictionary.
+// Shared by easyDecode() and WindowDecoder, which keep the state
+// between calls. False if the output ran out of space.
+static bool decodeCode(const int code, Dictionary & dictionary, int & prevCode,
+                       int & firstByte, int & codeBitsWidth, SegmentWriter & output)
+{
+    if (prevCode == Nil)
+    {
+        if (!outputByte(code, output))
+        {
+            return false;
+        }
+        firstByte = code;
+        prevCode  = code;
+        return true;
+    }
+
+    if (code >= dictionary.size)
+    {
+        if (!outputSequence(dictionary, prevCode, output, firstByte))
+        {
+            return false;
+        }
+        if (!outputByte(firstByte, output))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if (!outputSequence(dictionary, code, output, firstByte))
+        {
+            return false;
+        }
+    }
+
+    dictionary.add(prevCode, firstByte);
+    if (dictionary.flush(codeBitsWidth))
+    {
+        prevCode = Nil;
+    }
+    else
+    {
+        prevCode = code;
+    }
+    return true;
+}
+
+// The decoding loop shared by the easyDecode() overloads.
+static int decodeCodes(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+                       Dictionary & dictionary, SegmentWriter & output)
+{
     int prevCode      = Nil;
     int firstByte     = 0;
-    int bytesDecoded  = 0;
     int codeBitsWidth = StartBits;
-
-    // We'll reconstruct the dictionary based on the
-    // bit stream codes. Unlike Huffman encoding, we
-    // don't store the dictionary as a prefix to the data.
-    Dictionary dictionary;
+    dictionary.reset();
     BitStreamReader bitStream(compressed, compressedSizeBytes, compressedSizeBits);
 
     // We check to avoid an overflow of the user buffer.
@@ -723,56 +1394,654 @@ int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, c
     while (!bitStream.isEndOfStream())
     {
         assert(codeBitsWidth <= MaxDictBits);
-        code = static_cast<int>(bitStream.readBitsU64(codeBitsWidth));
+        const int code = static_cast<int>(bitStream.readBitsU64(codeBitsWidth));
+        LZW_STATS_ADD(codesRead, 1);
 
-        if (prevCode == Nil)
+        if (!decodeCode(code, dictionary, prevCode, firstByte, codeBitsWidth, output))
         {
-            if (!outputByte(code, uncompressed,
-                 uncompressedSizeBytes, bytesDecoded))
+            break;
+        }
+    }
+
+    LZW_STATS_ADD(decodeCalls, 1);
+    LZW_STATS_ADD(bitsRead, bitStream.getBitsRead());
+    LZW_STATS_ADD(bytesDecoded, output.getBytesWritten());
+    return output.getBytesWritten();
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               std::uint8_t * uncompressed, const int uncompressedSizeBytes)
+{
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        LZW_ERROR("lzw::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    const OutputSegment segment = { uncompressed, uncompressedSizeBytes };
+    return easyDecode(compressed, compressedSizeBytes, compressedSizeBits, &segment, 1);
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               const OutputSegment * outputSegments, const int outputSegmentCount)
+{
+    if (compressed == nullptr || outputSegments == nullptr)
+    {
+        LZW_ERROR("lzw::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 ||
+        SegmentWriter::countBytes(outputSegments, outputSegmentCount) <= 0)
+    {
+        LZW_ERROR("lzw::easyDecode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    // We'll reconstruct the dictionary based on the
+    // bit stream codes. Unlike Huffman encoding, we
+    // don't store the dictionary as a prefix to the data.
+    Dictionary dictionary;
+    SegmentWriter output(outputSegments, outputSegmentCount);
+    return decodeCodes(compressed, compressedSizeBytes, compressedSizeBits, dictionary, output);
+}
+
+// ========================================================
+// easyDecodeParallel() implementation:
+// ========================================================
+
+// Decodes the codes in [bitBegin, bitEnd) of the stream, which start right
+// after a dictionary reset (or at the start), into the given output range.
+static int decodeSegment(const std::uint8_t * compressed, const int compressedSizeBytes,
+                         const int bitBegin, const int bitEnd, std::uint8_t * output, const int outputSizeBytes)
+{
+    int prevCode      = Nil;
+    int firstByte     = 0;
+    int codeBitsWidth = StartBits;
+    const OutputSegment segment = { output, outputSizeBytes };
+    SegmentWriter writer(&segment, 1);
+
+    Dictionary dictionary;
+    BitStreamReader bitStream(compressed, compressedSizeBytes, bitEnd);
+    bitStream.seek(bitBegin);
+
+    while (!bitStream.isEndOfStream())
+    {
+        const int code = static_cast<int>(bitStream.readBitsU64(codeBitsWidth));
+        LZW_STATS_ADD(codesRead, 1);
+
+        if (!decodeCode(code, dictionary, prevCode, firstByte, codeBitsWidth, writer))
+        {
+            break;
+        }
+    }
+
+    LZW_STATS_ADD(bitsRead, bitStream.getBitsRead() - bitBegin);
+    return writer.getBytesWritten();
+}
+
+int easyDecodeParallel(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+                       const ResetPoint * resetPoints, const int resetPointCount,
+                       std::uint8_t * uncompressed, const int uncompressedSizeBytes, int threadCount)
+{
+    if (compressed == nullptr || uncompressed == nullptr || (resetPoints == nullptr && resetPointCount != 0))
+    {
+        LZW_ERROR("lzw::easyDecodeParallel(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || uncompressedSizeBytes <= 0 || resetPointCount < 0)
+    {
+        LZW_ERROR("lzw::easyDecodeParallel(): Bad in/out sizes!");
+        return 0;
+    }
+
+    // Segment s runs from reset point s - 1 (or the start) to reset point s (or the end).
+    const int segmentCount = resetPointCount + 1;
+    const auto segmentBits = [=](const int s, int & bitBegin, int & bitEnd)
+    {
+        bitBegin = (s == 0) ? 0 : resetPoints[s - 1].bitOffset;
+        bitEnd   = (s == resetPointCount) ? compressedSizeBits : resetPoints[s].bitOffset;
+    };
+    const auto segmentBytes = [=](const int s, int & byteBegin, int & byteEnd)
+    {
+        byteBegin = (s == 0) ? 0 : resetPoints[s - 1].byteOffset;
+        byteEnd   = (s == resetPointCount) ? uncompressedSizeBytes : resetPoints[s].byteOffset;
+    };
+
+    for (int s = 0; s < segmentCount; ++s)
+    {
+        int bitBegin, bitEnd, byteBegin, byteEnd;
+        segmentBits(s, bitBegin, bitEnd);
+        segmentBytes(s, byteBegin, byteEnd);
+        if (bitBegin < 0 || bitBegin > bitEnd || bitEnd > compressedSizeBits ||
+            byteBegin < 0 || byteBegin > byteEnd || byteEnd > uncompressedSizeBytes)
+        {
+            LZW_ERROR("lzw::easyDecodeParallel(): Bad reset points!");
+            return 0;
+        }
+    }
+
+    // Thread t decodes segments t, t + threadCount, t + 2 * threadCount...
+    // They all hold the same number of codes, so that's even enough.
+    std::int64_t bytesDecoded = 0;
+    const auto decodeShare = [=](const int t, const int stride, std::int64_t & threadBytes)
+    {
+        for (int s = t; s < segmentCount; s += stride)
+        {
+            int bitBegin, bitEnd, byteBegin, byteEnd;
+            segmentBits(s, bitBegin, bitEnd);
+            segmentBytes(s, byteBegin, byteEnd);
+            threadBytes += decodeSegment(compressed, compressedSizeBytes, bitBegin, bitEnd,
+                                         uncompressed + byteBegin, byteEnd - byteBegin);
+        }
+    };
+
+    #ifdef LZW_NO_THREADS
+    threadCount = 1;
+    #else // !LZW_NO_THREADS
+    if (threadCount <= 0)
+    {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (threadCount > segmentCount)
+    {
+        threadCount = segmentCount;
+    }
+    if (threadCount > 1)
+    {
+        // The calling thread takes the first share.
+        std::vector<std::int64_t> threadBytes(threadCount, 0);
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+        for (int t = 1; t < threadCount; ++t)
+        {
+            threads.emplace_back(decodeShare, t, threadCount, std::ref(threadBytes[t]));
+        }
+
+        decodeShare(0, threadCount, threadBytes[0]);
+
+        for (int t = 0; t < threadCount; ++t)
+        {
+            if (t != 0)
             {
-                break;
+                threads[t - 1].join();
             }
-            firstByte = code;
-            prevCode  = code;
-            continue;
+            bytesDecoded += threadBytes[t];
+        }
+    }
+    #endif // LZW_NO_THREADS
+
+    if (threadCount <= 1)
+    {
+        decodeShare(0, 1, bytesDecoded);
+    }
+
+    LZW_STATS_ADD(decodeCalls, 1);
+    LZW_STATS_ADD(bytesDecoded, bytesDecoded);
+    return static_cast<int>(bytesDecoded);
+}
+
+// ========================================================
+// LZMW / LZAP implementation:
+// ========================================================
+
+// Every phrase these modes add is the previous phrase followed by (part of)
+// the current one, which sit next to each other in the data. So a phrase is
+// just an offset and length into the uncompressed bytes, on both sides.
+struct PhraseDictionary
+{
+    // Phrases are cheap to store, so these modes go up to 14-bit codes.
+    static constexpr int MaxPhraseBits    = 14;
+    static constexpr int MaxPhraseEntries = (1 << MaxPhraseBits); // 16384
+    static constexpr int HashBits         = 14;
+    static constexpr int MaxProbes        = 256; // Candidates checked per match search.
+
+    int size;
+    int offsets[MaxPhraseEntries];
+    int lengths[MaxPhraseEntries];
+
+    // Encoder only: phrases chained by a hash of their first two bytes, newest first.
+    int hashHeads[1 << HashBits];
+    int hashNext[MaxPhraseEntries];
+
+    static int hash(const std::uint8_t * bytes)
+    {
+        const std::uint32_t key = (static_cast<std::uint32_t>(bytes[0]) << 8) | bytes[1];
+        return static_cast<int>((key * 2654435761u) >> (32 - HashBits));
+    }
+
+    static int codeBitsWidth(const int dictSize)
+    {
+        // Enough bits for any code in [0, dictSize).
+        int width = StartBits;
+        while ((1 << width) < dictSize)
+        {
+            ++width;
         }
+        return width;
+    }
 
-        if (code >= dictionary.size)
+    void reset(const bool hashed)
+    {
+        size = FirstCode;
+        if (hashed)
         {
-            if (!outputSequence(dictionary, prevCode, uncompressed,
-                 uncompressedSizeBytes, bytesDecoded, firstByte))
+            for (int & head : hashHeads)
             {
-                break;
+                head = Nil;
             }
-            if (!outputByte(firstByte, uncompressed,
-                 uncompressedSizeBytes, bytesDecoded))
+        }
+    }
+
+    // Adds the phrase(s) that follow a code, mirrored exactly by encoder and
+    // decoder. False if the dictionary filled and was cleared, in which case
+    // the next code has no previous phrase.
+    bool grow(const Mode mode, const int prevOffset, const int prevLength, const int currLength,
+              const std::uint8_t * data, const bool hashed)
+    {
+        const int first = (mode == Mode::LZAP) ? 1 : currLength;
+        for (int n = first; n <= currLength; ++n)
+        {
+            offsets[size] = prevOffset;
+            lengths[size] = prevLength + n;
+            if (hashed)
             {
-                break;
+                const int h = hash(data + prevOffset);
+                hashNext[size] = hashHeads[h];
+                hashHeads[h]   = size;
+            }
+            if (++size == MaxPhraseEntries)
+            {
+                reset(hashed);
+                LZW_STATS_ADD(dictionaryResets, 1);
+                return false;
             }
         }
-        else
+        return true;
+    }
+
+    // Longest phrase matching the data at pos, not running past end. Single bytes always match.
+    int findLongest(const std::uint8_t * data, const int pos, const int end, int & matchLength) const
+    {
+        int bestCode = data[pos];
+        matchLength  = 1;
+        if (end - pos < 2)
+        {
+            return bestCode;
+        }
+
+        int probes = 0;
+        for (int code = hashHeads[hash(data + pos)]; code != Nil && probes < MaxProbes; code = hashNext[code])
         {
-            if (!outputSequence(dictionary, code, uncompressed,
-                 uncompressedSizeBytes, bytesDecoded, firstByte))
+            ++probes;
+            const int length = lengths[code];
+            if (length <= matchLength || length > end - pos)
+            {
+                continue;
+            }
+            const std::uint8_t * const phrase = data + offsets[code];
+            if (phrase[length - 1] == data[pos + length - 1] &&
+                std::memcmp(phrase, data + pos, length) == 0)
             {
-                break;
+                bestCode    = code;
+                matchLength = length;
             }
         }
 
-        dictionary.add(prevCode, firstByte);
-        if (dictionary.flush(codeBitsWidth))
+        LZW_STATS_ADD(dictionaryProbes, probes);
+        return bestCode;
+    }
+};
+
+static void encodePhrases(const std::uint8_t * uncompressed, const int uncompressedSizeBytes, const Mode mode,
+                          PhraseDictionary * dictionary, BitStreamWriter & bitStream)
+{
+    LZW_STATS_ADD(bytesEncoded, uncompressedSizeBytes);
+    dictionary->reset(true);
+
+    int prevOffset = Nil;
+    int prevLength = 0;
+
+    for (int pos = 0; pos < uncompressedSizeBytes;)
+    {
+        int length;
+        const int code = dictionary->findLongest(uncompressed, pos, uncompressedSizeBytes, length);
+
+        bitStream.appendBitsU64(code, PhraseDictionary::codeBitsWidth(dictionary->size));
+        LZW_STATS_ADD(codesWritten, 1);
+
+        if (prevOffset == Nil || dictionary->grow(mode, prevOffset, prevLength, length, uncompressed, true))
         {
-            prevCode = Nil;
+            prevOffset = pos;
+            prevLength = length;
         }
         else
         {
-            prevCode = code;
+            prevOffset = Nil;
         }
+        pos += length;
+    }
+
+    LZW_STATS_ADD(encodeCalls, 1);
+    LZW_STATS_ADD(bitsWritten, bitStream.getBitCount());
+}
+
+void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits,
+                const Mode mode)
+{
+    if (mode == Mode::LZW)
+    {
+        easyEncode(uncompressed, uncompressedSizeBytes, compressed, compressedSizeBytes, compressedSizeBits);
+        return;
+    }
+
+    if (uncompressed == nullptr || compressed == nullptr)
+    {
+        LZW_ERROR("lzw::easyEncode(): Null data pointer(s)!");
+        return;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
+    {
+        LZW_ERROR("lzw::easyEncode(): Bad in/out sizes!");
+        return;
+    }
+
+    // Too big for the stack of most threads.
+    PhraseDictionary * dictionary = static_cast<PhraseDictionary *>(LZW_MALLOC(sizeof(PhraseDictionary)));
+    BitStreamWriter bitStream;
+    encodePhrases(uncompressed, uncompressedSizeBytes, mode, dictionary, bitStream);
+    LZW_MFREE(dictionary);
+
+    *compressedSizeBytes = bitStream.getByteCount();
+    *compressedSizeBits  = bitStream.getBitCount();
+    *compressed          = bitStream.release();
+}
+
+static int decodePhrases(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+                         std::uint8_t * uncompressed, const int uncompressedSizeBytes, const Mode mode,
+                         PhraseDictionary * dictionary)
+{
+    dictionary->reset(false);
+    BitStreamReader bitStream(compressed, compressedSizeBytes, compressedSizeBits);
+    int prevOffset = Nil;
+    int prevLength = 0;
+    int pos = 0;
+
+    while (!bitStream.isEndOfStream())
+    {
+        const int code = static_cast<int>(bitStream.readBitsU64(PhraseDictionary::codeBitsWidth(dictionary->size)));
+        LZW_STATS_ADD(codesRead, 1);
+
+        if (code >= dictionary->size)
+        {
+            LZW_ERROR("lzw::easyDecode(): Bad code in the stream!");
+            break;
+        }
+
+        // Phrases always point at bytes decoded by earlier codes.
+        const int length = (code < FirstCode) ? 1 : dictionary->lengths[code];
+        if (length > uncompressedSizeBytes - pos)
+        {
+            LZW_ERROR("Decoder output buffer too small!");
+            break;
+        }
+        if (code < FirstCode)
+        {
+            uncompressed[pos] = static_cast<std::uint8_t>(code);
+        }
+        else
+        {
+            std::memcpy(uncompressed + pos, uncompressed + dictionary->offsets[code], length);
+        }
+
+        if (prevOffset == Nil || dictionary->grow(mode, prevOffset, prevLength, length, uncompressed, false))
+        {
+            prevOffset = pos;
+            prevLength = length;
+        }
+        else
+        {
+            prevOffset = Nil;
+        }
+        pos += length;
+    }
+
+    LZW_STATS_ADD(decodeCalls, 1);
+    LZW_STATS_ADD(bitsRead, bitStream.getBitsRead());
+    LZW_STATS_ADD(bytesDecoded, pos);
+    return pos;
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               std::uint8_t * uncompressed, const int uncompressedSizeBytes, const Mode mode)
+{
+    if (mode == Mode::LZW)
+    {
+        return easyDecode(compressed, compressedSizeBytes, compressedSizeBits, uncompressed, uncompressedSizeBytes);
+    }
+
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        LZW_ERROR("lzw::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || uncompressedSizeBytes <= 0)
+    {
+        LZW_ERROR("lzw::easyDecode(): Bad in/out sizes!");
+        return 0;
     }
 
+    PhraseDictionary * dictionary = static_cast<PhraseDictionary *>(LZW_MALLOC(sizeof(PhraseDictionary)));
+    const int bytesDecoded = decodePhrases(compressed, compressedSizeBytes, compressedSizeBits,
+                                           uncompressed, uncompressedSizeBytes, mode, dictionary);
+    LZW_MFREE(dictionary);
     return bytesDecoded;
 }
 
+
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+constexpr std::size_t WorkspaceAlignment = alignof(std::max_align_t);
+
+int workspaceSize(const Mode mode)
+{
+    const std::size_t stateSize = (mode == Mode::LZW) ? sizeof(Dictionary) : sizeof(PhraseDictionary);
+    return static_cast<int>(stateSize + WorkspaceAlignment - 1);
+}
+
+// Where the dictionary goes in the caller's workspace, or null if it is too small.
+static void * alignWorkspace(void * workspace, const int workspaceSizeBytes, const Mode mode)
+{
+    if (workspace == nullptr || workspaceSizeBytes < workspaceSize(mode))
+    {
+        return nullptr;
+    }
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(workspace);
+    return reinterpret_cast<void *>((address + WorkspaceAlignment - 1) & ~(WorkspaceAlignment - 1));
+}
+
+int easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+               std::uint8_t * compressed, const int compressedCapacityBytes, int * compressedSizeBits,
+               void * workspace, const int workspaceSizeBytes, const Mode mode)
+{
+    if (uncompressed == nullptr || compressed == nullptr || compressedSizeBits == nullptr)
+    {
+        LZW_ERROR("lzw::easyEncode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedCapacityBytes <= 0)
+    {
+        LZW_ERROR("lzw::easyEncode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    void * const state = alignWorkspace(workspace, workspaceSizeBytes, mode);
+    if (state == nullptr)
+    {
+        LZW_ERROR("lzw::easyEncode(): Workspace too small!");
+        return 0;
+    }
+
+    BitStreamWriter bitStream(compressed, compressedCapacityBytes);
+    if (mode == Mode::LZW)
+    {
+        encodeCodes(uncompressed, uncompressedSizeBytes, *new (state) Dictionary, bitStream, nullptr, nullptr);
+    }
+    else
+    {
+        encodePhrases(uncompressed, uncompressedSizeBytes, mode, new (state) PhraseDictionary, bitStream);
+    }
+
+    if (bitStream.hasOverflowed())
+    {
+        LZW_ERROR("lzw::easyEncode(): Output buffer too small!");
+        return 0;
+    }
+
+    *compressedSizeBits = bitStream.getBitCount();
+    return bitStream.getByteCount();
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+               void * workspace, const int workspaceSizeBytes, const Mode mode)
+{
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        LZW_ERROR("lzw::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || uncompressedSizeBytes <= 0)
+    {
+        LZW_ERROR("lzw::easyDecode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    void * const state = alignWorkspace(workspace, workspaceSizeBytes, mode);
+    if (state == nullptr)
+    {
+        LZW_ERROR("lzw::easyDecode(): Workspace too small!");
+        return 0;
+    }
+
+    if (mode == Mode::LZW)
+    {
+        const OutputSegment segment = { uncompressed, uncompressedSizeBytes };
+        SegmentWriter output(&segment, 1);
+        return decodeCodes(compressed, compressedSizeBytes, compressedSizeBits, *new (state) Dictionary, output);
+    }
+    return decodePhrases(compressed, compressedSizeBytes, compressedSizeBits,
+                         uncompressed, uncompressedSizeBytes, mode, new (state) PhraseDictionary);
+}
+
+// ========================================================
+// In-place decoding:
+// ========================================================
+
+int inPlaceMargin(const int compressedSizeBytes, const Mode mode)
+{
+    // Past the code being decoded, the input left is at most its bits / 8 plus
+    // the partial bytes at either end, and the output left at least one byte per
+    // code. Two bytes of slack cover the rounding.
+    const std::int64_t size = (compressedSizeBytes > 0) ? compressedSizeBytes : 0;
+    return static_cast<int>((mode == Mode::LZW) ? size / 3 + 2 : size * 3 / 7 + 2);
+}
+
+int easyDecodeInPlace(std::uint8_t * buffer, const int bufferSizeBytes, const int compressedSizeBytes,
+                      const int compressedSizeBits, const Mode mode)
+{
+    if (buffer == nullptr)
+    {
+        LZW_ERROR("lzw::easyDecodeInPlace(): Null data pointer!");
+        return 0;
+    }
+
+    const int outputSizeBytes = bufferSizeBytes - inPlaceMargin(compressedSizeBytes, mode);
+    if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || bufferSizeBytes < compressedSizeBytes || outputSizeBytes <= 0)
+    {
+        LZW_ERROR("lzw::easyDecodeInPlace(): Bad in/out sizes!");
+        return 0;
+    }
+
+    // The reader only looks ahead of the next unread byte, which the
+    // output cannot reach as long as it stays within the margin.
+    const std::uint8_t * const compressed = buffer + bufferSizeBytes - compressedSizeBytes;
+    return easyDecode(compressed, compressedSizeBytes, compressedSizeBits, buffer, outputSizeBytes, mode);
+}
+
+// ========================================================
+// class WindowDecoder:
+// ========================================================
+
+WindowDecoder::WindowDecoder(const std::uint8_t * compressed, const int compressedSizeBytes,
+                             const int compressedSizeBits, const int windowSizeBytes)
+    : bitStream(compressed, compressedSizeBytes, compressedSizeBits)
+    , prevCode(Nil)
+    , firstByte(0)
+    , codeBitsWidth(StartBits)
+    , buffer(nullptr)
+    , windowSize(windowSizeBytes > 0 ? windowSizeBytes : DefaultWindowSizeBytes)
+    , carryBytes(0)
+    , bytesDecoded(0)
+{
+    if (compressed == nullptr || compressedSizeBytes <= 0 || compressedSizeBits <= 0)
+    {
+        LZW_ERROR("lzw::WindowDecoder: Bad compressed data!");
+    }
+    // A sequence is at most one byte per dictionary entry, plus firstByte.
+    buffer = static_cast<std::uint8_t *>(LZW_MALLOC(windowSize + MaxDictEntries + 1));
+    LZW_STATS_ADD(decodeCalls, 1);
+}
+
+WindowDecoder::~WindowDecoder()
+{
+    LZW_STATS_ADD(bitsRead, bitStream.getBitsRead());
+    LZW_MFREE(buffer);
+}
+
+int WindowDecoder::next(const std::uint8_t ** window)
+{
+    assert(window != nullptr);
+
+    // Bytes of the last code that didn't fit in the previous window.
+    if (carryBytes > 0)
+    {
+        std::memmove(buffer, buffer + windowSize, carryBytes);
+    }
+
+    const OutputSegment segment = { buffer + carryBytes, windowSize + MaxDictEntries + 1 - carryBytes };
+    SegmentWriter output(&segment, 1);
+
+    while (carryBytes + output.getBytesWritten() < windowSize && !bitStream.isEndOfStream())
+    {
+        assert(codeBitsWidth <= MaxDictBits);
+        const int code = static_cast<int>(bitStream.readBitsU64(codeBitsWidth));
+        LZW_STATS_ADD(codesRead, 1);
+
+        if (!decodeCode(code, dictionary, prevCode, firstByte, codeBitsWidth, output))
+        {
+            break;
+        }
+    }
+
+    const int filled = carryBytes + output.getBytesWritten();
+    const int windowBytes = (filled < windowSize) ? filled : windowSize;
+    carryBytes = filled - windowBytes;
+    bytesDecoded += windowBytes;
+
+    LZW_STATS_ADD(bytesDecoded, windowBytes);
+    *window = buffer;
+    return windowBytes;
+}
+
 } // namespace lzw {}
 
 // ================ End of implementation =================
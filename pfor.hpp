@@ -0,0 +1,770 @@
+// ================================================================================================
+// -*- C++ -*-
+// File: pfor.hpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: Frame of reference bit packing with patched exceptions (PFor) for 32-bit integer arrays.
+// ================================================================================================
+
+#ifndef PFOR_HPP
+#define PFOR_HPP
+
+// ---------
+//  LICENSE
+// ---------
+// This software is in the public domain. Where that dedication is not recognized,
+// you are granted a perpetual, irrevocable license to copy, distribute, and modify
+// this file as you see fit.
+//
+// The source code is provided "as is", without warranty of any kind, express or implied.
+// No attribution is required, but a mention about the author is appreciated.
+//
+// -------
+//  SETUP
+// -------
+// #define PFOR_IMPLEMENTATION in one source file before including
+// this file, then use pfor.hpp as a normal header file elsewhere.
+//
+// The block unpacking loop is dispatched at runtime to an AVX2 version
+// when the CPU supports it, so a single binary built without -march
+// flags still uses the widest kernel.
+// #define PFOR_NO_SIMD to always use the portable scalar code.
+//
+// ----------
+//  OVERVIEW
+// ----------
+// The integers are split in blocks of BlockSize values. Each block stores
+// its smallest value (the frame of reference) and the differences to it
+// in a fixed number of bits b, so decoding is shifts and masks with no
+// branches on the data, unlike the unary codes of rice.hpp. The few values
+// that don't fit in b bits are exceptions: their low b bits stay in place
+// and the high bits are stored after the block header along with their
+// positions, then patched in after unpacking. The b of each block is the
+// one that gives the smallest block, exceptions included.
+//
+// The bits are laid out in 4 interleaved 32-bit lanes (value i goes to
+// lane i % 4), so a 128-bit register unpacks 4 values per shift and mask,
+// or two of those (2 x 4 values) in a 256-bit register.
+//
+// Stream layout (all little-endian):
+//
+//   u32 integer count
+//   per block:
+//     u8  b, the bit width (0 to 32)
+//     u8  exception count e
+//     u32 frame of reference
+//     if e > 0:
+//       u8  exception high bits width
+//       e x u8 exception positions
+//       the exception high bits, packed, padded to a byte
+//     16 * b bytes of packed values
+//
+// The last block is padded with the frame of reference if it is short.
+
+#include <cstdint>
+
+namespace pfor
+{
+
+// Number of integers per block.
+constexpr int BlockSize = 128;
+
+// Blocks are unpacked with AVX2 when the CPU and OS support it.
+// False with PFOR_NO_SIMD or when not compiling for x86/x64.
+struct CpuFeatures
+{
+    bool avx2 = false;
+};
+
+// Whether the AVX2 unpacking kernels are in use.
+const CpuFeatures & getCpuFeatures();
+
+// Set avx2 to false to force the scalar unpacking. It can't be turned
+// on if the CPU lacks it. Not thread safe; call it before decoding.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Block and exception counts, updated only with PFOR_ENABLE_STATS defined
+// in the PFOR_IMPLEMENTATION file. Thread local, so concurrent callers
+// don't mix their numbers.
+struct Stats
+{
+    std::uint64_t encodeCalls     = 0; // easyEncode() calls.
+    std::uint64_t decodeCalls     = 0; // easyDecode() calls.
+    std::uint64_t integersEncoded = 0; // Integers consumed by the encoder.
+    std::uint64_t integersDecoded = 0; // Integers produced by the decoder.
+    std::uint64_t blocksEncoded   = 0; // Blocks written by the encoder.
+    std::uint64_t exceptions      = 0; // Values written as exceptions; high counts mean outliers in the data.
+};
+
+// Counters of this thread; resetStats() starts them over.
+const Stats & getStats();
+void resetStats();
+
+// Size of the largest possible output of easyEncode() for 'count' integers.
+int maxEncodedSize(int count);
+
+// Encodes 'count' integers into 'output', which should have room for
+// maxEncodedSize(count) bytes. Returns the bytes written or -1 on error.
+int easyEncode(const std::uint32_t * input, int count, std::uint8_t * output, int outSizeBytes);
+
+// Number of integers in the output of easyEncode(), or -1 if the input is not valid.
+int getDecodedCount(const std::uint8_t * input, int inSizeBytes);
+
+// Decodes the output of easyEncode(). Returns the number of integers
+// written to 'output', or -1 if the input is corrupt or the output
+// can't hold getDecodedCount() integers.
+int easyDecode(const std::uint8_t * input, int inSizeBytes, std::uint32_t * output, int outCount);
+
+} // namespace pfor {}
+
+// ================== End of header file ==================
+#endif // PFOR_HPP
+// ================== End of header file ==================
+
+// ================================================================================================
+//
+//                                     PFor Implementation
+//
+// ================================================================================================
+
+#ifdef PFOR_IMPLEMENTATION
+
+#include <cassert>
+#include <cstring>
+
+#if !defined(PFOR_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define PFOR_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define PFOR_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define PFOR_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define PFOR_X86_SIMD 0
+#endif // x86
+
+namespace pfor
+{
+
+// Lanes the values are interleaved in, and the packed size of a block per bit of width.
+constexpr int LaneCount = 4;
+constexpr int ValuesPerLane = BlockSize / LaneCount;
+constexpr int BytesPerBit = BlockSize / 8;
+
+constexpr int StreamHeaderBytes = 4;
+constexpr int BlockHeaderBytes  = 6;
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef PFOR_ENABLE_STATS
+    #define PFOR_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !PFOR_ENABLE_STATS
+    #define PFOR_STATS_ADD(counter, amount) ((void)0)
+#endif // PFOR_ENABLE_STATS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if PFOR_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+// XCR0 tells us which register files the OS saves on context switches.
+static std::uint64_t readXCR0()
+{
+    #if defined(_MSC_VER)
+    return _xgetbv(0);
+    #else // GCC/Clang
+    std::uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (std::uint64_t(edx) << 32) | eax;
+    #endif // _MSC_VER
+}
+
+#endif // PFOR_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if PFOR_X86_SIMD
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+
+    // AVX2 unpacking also needs the OS to save the YMM registers (XCR0).
+    const std::uint64_t xcr0 = ((regs[2] & (1u << 27)) != 0) ? readXCR0() : 0;
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.avx2 = avx && (xcr0 & 0x06) == 0x06 && (regs[1] & (1u << 5)) != 0;
+    }
+    #endif // PFOR_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Helpers:
+// ========================================================
+
+static std::uint32_t loadU32(const std::uint8_t * bytes)
+{
+    std::uint32_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap32(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    return word;
+}
+
+static void storeU32(std::uint8_t * bytes, std::uint32_t word)
+{
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap32(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    std::memcpy(bytes, &word, sizeof(word));
+}
+
+// Mask of the low 'bitCount' bits, 0 to 32.
+static constexpr std::uint32_t lowBitsMask(const int bitCount)
+{
+    return (bitCount >= 32) ? 0xFFFFFFFF : (std::uint32_t(1) << bitCount) - 1;
+}
+
+// Bits needed to store 'value', 0 for 0.
+static int bitWidth(const std::uint32_t value)
+{
+    #if defined(__GNUC__)
+    return (value != 0) ? 32 - __builtin_clz(value) : 0;
+    #else // !__GNUC__
+    int width = 0;
+    for (std::uint32_t v = value; v != 0; v >>= 1)
+    {
+        ++width;
+    }
+    return width;
+    #endif // __GNUC__
+}
+
+// ========================================================
+// Bit packing:
+// ========================================================
+
+// Packs a block of values, already masked to 'bitCount' bits. Lane l holds
+// values l, l+4, l+8..., and word w of lane l is at byte (w * 4 + l) * 4.
+// Each lane holds ValuesPerLane * bitCount bits, a whole number of words.
+static void packBlock(const std::uint32_t * values, const int bitCount, std::uint8_t * output)
+{
+    for (int lane = 0; lane < LaneCount; ++lane)
+    {
+        std::uint8_t * words = output + lane * 4;
+        std::uint64_t accum = 0;
+        int accumBits = 0;
+
+        for (int v = 0; v < ValuesPerLane; ++v)
+        {
+            accum |= std::uint64_t(values[v * LaneCount + lane]) << accumBits;
+            accumBits += bitCount;
+            if (accumBits >= 32)
+            {
+                storeU32(words, static_cast<std::uint32_t>(accum));
+                words += LaneCount * 4;
+                accum >>= 32;
+                accumBits -= 32;
+            }
+        }
+    }
+}
+
+// Inverse of packBlock(), adding 'base' to each value. One instantiation
+// per bit width, so the masks and shifts are constants.
+template<int B>
+static void unpackBlockScalar(const std::uint8_t * input, const std::uint32_t base, std::uint32_t * output)
+{
+    constexpr std::uint64_t Mask = lowBitsMask(B);
+    for (int lane = 0; lane < LaneCount; ++lane)
+    {
+        const std::uint8_t * words = input + lane * 4;
+        std::uint64_t accum = 0;
+        int accumBits = 0;
+
+        for (int v = 0; v < ValuesPerLane; ++v)
+        {
+            if (accumBits < B)
+            {
+                accum |= std::uint64_t(loadU32(words)) << accumBits;
+                words += LaneCount * 4;
+                accumBits += 32;
+            }
+            output[v * LaneCount + lane] = base + static_cast<std::uint32_t>(accum & Mask);
+            accum >>= B;
+            accumBits -= B;
+        }
+    }
+}
+
+#if PFOR_X86_SIMD
+
+// Rows 'low' and 'high' of 4 words each, in the low and high halves of a register.
+PFOR_TARGET("avx2")
+static __m256i loadRowPair(const __m128i * rows, const int low, const int high)
+{
+    if (high == low)
+    {
+        return _mm256_broadcastsi128_si256(_mm_loadu_si128(rows + low));
+    }
+    if (high == low + 1)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + low));
+    }
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(rows + low)),
+                                   _mm_loadu_si128(rows + high), 1);
+}
+
+// Unpacks values v and v+1 of every lane per step: the low half of the
+// register does v, the high half v+1, each with its own shift count.
+// Both loops are fully unrolled, so the row indexes and shift counts fold.
+template<int B>
+PFOR_TARGET("avx2")
+static void unpackBlockAVX2(const std::uint8_t * input, const std::uint32_t base, std::uint32_t * output)
+{
+    const __m128i * rows = reinterpret_cast<const __m128i *>(input);
+    const __m256i mask   = _mm256_set1_epi32(static_cast<int>(lowBitsMask(B)));
+    const __m256i vbase  = _mm256_set1_epi32(static_cast<int>(base));
+    __m256i * out = reinterpret_cast<__m256i *>(output);
+
+    // No packed data to read at all for B = 0.
+    if (B == 0)
+    {
+        for (int v = 0; v < ValuesPerLane / 2; ++v)
+        {
+            _mm256_storeu_si256(out + v, vbase);
+        }
+        return;
+    }
+
+    #if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC unroll 16
+    #endif // __GNUC__
+    for (int v = 0; v < ValuesPerLane; v += 2)
+    {
+        const int bit0   = v * B;
+        const int bit1   = bit0 + B;
+        const int shift0 = bit0 & 31;
+        const int shift1 = bit1 & 31;
+
+        __m256i x = _mm256_srlv_epi32(loadRowPair(rows, bit0 >> 5, bit1 >> 5),
+                                      _mm256_setr_epi32(shift0, shift0, shift0, shift0, shift1, shift1, shift1, shift1));
+
+        // Values straddling two words take the rest from the next row. A half that
+        // doesn't straddle re-reads its own row (never past the end of the block)
+        // and shifts it by 32, which gives zero.
+        const bool spill0 = shift0 + B > 32;
+        const bool spill1 = shift1 + B > 32;
+        if (spill0 || spill1)
+        {
+            const int left0 = spill0 ? 32 - shift0 : 32;
+            const int left1 = spill1 ? 32 - shift1 : 32;
+            const __m256i next = loadRowPair(rows, (bit0 >> 5) + spill0, (bit1 >> 5) + spill1);
+            x = _mm256_or_si256(x, _mm256_sllv_epi32(next, _mm256_setr_epi32(left0, left0, left0, left0,
+                                                                             left1, left1, left1, left1)));
+        }
+        _mm256_storeu_si256(out + v / 2, _mm256_add_epi32(_mm256_and_si256(x, mask), vbase));
+    }
+}
+
+#endif // PFOR_X86_SIMD
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+using UnpackFunc = void (*)(const std::uint8_t * input, std::uint32_t base, std::uint32_t * output);
+
+#define PFOR_UNPACK_FUNCS(func) {                                         \
+    &func<0>,  &func<1>,  &func<2>,  &func<3>,  &func<4>,  &func<5>,      \
+    &func<6>,  &func<7>,  &func<8>,  &func<9>,  &func<10>, &func<11>,     \
+    &func<12>, &func<13>, &func<14>, &func<15>, &func<16>, &func<17>,     \
+    &func<18>, &func<19>, &func<20>, &func<21>, &func<22>, &func<23>,     \
+    &func<24>, &func<25>, &func<26>, &func<27>, &func<28>, &func<29>,     \
+    &func<30>, &func<31>, &func<32> }
+
+struct Kernels
+{
+    // Indexed by bit width, 0 to 32.
+    const UnpackFunc * unpackBlock;
+};
+
+static const UnpackFunc unpackFuncsScalar[33] = PFOR_UNPACK_FUNCS(unpackBlockScalar);
+#if PFOR_X86_SIMD
+static const UnpackFunc unpackFuncsAVX2[33] = PFOR_UNPACK_FUNCS(unpackBlockAVX2);
+#endif // PFOR_X86_SIMD
+
+#undef PFOR_UNPACK_FUNCS
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.unpackBlock = unpackFuncsScalar;
+
+    #if PFOR_X86_SIMD
+    if (features.avx2)
+    {
+        kernels.unpackBlock = unpackFuncsAVX2;
+    }
+    #else // !PFOR_X86_SIMD
+    (void)features;
+    #endif // PFOR_X86_SIMD
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.avx2 = features.avx2 && detected.avx2;
+
+    kernelsInstance() = selectKernels(current);
+}
+
+// ========================================================
+// Block encoding:
+// ========================================================
+
+// Picks the bit width giving the smallest block for the given histogram
+// of value widths. Returns the width and its exception count.
+static int chooseBitWidth(const int (&widthCounts)[33], const int maxWidth, int & exceptionCount)
+{
+    int bestWidth = maxWidth;
+    int bestSize  = BytesPerBit * maxWidth;
+    int bestExceptions = 0;
+
+    // Values wider than b are the exceptions. Walk b downwards,
+    // adding up the values that stop fitting.
+    int exceptions = 0;
+    for (int b = maxWidth - 1; b >= 0; --b)
+    {
+        exceptions += widthCounts[b + 1];
+
+        const int highBits = maxWidth - b;
+        const int size = BytesPerBit * b + 1 + exceptions + (exceptions * highBits + 7) / 8;
+        if (size < bestSize)
+        {
+            bestWidth = b;
+            bestSize  = size;
+            bestExceptions = exceptions;
+        }
+    }
+
+    exceptionCount = bestExceptions;
+    return bestWidth;
+}
+
+// Encodes up to BlockSize values. Returns the bytes written.
+static int encodeBlock(const std::uint32_t * input, const int count, std::uint8_t * output)
+{
+    assert(count > 0 && count <= BlockSize);
+
+    std::uint32_t base = input[0];
+    for (int i = 1; i < count; ++i)
+    {
+        base = (input[i] < base) ? input[i] : base;
+    }
+
+    // Offsets from the frame of reference. A short block is padded with zeros.
+    std::uint32_t values[BlockSize];
+    int widthCounts[33] = {};
+    int maxWidth = 0;
+    for (int i = 0; i < BlockSize; ++i)
+    {
+        values[i] = (i < count) ? input[i] - base : 0;
+        const int width = bitWidth(values[i]);
+        widthCounts[width]++;
+        maxWidth = (width > maxWidth) ? width : maxWidth;
+    }
+
+    int exceptionCount;
+    const int bitCount = chooseBitWidth(widthCounts, maxWidth, exceptionCount);
+
+    std::uint8_t * out = output;
+    *out++ = static_cast<std::uint8_t>(bitCount);
+    *out++ = static_cast<std::uint8_t>(exceptionCount);
+    storeU32(out, base);
+    out += 4;
+
+    if (exceptionCount > 0)
+    {
+        const int highBits = maxWidth - bitCount;
+        *out++ = static_cast<std::uint8_t>(highBits);
+
+        std::uint8_t * positions = out;
+        out += exceptionCount;
+
+        // High bits of the exceptions, least significant bit first.
+        std::uint64_t accum = 0;
+        int accumBits = 0;
+        for (int i = 0; i < BlockSize; ++i)
+        {
+            const std::uint32_t high = values[i] >> bitCount;
+            if (high != 0)
+            {
+                *positions++ = static_cast<std::uint8_t>(i);
+                accum |= std::uint64_t(high) << accumBits;
+                accumBits += highBits;
+                while (accumBits >= 8)
+                {
+                    *out++ = static_cast<std::uint8_t>(accum);
+                    accum >>= 8;
+                    accumBits -= 8;
+                }
+            }
+        }
+        if (accumBits > 0)
+        {
+            *out++ = static_cast<std::uint8_t>(accum);
+        }
+    }
+
+    const std::uint32_t mask = lowBitsMask(bitCount);
+    for (int i = 0; i < BlockSize; ++i)
+    {
+        values[i] &= mask;
+    }
+    packBlock(values, bitCount, out);
+    out += BytesPerBit * bitCount;
+
+    PFOR_STATS_ADD(blocksEncoded, 1);
+    PFOR_STATS_ADD(exceptions, exceptionCount);
+    return static_cast<int>(out - output);
+}
+
+// Decodes a whole block into 'output' (room for BlockSize values).
+// Returns the bytes consumed, or -1 if the block is not valid.
+static int decodeBlock(const std::uint8_t * input, const int inSizeBytes, std::uint32_t * output)
+{
+    if (inSizeBytes < BlockHeaderBytes)
+    {
+        return -1;
+    }
+
+    const std::uint8_t * in = input;
+    const std::uint8_t * inEnd = input + inSizeBytes;
+    const int bitCount = *in++;
+    const int exceptionCount = *in++;
+    const std::uint32_t base = loadU32(in);
+    in += 4;
+
+    if (bitCount > 32)
+    {
+        return -1;
+    }
+
+    const std::uint8_t * positions = nullptr;
+    const std::uint8_t * highs = nullptr;
+    int highBits = 0;
+    if (exceptionCount > 0)
+    {
+        if (in == inEnd)
+        {
+            return -1;
+        }
+        highBits = *in++;
+        if (highBits == 0 || bitCount + highBits > 32)
+        {
+            return -1;
+        }
+
+        const int highBytes = (exceptionCount * highBits + 7) / 8;
+        if (inEnd - in < exceptionCount + highBytes)
+        {
+            return -1;
+        }
+        positions = in;
+        highs = in + exceptionCount;
+        in += exceptionCount + highBytes;
+    }
+
+    if (inEnd - in < BytesPerBit * bitCount)
+    {
+        return -1;
+    }
+    kernelsInstance().unpackBlock[bitCount](in, base, output);
+    in += BytesPerBit * bitCount;
+
+    // Patch the exceptions. The low bits are in place already, and
+    // adding the high bits on top of base + low is the same as OR-ing
+    // them into the offset, with unsigned wraparound.
+    std::uint64_t accum = 0;
+    int accumBits = 0;
+    for (int e = 0; e < exceptionCount; ++e)
+    {
+        while (accumBits < highBits)
+        {
+            accum |= std::uint64_t(*highs++) << accumBits;
+            accumBits += 8;
+        }
+        const std::uint32_t high = static_cast<std::uint32_t>(accum & lowBitsMask(highBits));
+        accum >>= highBits;
+        accumBits -= highBits;
+
+        if (positions[e] >= BlockSize)
+        {
+            return -1;
+        }
+        output[positions[e]] += high << bitCount;
+    }
+
+    return static_cast<int>(in - input);
+}
+
+// ========================================================
+// easyEncode() / easyDecode():
+// ========================================================
+
+int maxEncodedSize(const int count)
+{
+    // A block never gets bigger than it is with no exceptions at 32 bits.
+    const int blockCount = (count + BlockSize - 1) / BlockSize;
+    return StreamHeaderBytes + blockCount * (BlockHeaderBytes + BytesPerBit * 32);
+}
+
+int easyEncode(const std::uint32_t * input, const int count, std::uint8_t * output, const int outSizeBytes)
+{
+    if ((input == nullptr && count > 0) || output == nullptr)
+    {
+        return -1;
+    }
+    if (count < 0 || outSizeBytes < maxEncodedSize(count))
+    {
+        return -1;
+    }
+
+    PFOR_STATS_ADD(encodeCalls, 1);
+    PFOR_STATS_ADD(integersEncoded, count);
+
+    storeU32(output, static_cast<std::uint32_t>(count));
+    int bytesWritten = StreamHeaderBytes;
+
+    for (int i = 0; i < count; i += BlockSize)
+    {
+        const int blockCount = (count - i < BlockSize) ? count - i : BlockSize;
+        bytesWritten += encodeBlock(input + i, blockCount, output + bytesWritten);
+    }
+
+    return bytesWritten;
+}
+
+int getDecodedCount(const std::uint8_t * input, const int inSizeBytes)
+{
+    if (input == nullptr || inSizeBytes < StreamHeaderBytes)
+    {
+        return -1;
+    }
+
+    const std::uint32_t count = loadU32(input);
+    return (count <= 0x7FFFFFFF) ? static_cast<int>(count) : -1;
+}
+
+int easyDecode(const std::uint8_t * input, const int inSizeBytes, std::uint32_t * output, const int outCount)
+{
+    const int count = getDecodedCount(input, inSizeBytes);
+    if (count < 0 || count > outCount || (output == nullptr && count > 0))
+    {
+        return -1;
+    }
+
+    PFOR_STATS_ADD(decodeCalls, 1);
+
+    int bytesRead = StreamHeaderBytes;
+    int i = 0;
+
+    // Whole blocks go straight to the output.
+    for (; i + BlockSize <= count; i += BlockSize)
+    {
+        const int blockBytes = decodeBlock(input + bytesRead, inSizeBytes - bytesRead, output + i);
+        if (blockBytes < 0)
+        {
+            return -1;
+        }
+        bytesRead += blockBytes;
+    }
+
+    // The padded last block goes through a full size buffer.
+    if (i < count)
+    {
+        std::uint32_t lastBlock[BlockSize];
+        if (decodeBlock(input + bytesRead, inSizeBytes - bytesRead, lastBlock) < 0)
+        {
+            return -1;
+        }
+        std::memcpy(output + i, lastBlock, (count - i) * sizeof(std::uint32_t));
+    }
+
+    PFOR_STATS_ADD(integersDecoded, count);
+    return count;
+}
+
+} // namespace pfor {}
+
+// ================ End of implementation =================
+#endif // PFOR_IMPLEMENTATION
+// ================ End of implementation =================
@@ -0,0 +1,683 @@
+// ================================================================================================
+// -*- C++ -*-
+// File: pipeline.hpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: Multi-threaded block compression pipeline (reader -> N workers -> ordered writer).
+// ================================================================================================
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+// ---------
+//  LICENSE
+// ---------
+// This software is in the public domain. Where that dedication is not recognized,
+// you are granted a perpetual, irrevocable license to copy, distribute, and modify
+// this file as you see fit.
+//
+// The source code is provided "as is", without warranty of any kind, express or implied.
+// No attribution is required, but a mention about the author is appreciated.
+//
+// -------
+//  SETUP
+// -------
+// #define PIPELINE_IMPLEMENTATION in one source file before including
+// this file, then use pipeline.hpp as a normal header file elsewhere.
+//
+// ----------
+//  OVERVIEW
+// ----------
+// run() splits the work of compressing (or decompressing) a large data
+// set in three kinds of stages, each one in its own thread:
+//
+//  reader  --> worker 0 -->  writer
+//          --> worker 1 -->
+//          --> ...      -->
+//
+// The reader hands blocks to the workers in round-robin order, and the
+// writer (which runs in the calling thread) collects them back in that
+// same order, so the output is written in the order it was read without
+// any reordering buffer. Every worker has its own pair of bounded
+// single-producer/single-consumer lock-free queues, so no locks are
+// taken while blocks keep flowing. A stage that has to wait spins
+// briefly, then sleeps until the other side of its queue moves, so
+// idle stages don't use any CPU. A full queue stalls the reader (backpressure), which
+// bounds memory use to (workers * queueDepth * 2) blocks in flight, while
+// the disk reads and writes overlap with the compression work.
+//
+// The worker callback is where a codec goes. makeEncoder()/makeDecoder()
+// wrap the easyEncode()/easyDecode() functions of any of the codecs in
+// this repository. Each encoded block is written as a frame with a small
+// header, so the decoder side can split the stream back into blocks with
+// makeFrameReader(). Blocks are compressed independently of each other.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace pipeline
+{
+
+// A piece of input or output data moving through the pipeline.
+using Block = std::vector<std::uint8_t>;
+
+// Reader stage: fill 'block' with the next piece of the input.
+// Leave it empty when the input is over. Return false on error.
+using ReadFunc = std::function<bool(Block & block)>;
+
+// Worker stage: turn one input block into one output block. Called
+// concurrently from all the worker threads. Return false on error.
+using CodecFunc = std::function<bool(const Block & input, Block & output)>;
+
+// Writer stage: receives the output blocks in the order the reader
+// produced the input blocks. Return false on error.
+using WriteFunc = std::function<bool(const Block & block)>;
+
+// None of the callbacks are allowed to throw.
+
+struct Options
+{
+    int workerCount = 0; // Compressor threads. 0 = one per hardware thread not taken by the reader/writer.
+    int queueDepth  = 4; // Blocks each queue can hold (rounded up to a power of two).
+};
+
+struct Stats
+{
+    std::uint64_t blocks       = 0; // Blocks that made it all the way to the writer.
+    std::uint64_t bytesRead    = 0; // Sum of the input block sizes.
+    std::uint64_t bytesWritten = 0; // Sum of the output block sizes.
+    std::uint64_t readerStalls = 0; // Times the reader found a queue full (workers are the bottleneck).
+    std::uint64_t writerStalls = 0; // Times the writer found a queue empty (reader/workers are the bottleneck).
+};
+
+// Runs the reader, workers and writer until the reader reports the end of
+// the input or any stage fails. Returns true if all the blocks were written.
+bool run(const ReadFunc & reader, const CodecFunc & codec, const WriteFunc & writer,
+         const Options & options = Options(), Stats * stats = nullptr);
+
+// ========================================================
+// Codec adapters:
+// ========================================================
+
+// Frames written by the makeEncoder() adapters, little-endian:
+//  u32 uncompressed size in bytes
+//  u32 payload size in bytes
+//  u32 payload size in bits (payload bytes * 8 for the byte-oriented codecs)
+//  payload
+constexpr int FrameHeaderBytes = 12;
+
+// Signatures of the easyEncode()/easyDecode() functions of the bit stream
+// codecs (lzw, huffman, rice, rangecoder) and of the byte-oriented rle codec.
+using BitEncodeFunc  = void (*)(const std::uint8_t *, int, std::uint8_t **, int *, int *);
+using BitDecodeFunc  = int  (*)(const std::uint8_t *, int, int, std::uint8_t *, int);
+using ByteEncodeFunc = int  (*)(const std::uint8_t *, int, std::uint8_t *, int);
+using ByteDecodeFunc = int  (*)(const std::uint8_t *, int, std::uint8_t *, int);
+
+// Releases the buffer allocated by a BitEncodeFunc (the codec's XYZ_MFREE).
+using FreeFunc = void (*)(void *);
+
+// E.g.: makeEncoder(lzw::easyEncode, [](void * p) { LZW_MFREE(p); })
+CodecFunc makeEncoder(BitEncodeFunc encode, FreeFunc freeFunc);
+CodecFunc makeDecoder(BitDecodeFunc decode);
+
+// E.g.: makeByteEncoder(rle::easyEncode, 3), where the expansion factor is the
+// worst case output size per input byte (3 for rle with 16-bit words, else 2).
+CodecFunc makeByteEncoder(ByteEncodeFunc encode, int maxExpansion);
+CodecFunc makeByteDecoder(ByteDecodeFunc decode);
+
+// ========================================================
+// File stages:
+// ========================================================
+
+// Reads the file in blocks of a fixed size (the last one may be shorter).
+ReadFunc makeFileReader(std::FILE * file, int blockSizeBytes);
+
+// Reads back one frame written by a makeEncoder() adapter per block.
+ReadFunc makeFrameReader(std::FILE * file);
+
+// Appends every block to the file.
+WriteFunc makeFileWriter(std::FILE * file);
+
+// ========================================================
+// template class SpscQueue:
+// ========================================================
+
+// Bounded single-producer/single-consumer ring buffer. One thread may call
+// tryPush() and one other thread may call tryPop(), without any locking.
+// Both return false instead of blocking when the queue is full/empty.
+template<typename T>
+class SpscQueue final
+{
+public:
+
+    // No copy/assignment.
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue & operator = (const SpscQueue &) = delete;
+
+    explicit SpscQueue(const int capacity)
+        : slots(roundUpPow2(capacity))
+        , mask(slots.size() - 1)
+        , head(0)
+        , tail(0)
+    { }
+
+    // Moves 'item' into the queue if there's room.
+    bool tryPush(T & item)
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size())
+        {
+            return false;
+        }
+        slots[t & mask] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves the oldest item out of the queue if there's one.
+    bool tryPop(T & item)
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = std::move(slots[h & mask]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+
+    static std::size_t roundUpPow2(const int n)
+    {
+        std::size_t size = 1;
+        while (size < static_cast<std::size_t>(n))
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    // The consumer owns 'head' and the producer owns 'tail'. The padding
+    // keeps them in separate cache lines, so the two threads don't keep
+    // stealing the line from each other on every push/pop.
+    static constexpr int CacheLineSize = 64;
+
+    std::vector<T> slots;
+    const std::size_t mask;
+    char padding0[CacheLineSize];
+    std::atomic<std::size_t> head;
+    char padding1[CacheLineSize - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> tail;
+};
+
+} // namespace pipeline {}
+
+// ================== End of header file ==================
+#endif // PIPELINE_HPP
+// ================== End of header file ==================
+
+// ================================================================================================
+//
+//                                     Pipeline Implementation
+//
+// ================================================================================================
+
+#ifdef PIPELINE_IMPLEMENTATION
+
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace pipeline
+{
+
+// ========================================================
+// Stage plumbing:
+// ========================================================
+
+// What goes through the queues. 'last' marks the end of the input,
+// sent to every worker after the final block.
+struct QueueItem
+{
+    Block data;
+    bool  last;
+
+    QueueItem()
+        : data()
+        , last(false)
+    { }
+};
+
+// A queue plus what a stage needs to sleep on it. The mutex is only taken
+// by a stage that ran out of spins and by the other side when it sees it
+// asleep, so the queue stays lock-free while blocks keep flowing.
+struct Channel
+{
+    SpscQueue<QueueItem> queue;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::atomic<int> sleepers;
+
+    explicit Channel(const int capacity)
+        : queue(capacity)
+        , mutex()
+        , wakeup()
+        , sleepers(0)
+    { }
+};
+
+// Spin a little before going to sleep. Stages are usually waiting
+// on each other for very short periods when the pipeline is balanced.
+constexpr int SpinsBeforeSleep = 64;
+
+// Retries 'attempt' (a push or pop on the channel) until it succeeds or the
+// pipeline fails. False on failure.
+template<typename Attempt>
+static bool waitFor(Channel & channel, const Attempt & attempt, const std::atomic<bool> & failed, std::uint64_t & stalls)
+{
+    if (attempt())
+    {
+        return true;
+    }
+
+    ++stalls;
+    for (int spins = 0; spins < SpinsBeforeSleep; ++spins)
+    {
+        if (failed.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        if (attempt())
+        {
+            return true;
+        }
+    }
+
+    // Pairs with the fence in wakeOtherSide(): either the attempt below sees
+    // the other side's progress or the other side sees this one asleep.
+    std::unique_lock<std::mutex> lock(channel.mutex);
+    channel.sleepers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool done = false;
+    while (!(done = attempt()) && !failed.load())
+    {
+        channel.wakeup.wait(lock);
+    }
+    channel.sleepers.fetch_sub(1);
+    return done;
+}
+
+static void wakeOtherSide(Channel & channel)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (channel.sleepers.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(channel.mutex);
+        channel.wakeup.notify_all();
+    }
+}
+
+static bool pushWait(Channel & channel, QueueItem & item, const std::atomic<bool> & failed, std::uint64_t & stalls)
+{
+    if (!waitFor(channel, [&]() { return channel.queue.tryPush(item); }, failed, stalls))
+    {
+        return false;
+    }
+    wakeOtherSide(channel);
+    return true;
+}
+
+static bool popWait(Channel & channel, QueueItem & item, const std::atomic<bool> & failed, std::uint64_t & stalls)
+{
+    if (!waitFor(channel, [&]() { return channel.queue.tryPop(item); }, failed, stalls))
+    {
+        return false;
+    }
+    wakeOtherSide(channel);
+    return true;
+}
+
+// ========================================================
+// run():
+// ========================================================
+
+bool run(const ReadFunc & reader, const CodecFunc & codec, const WriteFunc & writer,
+         const Options & options, Stats * stats)
+{
+    // The reader and the writer take a hardware thread each.
+    int workerCount = options.workerCount;
+    if (workerCount <= 0)
+    {
+        workerCount = static_cast<int>(std::thread::hardware_concurrency()) - 2;
+        if (workerCount <= 0)
+        {
+            workerCount = 1;
+        }
+    }
+    const int queueDepth = (options.queueDepth > 0) ? options.queueDepth : 1;
+
+    // Channels don't move (atomics), so they are allocated individually.
+    std::vector<std::unique_ptr<Channel>> inQueues;
+    std::vector<std::unique_ptr<Channel>> outQueues;
+    for (int w = 0; w < workerCount; ++w)
+    {
+        inQueues.emplace_back(new Channel(queueDepth));
+        outQueues.emplace_back(new Channel(queueDepth));
+    }
+
+    // Stops every stage, including the ones asleep on a channel.
+    std::atomic<bool> failed(false);
+    const auto fail = [&]()
+    {
+        failed = true;
+        for (int w = 0; w < workerCount; ++w)
+        {
+            for (Channel * channel : { inQueues[w].get(), outQueues[w].get() })
+            {
+                std::lock_guard<std::mutex> lock(channel->mutex);
+                channel->wakeup.notify_all();
+            }
+        }
+    };
+    std::uint64_t bytesRead    = 0;
+    std::uint64_t readerStalls = 0;
+
+    std::thread readerThread([&]()
+    {
+        std::uint64_t unusedStalls = 0;
+        for (std::size_t index = 0; ; ++index)
+        {
+            QueueItem item;
+            if (!reader(item.data))
+            {
+                fail();
+                return;
+            }
+            if (item.data.empty())
+            {
+                break;
+            }
+            bytesRead += item.data.size();
+            if (!pushWait(*inQueues[index % workerCount], item, failed, readerStalls))
+            {
+                return;
+            }
+        }
+
+        // Each worker forwards its end marker to the writer once
+        // it's done with the blocks queued before it.
+        for (int w = 0; w < workerCount; ++w)
+        {
+            QueueItem item;
+            item.last = true;
+            if (!pushWait(*inQueues[w], item, failed, unusedStalls))
+            {
+                return;
+            }
+        }
+    });
+
+    std::vector<std::thread> workerThreads;
+    for (int w = 0; w < workerCount; ++w)
+    {
+        workerThreads.emplace_back([&, w]()
+        {
+            std::uint64_t unusedStalls = 0;
+            for (;;)
+            {
+                QueueItem input;
+                if (!popWait(*inQueues[w], input, failed, unusedStalls))
+                {
+                    return;
+                }
+
+                QueueItem output;
+                output.last = input.last;
+                if (!input.last && !codec(input.data, output.data))
+                {
+                    fail();
+                    return;
+                }
+                if (!pushWait(*outQueues[w], output, failed, unusedStalls) || input.last)
+                {
+                    return;
+                }
+            }
+        });
+    }
+
+    // The writer runs in the calling thread. Blocks come back from
+    // the workers in the same round-robin order they went out.
+    std::uint64_t blocks       = 0;
+    std::uint64_t bytesWritten = 0;
+    std::uint64_t writerStalls = 0;
+    for (std::size_t index = 0; ; ++index)
+    {
+        QueueItem item;
+        if (!popWait(*outQueues[index % workerCount], item, failed, writerStalls) || item.last)
+        {
+            break;
+        }
+        if (!writer(item.data))
+        {
+            fail();
+            break;
+        }
+        bytesWritten += item.data.size();
+        ++blocks;
+    }
+
+    readerThread.join();
+    for (auto & thread : workerThreads)
+    {
+        thread.join();
+    }
+
+    if (stats != nullptr)
+    {
+        stats->blocks       = blocks;
+        stats->bytesRead    = bytesRead;
+        stats->bytesWritten = bytesWritten;
+        stats->readerStalls = readerStalls;
+        stats->writerStalls = writerStalls;
+    }
+    return !failed;
+}
+
+// ========================================================
+// Frame helpers:
+// ========================================================
+
+static void writeU32(std::uint8_t * ptr, const std::uint32_t value)
+{
+    ptr[0] = static_cast<std::uint8_t>(value);
+    ptr[1] = static_cast<std::uint8_t>(value >> 8);
+    ptr[2] = static_cast<std::uint8_t>(value >> 16);
+    ptr[3] = static_cast<std::uint8_t>(value >> 24);
+}
+
+static std::uint32_t readU32(const std::uint8_t * ptr)
+{
+    return static_cast<std::uint32_t>(ptr[0])         |
+           (static_cast<std::uint32_t>(ptr[1]) << 8)  |
+           (static_cast<std::uint32_t>(ptr[2]) << 16) |
+           (static_cast<std::uint32_t>(ptr[3]) << 24);
+}
+
+static void writeFrameHeader(std::uint8_t * ptr, const int uncompressedBytes,
+                             const int payloadBytes, const int payloadBits)
+{
+    writeU32(ptr + 0, static_cast<std::uint32_t>(uncompressedBytes));
+    writeU32(ptr + 4, static_cast<std::uint32_t>(payloadBytes));
+    writeU32(ptr + 8, static_cast<std::uint32_t>(payloadBits));
+}
+
+// Validates the header against the block size. False if the frame is malformed.
+static bool readFrameHeader(const Block & frame, int & uncompressedBytes, int & payloadBytes, int & payloadBits)
+{
+    if (frame.size() < static_cast<std::size_t>(FrameHeaderBytes))
+    {
+        return false;
+    }
+
+    const std::uint32_t rawSize  = readU32(frame.data() + 0);
+    const std::uint32_t byteSize = readU32(frame.data() + 4);
+    const std::uint32_t bitSize  = readU32(frame.data() + 8);
+
+    if (rawSize > 0x7FFFFFFF || byteSize != frame.size() - FrameHeaderBytes ||
+        bitSize > static_cast<std::uint64_t>(byteSize) * 8)
+    {
+        return false;
+    }
+
+    uncompressedBytes = static_cast<int>(rawSize);
+    payloadBytes      = static_cast<int>(byteSize);
+    payloadBits       = static_cast<int>(bitSize);
+    return true;
+}
+
+// ========================================================
+// Codec adapters:
+// ========================================================
+
+CodecFunc makeEncoder(const BitEncodeFunc encode, const FreeFunc freeFunc)
+{
+    return [encode, freeFunc](const Block & input, Block & output) -> bool
+    {
+        int compressedSizeBytes = 0;
+        int compressedSizeBits  = 0;
+        std::uint8_t * compressed = nullptr;
+
+        encode(input.data(), static_cast<int>(input.size()),
+               &compressed, &compressedSizeBytes, &compressedSizeBits);
+        if (compressed == nullptr)
+        {
+            return false;
+        }
+
+        output.resize(FrameHeaderBytes + compressedSizeBytes);
+        writeFrameHeader(output.data(), static_cast<int>(input.size()), compressedSizeBytes, compressedSizeBits);
+        std::memcpy(output.data() + FrameHeaderBytes, compressed, compressedSizeBytes);
+
+        freeFunc(compressed);
+        return true;
+    };
+}
+
+CodecFunc makeDecoder(const BitDecodeFunc decode)
+{
+    return [decode](const Block & input, Block & output) -> bool
+    {
+        int uncompressedBytes, payloadBytes, payloadBits;
+        if (!readFrameHeader(input, uncompressedBytes, payloadBytes, payloadBits))
+        {
+            return false;
+        }
+
+        output.resize(uncompressedBytes);
+        return decode(input.data() + FrameHeaderBytes, payloadBytes, payloadBits,
+                      output.data(), uncompressedBytes) == uncompressedBytes;
+    };
+}
+
+CodecFunc makeByteEncoder(const ByteEncodeFunc encode, const int maxExpansion)
+{
+    return [encode, maxExpansion](const Block & input, Block & output) -> bool
+    {
+        const int inSizeBytes = static_cast<int>(input.size());
+        output.resize(FrameHeaderBytes + static_cast<std::size_t>(inSizeBytes) * maxExpansion);
+
+        const int payloadBytes = encode(input.data(), inSizeBytes, output.data() + FrameHeaderBytes,
+                                        static_cast<int>(output.size()) - FrameHeaderBytes);
+        if (payloadBytes < 0)
+        {
+            return false;
+        }
+
+        output.resize(FrameHeaderBytes + payloadBytes);
+        writeFrameHeader(output.data(), inSizeBytes, payloadBytes, payloadBytes * 8);
+        return true;
+    };
+}
+
+CodecFunc makeByteDecoder(const ByteDecodeFunc decode)
+{
+    return [decode](const Block & input, Block & output) -> bool
+    {
+        int uncompressedBytes, payloadBytes, payloadBits;
+        if (!readFrameHeader(input, uncompressedBytes, payloadBytes, payloadBits))
+        {
+            return false;
+        }
+
+        output.resize(uncompressedBytes);
+        return decode(input.data() + FrameHeaderBytes, payloadBytes,
+                      output.data(), uncompressedBytes) == uncompressedBytes;
+    };
+}
+
+// ========================================================
+// File stages:
+// ========================================================
+
+ReadFunc makeFileReader(std::FILE * file, const int blockSizeBytes)
+{
+    return [file, blockSizeBytes](Block & block) -> bool
+    {
+        block.resize(blockSizeBytes);
+        const std::size_t bytesRead = std::fread(block.data(), 1, block.size(), file);
+        block.resize(bytesRead);
+        return !std::ferror(file);
+    };
+}
+
+ReadFunc makeFrameReader(std::FILE * file)
+{
+    return [file](Block & block) -> bool
+    {
+        block.resize(FrameHeaderBytes);
+        const std::size_t headerRead = std::fread(block.data(), 1, FrameHeaderBytes, file);
+        if (headerRead == 0 && std::feof(file))
+        {
+            block.clear(); // End of input.
+            return true;
+        }
+        if (headerRead != static_cast<std::size_t>(FrameHeaderBytes))
+        {
+            return false; // Truncated frame or read error.
+        }
+
+        const std::uint32_t payloadBytes = readU32(block.data() + 4);
+        if (payloadBytes > 0x7FFFFFFF - FrameHeaderBytes)
+        {
+            return false;
+        }
+
+        block.resize(FrameHeaderBytes + payloadBytes);
+        return std::fread(block.data() + FrameHeaderBytes, 1, payloadBytes, file) == payloadBytes;
+    };
+}
+
+WriteFunc makeFileWriter(std::FILE * file)
+{
+    return [file](const Block & block) -> bool
+    {
+        return std::fwrite(block.data(), 1, block.size(), file) == block.size();
+    };
+}
+
+} // namespace pipeline {}
+
+// ================ End of implementation =================
+#endif // PIPELINE_IMPLEMENTATION
+// ================ End of implementation =================
@@ -0,0 +1,824 @@
+// ================================================================================================
+// -*- C++ -*-
+// File: rangecoder.hpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: Adaptive binary range coder (arithmetic coding) with order-0 and order-1 byte models.
+// ================================================================================================
+
+#ifndef RANGECODER_HPP
+#define RANGECODER_HPP
+
+// ---------
+//  LICENSE
+// ---------
+// This software is in the public domain. Where that dedication is not recognized,
+// you are granted a perpetual, irrevocable license to copy, distribute, and modify
+// this file as you see fit.
+//
+// The source code is provided "as is", without warranty of any kind, express or implied.
+// No attribution is required, but a mention about the author is appreciated.
+//
+// -------
+//  SETUP
+// -------
+// #define RANGECODER_IMPLEMENTATION in one source file before including
+// this file, then use rangecoder.hpp as a normal header file elsewhere.
+//
+// You can override the RANGECODER_ERROR() macro to supply your
+// own error handling strategy. The default simply writes to
+// stderr and calls std::abort().
+//
+// The output buffer of the Encoder and the probability tables of a
+// ByteModel are sourced from RANGECODER_MALLOC/RANGECODER_MFREE,
+// unless they are given by the caller (see the low-memory profile).
+//
+// ----------
+//  OVERVIEW
+// ----------
+// Huffman spends a whole number of bits on each symbol, so on very
+// skewed data (a byte that shows up 99% of the time still costs 1 bit)
+// it can be far from the entropy, and it has to send its tree first.
+// A range coder spends fractional bits and needs no table: the encoder
+// and the decoder start from the same flat probabilities and adapt them
+// in lockstep as the data goes by.
+//
+// This is the binary coder of LZMA: every decision is a bit coded with a
+// 12-bit probability that moves 1/16th of the way towards the bit just
+// seen (a shift and an add per bit). A byte is coded as 8 such bits down
+// a binary tree, MSB first, each node with its own probability, which
+// makes it an adaptive model of all 256 symbols. In the order-1 model
+// there is one such tree for each value of the previous byte, so text
+// and other data where a byte predicts the next compress further, at
+// the cost of a 128 KB table and of a slower start.
+//
+// Coding is serial by nature, so there are no SIMD kernels here.
+//
+// easyEncode()/easyDecode() have the same signatures as the huffman and
+// rice ones. The decoder is given the uncompressed size, as with those,
+// and the stream has no header at all: the first byte the range coder
+// writes is always a zero, so easyEncode() keeps the model in it.
+//
+// --------------
+//  USEFUL LINKS
+// --------------
+// Wikipedia:
+//  https://en.wikipedia.org/wiki/Range_coding
+
+#include <cstdint>
+#include <cstdlib>
+
+// If you provide a custom malloc(), you must also provide a custom free().
+// Note: We never check RANGECODER_MALLOC's return for null. A custom implementation
+// should just abort with a fatal error if the program runs out of memory.
+#ifndef RANGECODER_MALLOC
+    #define RANGECODER_MALLOC std::malloc
+    #define RANGECODER_MFREE  std::free
+#endif // RANGECODER_MALLOC
+
+namespace rangecoder
+{
+
+// ========================================================
+
+// The default fatalError() function writes to stderr and aborts.
+#ifndef RANGECODER_ERROR
+    void fatalError(const char * message);
+    #define RANGECODER_USING_DEFAULT_ERROR_HANDLER
+    #define RANGECODER_ERROR(message) ::rangecoder::fatalError(message)
+#endif // RANGECODER_ERROR
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Byte and carry counts of the coder. Compiled in by defining
+// RANGECODER_ENABLE_STATS with RANGECODER_IMPLEMENTATION, always
+// zero otherwise. One set per thread.
+struct Stats
+{
+    std::uint64_t encodeCalls  = 0; // easyEncode() calls.
+    std::uint64_t decodeCalls  = 0; // easyDecode() calls.
+    std::uint64_t bytesEncoded = 0; // Uncompressed bytes consumed by the encoder.
+    std::uint64_t bytesDecoded = 0; // Uncompressed bytes produced by the decoder.
+    std::uint64_t bytesWritten = 0; // Compressed bytes output by the Encoder.
+    std::uint64_t bytesRead    = 0; // Compressed bytes consumed by the Decoder.
+    std::uint64_t carries      = 0; // Carries into the bytes held back by the Encoder.
+};
+
+// The calling thread's counters.
+const Stats & getStats();
+void resetStats();
+
+// ========================================================
+// Probabilities:
+// ========================================================
+
+// Probability of a bit being 0, out of 1 << ProbBits. Adapted by
+// 1 / (1 << AdaptShift) of the distance to 0 or 1 after each bit.
+using Prob = std::uint16_t;
+constexpr int  ProbBits   = 12;
+constexpr int  AdaptShift = 4;
+constexpr Prob ProbInit   = 1 << (ProbBits - 1);
+
+// Which ByteModel to code the bytes with.
+enum class Model : std::uint8_t
+{
+    Order0 = 0, // A single 256 symbol tree.
+    Order1 = 1  // A tree per value of the previous byte.
+};
+
+// ========================================================
+// class Encoder:
+// ========================================================
+
+class Encoder final
+{
+public:
+
+    // No copy/assignment.
+    Encoder(const Encoder &) = delete;
+    Encoder & operator = (const Encoder &) = delete;
+
+    explicit Encoder(int initialSizeBytes = 1024);
+
+    // Writes to a fixed caller buffer, which is never grown nor freed. Bytes
+    // that don't fit are dropped and hasOverflowed() becomes true.
+    Encoder(std::uint8_t * buffer, int bufferSizeBytes);
+    ~Encoder();
+
+    // Codes a bit with the probability of it being 0, then adapts the probability.
+    void encodeBit(Prob & prob, int bit);
+
+    // Codes the 8 bits of a byte down a tree of 256 probabilities (tree[0] unused).
+    void encodeByte(Prob * tree, int byte);
+
+    // Writes out the last bytes of the state. Nothing can be encoded after it.
+    void flush();
+
+    // Hands the buffer to the caller, who frees it with RANGECODER_MFREE().
+    std::uint8_t * release();
+
+    int getByteCount() const { return bytesWritten; }
+    const std::uint8_t * getStream() const { return stream; }
+    bool hasOverflowed() const { return overflowed; }
+
+private:
+
+    void shiftLow();
+    void writeByte(std::uint8_t byte);
+
+    std::uint8_t * stream;     // Heap allocated output buffer, owned by the class instance unless fixed.
+    bool fixedBuffer;          // The stream is a caller buffer.
+    bool overflowed;           // A fixed buffer ran out of space.
+    int bytesAllocated;        // Current size of the stream buffer in bytes.
+    int bytesWritten;          // Bytes of the stream buffer in use.
+    std::uint64_t low;         // Bottom of the current interval, plus a carry in bit 32.
+    std::uint32_t range;       // Width of the current interval.
+    std::uint8_t cache;        // Last top byte of 'low', held back in case a carry reaches it.
+    std::int64_t cacheSize;    // The cache byte plus the 0xFF bytes held back after it.
+};
+
+// ========================================================
+// class Decoder:
+// ========================================================
+
+class Decoder final
+{
+public:
+
+    // No copy/assignment.
+    Decoder(const Decoder &) = delete;
+    Decoder & operator = (const Decoder &) = delete;
+
+    Decoder(const std::uint8_t * compressed, int sizeBytes);
+
+    int decodeBit(Prob & prob);
+    int decodeByte(Prob * tree);
+
+    // True once the decoder needed more bytes than the stream had,
+    // meaning the stream was truncated or was not a range coder one.
+    bool isOverrun() const { return bytesRead > streamSize; }
+    int getBytesRead() const { return bytesRead; }
+
+private:
+
+    std::uint8_t nextByte();
+
+    const std::uint8_t * stream;
+    int streamSize;
+    int bytesRead;
+    std::uint32_t range;
+    std::uint32_t code;
+};
+
+// ========================================================
+// class ByteModel:
+// ========================================================
+
+// The adaptive probabilities of the bytes of one stream. Use one for
+// encoding and a fresh one, of the same Model, to decode it.
+class ByteModel final
+{
+public:
+
+    // No copy/assignment.
+    ByteModel(const ByteModel &) = delete;
+    ByteModel & operator = (const ByteModel &) = delete;
+
+    explicit ByteModel(Model byteModel);
+
+    // Keeps the probabilities in a caller table of tableSize(byteModel) entries.
+    ByteModel(Model byteModel, Prob * table);
+    ~ByteModel();
+
+    static int tableSize(Model byteModel);
+
+    void encode(Encoder & encoder, std::uint8_t byte);
+    std::uint8_t decode(Decoder & decoder);
+
+    // Back to the flat probabilities.
+    void reset();
+
+    Model getModel() const { return model; }
+
+private:
+
+    Prob * probs;        // 256 probabilities per context, heap allocated unless given by the caller.
+    const bool ownsProbs;
+    const Model model;
+    int context;         // Previous byte, for Order1. Always 0 for Order0.
+};
+
+// ========================================================
+// easyEncode() / easyDecode():
+// ========================================================
+
+// Quick range coder data compression with the order-0 model. Output compressed
+// data is heap allocated with RANGECODER_MALLOC() and should be later freed
+// with RANGECODER_MFREE(). The size in bits is always the size in bytes * 8.
+void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits);
+
+// Same as above, with the model to use.
+void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits, Model model);
+
+// Decompress back the output of easyEncode(), of either model, into uncompressedSizeBytes
+// bytes (the size given to the encoder). Returns the number of bytes decoded, which is
+// less than uncompressedSizeBytes only if the compressed data ended too soon.
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               std::uint8_t * uncompressed, int uncompressedSizeBytes);
+
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+// For small stacks and no heap at all (e.g. thousands of fibers with 16KB
+// stacks), the overloads below write to caller buffers and keep the ByteModel
+// probabilities in a caller-provided workspace of workspaceSize() bytes
+// (512 bytes for Order0, 128KB for Order1). They never call RANGECODER_MALLOC
+// and use a few hundred bytes of stack.
+int workspaceSize(Model model = Model::Order0);
+
+// Returns the compressed size in bytes, or zero if the output buffer or the
+// workspace was too small (RANGECODER_ERROR() is called first). Same stream
+// as the heap-allocating easyEncode().
+int easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+               std::uint8_t * compressed, int compressedCapacityBytes, int * compressedSizeBits,
+               void * workspace, int workspaceSizeBytes, Model model = Model::Order0);
+
+// Same as easyDecode(), with the probabilities in the workspace, which
+// must be big enough for the model of the stream.
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               std::uint8_t * uncompressed, int uncompressedSizeBytes,
+               void * workspace, int workspaceSizeBytes);
+
+} // namespace rangecoder {}
+
+// ================== End of header file ==================
+#endif // RANGECODER_HPP
+// ================== End of header file ==================
+
+// ================================================================================================
+//
+//                                  Range Coder Implementation
+//
+// ================================================================================================
+
+#ifdef RANGECODER_IMPLEMENTATION
+
+#ifdef RANGECODER_USING_DEFAULT_ERROR_HANDLER
+    #include <cstdio> // For the default error handler
+#endif // RANGECODER_USING_DEFAULT_ERROR_HANDLER
+
+#include <cstring>
+
+namespace rangecoder
+{
+
+// The interval is renormalized (a byte shifted out) when the range drops below this.
+constexpr std::uint32_t TopValue = std::uint32_t(1) << 24;
+
+// Bytes of state the Decoder reads before the first bit, the always zero one included.
+constexpr int InitBytes = 5;
+
+// ========================================================
+
+#ifdef RANGECODER_USING_DEFAULT_ERROR_HANDLER
+
+// Prints a fatal error to stderr and aborts the process.
+// This is the default method used by RANGECODER_ERROR(), but
+// you can override the macro to use other error handling
+// mechanisms, such as C++ exceptions.
+void fatalError(const char * const message)
+{
+    std::fprintf(stderr, "Range coder error: %s\n", message);
+    std::abort();
+}
+
+#endif // RANGECODER_USING_DEFAULT_ERROR_HANDLER
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef RANGECODER_ENABLE_STATS
+    #define RANGECODER_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !RANGECODER_ENABLE_STATS
+    #define RANGECODER_STATS_ADD(counter, amount) ((void)0)
+#endif // RANGECODER_ENABLE_STATS
+
+// ========================================================
+// class Encoder:
+// ========================================================
+
+Encoder::Encoder(const int initialSizeBytes)
+    : stream{ nullptr }
+    , fixedBuffer{ false }
+    , overflowed{ false }
+    , bytesAllocated{ (initialSizeBytes > 16) ? initialSizeBytes : 16 }
+    , bytesWritten{ 0 }
+    , low{ 0 }
+    , range{ 0xFFFFFFFF }
+    , cache{ 0 }
+    , cacheSize{ 1 }
+{
+    stream = static_cast<std::uint8_t *>(RANGECODER_MALLOC(bytesAllocated));
+}
+
+Encoder::Encoder(std::uint8_t * buffer, const int bufferSizeBytes)
+    : stream{ buffer }
+    , fixedBuffer{ true }
+    , overflowed{ false }
+    , bytesAllocated{ (buffer != nullptr && bufferSizeBytes > 0) ? bufferSizeBytes : 0 }
+    , bytesWritten{ 0 }
+    , low{ 0 }
+    , range{ 0xFFFFFFFF }
+    , cache{ 0 }
+    , cacheSize{ 1 }
+{
+}
+
+Encoder::~Encoder()
+{
+    if (!fixedBuffer)
+    {
+        RANGECODER_MFREE(stream);
+    }
+}
+
+void Encoder::encodeBit(Prob & prob, const int bit)
+{
+    const std::uint32_t bound = (range >> ProbBits) * prob;
+    if (bit == 0)
+    {
+        range = bound;
+        prob = static_cast<Prob>(prob + (((1 << ProbBits) - prob) >> AdaptShift));
+    }
+    else
+    {
+        low   += bound;
+        range -= bound;
+        prob = static_cast<Prob>(prob - (prob >> AdaptShift));
+    }
+
+    while (range < TopValue)
+    {
+        range <<= 8;
+        shiftLow();
+    }
+}
+
+void Encoder::encodeByte(Prob * tree, const int byte)
+{
+    int node = 1;
+    for (int b = 7; b >= 0; --b)
+    {
+        const int bit = (byte >> b) & 1;
+        encodeBit(tree[node], bit);
+        node = (node << 1) | bit;
+    }
+}
+
+void Encoder::flush()
+{
+    for (int i = 0; i < InitBytes; ++i)
+    {
+        shiftLow();
+    }
+}
+
+std::uint8_t * Encoder::release()
+{
+    std::uint8_t * released = stream;
+    stream = nullptr;
+    bytesAllocated = 0;
+    bytesWritten = 0;
+    return released;
+}
+
+// The top byte of 'low' can't be written as soon as it is shifted out:
+// a later addition may still carry into it, and through any 0xFF bytes
+// that follow it. Those are held back (cache + cacheSize) until a byte
+// other than 0xFF shows that no carry can get past it anymore.
+void Encoder::shiftLow()
+{
+    if (static_cast<std::uint32_t>(low) < 0xFF000000 || (low >> 32) != 0)
+    {
+        const std::uint8_t carry = static_cast<std::uint8_t>(low >> 32);
+        RANGECODER_STATS_ADD(carries, carry);
+
+        std::uint8_t held = cache;
+        do
+        {
+            writeByte(static_cast<std::uint8_t>(held + carry));
+            held = 0xFF;
+        } while (--cacheSize != 0);
+        cache = static_cast<std::uint8_t>(low >> 24);
+    }
+    ++cacheSize;
+    low = (low & 0x00FFFFFF) << 8;
+}
+
+void Encoder::writeByte(const std::uint8_t byte)
+{
+    if (bytesWritten == bytesAllocated)
+    {
+        if (fixedBuffer)
+        {
+            overflowed = true;
+            return;
+        }
+        std::uint8_t * newStream = static_cast<std::uint8_t *>(RANGECODER_MALLOC(bytesAllocated * 2));
+        std::memcpy(newStream, stream, bytesWritten);
+        RANGECODER_MFREE(stream);
+        stream = newStream;
+        bytesAllocated *= 2;
+    }
+    stream[bytesWritten++] = byte;
+    RANGECODER_STATS_ADD(bytesWritten, 1);
+}
+
+// ========================================================
+// class Decoder:
+// ========================================================
+
+Decoder::Decoder(const std::uint8_t * const compressed, const int sizeBytes)
+    : stream{ compressed }
+    , streamSize{ sizeBytes }
+    , bytesRead{ 0 }
+    , range{ 0xFFFFFFFF }
+    , code{ 0 }
+{
+    for (int i = 0; i < InitBytes; ++i)
+    {
+        code = (code << 8) | nextByte();
+    }
+}
+
+int Decoder::decodeBit(Prob & prob)
+{
+    const std::uint32_t bound = (range >> ProbBits) * prob;
+    int bit;
+    if (code < bound)
+    {
+        range = bound;
+        prob = static_cast<Prob>(prob + (((1 << ProbBits) - prob) >> AdaptShift));
+        bit = 0;
+    }
+    else
+    {
+        code  -= bound;
+        range -= bound;
+        prob = static_cast<Prob>(prob - (prob >> AdaptShift));
+        bit = 1;
+    }
+
+    while (range < TopValue)
+    {
+        range <<= 8;
+        code = (code << 8) | nextByte();
+    }
+    return bit;
+}
+
+int Decoder::decodeByte(Prob * tree)
+{
+    int node = 1;
+    while (node < 256)
+    {
+        node = (node << 1) | decodeBit(tree[node]);
+    }
+    return node - 256;
+}
+
+// Past the end of the stream it reads zeros, so the decoder never looks
+// outside the buffer; isOverrun() then tells the data was cut short.
+std::uint8_t Decoder::nextByte()
+{
+    const std::uint8_t byte = (bytesRead < streamSize) ? stream[bytesRead] : 0;
+    ++bytesRead;
+    RANGECODER_STATS_ADD(bytesRead, 1);
+    return byte;
+}
+
+// ========================================================
+// class ByteModel:
+// ========================================================
+
+static int contextCount(const Model model)
+{
+    return (model == Model::Order1) ? 256 : 1;
+}
+
+ByteModel::ByteModel(const Model byteModel)
+    : probs{ static_cast<Prob *>(RANGECODER_MALLOC(tableSize(byteModel) * sizeof(Prob))) }
+    , ownsProbs{ true }
+    , model{ byteModel }
+    , context{ 0 }
+{
+    reset();
+}
+
+ByteModel::ByteModel(const Model byteModel, Prob * table)
+    : probs{ table }
+    , ownsProbs{ false }
+    , model{ byteModel }
+    , context{ 0 }
+{
+    reset();
+}
+
+ByteModel::~ByteModel()
+{
+    if (ownsProbs)
+    {
+        RANGECODER_MFREE(probs);
+    }
+}
+
+int ByteModel::tableSize(const Model byteModel)
+{
+    return contextCount(byteModel) * 256;
+}
+
+void ByteModel::encode(Encoder & encoder, const std::uint8_t byte)
+{
+    encoder.encodeByte(probs + context * 256, byte);
+    if (model == Model::Order1)
+    {
+        context = byte;
+    }
+}
+
+std::uint8_t ByteModel::decode(Decoder & decoder)
+{
+    const std::uint8_t byte = static_cast<std::uint8_t>(decoder.decodeByte(probs + context * 256));
+    if (model == Model::Order1)
+    {
+        context = byte;
+    }
+    return byte;
+}
+
+void ByteModel::reset()
+{
+    const int count = tableSize(model);
+    for (int i = 0; i < count; ++i)
+    {
+        probs[i] = ProbInit;
+    }
+    context = 0;
+}
+
+// ========================================================
+// easyEncode() / easyDecode():
+// ========================================================
+
+static void encodeBytes(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                        Encoder & encoder, ByteModel & byteModel)
+{
+    RANGECODER_STATS_ADD(encodeCalls, 1);
+    RANGECODER_STATS_ADD(bytesEncoded, uncompressedSizeBytes);
+
+    for (int i = 0; i < uncompressedSizeBytes; ++i)
+    {
+        byteModel.encode(encoder, uncompressed[i]);
+    }
+    encoder.flush();
+}
+
+static int decodeBytes(Decoder & decoder, ByteModel & byteModel,
+                       std::uint8_t * uncompressed, const int uncompressedSizeBytes)
+{
+    RANGECODER_STATS_ADD(decodeCalls, 1);
+
+    int bytesDecoded = 0;
+    while (bytesDecoded < uncompressedSizeBytes)
+    {
+        uncompressed[bytesDecoded] = byteModel.decode(decoder);
+        if (decoder.isOverrun())
+        {
+            RANGECODER_ERROR("Failed to read bytes from stream! Unexpected end.");
+            break;
+        }
+        ++bytesDecoded;
+    }
+
+    RANGECODER_STATS_ADD(bytesDecoded, bytesDecoded);
+    return bytesDecoded;
+}
+
+void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits)
+{
+    easyEncode(uncompressed, uncompressedSizeBytes, compressed, compressedSizeBytes, compressedSizeBits, Model::Order0);
+}
+
+void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits, const Model model)
+{
+    if (uncompressed == nullptr || compressed == nullptr)
+    {
+        RANGECODER_ERROR("rangecoder::easyEncode(): Null data pointer(s)!");
+        return;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedSizeBytes == nullptr || compressedSizeBits == nullptr)
+    {
+        RANGECODER_ERROR("rangecoder::easyEncode(): Bad in/out sizes!");
+        return;
+    }
+
+    Encoder encoder(uncompressedSizeBytes / 2 + 64);
+    ByteModel byteModel(model);
+    encodeBytes(uncompressed, uncompressedSizeBytes, encoder, byteModel);
+
+    // The first byte out of the encoder is always zero. It carries the model instead.
+    *compressedSizeBytes = encoder.getByteCount();
+    *compressedSizeBits  = encoder.getByteCount() * 8;
+    *compressed = encoder.release();
+    (*compressed)[0] = static_cast<std::uint8_t>(model);
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               std::uint8_t * uncompressed, const int uncompressedSizeBytes)
+{
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        RANGECODER_ERROR("rangecoder::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes < InitBytes || compressedSizeBits < compressedSizeBytes * 8 - 7 || uncompressedSizeBytes <= 0)
+    {
+        RANGECODER_ERROR("rangecoder::easyDecode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    if (compressed[0] > static_cast<std::uint8_t>(Model::Order1))
+    {
+        RANGECODER_ERROR("rangecoder::easyDecode(): Bad stream header!");
+        return 0;
+    }
+
+    Decoder decoder(compressed, compressedSizeBytes);
+    ByteModel byteModel(static_cast<Model>(compressed[0]));
+    return decodeBytes(decoder, byteModel, uncompressed, uncompressedSizeBytes);
+}
+
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+int workspaceSize(const Model model)
+{
+    return ByteModel::tableSize(model) * static_cast<int>(sizeof(Prob)) + static_cast<int>(alignof(Prob)) - 1;
+}
+
+// Where the probabilities go in the caller's workspace, or null if it is too small.
+static Prob * alignWorkspace(void * workspace, const int workspaceSizeBytes, const Model model)
+{
+    if (workspace == nullptr || workspaceSizeBytes < workspaceSize(model))
+    {
+        return nullptr;
+    }
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(workspace);
+    return reinterpret_cast<Prob *>((address + alignof(Prob) - 1) & ~std::uintptr_t(alignof(Prob) - 1));
+}
+
+int easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+               std::uint8_t * compressed, const int compressedCapacityBytes, int * compressedSizeBits,
+               void * workspace, const int workspaceSizeBytes, const Model model)
+{
+    if (uncompressed == nullptr || compressed == nullptr || compressedSizeBits == nullptr)
+    {
+        RANGECODER_ERROR("rangecoder::easyEncode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedCapacityBytes <= 0)
+    {
+        RANGECODER_ERROR("rangecoder::easyEncode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    Prob * const table = alignWorkspace(workspace, workspaceSizeBytes, model);
+    if (table == nullptr)
+    {
+        RANGECODER_ERROR("rangecoder::easyEncode(): Workspace too small!");
+        return 0;
+    }
+
+    Encoder encoder(compressed, compressedCapacityBytes);
+    ByteModel byteModel(model, table);
+    encodeBytes(uncompressed, uncompressedSizeBytes, encoder, byteModel);
+
+    if (encoder.hasOverflowed())
+    {
+        RANGECODER_ERROR("rangecoder::easyEncode(): Output buffer too small!");
+        return 0;
+    }
+
+    compressed[0] = static_cast<std::uint8_t>(model);
+    *compressedSizeBits = encoder.getByteCount() * 8;
+    return encoder.getByteCount();
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+               void * workspace, const int workspaceSizeBytes)
+{
+    if (compressed == nullptr || uncompressed == nullptr)
+    {
+        RANGECODER_ERROR("rangecoder::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (compressedSizeBytes < InitBytes || compressedSizeBits < compressedSizeBytes * 8 - 7 || uncompressedSizeBytes <= 0)
+    {
+        RANGECODER_ERROR("rangecoder::easyDecode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    if (compressed[0] > static_cast<std::uint8_t>(Model::Order1))
+    {
+        RANGECODER_ERROR("rangecoder::easyDecode(): Bad stream header!");
+        return 0;
+    }
+
+    const Model model = static_cast<Model>(compressed[0]);
+    Prob * const table = alignWorkspace(workspace, workspaceSizeBytes, model);
+    if (table == nullptr)
+    {
+        RANGECODER_ERROR("rangecoder::easyDecode(): Workspace too small!");
+        return 0;
+    }
+
+    Decoder decoder(compressed, compressedSizeBytes);
+    ByteModel byteModel(model, table);
+    return decodeBytes(decoder, byteModel, uncompressed, uncompressedSizeBytes);
+}
+
+} // namespace rangecoder {}
+
+// ================ End of implementation =================
+#endif // RANGECODER_IMPLEMENTATION
+// ================ End of implementation =================
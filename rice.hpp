@@ -7,6 +7,8 @@
 // Brief: Rice encoding/decoding (named after Robert F. Rice), which is based on Golomb Coding.
 //        http://dmr.ath.cx/code/rice/
 //        https://en.wikipedia.org/wiki/Golomb_coding
+//        Also does general Golomb (any divisor) and order-k Exp-Golomb coding, see rice::Mode.
+//        https://en.wikipedia.org/wiki/Exponential-Golomb_coding
 // ================================================================================================
 
 #ifndef RICE_HPP
@@ -35,6 +37,63 @@ namespace rice
     #define RICE_ERROR(message) ::rice::fatalError(message)
 #endif // RICE_ERROR
 
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+// AVX2 computes the codes of 8 values at once in the block encoder, and
+// BMI1/BMI2 speed up the bit I/O and the unary decode. Detected on first
+// use; all false with RICE_NO_SIMD or when not compiling for x86/x64.
+struct CpuFeatures
+{
+    bool avx2 = false;
+    bool bmi2 = false;
+};
+
+// Features in use by the encoder/decoder kernels.
+const CpuFeatures & getCpuFeatures();
+
+// Masks the detected features, e.g. to force the scalar kernels in tests.
+// Not thread safe; call it before any encoding/decoding takes place.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Bit counts and the K picked per call, compiled in with RICE_ENABLE_STATS
+// (define it with RICE_IMPLEMENTATION). Zeros otherwise; kept per thread.
+struct Stats
+{
+    std::uint64_t encodeCalls      = 0; // easyEncode() calls.
+    std::uint64_t decodeCalls      = 0; // easyDecode() calls.
+    std::uint64_t bytesEncoded     = 0; // Uncompressed bytes consumed by the encoder.
+    std::uint64_t bytesDecoded     = 0; // Uncompressed bytes produced by the decoder.
+    std::uint64_t bitsWritten      = 0; // Compressed bits output by the encoder.
+    std::uint64_t bitsRead         = 0; // Compressed bits consumed by the decoder.
+    std::uint64_t allocatorGrowths = 0; // Reallocations of an Encoder buffer in allocate().
+    std::uint64_t kBitsSelected[9] = {}; // How many times easyEncode() picked each K (0 to 8).
+};
+
+// This thread's counters since startup or resetStats().
+const Stats & getStats();
+void resetStats();
+
+// Largest remainder width. Samples are bytes, so a wider K never pays off.
+constexpr int MaxKBits = 8;
+
+// Largest Golomb divisor. Same reason as above.
+constexpr int MaxGolombM = 256;
+
+// How the values are coded. All of them share the unary quotient.
+enum class Mode
+{
+    Rice,      // Divisor M = 2^K and a K bits remainder. Fastest to decode.
+    Golomb,    // Any divisor M (1 to MaxGolombM) with a truncated binary remainder.
+    ExpGolomb, // Order-k Exp-Golomb. Code length grows with log(value), good for heavy tails.
+    Best       // Whichever of the above gives the smallest output, from the histogram.
+};
+
 // ========================================================
 // class Encoder:
 // ========================================================
@@ -50,16 +109,31 @@ public:
     Encoder();
     explicit Encoder(int initialSizeInBits, int growthGranularity = 2);
 
+    // Writes to a fixed caller buffer, which is never grown nor freed. Bits that
+    // don't fit are dropped and hasOverflowed() becomes true.
+    Encoder(std::uint8_t * buffer, int bufferSizeBytes);
+
     void encodeByte(int value, int KBits);
+    void encodeGolomb(int value, int M);
+    void encodeExpGolomb(int value, int k);
     void writeKBitsWord(std::uint32_t KBits, int bitCount);
+
+    // Same as calling encodeByte() for each input byte, but runs a
+    // loop specialized for the given KBits (0 to MaxKBits).
+    void encodeBlock(const std::uint8_t * input, int count, int KBits);
     void appendBit(int bit);
 
     static int computeCodeLength(int value, int KBits);
+    static int computeGolombCodeLength(int value, int M);
+    static int computeExpGolombCodeLength(int value, int k);
     static int findBestKBits(const std::uint8_t * input, int inSizeBytes, int KBitsMax, int * outBestSizeBits);
+    static int findBestGolombM(const std::uint8_t * input, int inSizeBytes, int * outBestSizeBits);
+    static int findBestExpGolombK(const std::uint8_t * input, int inSizeBytes, int * outBestSizeBits);
 
     int getByteCount() const;
     int getBitCount()  const;
     const std::uint8_t * getBitStream() const;
+    bool hasOverflowed() const { return overflowed; }
 
     void allocate(int bitsWanted);
     void setGranularity(int growthGranularity);
@@ -71,9 +145,14 @@ private:
 
     void internalInit();
     static int nextPowerOfTwo(int num);
+
+    // One instantiation per KBits value, picked by encodeBlock().
+    template<int K> void encodeBlockK(const std::uint8_t * input, int count);
     static std::uint8_t * allocBytes(int bytesWanted, std::uint8_t * oldPtr, int oldSize);
 
-    std::uint8_t * stream; // Growable buffer to store our bits. Heap allocated & owned by the class instance.
+    std::uint8_t * stream; // Growable buffer to store our bits. Heap allocated & owned by the class instance,
+                           // unless it is a fixed caller buffer (granularity is then zero).
+    bool overflowed;       // A fixed buffer ran out of space.
     int bytesAllocated;    // Current size of heap-allocated stream buffer *in bytes*.
     int granularity;       // Amount bytesAllocated multiplies by when auto-resizing in appendBit().
     int currBytePos;       // Current byte being written to, from 0 to bytesAllocated-1.
@@ -100,12 +179,28 @@ public:
     bool readNextBit(int & bitOut);
     int readKBitsWord(int bitCount);
 
+    // Reads a run of 1 bits and the terminating 0, returning the run length in q.
+    // False if the stream ended before the terminating bit was found.
+    bool readUnary(int & q);
+
+    // Decodes up to 'count' values coded with the given KBits (0 to MaxKBits).
+    // Returns the number decoded, which is less than 'count' if the stream ends.
+    int decodeBlock(std::uint8_t * output, int count, int KBits);
+
+    // Same as decodeBlock() for Golomb (M) and Exp-Golomb (k) coded values.
+    int decodeGolombBlock(std::uint8_t * output, int count, int M);
+    int decodeExpGolombBlock(std::uint8_t * output, int count, int k);
+
     int getByteCount() const { return sizeInBytes; }
     int getBitCount()  const { return sizeInBits;  }
+    int getBitsLeft()  const { return sizeInBits - numBitsRead; }
     const std::uint8_t * getBitStream() const { return stream; }
 
 private:
 
+    // One instantiation per KBits value, picked by decodeBlock().
+    template<int K> int decodeBlockK(std::uint8_t * output, int count);
+
     const std::uint8_t * stream; // Pointer to the external bit stream. Not owned by the reader.
     const int sizeInBytes;       // Size of the stream *in bytes*. Might include padding.
     const int sizeInBits;        // Size of the stream *in bits*, padding *not* include.
@@ -123,6 +218,12 @@ private:
 void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
                 std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits);
 
+// Same as above with a choice of coding mode. The parameter of the mode
+// is picked from the histogram of the input and stored in the stream,
+// so easyDecode() reads the output of both versions.
+void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits, Mode mode);
+
 // Decompress back the output of easyEncode().
 // The uncompressed output buffer is assumed to be big enough to hold the uncompressed data,
 // if it happens to be smaller, the decoder will return a partial output and the return value
@@ -130,6 +231,77 @@ void easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
 int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
                std::uint8_t * uncompressed, int uncompressedSizeBytes);
 
+// One piece of a scatter/gather output buffer, like a POSIX iovec.
+struct OutputSegment
+{
+    std::uint8_t * data;
+    int sizeBytes;
+};
+
+// Decompress straight into a list of buffers (e.g. network buffers or pages),
+// which are filled in order as if they were a single contiguous buffer.
+// Same return value as the contiguous easyDecode().
+int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+               const OutputSegment * outputSegments, int outputSegmentCount);
+
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+// Rice coding keeps a few words of state on each side, so there is no
+// workspace: easyDecode() already writes to caller buffers with no heap
+// use, and the easyEncode() below writes to a caller buffer too. Both use
+// under 3KB of stack. Mode::Rice and Mode::Best output always fits in
+// (uncompressedSizeBytes * 9 + 16) / 8 + 1 bytes; the encoder is fastest
+// with 9 bytes more than the output size.
+int workspaceSize(); // Always zero.
+
+// Returns the compressed size in bytes, or zero if the output buffer was
+// too small (RICE_ERROR() is called first). Same stream as the
+// heap-allocating easyEncode().
+int easyEncode(const std::uint8_t * uncompressed, int uncompressedSizeBytes,
+               std::uint8_t * compressed, int compressedCapacityBytes, int * compressedSizeBits,
+               Mode mode = Mode::Rice);
+
+// ========================================================
+// class WindowDecoder:
+// ========================================================
+
+// Decodes the output of easyEncode() one fixed-size window at a time,
+// so the data can be consumed while it is decoded and only a window of
+// it has to be kept in memory, instead of the whole uncompressed size.
+class WindowDecoder final
+{
+public:
+
+    static constexpr int DefaultWindowSizeBytes = 64 * 1024;
+
+    // No copy/assignment.
+    WindowDecoder(const WindowDecoder &) = delete;
+    WindowDecoder & operator = (const WindowDecoder &) = delete;
+
+    WindowDecoder(const std::uint8_t * compressed, int compressedSizeBytes, int compressedSizeBits,
+                  int windowSizeBytes = DefaultWindowSizeBytes);
+    ~WindowDecoder();
+
+    // Decodes the next window and points *window to it. Returns its size
+    // in bytes, which is only less than the window size for the last one,
+    // and 0 once the stream is over. The data stays valid until the next call.
+    int next(const std::uint8_t ** window);
+
+    // Total bytes returned by next() so far.
+    int getBytesDecoded() const { return bytesDecoded; }
+
+private:
+
+    Decoder bitStreamDecoder;
+    Mode mode;
+    int parameter;
+    std::uint8_t * buffer;
+    const int windowSize;
+    int bytesDecoded;
+};
+
 } // namespace rice {}
 
 // ================== End of header file ==================
@@ -149,6 +321,21 @@ int easyDecode(const std::uint8_t * compressed, int compressedSizeBytes, int com
 #endif // RICE_USING_DEFAULT_ERROR_HANDLER
 
 #include <cassert>
+#include <cstring>
+
+#if !defined(RICE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define RICE_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define RICE_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define RICE_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define RICE_X86_SIMD 0
+#endif // x86
 
 namespace rice
 {
@@ -169,6 +356,413 @@ void fatalError(const char * const message)
 
 #endif // RICE_USING_DEFAULT_ERROR_HANDLER
 
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef RICE_ENABLE_STATS
+    #define RICE_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !RICE_ENABLE_STATS
+    #define RICE_STATS_ADD(counter, amount) ((void)0)
+#endif // RICE_ENABLE_STATS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if RICE_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+// XCR0 tells us which register files the OS saves on context switches.
+static std::uint64_t readXCR0()
+{
+    #if defined(_MSC_VER)
+    return _xgetbv(0);
+    #else // GCC/Clang
+    std::uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (std::uint64_t(edx) << 32) | eax;
+    #endif // _MSC_VER
+}
+
+#endif // RICE_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if RICE_X86_SIMD
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+
+    // AVX2 code generation also needs OS support for the YMM state (XCR0).
+    const std::uint64_t xcr0 = ((regs[2] & (1u << 27)) != 0) ? readXCR0() : 0;
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.avx2 = avx && (xcr0 & 0x06) == 0x06 && (regs[1] & (1u << 5)) != 0;
+        features.bmi2 = (regs[1] & (1u << 3)) != 0 && (regs[1] & (1u << 8)) != 0; // BMI1 + BMI2
+    }
+    #endif // RICE_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Histogram:
+// ========================================================
+
+// Counts the occurrences of each byte value. Four interleaved sub-histograms
+// break the store-to-load dependency on repeated symbols (long runs of the
+// same byte would otherwise serialize on a single counter). There's no AVX2
+// or AVX-512 variant since scatter/gather based histograms are no faster.
+static void histogramScalar(const std::uint8_t * data, const int dataSizeBytes, std::uint32_t * counts)
+{
+    std::uint32_t banks[4][256];
+    std::memset(banks, 0, sizeof(banks));
+
+    int i = 0;
+    for (; i + 4 <= dataSizeBytes; i += 4)
+    {
+        ++banks[0][data[i + 0]];
+        ++banks[1][data[i + 1]];
+        ++banks[2][data[i + 2]];
+        ++banks[3][data[i + 3]];
+    }
+    for (; i < dataSizeBytes; ++i)
+    {
+        ++banks[0][data[i]];
+    }
+
+    for (int s = 0; s < 256; ++s)
+    {
+        counts[s] = banks[0][s] + banks[1][s] + banks[2][s] + banks[3][s];
+    }
+}
+
+// ========================================================
+// Bit packing kernels:
+// ========================================================
+
+// Bit streams are filled from the least significant bit of each byte,
+// so an unaligned little-endian 64-bit load lines up a window of bits
+// we can shift and mask in one go rather than looping bit by bit.
+// The kernels handle up to MaxFastBits bits per call and need 8 valid
+// bytes starting at the byte that contains bitPos.
+constexpr int MaxFastBits = 57;
+
+static std::uint64_t loadU64(const std::uint8_t * bytes)
+{
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    return word;
+}
+
+static void storeU64(std::uint8_t * bytes, std::uint64_t word)
+{
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    std::memcpy(bytes, &word, sizeof(word));
+}
+
+static std::uint64_t peekBitsScalar(const std::uint8_t * stream, const int bitPos, const int bitCount)
+{
+    const std::uint64_t word = loadU64(stream + (bitPos >> 3)) >> (bitPos & 7);
+    return word & ((std::uint64_t(1) << bitCount) - 1);
+}
+
+static void pokeBitsScalar(std::uint8_t * stream, const int bitPos, const std::uint64_t num, const int bitCount)
+{
+    const int shift = bitPos & 7;
+    const std::uint64_t mask = ((std::uint64_t(1) << bitCount) - 1) << shift;
+    std::uint8_t * bytes = stream + (bitPos >> 3);
+    storeU64(bytes, (loadU64(bytes) & ~mask) | ((num << shift) & mask));
+}
+
+#if RICE_X86_SIMD && (defined(__x86_64__) || defined(_M_X64))
+
+// Same as above, but bzhi does the masking and the variable
+// shifts compile to shrx/shlx (no flags, no CL register).
+RICE_TARGET("bmi,bmi2")
+static std::uint64_t peekBitsBMI2(const std::uint8_t * stream, const int bitPos, const int bitCount)
+{
+    const std::uint64_t word = loadU64(stream + (bitPos >> 3));
+    return _bzhi_u64(word >> (bitPos & 7), static_cast<unsigned>(bitCount));
+}
+
+RICE_TARGET("bmi,bmi2")
+static void pokeBitsBMI2(std::uint8_t * stream, const int bitPos, const std::uint64_t num, const int bitCount)
+{
+    const int shift = bitPos & 7;
+    const std::uint64_t mask = _bzhi_u64(~std::uint64_t(0), static_cast<unsigned>(bitCount)) << shift;
+    std::uint8_t * bytes = stream + (bitPos >> 3);
+    storeU64(bytes, (loadU64(bytes) & ~mask) | (_bzhi_u64(num, static_cast<unsigned>(bitCount)) << shift));
+}
+
+#endif // RICE_X86_SIMD && x64
+
+// Unary codes are runs of 1 bits terminated by a 0, so the length
+// of a run is the count of trailing zeros of the inverted word.
+static int countTrailingOnesScalar(const std::uint64_t word)
+{
+    #if defined(__GNUC__)
+    return __builtin_ctzll(~word);
+    #else // !__GNUC__
+    int count = 0;
+    for (std::uint64_t w = word; (w & 1) != 0; w >>= 1)
+    {
+        ++count;
+    }
+    return count;
+    #endif // __GNUC__
+}
+
+#if RICE_X86_SIMD && (defined(__x86_64__) || defined(_M_X64))
+
+RICE_TARGET("bmi")
+static int countTrailingOnesBMI(const std::uint64_t word)
+{
+    return static_cast<int>(_tzcnt_u64(~word));
+}
+
+#endif // RICE_X86_SIMD && x64
+
+// ========================================================
+// Code word kernels:
+// ========================================================
+
+// The Rice code of a byte: q = value >> K ones, a 0, then the K bits
+// remainder reversed, 'length' = q+1+K bits in total. Only codes of up
+// to 32 bits are built here; longer ones take the Encoder's slow path.
+constexpr int MaxPackedCodeBits = 32;
+
+#if RICE_X86_SIMD
+
+// Builds the codes and lengths of 8 values per step, in 32-bit lanes.
+// Stops before the first group of 8 holding a code longer than
+// MaxPackedCodeBits, and before a tail of less than 8 values.
+// Returns the number of values done.
+RICE_TARGET("avx2")
+static int makeCodesAVX2(const std::uint8_t * input, const int count, const int K,
+                         std::uint32_t * codes, std::uint8_t * lengths)
+{
+    const __m128i kShift       = _mm_cvtsi32_si128(K);
+    const __m128i reverseShift = _mm_cvtsi32_si128(8 - K);
+    const __m256i one          = _mm256_set1_epi32(1);
+    const __m256i lengthBias   = _mm256_set1_epi32(1 + K);
+    const __m256i maxLength    = _mm256_set1_epi32(MaxPackedCodeBits);
+    const __m256i lowNibble    = _mm256_set1_epi32(0x0F);
+    const __m256i remMask      = _mm256_set1_epi32((1 << K) - 1);
+
+    // Bit reversed nibbles. The lanes only hold a byte, so
+    // the zero upper bytes look up entry 0 and stay zero.
+    const __m256i reverseNibble = _mm256_setr_epi8(
+        0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15,
+        0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15);
+
+    // Gathers byte 0 of each 32-bit lane into the low 8 bytes of each 128-bit half.
+    const __m256i packLengths = _mm256_setr_epi8(
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i bytes  = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(input + i));
+        const __m256i values = _mm256_cvtepu8_epi32(bytes);
+        const __m256i q      = _mm256_srl_epi32(values, kShift);
+        const __m256i length = _mm256_add_epi32(q, lengthBias);
+
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(length, maxLength)) != 0)
+        {
+            break;
+        }
+
+        // Remainder reversed a nibble at a time, then shifted down to K bits.
+        const __m256i r       = _mm256_and_si256(values, remMask);
+        const __m256i revLow  = _mm256_shuffle_epi8(reverseNibble, _mm256_and_si256(r, lowNibble));
+        const __m256i revHigh = _mm256_shuffle_epi8(reverseNibble, _mm256_srli_epi32(r, 4));
+        const __m256i rev     = _mm256_srl_epi32(_mm256_or_si256(_mm256_slli_epi32(revLow, 4), revHigh), reverseShift);
+
+        // q ones, then the remainder past the terminating zero. The shifts by 32
+        // (q = 31, K = 0) give zero, which is what both terms want.
+        const __m256i ones = _mm256_sub_epi32(_mm256_sllv_epi32(one, q), one);
+        const __m256i code = _mm256_or_si256(ones, _mm256_sllv_epi32(rev, _mm256_add_epi32(q, one)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(codes + i), code);
+
+        const __m256i packed = _mm256_shuffle_epi8(length, packLengths);
+        const std::uint32_t low  = static_cast<std::uint32_t>(_mm256_extract_epi32(packed, 0));
+        const std::uint32_t high = static_cast<std::uint32_t>(_mm256_extract_epi32(packed, 4));
+        std::memcpy(lengths + i,     &low,  sizeof(low));
+        std::memcpy(lengths + i + 4, &high, sizeof(high));
+    }
+    return i;
+}
+
+#endif // RICE_X86_SIMD
+
+// Packs codes of up to MaxPackedCodeBits into a 64-bit accumulator that
+// goes out 32 bits at a time, so the stream sees plain stores rather than
+// a read-modify-write per code. Writes up to 8 bytes past the last code.
+class BitPacker final
+{
+public:
+
+    BitPacker(std::uint8_t * stream, const int bitPos)
+        : start(stream)
+        , out(stream + (bitPos >> 3))
+        , accum(*out & ((1u << (bitPos & 7)) - 1))
+        , accumBits(bitPos & 7)
+    { }
+
+    void put(const std::uint32_t code, const int length)
+    {
+        accum |= std::uint64_t(code) << accumBits;
+        accumBits += length;
+
+        // Branch free flush of the low 32 bits once we have them.
+        storeU64(out, accum);
+        const int flush = accumBits & 32;
+        out       += flush >> 3;
+        accum    >>= flush;
+        accumBits -= flush;
+    }
+
+    // Returns the bit position just past the last code.
+    int finish()
+    {
+        storeU64(out, accum);
+        return static_cast<int>(out - start) * 8 + accumBits;
+    }
+
+private:
+
+    std::uint8_t * start;
+    std::uint8_t * out;
+    std::uint64_t accum;
+    int accumBits;
+};
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+struct Kernels
+{
+    std::uint64_t (*peekBits)(const std::uint8_t * stream, int bitPos, int bitCount);
+    void (*pokeBits)(std::uint8_t * stream, int bitPos, std::uint64_t num, int bitCount);
+    int (*countTrailingOnes)(std::uint64_t word);
+
+    // Null when there's no vector version. The per-K scalar encoders
+    // build the codes inline, which beats a scalar version of this.
+    int (*makeCodes)(const std::uint8_t * input, int count, int K, std::uint32_t * codes, std::uint8_t * lengths);
+};
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.peekBits          = &peekBitsScalar;
+    kernels.pokeBits          = &pokeBitsScalar;
+    kernels.countTrailingOnes = &countTrailingOnesScalar;
+    kernels.makeCodes         = nullptr;
+
+    #if RICE_X86_SIMD
+    if (features.avx2)
+    {
+        kernels.makeCodes = &makeCodesAVX2;
+    }
+    #endif // RICE_X86_SIMD
+
+    #if RICE_X86_SIMD && (defined(__x86_64__) || defined(_M_X64))
+    if (features.bmi2)
+    {
+        kernels.peekBits          = &peekBitsBMI2;
+        kernels.pokeBits          = &pokeBitsBMI2;
+        kernels.countTrailingOnes = &countTrailingOnesBMI;
+    }
+    #else // !x64
+    (void)features;
+    #endif // RICE_X86_SIMD && x64
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.avx2 = features.avx2 && detected.avx2;
+    current.bmi2 = features.bmi2 && detected.bmi2;
+
+    kernelsInstance() = selectKernels(current);
+}
+
+// ========================================================
+
+// The K bits remainder is stored most significant bit first, which is
+// the reverse of the stream order. Flip the low 'bitCount' (<= 8) bits
+// of 'value' so it can be written/read as a single word. Bit-hack from:
+// http://graphics.stanford.edu/~seander/bithacks.html#ReverseByteWith64Bits
+static std::uint32_t reverseBits(const std::uint32_t value, const int bitCount)
+{
+    assert(bitCount <= 8);
+    const std::uint64_t reversed = (((value * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL >> 32) & 0xFF;
+    return static_cast<std::uint32_t>(reversed >> (8 - bitCount));
+}
+
 // ========================================================
 // class Encoder:
 // ========================================================
@@ -188,9 +782,17 @@ Encoder::Encoder(const int initialSizeInBits, const int growthGranularity)
     allocate(initialSizeInBits);
 }
 
+Encoder::Encoder(std::uint8_t * buffer, const int bufferSizeBytes)
+{
+    internalInit();
+    stream         = buffer;
+    bytesAllocated = (buffer != nullptr && bufferSizeBytes > 0) ? bufferSizeBytes : 0;
+    granularity    = 0;
+}
+
 Encoder::~Encoder()
 {
-    if (stream != nullptr)
+    if (stream != nullptr && granularity != 0)
     {
         RICE_MFREE(stream);
     }
@@ -199,6 +801,7 @@ Encoder::~Encoder()
 void Encoder::internalInit()
 {
     stream         = nullptr;
+    overflowed     = false;
     bytesAllocated = 0;
     granularity    = 2;
     currBytePos    = 0;
@@ -209,20 +812,130 @@ void Encoder::internalInit()
 void Encoder::encodeByte(const int value, const int KBits)
 {
     const int m = 1 << KBits;
-    const int q = value / m;
+    int q = value / m;
 
     // Write the quotient code (q 1 bits followed by a terminating 0)
-    for (int i = 0; i < q; ++i)
+    for (; q >= 32; q -= 32)
     {
-        appendBit(1);
+        writeKBitsWord(0xFFFFFFFF, 32);
     }
-    appendBit(0);
+    writeKBitsWord((std::uint32_t(1) << q) - 1, q + 1);
 
     // Write the reminder (last k bits of the value)
-    for (int i = KBits - 1; i >= 0; i--)
+    writeKBitsWord(reverseBits(value & (m - 1), KBits), KBits);
+}
+
+void Encoder::encodeBlock(const std::uint8_t * input, const int count, const int KBits)
+{
+    using EncodeBlockFunc = void (Encoder::*)(const std::uint8_t *, int);
+    static const EncodeBlockFunc encodeBlockFuncs[MaxKBits + 1] = {
+        &Encoder::encodeBlockK<0>, &Encoder::encodeBlockK<1>, &Encoder::encodeBlockK<2>,
+        &Encoder::encodeBlockK<3>, &Encoder::encodeBlockK<4>, &Encoder::encodeBlockK<5>,
+        &Encoder::encodeBlockK<6>, &Encoder::encodeBlockK<7>, &Encoder::encodeBlockK<8>
+    };
+
+    assert(input != nullptr);
+    assert(KBits >= 0 && KBits <= MaxKBits);
+
+    // One pass to size the output exactly, so the loops below never check
+    // for room. Plus the 8 bytes the packer and kernels touch past the end.
+    std::int64_t bitsNeeded = std::int64_t(count) * (1 + KBits);
+    for (int i = 0; i < count; ++i)
     {
-        appendBit((value >> i) & 1);
+        bitsNeeded += input[i] >> KBits;
     }
+    const std::int64_t bitsWanted = (numBitsWritten + bitsNeeded + 72 + 7) & ~7;
+    if (granularity == 0 && bitsWanted / 8 > bytesAllocated)
+    {
+        // A fixed buffer without the slack: one checked write at a time.
+        for (int i = 0; i < count; ++i)
+        {
+            encodeByte(input[i], KBits);
+        }
+        return;
+    }
+    allocate(static_cast<int>(bitsWanted));
+
+    const auto makeCodes = kernelsInstance().makeCodes;
+    if (makeCodes == nullptr)
+    {
+        (this->*encodeBlockFuncs[KBits])(input, count);
+        return;
+    }
+
+    // Codes and lengths built by the vector kernel a batch at a time, then packed.
+    constexpr int BatchSize = 256;
+    std::uint32_t codes[BatchSize];
+    std::uint8_t lengths[BatchSize];
+
+    int i = 0;
+    while (i < count)
+    {
+        const int batch = (count - i < BatchSize) ? count - i : BatchSize;
+        const int done  = makeCodes(input + i, batch, KBits, codes, lengths);
+
+        BitPacker packer(stream, numBitsWritten);
+        for (int c = 0; c < done; ++c)
+        {
+            packer.put(codes[c], lengths[c]);
+        }
+        numBitsWritten = packer.finish();
+        i += done;
+
+        // The kernel left out a group with a long code or the tail.
+        if (done < batch)
+        {
+            const int rest = (count - i < 8) ? count - i : 8;
+            (this->*encodeBlockFuncs[KBits])(input + i, rest);
+            i += rest;
+        }
+    }
+
+    currBytePos = numBitsWritten >> 3;
+    nextBitPos  = numBitsWritten & 7;
+}
+
+template<int K>
+void Encoder::encodeBlockK(const std::uint8_t * input, const int count)
+{
+    // With K known at compile time the divide by m is a shift and
+    // the remainder mask and bit reversal fold into constants.
+    // Room for the codes was reserved by encodeBlock().
+    constexpr std::uint32_t RemainderMask = (std::uint32_t(1) << K) - 1;
+
+    BitPacker packer(stream, numBitsWritten);
+    for (int i = 0; i < count; ++i)
+    {
+        const int value = input[i];
+        const int q = value >> K;
+        const int length = q + 1 + K;
+
+        if (length <= MaxPackedCodeBits)
+        {
+            const std::uint64_t code = ((std::uint64_t(1) << q) - 1) |
+                                       (std::uint64_t(reverseBits(value & RemainderMask, K)) << (q + 1));
+            packer.put(static_cast<std::uint32_t>(code), length);
+            continue;
+        }
+
+        // Long quotients only happen for small K with large values.
+        numBitsWritten = packer.finish();
+        int longQ = q;
+        for (; longQ >= 32; longQ -= 32)
+        {
+            pokeBitsScalar(stream, numBitsWritten, 0xFFFFFFFF, 32);
+            numBitsWritten += 32;
+        }
+        const std::uint64_t code = ((std::uint64_t(1) << longQ) - 1) |
+                                   (std::uint64_t(reverseBits(value & RemainderMask, K)) << (longQ + 1));
+        pokeBitsScalar(stream, numBitsWritten, code, longQ + 1 + K);
+        numBitsWritten += longQ + 1 + K;
+        packer = BitPacker(stream, numBitsWritten);
+    }
+
+    numBitsWritten = packer.finish();
+    currBytePos = numBitsWritten >> 3;
+    nextBitPos  = numBitsWritten & 7;
 }
 
 int Encoder::computeCodeLength(const int value, const int KBits)
@@ -232,46 +945,168 @@ int Encoder::computeCodeLength(const int value, const int KBits)
     return q + 1 + KBits;
 }
 
-int Encoder::findBestKBits(const std::uint8_t * input, const int inSizeBytes, const int KBitsMax, int * outBestSizeBits)
+// ========================================================
+
+// Truncated binary code of the remainders 0 to M-1: with b = ceil(log2(M)),
+// the first u = 2^b - M remainders use b-1 bits and the others b bits
+// (as r + u). Same as plain binary when M is a power of two.
+static int golombRemainderBits(const int M)
+{
+    int b = 0;
+    while ((1 << b) < M)
+    {
+        ++b;
+    }
+    return b;
+}
+
+static int floorLog2(int value)
+{
+    int log = 0;
+    while (value >>= 1)
+    {
+        ++log;
+    }
+    return log;
+}
+
+void Encoder::encodeGolomb(const int value, const int M)
+{
+    assert(M >= 1 && M <= MaxGolombM);
+
+    int q = value / M;
+    const int r = value % M;
+
+    // Quotient in unary, same as Rice:
+    for (; q >= 32; q -= 32)
+    {
+        writeKBitsWord(0xFFFFFFFF, 32);
+    }
+    writeKBitsWord((std::uint32_t(1) << q) - 1, q + 1);
+
+    // Truncated binary remainder, most significant bit first:
+    const int b = golombRemainderBits(M);
+    const int u = (1 << b) - M;
+    if (r < u)
+    {
+        writeKBitsWord(reverseBits(r, b - 1), b - 1);
+    }
+    else
+    {
+        writeKBitsWord(reverseBits(r + u, b), b);
+    }
+}
+
+void Encoder::encodeExpGolomb(const int value, const int k)
+{
+    assert(k >= 0 && k <= MaxKBits);
+
+    // w has L+1 significant bits. The unary part tells the decoder
+    // L-k, and the low L bits of w follow, most significant first.
+    const int w = value + (1 << k);
+    const int L = floorLog2(w);
+    const int q = L - k;
+
+    writeKBitsWord((std::uint32_t(1) << q) - 1, q + 1);
+    writeKBitsWord(reverseBits(w & ((1 << L) - 1), L), L);
+}
+
+int Encoder::computeGolombCodeLength(const int value, const int M)
+{
+    const int b = golombRemainderBits(M);
+    const int u = (1 << b) - M;
+    return value / M + 1 + ((value % M < u) ? b - 1 : b);
+}
+
+int Encoder::computeExpGolombCodeLength(const int value, const int k)
+{
+    const int L = floorLog2(value + (1 << k));
+    return (L - k) + 1 + L;
+}
+
+// Best parameter in [first, last] for the given code length function. Sizes come from
+// the byte histogram, so each candidate costs 256 steps rather than a pass over the input.
+static int findBestParameter(const std::uint8_t * input, const int inSizeBytes, const int first, const int last,
+                             int (*codeLength)(int, int), int * outBestSizeBits)
 {
     assert(input != nullptr);
     assert(outBestSizeBits != nullptr);
 
-    int bestKBits = 0;
-    int bestSize  = 0;
+    std::uint32_t counts[256];
+    histogramScalar(input, inSizeBytes, counts);
 
-    for (int k = 0; k <= KBitsMax; ++k)
+    int bestParameter = first;
+    std::int64_t bestSize = -1;
+
+    for (int p = first; p <= last; ++p)
     {
-        int outputSize = 0;
-        for (int i = 0; i < inSizeBytes; ++i)
+        std::int64_t outputSize = 0;
+        for (int v = 0; v < 256; ++v)
         {
-            outputSize += computeCodeLength(input[i], k);
+            outputSize += static_cast<std::int64_t>(counts[v]) * codeLength(v, p);
         }
 
-        if (bestSize == 0 || outputSize < bestSize)
+        if (bestSize < 0 || outputSize < bestSize)
         {
             bestSize = outputSize;
-            bestKBits = k;
+            bestParameter = p;
         }
     }
 
-    *outBestSizeBits = bestSize;
-    return bestKBits;
+    *outBestSizeBits = static_cast<int>(bestSize);
+    return bestParameter;
+}
+
+int Encoder::findBestKBits(const std::uint8_t * input, const int inSizeBytes, const int KBitsMax, int * outBestSizeBits)
+{
+    return findBestParameter(input, inSizeBytes, 0, KBitsMax, &Encoder::computeCodeLength, outBestSizeBits);
+}
+
+int Encoder::findBestGolombM(const std::uint8_t * input, const int inSizeBytes, int * outBestSizeBits)
+{
+    return findBestParameter(input, inSizeBytes, 1, MaxGolombM, &Encoder::computeGolombCodeLength, outBestSizeBits);
+}
+
+int Encoder::findBestExpGolombK(const std::uint8_t * input, const int inSizeBytes, int * outBestSizeBits)
+{
+    return findBestParameter(input, inSizeBytes, 0, MaxKBits, &Encoder::computeExpGolombCodeLength, outBestSizeBits);
 }
 
 void Encoder::writeKBitsWord(const std::uint32_t KBits, const int bitCount)
 {
     assert(bitCount <= 32);
-    for (int b = 0; b < bitCount; ++b)
+
+    // The kernel touches 8 bytes, and appendBit() expects
+    // the current byte to be valid afterwards, so need 9.
+    while (currBytePos + 9 > bytesAllocated)
     {
-        const std::uint32_t mask = std::uint32_t(1) << b;
-        const int bit = !!(KBits & mask);
-        appendBit(bit);
+        if (granularity == 0)
+        {
+            // Last few bytes of a fixed buffer.
+            for (int b = 0; b < bitCount; ++b)
+            {
+                appendBit(static_cast<int>((KBits >> b) & 1));
+            }
+            return;
+        }
+        allocate(bytesAllocated * granularity * 8);
     }
+
+    kernelsInstance().pokeBits(stream, numBitsWritten, KBits, bitCount);
+    numBitsWritten += bitCount;
+    currBytePos = numBitsWritten >> 3;
+    nextBitPos  = numBitsWritten & 7;
 }
 
 void Encoder::appendBit(const int bit)
 {
+    // Only a fixed buffer can be full here.
+    if (currBytePos == bytesAllocated)
+    {
+        overflowed = true;
+        return;
+    }
+
     const std::uint32_t mask = std::uint32_t(1) << nextBitPos;
     stream[currBytePos] = (stream[currBytePos] & ~mask) | (-bit & mask);
     ++numBitsWritten;
@@ -279,7 +1114,7 @@ void Encoder::appendBit(const int bit)
     if (++nextBitPos == 8)
     {
         nextBitPos = 0;
-        if (++currBytePos == bytesAllocated)
+        if (++currBytePos == bytesAllocated && granularity != 0)
         {
             allocate(bytesAllocated * granularity * 8);
         }
@@ -310,7 +1145,10 @@ const std::uint8_t * Encoder::getBitStream() const
 
 void Encoder::setGranularity(const int growthGranularity)
 {
-    granularity = (growthGranularity >= 2) ? growthGranularity : 2;
+    if (granularity != 0)
+    {
+        granularity = (growthGranularity >= 2) ? growthGranularity : 2;
+    }
 }
 
 std::uint8_t * Encoder::release()
@@ -340,7 +1178,13 @@ void Encoder::allocate(int bitsWanted)
     {
         return;
     }
+    if (granularity == 0)
+    {
+        overflowed = true;
+        return;
+    }
 
+    RICE_STATS_ADD(allocatorGrowths, stream != nullptr);
     stream = allocBytes(sizeInBytes, stream, bytesAllocated);
     bytesAllocated = sizeInBytes;
 }
@@ -416,6 +1260,17 @@ int Decoder::readKBitsWord(const int bitCount)
 {
     assert(bitCount <= 32);
 
+    // Fast path: grab the whole thing with a single kernel call
+    // when there are enough bytes left for its 64-bit load.
+    if (numBitsRead + bitCount <= sizeInBits && currBytePos + 8 <= sizeInBytes)
+    {
+        const std::uint64_t num = kernelsInstance().peekBits(stream, numBitsRead, bitCount);
+        numBitsRead += bitCount;
+        currBytePos = numBitsRead >> 3;
+        nextBitPos  = numBitsRead & 7;
+        return static_cast<int>(num);
+    }
+
     std::uint32_t num = 0;
     for (int b = 0; b < bitCount; ++b)
     {
@@ -435,12 +1290,321 @@ int Decoder::readKBitsWord(const int bitCount)
     return static_cast<int>(num);
 }
 
+bool Decoder::readUnary(int & q)
+{
+    q = 0;
+    const auto & kernels = kernelsInstance();
+
+    // Count the 1 bits up to MaxFastBits at a time:
+    while (numBitsRead < sizeInBits && currBytePos + 8 <= sizeInBytes)
+    {
+        const int windowBits = (sizeInBits - numBitsRead < MaxFastBits) ? (sizeInBits - numBitsRead) : MaxFastBits;
+        const std::uint64_t window = kernels.peekBits(stream, numBitsRead, windowBits);
+
+        // Bits above the window are zero, so this is never more than windowBits.
+        const int ones = kernels.countTrailingOnes(window);
+        const int consumed = (ones < windowBits) ? (ones + 1) : ones;
+
+        q += ones;
+        numBitsRead += consumed;
+        currBytePos = numBitsRead >> 3;
+        nextBitPos  = numBitsRead & 7;
+
+        if (ones < windowBits)
+        {
+            return true; // Found the terminating 0.
+        }
+    }
+
+    // Near the end of the stream:
+    int bit;
+    while (readNextBit(bit))
+    {
+        if (bit == 0)
+        {
+            return true;
+        }
+        ++q;
+    }
+    return false;
+}
+
+int Decoder::decodeBlock(std::uint8_t * output, const int count, const int KBits)
+{
+    using DecodeBlockFunc = int (Decoder::*)(std::uint8_t *, int);
+    static const DecodeBlockFunc decodeBlockFuncs[MaxKBits + 1] = {
+        &Decoder::decodeBlockK<0>, &Decoder::decodeBlockK<1>, &Decoder::decodeBlockK<2>,
+        &Decoder::decodeBlockK<3>, &Decoder::decodeBlockK<4>, &Decoder::decodeBlockK<5>,
+        &Decoder::decodeBlockK<6>, &Decoder::decodeBlockK<7>, &Decoder::decodeBlockK<8>
+    };
+
+    assert(output != nullptr);
+    assert(KBits >= 0 && KBits <= MaxKBits);
+    return (this->*decodeBlockFuncs[KBits])(output, count);
+}
+
+template<int K>
+int Decoder::decodeBlockK(std::uint8_t * output, const int count)
+{
+    constexpr std::uint64_t RemainderMask = (std::uint64_t(1) << K) - 1;
+
+    int decoded = 0;
+    while (decoded < count && numBitsRead < sizeInBits)
+    {
+        // Fast path: the whole code out of one peek, while we can load
+        // 8 bytes. The peeked bits above the window read as zeros, so
+        // the count of trailing ones never runs past the window.
+        if ((numBitsRead >> 3) + 8 <= sizeInBytes)
+        {
+            const std::uint64_t window = peekBitsScalar(stream, numBitsRead, MaxFastBits);
+            const int q = countTrailingOnesScalar(window);
+            const int length = q + 1 + K;
+
+            if (length <= MaxFastBits && length <= sizeInBits - numBitsRead)
+            {
+                const std::uint32_t remainder = static_cast<std::uint32_t>((window >> (q + 1)) & RemainderMask);
+                output[decoded++] = static_cast<std::uint8_t>((q << K) | reverseBits(remainder, K));
+                numBitsRead += length;
+                continue;
+            }
+        }
+
+        // Long quotient or near the end of the stream.
+        currBytePos = numBitsRead >> 3;
+        nextBitPos  = numBitsRead & 7;
+
+        int q;
+        if (!readUnary(q) || getBitsLeft() < K)
+        {
+            RICE_ERROR("Failed to read bits from stream! Unexpected end.");
+            break;
+        }
+        output[decoded++] = static_cast<std::uint8_t>((q << K) | reverseBits(readKBitsWord(K), K));
+    }
+
+    currBytePos = numBitsRead >> 3;
+    nextBitPos  = numBitsRead & 7;
+    return decoded;
+}
+
+int Decoder::decodeGolombBlock(std::uint8_t * output, const int count, const int M)
+{
+    assert(output != nullptr);
+    assert(M >= 1 && M <= MaxGolombM);
+
+    const int b = golombRemainderBits(M);
+    const int u = (1 << b) - M;
+
+    int decoded = 0;
+    while (decoded < count && getBitsLeft() > 0)
+    {
+        int q;
+        if (!readUnary(q) || getBitsLeft() < b - 1)
+        {
+            RICE_ERROR("Failed to read bits from stream! Unexpected end.");
+            break;
+        }
+
+        // b-1 bits first, and one more if that's not a short remainder.
+        int r = 0;
+        if (b > 0)
+        {
+            r = static_cast<int>(reverseBits(readKBitsWord(b - 1), b - 1));
+            if (r >= u)
+            {
+                int bit;
+                if (!readNextBit(bit))
+                {
+                    RICE_ERROR("Failed to read bits from stream! Unexpected end.");
+                    break;
+                }
+                r = ((r << 1) | bit) - u;
+            }
+        }
+        output[decoded++] = static_cast<std::uint8_t>(q * M + r);
+    }
+    return decoded;
+}
+
+int Decoder::decodeExpGolombBlock(std::uint8_t * output, const int count, const int k)
+{
+    assert(output != nullptr);
+    assert(k >= 0 && k <= MaxKBits);
+
+    int decoded = 0;
+    while (decoded < count && getBitsLeft() > 0)
+    {
+        int q;
+        if (!readUnary(q) || q + k > MaxKBits || getBitsLeft() < q + k)
+        {
+            RICE_ERROR("Failed to read bits from stream! Unexpected end.");
+            break;
+        }
+
+        const int L = q + k;
+        const int w = (1 << L) | static_cast<int>(reverseBits(readKBitsWord(L), L));
+        output[decoded++] = static_cast<std::uint8_t>(w - (1 << k));
+    }
+    return decoded;
+}
+
+// ========================================================
+// Stream header:
+// ========================================================
+
+//
+// Rice streams start with their K in 4 bits (0 to 8). The other modes
+// start with the unused value 15 as an escape, followed by the mode in
+// 4 bits and its parameter in 8 bits (Golomb M-1 or Exp-Golomb k), so
+// streams written before the other modes existed still decode.
+//
+constexpr int ExtendedHeaderTag = 15;
+
+struct StreamHeader
+{
+    Mode mode;
+    int parameter; // K, M or k.
+};
+
+static void writeStreamHeader(Encoder & bitStreamEncoder, const StreamHeader & header)
+{
+    if (header.mode == Mode::Rice)
+    {
+        bitStreamEncoder.writeKBitsWord(header.parameter, 4);
+        return;
+    }
+
+    bitStreamEncoder.writeKBitsWord(ExtendedHeaderTag, 4);
+    bitStreamEncoder.writeKBitsWord(static_cast<std::uint32_t>(header.mode), 4);
+    bitStreamEncoder.writeKBitsWord(header.mode == Mode::Golomb ? header.parameter - 1 : header.parameter, 8);
+}
+
+static bool readStreamHeader(Decoder & bitStreamDecoder, StreamHeader & header)
+{
+    if (bitStreamDecoder.getBitsLeft() < 4)
+    {
+        return false;
+    }
+
+    const int tag = bitStreamDecoder.readKBitsWord(4);
+    if (tag != ExtendedHeaderTag)
+    {
+        header.mode      = Mode::Rice;
+        header.parameter = tag;
+        return tag <= MaxKBits;
+    }
+
+    if (bitStreamDecoder.getBitsLeft() < 12)
+    {
+        return false;
+    }
+
+    const int mode  = bitStreamDecoder.readKBitsWord(4);
+    const int param = bitStreamDecoder.readKBitsWord(8);
+    if (mode == static_cast<int>(Mode::Golomb))
+    {
+        header.mode      = Mode::Golomb;
+        header.parameter = param + 1;
+        return true;
+    }
+    if (mode == static_cast<int>(Mode::ExpGolomb))
+    {
+        header.mode      = Mode::ExpGolomb;
+        header.parameter = param;
+        return param <= MaxKBits;
+    }
+    return false;
+}
+
+static int decodeValues(Decoder & bitStreamDecoder, const StreamHeader & header,
+                        std::uint8_t * output, const int count)
+{
+    switch (header.mode)
+    {
+    case Mode::Golomb    : return bitStreamDecoder.decodeGolombBlock(output, count, header.parameter);
+    case Mode::ExpGolomb : return bitStreamDecoder.decodeExpGolombBlock(output, count, header.parameter);
+    default              : return bitStreamDecoder.decodeBlock(output, count, header.parameter);
+    } // switch
+}
+
 // ========================================================
 // easyEncode() implementation:
 // ========================================================
 
+// Picks the parameter(s) from the histogram. Rice is tried first and
+// kept on ties, since it has the fastest decoder and a smaller header.
+// Also gives the exact size of the coded values, header not included.
+static StreamHeader pickStreamHeader(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                                     const Mode mode, int & minCompressedBitSize)
+{
+    StreamHeader header = { Mode::Rice, 0 };
+    minCompressedBitSize = 0;
+    if (mode == Mode::Rice || mode == Mode::Best)
+    {
+        header.parameter = Encoder::findBestKBits(uncompressed, uncompressedSizeBytes, MaxKBits, &minCompressedBitSize);
+    }
+    if (mode == Mode::Golomb || mode == Mode::Best)
+    {
+        int golombBits;
+        const int M = Encoder::findBestGolombM(uncompressed, uncompressedSizeBytes, &golombBits);
+        if (mode == Mode::Golomb || golombBits + 12 < minCompressedBitSize)
+        {
+            header = { Mode::Golomb, M };
+            minCompressedBitSize = golombBits + 12;
+        }
+    }
+    if (mode == Mode::ExpGolomb || mode == Mode::Best)
+    {
+        int expGolombBits;
+        const int k = Encoder::findBestExpGolombK(uncompressed, uncompressedSizeBytes, &expGolombBits);
+        if (mode == Mode::ExpGolomb || expGolombBits + 12 < minCompressedBitSize)
+        {
+            header = { Mode::ExpGolomb, k };
+            minCompressedBitSize = expGolombBits + 12;
+        }
+    }
+    return header;
+}
+
+static void encodeValues(Encoder & bitStreamEncoder, const StreamHeader & header,
+                         const std::uint8_t * uncompressed, const int uncompressedSizeBytes)
+{
+    writeStreamHeader(bitStreamEncoder, header);
+
+    // Encode each byte of the input:
+    switch (header.mode)
+    {
+    case Mode::Golomb :
+        for (int b = 0; b < uncompressedSizeBytes; ++b)
+        {
+            bitStreamEncoder.encodeGolomb(uncompressed[b], header.parameter);
+        }
+        break;
+    case Mode::ExpGolomb :
+        for (int b = 0; b < uncompressedSizeBytes; ++b)
+        {
+            bitStreamEncoder.encodeExpGolomb(uncompressed[b], header.parameter);
+        }
+        break;
+    default :
+        bitStreamEncoder.encodeBlock(uncompressed, uncompressedSizeBytes, header.parameter);
+        RICE_STATS_ADD(kBitsSelected[header.parameter], 1);
+        break;
+    } // switch
+
+    RICE_STATS_ADD(encodeCalls, 1);
+    RICE_STATS_ADD(bytesEncoded, uncompressedSizeBytes);
+    RICE_STATS_ADD(bitsWritten, bitStreamEncoder.getBitCount());
+}
+
 void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
                 std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits)
+{
+    easyEncode(uncompressed, uncompressedSizeBytes, compressed, compressedSizeBytes, compressedSizeBits, Mode::Rice);
+}
+
+void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+                std::uint8_t ** compressed, int * compressedSizeBytes, int * compressedSizeBits, const Mode mode)
 {
     if (uncompressed == nullptr || compressed == nullptr)
     {
@@ -454,21 +1618,13 @@ void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeByt
         return;
     }
 
-    // Do up to 8 passes to try finding the best K number of bits for the encoding.
     int minCompressedBitSize;
-    const int KBits = Encoder::findBestKBits(uncompressed, uncompressedSizeBytes, 8, &minCompressedBitSize);
-
-    Encoder bitStreamEncoder(minCompressedBitSize);
+    const StreamHeader header = pickStreamHeader(uncompressed, uncompressedSizeBytes, mode, minCompressedBitSize);
 
-    // The decoder needs to know the number of bits we've used.
-    // Since the max is 8, we only need up to 4 bits for that.
-    bitStreamEncoder.writeKBitsWord(KBits, 4);
-
-    // Encode each byte of the input:
-    for (int b = 0; b < uncompressedSizeBytes; ++b)
-    {
-        bitStreamEncoder.encodeByte(uncompressed[b], KBits);
-    }
+    // Room for the (up to 16 bits) header and the 8 bytes touched past
+    // the end by the word writes, so we never need to resize.
+    Encoder bitStreamEncoder(minCompressedBitSize + 16 + 72);
+    encodeValues(bitStreamEncoder, header, uncompressed, uncompressedSizeBytes);
 
     // Pass ownership of the compressed data buffer to the user pointer:
     *compressedSizeBytes = bitStreamEncoder.getByteCount();
@@ -476,6 +1632,126 @@ void easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeByt
     *compressed          = bitStreamEncoder.release();
 }
 
+// ========================================================
+// Low-memory profile:
+// ========================================================
+
+int workspaceSize()
+{
+    return 0;
+}
+
+int easyEncode(const std::uint8_t * uncompressed, const int uncompressedSizeBytes,
+               std::uint8_t * compressed, const int compressedCapacityBytes, int * compressedSizeBits,
+               const Mode mode)
+{
+    if (uncompressed == nullptr || compressed == nullptr || compressedSizeBits == nullptr)
+    {
+        RICE_ERROR("rice::easyEncode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    if (uncompressedSizeBytes <= 0 || compressedCapacityBytes <= 0)
+    {
+        RICE_ERROR("rice::easyEncode(): Bad in/out sizes!");
+        return 0;
+    }
+
+    int minCompressedBitSize;
+    const StreamHeader header = pickStreamHeader(uncompressed, uncompressedSizeBytes, mode, minCompressedBitSize);
+
+    Encoder bitStreamEncoder(compressed, compressedCapacityBytes);
+    encodeValues(bitStreamEncoder, header, uncompressed, uncompressedSizeBytes);
+
+    if (bitStreamEncoder.hasOverflowed())
+    {
+        RICE_ERROR("rice::easyEncode(): Output buffer too small!");
+        return 0;
+    }
+
+    *compressedSizeBits = bitStreamEncoder.getBitCount();
+    return bitStreamEncoder.getByteCount();
+}
+
+// ========================================================
+// Scatter/gather output:
+// ========================================================
+
+// Gives decodeValues() the OutputSegments one at a time, skipping empty ones.
+class SegmentWriter final
+{
+public:
+
+    // No copy/assignment.
+    SegmentWriter(const SegmentWriter &) = delete;
+    SegmentWriter & operator = (const SegmentWriter &) = delete;
+
+    SegmentWriter(const OutputSegment * outputSegments, const int outputSegmentCount)
+        : segments(outputSegments)
+        , segmentCount(outputSegmentCount)
+        , nextSegment(0)
+        , cursor(nullptr)
+        , segmentEnd(nullptr)
+    { }
+
+    // Sum of the segment sizes, or -1 if a segment is malformed.
+    static int countBytes(const OutputSegment * outputSegments, const int outputSegmentCount)
+    {
+        std::int64_t total = 0;
+        for (int s = 0; s < outputSegmentCount; ++s)
+        {
+            if (outputSegments[s].sizeBytes < 0 || (outputSegments[s].sizeBytes > 0 && outputSegments[s].data == nullptr))
+            {
+                return -1;
+            }
+            total += outputSegments[s].sizeBytes;
+        }
+        return (total <= 0x7FFFFFFF) ? static_cast<int>(total) : -1;
+    }
+
+    // Free space left in the current segment, moving to the next
+    // one if it is full. Write there, then call commit() with the
+    // number of bytes written. Null if all the segments are full.
+    std::uint8_t * getWindow(int & windowSize)
+    {
+        if (cursor == segmentEnd && !advance())
+        {
+            windowSize = 0;
+            return nullptr;
+        }
+        windowSize = static_cast<int>(segmentEnd - cursor);
+        return cursor;
+    }
+    void commit(const int bytesWritten)
+    {
+        assert(bytesWritten <= segmentEnd - cursor);
+        cursor += bytesWritten;
+    }
+
+private:
+
+    bool advance()
+    {
+        while (nextSegment < segmentCount)
+        {
+            const OutputSegment & segment = segments[nextSegment++];
+            if (segment.sizeBytes > 0)
+            {
+                cursor     = segment.data;
+                segmentEnd = segment.data + segment.sizeBytes;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const OutputSegment * segments;
+    const int segmentCount;
+    int nextSegment;             // Index of the segment after the current one.
+    std::uint8_t * cursor;       // Write position in the current segment.
+    std::uint8_t * segmentEnd;
+};
+
 // ========================================================
 // easyDecode() implementation:
 // ========================================================
@@ -489,52 +1765,120 @@ int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, c
         return 0;
     }
 
+    const OutputSegment segment = { uncompressed, uncompressedSizeBytes };
+    return easyDecode(compressed, compressedSizeBytes, compressedSizeBits, &segment, 1);
+}
+
+int easyDecode(const std::uint8_t * compressed, const int compressedSizeBytes, const int compressedSizeBits,
+               const OutputSegment * outputSegments, const int outputSegmentCount)
+{
+    if (compressed == nullptr || outputSegments == nullptr)
+    {
+        RICE_ERROR("rice::easyDecode(): Null data pointer(s)!");
+        return 0;
+    }
+
+    const int uncompressedSizeBytes = SegmentWriter::countBytes(outputSegments, outputSegmentCount);
     if (compressedSizeBytes <= 0 || compressedSizeBits <= 0 || uncompressedSizeBytes <= 0)
     {
         RICE_ERROR("rice::easyDecode(): Bad in/out sizes!");
         return 0;
     }
 
+    SegmentWriter output(outputSegments, outputSegmentCount);
+
     Decoder bitStreamDecoder(compressed, compressedSizeBytes, compressedSizeBits);
 
-    // KBits word length is fixed to 4 bits.
-    const int KBits = bitStreamDecoder.readKBitsWord(4);
-    const int m = 1 << KBits;
+    StreamHeader header;
+    if (!readStreamHeader(bitStreamDecoder, header))
+    {
+        RICE_ERROR("rice::easyDecode(): Bad stream header!");
+        return 0;
+    }
 
+    // Decode straight into each output segment until the buffer is full.
     int bytesDecoded = 0;
-    for (;;)
+    while (bytesDecoded < uncompressedSizeBytes)
     {
-        int q   = 0;
-        int bit = 0;
+        int windowSize = 0;
+        std::uint8_t * window = output.getWindow(windowSize);
 
-        // Reconstruct q:
-        while (bitStreamDecoder.readNextBit(bit) && (bit == 1))
-        {
-            ++q;
-        }
+        const int count = decodeValues(bitStreamDecoder, header, window, windowSize);
+        output.commit(count);
+        bytesDecoded += count;
 
-        // Reconstruct the remainder:
-        int value = m * q;
-        for (int i = KBits - 1; i >= 0; i--)
+        if (count < windowSize)
         {
-            if (!bitStreamDecoder.readNextBit(bit))
+            if (bitStreamDecoder.getBitsLeft() == 0)
             {
                 RICE_ERROR("Failed to read bits from stream! Unexpected end.");
-                return bytesDecoded;
             }
-            value = value | (bit << i);
+            return bytesDecoded;
         }
+    }
 
-        *uncompressed++ = static_cast<std::uint8_t>(value);
-        bytesDecoded++;
+    RICE_STATS_ADD(decodeCalls, 1);
+    RICE_STATS_ADD(bitsRead, bitStreamDecoder.getBitCount() - bitStreamDecoder.getBitsLeft());
+    RICE_STATS_ADD(bytesDecoded, bytesDecoded);
+    return bytesDecoded;
+}
 
-        if (bytesDecoded == uncompressedSizeBytes)
-        {
-            break; // Decompress buffer is full.
-        }
+// ========================================================
+// class WindowDecoder:
+// ========================================================
+
+WindowDecoder::WindowDecoder(const std::uint8_t * compressed, const int compressedSizeBytes,
+                             const int compressedSizeBits, const int windowSizeBytes)
+    : bitStreamDecoder(compressed, compressedSizeBytes, compressedSizeBits)
+    , mode(Mode::Rice)
+    , parameter(0)
+    , buffer(nullptr)
+    , windowSize(windowSizeBytes > 0 ? windowSizeBytes : DefaultWindowSizeBytes)
+    , bytesDecoded(0)
+{
+    if (compressed == nullptr || compressedSizeBytes <= 0 || compressedSizeBits <= 4)
+    {
+        RICE_ERROR("rice::WindowDecoder: Bad compressed data!");
+        return;
     }
 
-    return bytesDecoded;
+    StreamHeader header;
+    if (!readStreamHeader(bitStreamDecoder, header))
+    {
+        RICE_ERROR("rice::WindowDecoder: Bad stream header!");
+        return;
+    }
+    mode      = header.mode;
+    parameter = header.parameter;
+    buffer = static_cast<std::uint8_t *>(RICE_MALLOC(windowSize));
+    RICE_STATS_ADD(decodeCalls, 1);
+}
+
+WindowDecoder::~WindowDecoder()
+{
+    RICE_STATS_ADD(bitsRead, bitStreamDecoder.getBitCount() - bitStreamDecoder.getBitsLeft());
+    if (buffer != nullptr)
+    {
+        RICE_MFREE(buffer);
+    }
+}
+
+int WindowDecoder::next(const std::uint8_t ** window)
+{
+    assert(window != nullptr);
+    if (buffer == nullptr)
+    {
+        return 0;
+    }
+
+    // The stream has no symbol count; it ends with the last value's bits.
+    const StreamHeader header = { mode, parameter };
+    const int windowBytes = decodeValues(bitStreamDecoder, header, buffer, windowSize);
+
+    bytesDecoded += windowBytes;
+    RICE_STATS_ADD(bytesDecoded, windowBytes);
+    *window = buffer;
+    return windowBytes;
 }
 
 } // namespace rice {}
@@ -28,16 +28,119 @@
 //
 // RLE_WORD_SIZE_16 #define controls the size of the RLE word/count.
 // If not defined, use 8-bits count.
+//
+// The run scanning loop of the encoder is dispatched at runtime to
+// AVX2 or AVX-512BW versions when the CPU supports them, so a single
+// binary built without -march flags still uses the widest kernels.
+// #define RLE_NO_SIMD to always use the portable scalar code.
 
 #include <cstdint>
+#include <vector>
 
 namespace rle
 {
 
+// The encoder scans for the end of a run 64 or 32 bytes at a time with
+// AVX-512BW or AVX2. Detected on first use; all false with RLE_NO_SIMD
+// or when not compiling for x86/x64.
+struct CpuFeatures
+{
+    bool avx2     = false;
+    bool avx512bw = false;
+};
+
+// Features in use by the run scanning dispatch.
+const CpuFeatures & getCpuFeatures();
+
+// Turns detected features off (never on), e.g. to test the scalar scan.
+// Not thread safe; call it before encoding.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Run counters, e.g. to see whether 16-bit run lengths would pay off.
+// Only updated when RLE_ENABLE_STATS is defined where RLE_IMPLEMENTATION
+// is, and separately for each thread.
+struct Stats
+{
+    std::uint64_t encodeCalls   = 0; // easyEncode() calls.
+    std::uint64_t decodeCalls   = 0; // easyDecode() calls.
+    std::uint64_t bytesEncoded  = 0; // Uncompressed bytes consumed by the encoder.
+    std::uint64_t bytesDecoded  = 0; // Uncompressed bytes produced by the decoder.
+    std::uint64_t runsWritten   = 0; // RLE packets written by the encoder.
+    std::uint64_t runsRead      = 0; // RLE packets read by the decoder.
+    std::uint64_t maxLengthRuns = 0; // Runs split for reaching MaxRunLength; high counts suggest RLE_WORD_SIZE_16.
+};
+
+// Stats of the calling thread since startup or the last resetStats().
+const Stats & getStats();
+void resetStats();
+
 // RLE encode/decode raw bytes:
 int easyEncode(const std::uint8_t * input, int inSizeBytes, std::uint8_t * output, int outSizeBytes);
 int easyDecode(const std::uint8_t * input, int inSizeBytes, std::uint8_t * output, int outSizeBytes);
 
+// One piece of a scatter/gather output buffer, like a POSIX iovec.
+struct OutputSegment
+{
+    std::uint8_t * data;
+    int sizeBytes;
+};
+
+// Decode straight into a list of buffers (e.g. network buffers or pages),
+// which are filled in order as if they were a single contiguous buffer.
+// Same return value as the contiguous easyDecode().
+int easyDecode(const std::uint8_t * input, int inSizeBytes,
+               const OutputSegment * outputSegments, int outputSegmentCount);
+
+// In-place decoding: store the output of easyEncode() at the very end of the
+// destination buffer and decode it into the same buffer, so large payloads
+// don't need a separate input copy. The buffer must hold the decoded size plus
+// inPlaceMargin() bytes, so that the output never catches up with packets not
+// read yet. The margin is computed from the packets (no decoding), and is zero
+// when every run saves space. Returns -1 if the input is malformed.
+int inPlaceMargin(const std::uint8_t * input, int inSizeBytes);
+
+// Decodes the inSizeBytes at the end of the buffer to its start. Returns the
+// decoded size, or -1 if the buffer is too small for its margin, in which case
+// the contents of the buffer are undefined.
+int easyDecodeInPlace(std::uint8_t * buffer, int bufferSizeBytes, int inSizeBytes);
+
+// Decodes the output of easyEncode() one fixed-size window at a time,
+// so the data can be consumed while it is decoded and only a window of
+// it has to be kept in memory, instead of the whole uncompressed size.
+class WindowDecoder final
+{
+public:
+
+    static constexpr int DefaultWindowSizeBytes = 64 * 1024;
+
+    // No copy/assignment.
+    WindowDecoder(const WindowDecoder &) = delete;
+    WindowDecoder & operator = (const WindowDecoder &) = delete;
+
+    WindowDecoder(const std::uint8_t * input, int inSizeBytes, int windowSizeBytes = DefaultWindowSizeBytes);
+
+    // Decodes the next window and points *window to it. Returns its size
+    // in bytes, which is only less than the window size for the last one,
+    // and 0 once the input is over. The data stays valid until the next call.
+    int next(const std::uint8_t ** window);
+
+    // Total bytes returned by next() so far.
+    int getBytesDecoded() const { return bytesDecoded; }
+
+private:
+
+    const std::uint8_t * input;
+    const std::uint8_t * inputEnd;
+    std::vector<std::uint8_t> buffer;
+    int runLeft;          // Bytes of the current RLE packet not output yet.
+    std::uint8_t runByte;
+    int bytesDecoded;
+};
+
 } // namespace rle {}
 
 // ================== End of header file ==================
@@ -52,6 +155,24 @@ int easyDecode(const std::uint8_t * input, int inSizeBytes, std::uint8_t * outpu
 
 #ifdef RLE_IMPLEMENTATION
 
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#if !defined(RLE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define RLE_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define RLE_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define RLE_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define RLE_X86_SIMD 0
+#endif // x86
+
 namespace rle
 {
 
@@ -86,6 +207,226 @@ static void readData(const std::uint8_t *& input, T & val)
     input += sizeof(T);
 }
 
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef RLE_ENABLE_STATS
+    #define RLE_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !RLE_ENABLE_STATS
+    #define RLE_STATS_ADD(counter, amount) ((void)0)
+#endif // RLE_ENABLE_STATS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if RLE_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+// XCR0 tells us which register files the OS saves on context switches.
+static std::uint64_t readXCR0()
+{
+    #if defined(_MSC_VER)
+    return _xgetbv(0);
+    #else // GCC/Clang
+    std::uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (std::uint64_t(edx) << 32) | eax;
+    #endif // _MSC_VER
+}
+
+static int countTrailingZeros(const std::uint64_t num)
+{
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, num);
+    return static_cast<int>(index);
+    #elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(num)))
+    {
+        return static_cast<int>(index);
+    }
+    _BitScanForward(&index, static_cast<unsigned long>(num >> 32));
+    return static_cast<int>(index) + 32;
+    #else // GCC/Clang
+    return __builtin_ctzll(num);
+    #endif // _MSC_VER
+}
+
+#endif // RLE_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if RLE_X86_SIMD
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+
+    // The OS must save the YMM (and ZMM/opmask) registers (OSXSAVE + XCR0).
+    const std::uint64_t xcr0 = ((regs[2] & (1u << 27)) != 0) ? readXCR0() : 0;
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.avx2     = avx && (xcr0 & 0x06) == 0x06 && (regs[1] & (1u << 5)) != 0;
+        features.avx512bw = (xcr0 & 0xE6) == 0xE6 && (regs[1] & (1u << 16)) != 0 &&
+                            (regs[1] & (1u << 30)) != 0; // AVX-512F + BW
+    }
+    #endif // RLE_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Run scanning kernels:
+// ========================================================
+
+// Run bytes easyEncode() compares itself before calling a kernel.
+constexpr int InlineScanBytes = 32;
+
+// Each returns the length of the run of 'value' at the start of
+// 'input', scanning no further than 'count' bytes.
+static int scanRunScalar(const std::uint8_t * input, const int count, const std::uint8_t value)
+{
+    int i = 0;
+    while (i < count && input[i] == value)
+    {
+        ++i;
+    }
+    return i;
+}
+
+#if RLE_X86_SIMD
+
+RLE_TARGET("avx2")
+static int scanRunAVX2(const std::uint8_t * input, const int count, const std::uint8_t value)
+{
+    const __m256i splat = _mm256_set1_epi8(static_cast<char>(value));
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+        const std::uint32_t equal = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, splat)));
+        if (equal != 0xFFFFFFFF)
+        {
+            return i + countTrailingZeros(~equal);
+        }
+    }
+    return i + scanRunScalar(input + i, count - i, value);
+}
+
+RLE_TARGET("avx512f,avx512bw")
+static int scanRunAVX512(const std::uint8_t * input, const int count, const std::uint8_t value)
+{
+    const __m512i splat = _mm512_set1_epi8(static_cast<char>(value));
+
+    int i = 0;
+    for (; i + 64 <= count; i += 64)
+    {
+        const __m512i block = _mm512_loadu_si512(input + i);
+        const std::uint64_t equal = _mm512_cmpeq_epi8_mask(block, splat);
+        if (equal != ~std::uint64_t(0))
+        {
+            return i + countTrailingZeros(~equal);
+        }
+    }
+    return i + scanRunScalar(input + i, count - i, value);
+}
+
+#endif // RLE_X86_SIMD
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+struct Kernels
+{
+    int (*scanRun)(const std::uint8_t * input, int count, std::uint8_t value);
+};
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.scanRun = &scanRunScalar;
+
+    #if RLE_X86_SIMD
+    if (features.avx512bw)
+    {
+        kernels.scanRun = &scanRunAVX512;
+    }
+    else if (features.avx2)
+    {
+        kernels.scanRun = &scanRunAVX2;
+    }
+    #else // !RLE_X86_SIMD
+    (void)features;
+    #endif // RLE_X86_SIMD
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.avx2     = features.avx2     && detected.avx2;
+    current.avx512bw = features.avx512bw && detected.avx512bw;
+
+    kernelsInstance() = selectKernels(current);
+}
+
 // ========================================================
 
 int easyEncode(const std::uint8_t * input, const int inSizeBytes, std::uint8_t * output, const int outSizeBytes)
@@ -99,45 +440,159 @@ int easyEncode(const std::uint8_t * input, const int inSizeBytes, std::uint8_t *
         return -1;
     }
 
+    RLE_STATS_ADD(encodeCalls, 1);
+    RLE_STATS_ADD(bytesEncoded, inSizeBytes);
+
+    const auto scanRun = kernelsInstance().scanRun;
     int bytesWritten = 0;
-    RleWord rleCount = 0;
-    std::uint8_t rleByte = *input;
 
-    for (int i = 0; i < inSizeBytes; ++i, ++rleCount)
+    for (int i = 0; i < inSizeBytes;)
     {
-        const std::uint8_t b = *input++;
+        // Find the end of the sequence, up to the max size of a RLE word:
+        const std::uint8_t rleByte = input[i];
+        const int maxRunLength = (inSizeBytes - i < MaxRunLength) ? (inSizeBytes - i) : MaxRunLength;
+
+        // Most runs are short, so the first bytes are compared inline.
+        // Only a run that gets this far pays for the call into the kernel.
+        const int inlineLength = (maxRunLength < InlineScanBytes) ? maxRunLength : InlineScanBytes;
+        int rleCount = 1;
+        while (rleCount < inlineLength && input[i + rleCount] == rleByte)
+        {
+            ++rleCount;
+        }
+        if (rleCount == InlineScanBytes)
+        {
+            rleCount += scanRun(input + i + rleCount, maxRunLength - rleCount, rleByte);
+        }
+
+        if ((bytesWritten + sizeof(RleWord) + sizeof(std::uint8_t)) > static_cast<unsigned>(outSizeBytes))
+        {
+            // Can't fit anymore data! Stop with an error.
+            return -1;
+        }
+        bytesWritten += writeData(output, static_cast<RleWord>(rleCount));
+        bytesWritten += writeData(output, rleByte);
+        i += rleCount;
+
+        RLE_STATS_ADD(runsWritten, 1);
+        RLE_STATS_ADD(maxLengthRuns, rleCount == MaxRunLength);
+    }
+
+    return bytesWritten;
+}
+
+// ========================================================
+
+// ========================================================
+// Scatter/gather output:
+// ========================================================
+
+// The decoder expands each run straight into the caller's OutputSegments,
+// splitting it where a segment ends. Empty segments are skipped.
+class SegmentWriter final
+{
+public:
+
+    // No copy/assignment.
+    SegmentWriter(const SegmentWriter &) = delete;
+    SegmentWriter & operator = (const SegmentWriter &) = delete;
 
-        // Output when we hit the end of a sequence or the max size of a RLE word:
-        if (b != rleByte || rleCount == MaxRunLength)
+    SegmentWriter(const OutputSegment * outputSegments, const int outputSegmentCount)
+        : segments(outputSegments)
+        , segmentCount(outputSegmentCount)
+        , nextSegment(0)
+        , segmentStart(nullptr)
+        , cursor(nullptr)
+        , segmentEnd(nullptr)
+        , bytesBefore(0)
+    { }
+
+    // Sum of the segment sizes, or -1 if a segment is malformed.
+    static int countBytes(const OutputSegment * outputSegments, const int outputSegmentCount)
+    {
+        std::int64_t total = 0;
+        for (int s = 0; s < outputSegmentCount; ++s)
         {
-            if ((bytesWritten + sizeof(RleWord) + sizeof(std::uint8_t)) > static_cast<unsigned>(outSizeBytes))
+            if (outputSegments[s].sizeBytes < 0 || (outputSegments[s].sizeBytes > 0 && outputSegments[s].data == nullptr))
             {
-                // Can't fit anymore data! Stop with an error.
                 return -1;
             }
-            bytesWritten += writeData(output, rleCount);
-            bytesWritten += writeData(output, rleByte);
-            rleCount = 0;
-            rleByte  = b;
+            total += outputSegments[s].sizeBytes;
         }
+        return (total <= 0x7FFFFFFF) ? static_cast<int>(total) : -1;
     }
 
-    // Residual count at the end:
-    if (rleCount != 0)
+    // Writes 'count' copies of a byte. False if they didn't all fit.
+    bool fill(const std::uint8_t value, int count)
     {
-        if ((bytesWritten + sizeof(RleWord) + sizeof(std::uint8_t)) > static_cast<unsigned>(outSizeBytes))
+        // Short runs that fit the current segment are the common case,
+        // and a plain loop beats the call to memset() for those.
+        // The local pointer keeps byte stores from forcing reloads of 'cursor'.
+        if (count <= ShortFillBytes && count <= segmentEnd - cursor)
         {
-            return -1; // No more space! Output not complete.
+            std::uint8_t * out = cursor;
+            while (count--)
+            {
+                *out++ = value;
+            }
+            cursor = out;
+            return true;
         }
-        bytesWritten += writeData(output, rleCount);
-        bytesWritten += writeData(output, rleByte);
+
+        while (count > 0)
+        {
+            if (cursor == segmentEnd && !advance())
+            {
+                return false;
+            }
+            const int n = (segmentEnd - cursor < count) ? static_cast<int>(segmentEnd - cursor) : count;
+            std::memset(cursor, value, n);
+            cursor += n;
+            count  -= n;
+        }
+        return true;
     }
 
-    return bytesWritten;
-}
+    int getBytesWritten() const
+    {
+        return bytesBefore + static_cast<int>(cursor - segmentStart);
+    }
+
+private:
+
+    static constexpr int ShortFillBytes = 16;
+
+    bool advance()
+    {
+        while (nextSegment < segmentCount)
+        {
+            const OutputSegment & segment = segments[nextSegment++];
+            if (segment.sizeBytes > 0)
+            {
+                bytesBefore += static_cast<int>(segmentEnd - segmentStart);
+                segmentStart = segment.data;
+                cursor       = segment.data;
+                segmentEnd   = segment.data + segment.sizeBytes;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const OutputSegment * segments;
+    const int segmentCount;
+    int nextSegment;             // Index of the segment after the current one.
+    std::uint8_t * segmentStart; // Current segment being written to.
+    std::uint8_t * cursor;
+    std::uint8_t * segmentEnd;
+    int bytesBefore;             // Bytes written to the segments before the current one.
+};
 
 // ========================================================
 
+// Longest run the contiguous easyDecode() writes without memset().
+constexpr int ShortRunBytes = 16;
+
 int easyDecode(const std::uint8_t * input, const int inSizeBytes, std::uint8_t * output, const int outSizeBytes)
 {
     if (input == nullptr || output == nullptr)
@@ -149,6 +604,8 @@ int easyDecode(const std::uint8_t * input, const int inSizeBytes, std::uint8_t *
         return -1;
     }
 
+    RLE_STATS_ADD(decodeCalls, 1);
+
     int bytesWritten = 0;
     RleWord rleCount = 0;
     std::uint8_t rleByte = 0;
@@ -157,22 +614,190 @@ int easyDecode(const std::uint8_t * input, const int inSizeBytes, std::uint8_t *
     {
         readData(input, rleCount);
         readData(input, rleByte);
+        RLE_STATS_ADD(runsRead, 1);
 
-        // Replicate the RLE packet.
-        while (rleCount--)
+        if (rleCount > outSizeBytes - bytesWritten)
         {
-            *output++ = rleByte;
-            if (++bytesWritten == outSizeBytes && rleCount != 0)
+            // Reached end of output and we are not done yet, stop with an error.
+            return -1;
+        }
+
+        // Replicate the RLE packet. A plain loop beats the call to memset() for short runs.
+        if (rleCount <= ShortRunBytes)
+        {
+            for (int n = 0; n < rleCount; ++n)
             {
-                // Reached end of output and we are not done yet, stop with an error.
-                return -1;
+                output[n] = rleByte;
             }
         }
+        else
+        {
+            std::memset(output, rleByte, rleCount);
+        }
+        output       += rleCount;
+        bytesWritten += rleCount;
     }
 
+    RLE_STATS_ADD(bytesDecoded, bytesWritten);
     return bytesWritten;
 }
 
+int easyDecode(const std::uint8_t * input, const int inSizeBytes,
+               const OutputSegment * outputSegments, const int outputSegmentCount)
+{
+    if (input == nullptr || outputSegments == nullptr)
+    {
+        return -1;
+    }
+    if (inSizeBytes <= 0 || SegmentWriter::countBytes(outputSegments, outputSegmentCount) <= 0)
+    {
+        return -1;
+    }
+
+    RLE_STATS_ADD(decodeCalls, 1);
+
+    SegmentWriter output(outputSegments, outputSegmentCount);
+    RleWord rleCount = 0;
+    std::uint8_t rleByte = 0;
+
+    for (int i = 0; i < inSizeBytes; i += sizeof(rleCount) + sizeof(rleByte))
+    {
+        readData(input, rleCount);
+        readData(input, rleByte);
+        RLE_STATS_ADD(runsRead, 1);
+
+        // Replicate the RLE packet.
+        if (!output.fill(rleByte, rleCount))
+        {
+            // Reached end of output and we are not done yet, stop with an error.
+            return -1;
+        }
+    }
+
+    RLE_STATS_ADD(bytesDecoded, output.getBytesWritten());
+    return output.getBytesWritten();
+}
+
+// ========================================================
+// In-place decoding:
+// ========================================================
+
+constexpr int PacketSizeBytes = sizeof(RleWord) + sizeof(std::uint8_t);
+
+int inPlaceMargin(const std::uint8_t * input, const int inSizeBytes)
+{
+    if (input == nullptr || inSizeBytes <= 0 || inSizeBytes % PacketSizeBytes != 0)
+    {
+        return -1;
+    }
+
+    // The input starts at (decoded size + margin - inSizeBytes) and each packet is
+    // read before its run is written, so after any packet the output written so far
+    // must not go past the input read so far. The margin is the worst overshoot.
+    std::int64_t bytesWritten = 0;
+    std::int64_t maxOvershoot = 0;
+    for (int i = 0; i < inSizeBytes; i += PacketSizeBytes)
+    {
+        RleWord rleCount = 0;
+        std::memcpy(&rleCount, input + i, sizeof(rleCount));
+        bytesWritten += rleCount;
+        if (bytesWritten - (i + PacketSizeBytes) > maxOvershoot)
+        {
+            maxOvershoot = bytesWritten - (i + PacketSizeBytes);
+        }
+    }
+
+    const std::int64_t margin = maxOvershoot - (bytesWritten - inSizeBytes);
+    return (bytesWritten + margin <= 0x7FFFFFFF) ? static_cast<int>(margin) : -1;
+}
+
+int easyDecodeInPlace(std::uint8_t * buffer, const int bufferSizeBytes, const int inSizeBytes)
+{
+    if (buffer == nullptr || inSizeBytes <= 0 || bufferSizeBytes < inSizeBytes || inSizeBytes % PacketSizeBytes != 0)
+    {
+        return -1;
+    }
+
+    RLE_STATS_ADD(decodeCalls, 1);
+
+    const std::uint8_t * input = buffer + bufferSizeBytes - inSizeBytes;
+    const std::uint8_t * const inputEnd = buffer + bufferSizeBytes;
+    std::uint8_t * output = buffer;
+    RleWord rleCount = 0;
+    std::uint8_t rleByte = 0;
+
+    while (input != inputEnd)
+    {
+        readData(input, rleCount);
+        readData(input, rleByte);
+        RLE_STATS_ADD(runsRead, 1);
+
+        // The run may only overwrite packets that were already read.
+        if (rleCount > input - output)
+        {
+            return -1;
+        }
+        std::memset(output, rleByte, rleCount);
+        output += rleCount;
+    }
+
+    const int bytesDecoded = static_cast<int>(output - buffer);
+    RLE_STATS_ADD(bytesDecoded, bytesDecoded);
+    return bytesDecoded;
+}
+
+// ========================================================
+// class WindowDecoder:
+// ========================================================
+
+WindowDecoder::WindowDecoder(const std::uint8_t * inputData, const int inSizeBytes, const int windowSizeBytes)
+    : input(inputData)
+    , inputEnd((inputData != nullptr && inSizeBytes > 0) ? inputData + inSizeBytes : inputData)
+    , buffer(windowSizeBytes > 0 ? windowSizeBytes : DefaultWindowSizeBytes)
+    , runLeft(0)
+    , runByte(0)
+    , bytesDecoded(0)
+{
+    RLE_STATS_ADD(decodeCalls, 1);
+}
+
+int WindowDecoder::next(const std::uint8_t ** window)
+{
+    assert(window != nullptr);
+
+    const int windowSize = static_cast<int>(buffer.size());
+    std::uint8_t * out = buffer.data();
+    int windowBytes = 0;
+
+    while (windowBytes < windowSize)
+    {
+        if (runLeft == 0)
+        {
+            // A trailing partial packet is ignored.
+            if (inputEnd - input < static_cast<std::ptrdiff_t>(sizeof(RleWord) + sizeof(runByte)))
+            {
+                break;
+            }
+            RleWord rleCount = 0;
+            readData(input, rleCount);
+            readData(input, runByte);
+            runLeft = rleCount;
+            RLE_STATS_ADD(runsRead, 1);
+        }
+
+        // Runs can straddle windows; the rest goes in the next call.
+        const int n = (runLeft < windowSize - windowBytes) ? runLeft : windowSize - windowBytes;
+        std::memset(out + windowBytes, runByte, n);
+        windowBytes += n;
+        runLeft     -= n;
+    }
+
+    bytesDecoded += windowBytes;
+    RLE_STATS_ADD(bytesDecoded, windowBytes);
+    *window = out;
+    return windowBytes;
+}
+
 } // namespace rle {}
 
 // ================ End of implementation =================
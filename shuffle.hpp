@@ -0,0 +1,853 @@
+// ================================================================================================
+// -*- C++ -*-
+// File: shuffle.hpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: Byte and bit shuffling of typed arrays, a pre-transform for the byte codecs.
+// ================================================================================================
+
+#ifndef SHUFFLE_HPP
+#define SHUFFLE_HPP
+
+// ---------
+//  LICENSE
+// ---------
+// This software is in the public domain. Where that dedication is not recognized,
+// you are granted a perpetual, irrevocable license to copy, distribute, and modify
+// this file as you see fit.
+//
+// The source code is provided "as is", without warranty of any kind, express or implied.
+// No attribution is required, but a mention about the author is appreciated.
+//
+// -------
+//  SETUP
+// -------
+// #define SHUFFLE_IMPLEMENTATION in one source file before including
+// this file, then use shuffle.hpp as a normal header file elsewhere.
+//
+// The transposition loops are dispatched at runtime to AVX2 versions
+// when the CPU supports them, so a single binary built without -march
+// flags still uses them.
+// #define SHUFFLE_NO_SIMD to always use the portable scalar code.
+//
+// ----------
+//  OVERVIEW
+// ----------
+// An array of N elements of 'typeSize' bytes each (int32s, floats,
+// RGBA pixels) interleaves bytes that have little to do with each other:
+// the low byte of an int next to its high byte, the red channel next to
+// the green one. The byte codecs see a noisy string and do poorly on it.
+//
+// byteShuffle() regroups the bytes by their position in the element, the
+// way Blosc does: first byte 0 of every element, then byte 1 of every
+// element, and so on. The high bytes of small ints become long runs of
+// zeros, float exponents end up next to each other, and an RGBA image
+// becomes its four planes (toPlanar()/fromPlanar() are the same transform
+// under the names an image loader would look for).
+//
+// bitShuffle() goes one step further and also splits each of those byte
+// streams into its 8 bit planes, LSB plane first. Slowly varying values
+// then turn most planes into zeros, which suits RLE and Huffman better
+// still. It is the bitshuffle idea but not the bitshuffle library format.
+//
+// Both are the same size in and out and need no header: the caller keeps
+// track of the typeSize. Bytes past the last whole element (and, for the
+// bit shuffle, the last few elements past a multiple of 8) are copied as
+// they are at the end of the output.
+
+#include <cstdint>
+
+namespace shuffle
+{
+
+// Byte shuffles of 2, 4 and 8 byte types have AVX2 kernels. False with
+// SHUFFLE_NO_SIMD or when not compiling for x86/x64.
+struct CpuFeatures
+{
+    bool avx2 = false;
+};
+
+// Whether the AVX2 shuffle kernels are in use.
+const CpuFeatures & getCpuFeatures();
+
+// Set avx2 to false to force the scalar shuffles; it can't be forced on.
+// Not thread safe; call it before shuffling.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// How much of the shuffling went through the AVX2 kernels. Updated only
+// with SHUFFLE_ENABLE_STATS defined next to SHUFFLE_IMPLEMENTATION; per thread.
+struct Stats
+{
+    std::uint64_t shuffleCalls    = 0; // byteShuffle() and bitShuffle() calls.
+    std::uint64_t unshuffleCalls  = 0; // byteUnshuffle() and bitUnshuffle() calls.
+    std::uint64_t bytesShuffled   = 0; // Input bytes of the shuffles.
+    std::uint64_t bytesUnshuffled = 0; // Input bytes of the unshuffles.
+    std::uint64_t simdBytes       = 0; // Bytes that went through the AVX2 kernels, both ways.
+};
+
+// The calling thread's counters (zeros unless stats are on).
+const Stats & getStats();
+void resetStats();
+
+// Largest element size accepted by the functions below.
+constexpr int MaxTypeSize = 128;
+
+// Regroups the bytes of 'input' (sizeBytes / typeSize elements of typeSize bytes)
+// by position in the element. 'output' must hold sizeBytes and not overlap the
+// input. Returns the bytes written or -1 on error.
+int byteShuffle(const std::uint8_t * input, int sizeBytes, int typeSize,
+                std::uint8_t * output, int outSizeBytes);
+
+// Undoes byteShuffle() with the same typeSize.
+int byteUnshuffle(const std::uint8_t * input, int sizeBytes, int typeSize,
+                  std::uint8_t * output, int outSizeBytes);
+
+// As byteShuffle(), then each byte stream is split into its 8 bit planes.
+int bitShuffle(const std::uint8_t * input, int sizeBytes, int typeSize,
+               std::uint8_t * output, int outSizeBytes);
+
+// Undoes bitShuffle() with the same typeSize.
+int bitUnshuffle(const std::uint8_t * input, int sizeBytes, int typeSize,
+                 std::uint8_t * output, int outSizeBytes);
+
+// Interleaved pixels (RGBARGBA...) to one plane per channel (RR..GG..BB..AA..)
+// and back. Returns the bytes written (pixelCount * channels) or -1 on error.
+int toPlanar(const std::uint8_t * pixels, int pixelCount, int channels,
+             std::uint8_t * planes, int planesSizeBytes);
+int fromPlanar(const std::uint8_t * planes, int pixelCount, int channels,
+               std::uint8_t * pixels, int pixelsSizeBytes);
+
+} // namespace shuffle {}
+
+// ================== End of header file ==================
+#endif // SHUFFLE_HPP
+// ================== End of header file ==================
+
+// ================================================================================================
+//
+//                                    Shuffle Implementation
+//
+// ================================================================================================
+
+#ifdef SHUFFLE_IMPLEMENTATION
+
+#include <cstring>
+
+#if !defined(SHUFFLE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define SHUFFLE_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define SHUFFLE_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define SHUFFLE_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define SHUFFLE_X86_SIMD 0
+#endif // x86
+
+namespace shuffle
+{
+
+// The bit shuffle goes through a byte shuffled copy of this many bytes at a time.
+constexpr int ScratchBytes = 4096;
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef SHUFFLE_ENABLE_STATS
+    #define SHUFFLE_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !SHUFFLE_ENABLE_STATS
+    #define SHUFFLE_STATS_ADD(counter, amount) ((void)0)
+#endif // SHUFFLE_ENABLE_STATS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if SHUFFLE_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+// XCR0 tells us which register files the OS saves on context switches.
+static std::uint64_t readXCR0()
+{
+    #if defined(_MSC_VER)
+    return _xgetbv(0);
+    #else // GCC/Clang
+    std::uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (std::uint64_t(edx) << 32) | eax;
+    #endif // _MSC_VER
+}
+
+#endif // SHUFFLE_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if SHUFFLE_X86_SIMD
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+
+    // The AVX2 shuffles are only usable if the OS saves the YMM state.
+    const std::uint64_t xcr0 = ((regs[2] & (1u << 27)) != 0) ? readXCR0() : 0;
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.avx2 = avx && (xcr0 & 0x06) == 0x06 && (regs[1] & (1u << 5)) != 0;
+    }
+    #endif // SHUFFLE_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Byte transposition kernels:
+// ========================================================
+
+//
+// shuffleBytes writes byte j of each of the 'count' elements of 'input'
+// to output[j * stride + i]; unshuffleBytes does the reverse. The stride
+// is the element count for a whole array, or the block size when the bit
+// shuffle works on a piece of it.
+//
+using ShuffleBytesFunc   = void (*)(const std::uint8_t * input, int count, int typeSize, int stride, std::uint8_t * output);
+using UnshuffleBytesFunc = void (*)(const std::uint8_t * input, int count, int typeSize, int stride, std::uint8_t * output);
+
+static void shuffleBytesRange(const std::uint8_t * input, const int first, const int count, const int typeSize,
+                              const int stride, std::uint8_t * output)
+{
+    for (int j = 0; j < typeSize; ++j)
+    {
+        std::uint8_t * stream = output + static_cast<std::int64_t>(j) * stride;
+        for (int i = first; i < count; ++i)
+        {
+            stream[i] = input[static_cast<std::int64_t>(i) * typeSize + j];
+        }
+    }
+}
+
+static void unshuffleBytesRange(const std::uint8_t * input, const int first, const int count, const int typeSize,
+                                const int stride, std::uint8_t * output)
+{
+    for (int j = 0; j < typeSize; ++j)
+    {
+        const std::uint8_t * stream = input + static_cast<std::int64_t>(j) * stride;
+        for (int i = first; i < count; ++i)
+        {
+            output[static_cast<std::int64_t>(i) * typeSize + j] = stream[i];
+        }
+    }
+}
+
+static void shuffleBytesScalar(const std::uint8_t * input, const int count, const int typeSize,
+                               const int stride, std::uint8_t * output)
+{
+    shuffleBytesRange(input, 0, count, typeSize, stride, output);
+}
+
+static void unshuffleBytesScalar(const std::uint8_t * input, const int count, const int typeSize,
+                                 const int stride, std::uint8_t * output)
+{
+    unshuffleBytesRange(input, 0, count, typeSize, stride, output);
+}
+
+#if SHUFFLE_X86_SIMD
+
+// The AVX2 versions cover the 2, 4 and 8 byte types (int16/int32/float/
+// int64/double, RGBA pixels) and leave other sizes and the last few
+// elements to the scalar loop. Each returns how many elements it did.
+
+SHUFFLE_TARGET("avx2")
+static __m256i load256(const std::uint8_t * ptr)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+}
+
+SHUFFLE_TARGET("avx2")
+static void store256(std::uint8_t * ptr, const __m256i value)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ptr), value);
+}
+
+SHUFFLE_TARGET("avx2")
+static int shuffle2AVX2(const std::uint8_t * input, const int count, const int stride, std::uint8_t * output)
+{
+    // Even bytes then odd bytes in each lane, then the lane halves regrouped.
+    const __m256i mask = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                          0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const std::uint8_t * in = input + i * 2;
+        const __m256i v0 = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(load256(in),      mask), 0xD8);
+        const __m256i v1 = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(load256(in + 32), mask), 0xD8);
+        store256(output + i,          _mm256_permute2x128_si256(v0, v1, 0x20));
+        store256(output + stride + i, _mm256_permute2x128_si256(v0, v1, 0x31));
+    }
+    return i;
+}
+
+SHUFFLE_TARGET("avx2")
+static int unshuffle2AVX2(const std::uint8_t * input, const int count, const int stride, std::uint8_t * output)
+{
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i s0 = load256(input + i);
+        const __m256i s1 = load256(input + stride + i);
+        const __m256i lo = _mm256_unpacklo_epi8(s0, s1); // Elements 0-7 | 16-23
+        const __m256i hi = _mm256_unpackhi_epi8(s0, s1); // Elements 8-15 | 24-31
+        store256(output + i * 2,      _mm256_permute2x128_si256(lo, hi, 0x20));
+        store256(output + i * 2 + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+}
+
+SHUFFLE_TARGET("avx2")
+static int shuffle4AVX2(const std::uint8_t * input, const int count, const int stride, std::uint8_t * output)
+{
+    // 4x4 byte transpose in each lane, then the dwords put in order so that
+    // each qword holds one byte position of 8 elements.
+    const __m256i mask = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                          0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i v[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            v[k] = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(load256(input + (i + k * 8) * 4), mask), order);
+        }
+
+        // 4x4 qword transpose: stream j gets qword j of each of the four.
+        const __m256i lo01 = _mm256_unpacklo_epi64(v[0], v[1]);
+        const __m256i hi01 = _mm256_unpackhi_epi64(v[0], v[1]);
+        const __m256i lo23 = _mm256_unpacklo_epi64(v[2], v[3]);
+        const __m256i hi23 = _mm256_unpackhi_epi64(v[2], v[3]);
+        store256(output + i,              _mm256_permute2x128_si256(lo01, lo23, 0x20));
+        store256(output + stride + i,     _mm256_permute2x128_si256(hi01, hi23, 0x20));
+        store256(output + stride * 2 + i, _mm256_permute2x128_si256(lo01, lo23, 0x31));
+        store256(output + stride * 3 + i, _mm256_permute2x128_si256(hi01, hi23, 0x31));
+    }
+    return i;
+}
+
+SHUFFLE_TARGET("avx2")
+static int unshuffle4AVX2(const std::uint8_t * input, const int count, const int stride, std::uint8_t * output)
+{
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i s0 = load256(input + i);
+        const __m256i s1 = load256(input + stride + i);
+        const __m256i s2 = load256(input + stride * 2 + i);
+        const __m256i s3 = load256(input + stride * 3 + i);
+
+        const __m256i lo01 = _mm256_unpacklo_epi8(s0, s1); // Elements 0-7 | 16-23
+        const __m256i hi01 = _mm256_unpackhi_epi8(s0, s1); // Elements 8-15 | 24-31
+        const __m256i lo23 = _mm256_unpacklo_epi8(s2, s3);
+        const __m256i hi23 = _mm256_unpackhi_epi8(s2, s3);
+
+        const __m256i e0 = _mm256_unpacklo_epi16(lo01, lo23); // Elements 0-3 | 16-19
+        const __m256i e1 = _mm256_unpackhi_epi16(lo01, lo23); // Elements 4-7 | 20-23
+        const __m256i e2 = _mm256_unpacklo_epi16(hi01, hi23); // Elements 8-11 | 24-27
+        const __m256i e3 = _mm256_unpackhi_epi16(hi01, hi23); // Elements 12-15 | 28-31
+
+        std::uint8_t * out = output + i * 4;
+        store256(out,      _mm256_permute2x128_si256(e0, e1, 0x20));
+        store256(out + 32, _mm256_permute2x128_si256(e2, e3, 0x20));
+        store256(out + 64, _mm256_permute2x128_si256(e0, e1, 0x31));
+        store256(out + 96, _mm256_permute2x128_si256(e2, e3, 0x31));
+    }
+    return i;
+}
+
+SHUFFLE_TARGET("avx2")
+static int shuffle8AVX2(const std::uint8_t * input, const int count, const int stride, std::uint8_t * output)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        // Elements 0-7 in the low lanes and 8-15 in the high lanes, two per register.
+        const std::uint8_t * in = input + i * 8;
+        const __m256i l0 = load256(in);
+        const __m256i l1 = load256(in + 32);
+        const __m256i l2 = load256(in + 64);
+        const __m256i l3 = load256(in + 96);
+        __m256i a = _mm256_permute2x128_si256(l0, l2, 0x20);
+        __m256i b = _mm256_permute2x128_si256(l0, l2, 0x31);
+        __m256i c = _mm256_permute2x128_si256(l1, l3, 0x20);
+        __m256i d = _mm256_permute2x128_si256(l1, l3, 0x31);
+
+        // Each byte position of the pair side by side, then of 4 and 8 elements.
+        a = _mm256_unpacklo_epi8(a, _mm256_unpackhi_epi64(a, a));
+        b = _mm256_unpacklo_epi8(b, _mm256_unpackhi_epi64(b, b));
+        c = _mm256_unpacklo_epi8(c, _mm256_unpackhi_epi64(c, c));
+        d = _mm256_unpacklo_epi8(d, _mm256_unpackhi_epi64(d, d));
+
+        const __m256i ab0 = _mm256_unpacklo_epi16(a, b); // Positions 0-3
+        const __m256i ab1 = _mm256_unpackhi_epi16(a, b); // Positions 4-7
+        const __m256i cd0 = _mm256_unpacklo_epi16(c, d);
+        const __m256i cd1 = _mm256_unpackhi_epi16(c, d);
+
+        __m256i r[4];
+        r[0] = _mm256_unpacklo_epi32(ab0, cd0); // Positions 0, 1
+        r[1] = _mm256_unpackhi_epi32(ab0, cd0); // Positions 2, 3
+        r[2] = _mm256_unpacklo_epi32(ab1, cd1); // Positions 4, 5
+        r[3] = _mm256_unpackhi_epi32(ab1, cd1); // Positions 6, 7
+
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m256i streams = _mm256_permute4x64_epi64(r[k], 0xD8);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + stride * (k * 2) + i),     _mm256_castsi256_si128(streams));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + stride * (k * 2 + 1) + i), _mm256_extracti128_si256(streams, 1));
+        }
+    }
+    return i;
+}
+
+SHUFFLE_TARGET("avx2")
+static int unshuffle8AVX2(const std::uint8_t * input, const int count, const int stride, std::uint8_t * output)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        // 16 bytes of each stream, elements 0-7 in the low lane and 8-15 in the high.
+        __m256i s[8];
+        for (int k = 0; k < 8; ++k)
+        {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + stride * k + i));
+            s[k] = _mm256_permute4x64_epi64(_mm256_castsi128_si256(bytes), 0x50);
+        }
+
+        const __m256i s01 = _mm256_unpacklo_epi8(s[0], s[1]);
+        const __m256i s23 = _mm256_unpacklo_epi8(s[2], s[3]);
+        const __m256i s45 = _mm256_unpacklo_epi8(s[4], s[5]);
+        const __m256i s67 = _mm256_unpacklo_epi8(s[6], s[7]);
+
+        const __m256i lo0 = _mm256_unpacklo_epi16(s01, s23); // Bytes 0-3 of elements 0-3
+        const __m256i lo1 = _mm256_unpackhi_epi16(s01, s23); // Bytes 0-3 of elements 4-7
+        const __m256i hi0 = _mm256_unpacklo_epi16(s45, s67); // Bytes 4-7 of elements 0-3
+        const __m256i hi1 = _mm256_unpackhi_epi16(s45, s67); // Bytes 4-7 of elements 4-7
+
+        const __m256i e01 = _mm256_unpacklo_epi32(lo0, hi0);
+        const __m256i e23 = _mm256_unpackhi_epi32(lo0, hi0);
+        const __m256i e45 = _mm256_unpacklo_epi32(lo1, hi1);
+        const __m256i e67 = _mm256_unpackhi_epi32(lo1, hi1);
+
+        std::uint8_t * out = output + i * 8;
+        store256(out,      _mm256_permute2x128_si256(e01, e23, 0x20));
+        store256(out + 32, _mm256_permute2x128_si256(e45, e67, 0x20));
+        store256(out + 64, _mm256_permute2x128_si256(e01, e23, 0x31));
+        store256(out + 96, _mm256_permute2x128_si256(e45, e67, 0x31));
+    }
+    return i;
+}
+
+SHUFFLE_TARGET("avx2")
+static void shuffleBytesAVX2(const std::uint8_t * input, const int count, const int typeSize,
+                             const int stride, std::uint8_t * output)
+{
+    int done = 0;
+    switch (typeSize)
+    {
+    case 2 : done = shuffle2AVX2(input, count, stride, output); break;
+    case 4 : done = shuffle4AVX2(input, count, stride, output); break;
+    case 8 : done = shuffle8AVX2(input, count, stride, output); break;
+    default : break;
+    } // switch
+
+    SHUFFLE_STATS_ADD(simdBytes, done * typeSize);
+    shuffleBytesRange(input, done, count, typeSize, stride, output);
+}
+
+SHUFFLE_TARGET("avx2")
+static void unshuffleBytesAVX2(const std::uint8_t * input, const int count, const int typeSize,
+                               const int stride, std::uint8_t * output)
+{
+    int done = 0;
+    switch (typeSize)
+    {
+    case 2 : done = unshuffle2AVX2(input, count, stride, output); break;
+    case 4 : done = unshuffle4AVX2(input, count, stride, output); break;
+    case 8 : done = unshuffle8AVX2(input, count, stride, output); break;
+    default : break;
+    } // switch
+
+    SHUFFLE_STATS_ADD(simdBytes, done * typeSize);
+    unshuffleBytesRange(input, done, count, typeSize, stride, output);
+}
+
+#endif // SHUFFLE_X86_SIMD
+
+// ========================================================
+// Bit transposition kernels:
+// ========================================================
+
+//
+// transposeBits splits 'bytes' bytes (a multiple of 8) into 8 bit planes,
+// plane k at output + k * planeStride, bytes / 8 bytes long. Bit i of
+// byte g of plane k is bit k of input byte 8g + i. untransposeBits puts
+// them back together.
+//
+using TransposeBitsFunc   = void (*)(const std::uint8_t * input, int bytes, int planeStride, std::uint8_t * output);
+using UntransposeBitsFunc = void (*)(const std::uint8_t * input, int planeStride, int bytes, std::uint8_t * output);
+
+// Transposes the 8x8 bit matrix with a byte per row (Hacker's Delight, 7-3).
+static std::uint64_t transpose8x8(std::uint64_t x)
+{
+    std::uint64_t t;
+    t = (x ^ (x >>  7)) & 0x00AA00AA00AA00AAull; x ^= t ^ (t <<  7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull; x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull; x ^= t ^ (t << 28);
+    return x;
+}
+
+static void transposeBitsRange(const std::uint8_t * input, const int firstGroup, const int bytes,
+                               const int planeStride, std::uint8_t * output)
+{
+    for (int g = firstGroup; g < bytes / 8; ++g)
+    {
+        std::uint64_t x;
+        std::memcpy(&x, input + g * 8, sizeof(x));
+        x = transpose8x8(x);
+        for (int k = 0; k < 8; ++k)
+        {
+            output[k * planeStride + g] = static_cast<std::uint8_t>(x >> (k * 8));
+        }
+    }
+}
+
+static void untransposeBitsRange(const std::uint8_t * input, const int planeStride, const int firstGroup,
+                                 const int bytes, std::uint8_t * output)
+{
+    for (int g = firstGroup; g < bytes / 8; ++g)
+    {
+        std::uint64_t x = 0;
+        for (int k = 0; k < 8; ++k)
+        {
+            x |= static_cast<std::uint64_t>(input[k * planeStride + g]) << (k * 8);
+        }
+        x = transpose8x8(x);
+        std::memcpy(output + g * 8, &x, sizeof(x));
+    }
+}
+
+static void transposeBitsScalar(const std::uint8_t * input, const int bytes, const int planeStride, std::uint8_t * output)
+{
+    transposeBitsRange(input, 0, bytes, planeStride, output);
+}
+
+static void untransposeBitsScalar(const std::uint8_t * input, const int planeStride, const int bytes, std::uint8_t * output)
+{
+    untransposeBitsRange(input, planeStride, 0, bytes, output);
+}
+
+#if SHUFFLE_X86_SIMD
+
+// vpmovmskb takes the top bit of 32 bytes at once: 4 bytes of plane 7.
+// Adding the register to itself moves the next bit up for the next plane.
+SHUFFLE_TARGET("avx2")
+static void transposeBitsAVX2(const std::uint8_t * input, const int bytes, const int planeStride, std::uint8_t * output)
+{
+    int offset = 0;
+    for (; offset + 32 <= bytes; offset += 32)
+    {
+        __m256i v = load256(input + offset);
+        for (int k = 7; k >= 0; --k)
+        {
+            const std::uint32_t bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(v));
+            std::memcpy(output + k * planeStride + offset / 8, &bits, sizeof(bits));
+            v = _mm256_add_epi8(v, v);
+        }
+    }
+
+    SHUFFLE_STATS_ADD(simdBytes, offset);
+    transposeBitsRange(input, offset / 8, bytes, planeStride, output);
+}
+
+// Four 8x8 matrices at a time: 4 bytes from each plane, regrouped so that
+// each qword holds byte g of every plane, then transposed as in transpose8x8.
+SHUFFLE_TARGET("avx2")
+static void untransposeBitsAVX2(const std::uint8_t * input, const int planeStride, const int bytes, std::uint8_t * output)
+{
+    const __m256i mask = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                          0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256i mask7  = _mm256_set1_epi64x(0x00AA00AA00AA00AAll);
+    const __m256i mask14 = _mm256_set1_epi64x(0x0000CCCC0000CCCCll);
+    const __m256i mask28 = _mm256_set1_epi64x(0x00000000F0F0F0F0ll);
+
+    int offset = 0;
+    for (; offset + 32 <= bytes; offset += 32)
+    {
+        std::uint32_t planes[8];
+        for (int k = 0; k < 8; ++k)
+        {
+            std::memcpy(&planes[k], input + k * planeStride + offset / 8, sizeof(planes[k]));
+        }
+
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(planes));
+        x = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(x, mask), order);
+
+        __m256i t;
+        t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 7)), mask7);
+        x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 7)));
+        t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 14)), mask14);
+        x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 14)));
+        t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 28)), mask28);
+        x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 28)));
+
+        store256(output + offset, x);
+    }
+
+    SHUFFLE_STATS_ADD(simdBytes, offset);
+    untransposeBitsRange(input, planeStride, offset / 8, bytes, output);
+}
+
+#endif // SHUFFLE_X86_SIMD
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+struct Kernels
+{
+    ShuffleBytesFunc    shuffleBytes;
+    UnshuffleBytesFunc  unshuffleBytes;
+    TransposeBitsFunc   transposeBits;
+    UntransposeBitsFunc untransposeBits;
+};
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.shuffleBytes    = &shuffleBytesScalar;
+    kernels.unshuffleBytes  = &unshuffleBytesScalar;
+    kernels.transposeBits   = &transposeBitsScalar;
+    kernels.untransposeBits = &untransposeBitsScalar;
+
+    #if SHUFFLE_X86_SIMD
+    if (features.avx2)
+    {
+        kernels.shuffleBytes    = &shuffleBytesAVX2;
+        kernels.unshuffleBytes  = &unshuffleBytesAVX2;
+        kernels.transposeBits   = &transposeBitsAVX2;
+        kernels.untransposeBits = &untransposeBitsAVX2;
+    }
+    #else // !SHUFFLE_X86_SIMD
+    (void)features;
+    #endif // SHUFFLE_X86_SIMD
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.avx2 = features.avx2 && detected.avx2;
+
+    kernelsInstance() = selectKernels(current);
+}
+
+// ========================================================
+// Public interface:
+// ========================================================
+
+static bool validArguments(const std::uint8_t * input, const int sizeBytes, const int typeSize,
+                           const std::uint8_t * output, const int outSizeBytes)
+{
+    return input != nullptr && output != nullptr && sizeBytes >= 0 && outSizeBytes >= sizeBytes &&
+           typeSize > 0 && typeSize <= MaxTypeSize;
+}
+
+int byteShuffle(const std::uint8_t * input, const int sizeBytes, const int typeSize,
+                std::uint8_t * output, const int outSizeBytes)
+{
+    if (!validArguments(input, sizeBytes, typeSize, output, outSizeBytes))
+    {
+        return -1;
+    }
+
+    SHUFFLE_STATS_ADD(shuffleCalls, 1);
+    SHUFFLE_STATS_ADD(bytesShuffled, sizeBytes);
+
+    const int count = sizeBytes / typeSize;
+    kernelsInstance().shuffleBytes(input, count, typeSize, count, output);
+    std::memcpy(output + count * typeSize, input + count * typeSize, sizeBytes - count * typeSize);
+    return sizeBytes;
+}
+
+int byteUnshuffle(const std::uint8_t * input, const int sizeBytes, const int typeSize,
+                  std::uint8_t * output, const int outSizeBytes)
+{
+    if (!validArguments(input, sizeBytes, typeSize, output, outSizeBytes))
+    {
+        return -1;
+    }
+
+    SHUFFLE_STATS_ADD(unshuffleCalls, 1);
+    SHUFFLE_STATS_ADD(bytesUnshuffled, sizeBytes);
+
+    const int count = sizeBytes / typeSize;
+    kernelsInstance().unshuffleBytes(input, count, typeSize, count, output);
+    std::memcpy(output + count * typeSize, input + count * typeSize, sizeBytes - count * typeSize);
+    return sizeBytes;
+}
+
+//
+// The bit shuffle byte shuffles a block of elements into a scratch buffer,
+// then splits each of its byte streams into the stream's 8 bit planes in
+// the output. Stream j covers count bytes of the output, from j * count,
+// 'count' being the number of elements rounded down to a multiple of 8.
+//
+
+int bitShuffle(const std::uint8_t * input, const int sizeBytes, const int typeSize,
+               std::uint8_t * output, const int outSizeBytes)
+{
+    if (!validArguments(input, sizeBytes, typeSize, output, outSizeBytes))
+    {
+        return -1;
+    }
+
+    SHUFFLE_STATS_ADD(shuffleCalls, 1);
+    SHUFFLE_STATS_ADD(bytesShuffled, sizeBytes);
+
+    const Kernels & kernels = kernelsInstance();
+    const int count = (sizeBytes / typeSize) & ~7;
+    const int blockCount = (ScratchBytes / typeSize) & ~31;
+    const int planeStride = count / 8;
+    std::uint8_t scratch[ScratchBytes];
+
+    for (int first = 0; first < count; first += blockCount)
+    {
+        const int n = (count - first < blockCount) ? count - first : blockCount;
+        kernels.shuffleBytes(input + first * typeSize, n, typeSize, n, scratch);
+        for (int j = 0; j < typeSize; ++j)
+        {
+            kernels.transposeBits(scratch + j * n, n, planeStride, output + j * count + first / 8);
+        }
+    }
+
+    std::memcpy(output + count * typeSize, input + count * typeSize, sizeBytes - count * typeSize);
+    return sizeBytes;
+}
+
+int bitUnshuffle(const std::uint8_t * input, const int sizeBytes, const int typeSize,
+                 std::uint8_t * output, const int outSizeBytes)
+{
+    if (!validArguments(input, sizeBytes, typeSize, output, outSizeBytes))
+    {
+        return -1;
+    }
+
+    SHUFFLE_STATS_ADD(unshuffleCalls, 1);
+    SHUFFLE_STATS_ADD(bytesUnshuffled, sizeBytes);
+
+    const Kernels & kernels = kernelsInstance();
+    const int count = (sizeBytes / typeSize) & ~7;
+    const int blockCount = (ScratchBytes / typeSize) & ~31;
+    const int planeStride = count / 8;
+    std::uint8_t scratch[ScratchBytes];
+
+    for (int first = 0; first < count; first += blockCount)
+    {
+        const int n = (count - first < blockCount) ? count - first : blockCount;
+        for (int j = 0; j < typeSize; ++j)
+        {
+            kernels.untransposeBits(input + j * count + first / 8, planeStride, n, scratch + j * n);
+        }
+        kernels.unshuffleBytes(scratch, n, typeSize, n, output + first * typeSize);
+    }
+
+    std::memcpy(output + count * typeSize, input + count * typeSize, sizeBytes - count * typeSize);
+    return sizeBytes;
+}
+
+int toPlanar(const std::uint8_t * pixels, const int pixelCount, const int channels,
+             std::uint8_t * planes, const int planesSizeBytes)
+{
+    if (pixelCount < 0 || channels <= 0 || channels > MaxTypeSize ||
+        static_cast<std::int64_t>(pixelCount) * channels > 0x7FFFFFFF)
+    {
+        return -1;
+    }
+    return byteShuffle(pixels, pixelCount * channels, channels, planes, planesSizeBytes);
+}
+
+int fromPlanar(const std::uint8_t * planes, const int pixelCount, const int channels,
+               std::uint8_t * pixels, const int pixelsSizeBytes)
+{
+    if (pixelCount < 0 || channels <= 0 || channels > MaxTypeSize ||
+        static_cast<std::int64_t>(pixelCount) * channels > 0x7FFFFFFF)
+    {
+        return -1;
+    }
+    return byteUnshuffle(planes, pixelCount * channels, channels, pixels, pixelsSizeBytes);
+}
+
+} // namespace shuffle {}
+
+// ================ End of implementation =================
+#endif // SHUFFLE_IMPLEMENTATION
+// ================ End of implementation =================
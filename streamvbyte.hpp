@@ -0,0 +1,675 @@
+// ================================================================================================
+// -*- C++ -*-
+// File: streamvbyte.hpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: Stream VByte, byte-aligned variable length coding of 32-bit integers.
+//        https://arxiv.org/abs/1709.08990
+// ================================================================================================
+
+#ifndef STREAMVBYTE_HPP
+#define STREAMVBYTE_HPP
+
+// ---------
+//  LICENSE
+// ---------
+// This software is in the public domain. Where that dedication is not recognized,
+// you are granted a perpetual, irrevocable license to copy, distribute, and modify
+// this file as you see fit.
+//
+// The source code is provided "as is", without warranty of any kind, express or implied.
+// No attribution is required, but a mention about the author is appreciated.
+//
+// -------
+//  SETUP
+// -------
+// #define STREAMVBYTE_IMPLEMENTATION in one source file before including
+// this file, then use streamvbyte.hpp as a normal header file elsewhere.
+//
+// The decoding loop is dispatched at runtime to SSSE3 or AVX2 versions
+// when the CPU supports them, so a single binary built without -march
+// flags still uses the widest kernels.
+// #define STREAMVBYTE_NO_SIMD to always use the portable scalar code.
+//
+// ----------
+//  OVERVIEW
+// ----------
+// Each integer is stored in 1 to 4 bytes, its least significant bytes,
+// like the classic VByte/varint formats. Unlike those, the lengths are
+// not mixed with the data: they go in a separate control stream, 2 bits
+// per integer, so one control byte describes 4 integers. The decoder
+// looks the control byte up in a table of shuffle masks and expands the
+// 4 integers with a single byte shuffle, with no branches on the data.
+//
+// Optionally the integers are delta coded (for sorted lists such as
+// postings) and/or zigzag coded (for signed values of small magnitude)
+// before going in the stream. The decoder reverses both in registers.
+//
+// Stream layout:
+//
+//   u32 integer count (little-endian)
+//   u8  Transform
+//   (count + 3) / 4 control bytes, lengths - 1 of 4 integers, first in the low bits
+//   the integer bytes, little-endian
+//
+
+#include <cstdint>
+
+namespace streamvbyte
+{
+
+// The decoder expands groups of integers with pshufb: 4 at a time with
+// SSSE3, 8 with AVX2. Detected once; all false with STREAMVBYTE_NO_SIMD
+// or when not compiling for x86/x64.
+struct CpuFeatures
+{
+    bool ssse3 = false;
+    bool avx2  = false;
+};
+
+// Features in use by the decoding kernels.
+const CpuFeatures & getCpuFeatures();
+
+// Restricts the decoder to a subset of the detected features, e.g. SSSE3
+// only. Not thread safe; call it before decoding.
+void setCpuFeatures(const CpuFeatures & features);
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+// Integer and data byte counts; their ratio is the mean encoded size.
+// Needs STREAMVBYTE_ENABLE_STATS defined with STREAMVBYTE_IMPLEMENTATION.
+// Kept per thread.
+struct Stats
+{
+    std::uint64_t encodeCalls     = 0; // easyEncode() calls.
+    std::uint64_t decodeCalls     = 0; // easyDecode() calls.
+    std::uint64_t integersEncoded = 0; // Integers consumed by the encoder.
+    std::uint64_t integersDecoded = 0; // Integers produced by the decoder.
+    std::uint64_t dataBytes       = 0; // Bytes of the data stream written by the encoder (no control bytes).
+};
+
+// Counters of the calling thread; resetStats() clears them.
+const Stats & getStats();
+void resetStats();
+
+// Applied to the integers before they are stored.
+enum class Transform : std::uint8_t
+{
+    None        = 0,
+    Delta       = 1, // Differences between neighbours, for sorted lists. Wraps around on decreasing values.
+    ZigZag      = 2, // Signed values (cast to uint32) mapped to 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4...
+    DeltaZigZag = 3  // Both, for lists that go up and down by small amounts.
+};
+
+// Size of the largest possible output of easyEncode() for 'count' integers.
+int maxEncodedSize(int count);
+
+// Encodes 'count' integers into 'output', which should have room for
+// maxEncodedSize(count) bytes. Returns the bytes written or -1 on error.
+int easyEncode(const std::uint32_t * input, int count, std::uint8_t * output, int outSizeBytes,
+               Transform transform = Transform::None);
+
+// Number of integers in the output of easyEncode(), or -1 if the input is not valid.
+int getDecodedCount(const std::uint8_t * input, int inSizeBytes);
+
+// Decodes the output of easyEncode(), undoing its Transform. Returns the
+// number of integers written to 'output', or -1 if the input is corrupt
+// or the output can't hold getDecodedCount() integers.
+int easyDecode(const std::uint8_t * input, int inSizeBytes, std::uint32_t * output, int outCount);
+
+} // namespace streamvbyte {}
+
+// ================== End of header file ==================
+#endif // STREAMVBYTE_HPP
+// ================== End of header file ==================
+
+// ================================================================================================
+//
+//                                  Stream VByte Implementation
+//
+// ================================================================================================
+
+#ifdef STREAMVBYTE_IMPLEMENTATION
+
+#include <cstring>
+
+#if !defined(STREAMVBYTE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define STREAMVBYTE_X86_SIMD 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define STREAMVBYTE_TARGET(isa)
+    #else // GCC/Clang
+        #include <cpuid.h>
+        #define STREAMVBYTE_TARGET(isa) __attribute__((target(isa)))
+    #endif // _MSC_VER
+#else // !x86
+    #define STREAMVBYTE_X86_SIMD 0
+#endif // x86
+
+namespace streamvbyte
+{
+
+constexpr int StreamHeaderBytes = 5;
+
+// ========================================================
+// Instrumentation:
+// ========================================================
+
+static Stats & statsInstance()
+{
+    static thread_local Stats stats;
+    return stats;
+}
+
+const Stats & getStats()
+{
+    return statsInstance();
+}
+
+void resetStats()
+{
+    statsInstance() = Stats{};
+}
+
+#ifdef STREAMVBYTE_ENABLE_STATS
+    #define STREAMVBYTE_STATS_ADD(counter, amount) (statsInstance().counter += static_cast<std::uint64_t>(amount))
+#else // !STREAMVBYTE_ENABLE_STATS
+    #define STREAMVBYTE_STATS_ADD(counter, amount) ((void)0)
+#endif // STREAMVBYTE_ENABLE_STATS
+
+// ========================================================
+// Runtime CPU feature detection:
+// ========================================================
+
+#if STREAMVBYTE_X86_SIMD
+
+static void cpuid(const unsigned leaf, const unsigned subLeaf, unsigned regs[4])
+{
+    #if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i) { regs[i] = static_cast<unsigned>(r[i]); }
+    #else // GCC/Clang
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif // _MSC_VER
+}
+
+// XCR0 tells us which register files the OS saves on context switches.
+static std::uint64_t readXCR0()
+{
+    #if defined(_MSC_VER)
+    return _xgetbv(0);
+    #else // GCC/Clang
+    std::uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (std::uint64_t(edx) << 32) | eax;
+    #endif // _MSC_VER
+}
+
+#endif // STREAMVBYTE_X86_SIMD
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+    #if STREAMVBYTE_X86_SIMD
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    const unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    features.ssse3 = (regs[2] & (1u << 9)) != 0;
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+
+    // The 8-wide decoder also needs the OS to save the YMM registers.
+    const std::uint64_t xcr0 = ((regs[2] & (1u << 27)) != 0) ? readXCR0() : 0;
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, regs);
+        features.avx2 = avx && (xcr0 & 0x06) == 0x06 && (regs[1] & (1u << 5)) != 0;
+    }
+    #endif // STREAMVBYTE_X86_SIMD
+
+    return features;
+}
+
+static CpuFeatures & cpuFeaturesInstance()
+{
+    static CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+const CpuFeatures & getCpuFeatures()
+{
+    return cpuFeaturesInstance();
+}
+
+// ========================================================
+// Helpers:
+// ========================================================
+
+static std::uint32_t loadU32(const std::uint8_t * bytes)
+{
+    std::uint32_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap32(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    return word;
+}
+
+static void storeU32(std::uint8_t * bytes, std::uint32_t word)
+{
+    #if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap32(word);
+    #endif // __ORDER_BIG_ENDIAN__
+    std::memcpy(bytes, &word, sizeof(word));
+}
+
+static std::uint32_t zigZagEncode(const std::uint32_t value)
+{
+    return (value << 1) ^ static_cast<std::uint32_t>(static_cast<std::int32_t>(value) >> 31);
+}
+
+static std::uint32_t zigZagDecode(const std::uint32_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+// Bytes needed to store 'value', 1 to 4.
+static int byteLength(const std::uint32_t value)
+{
+    return (value < (1u << 8)) ? 1 : (value < (1u << 16)) ? 2 : (value < (1u << 24)) ? 3 : 4;
+}
+
+// ========================================================
+// Control byte tables:
+// ========================================================
+
+#if STREAMVBYTE_X86_SIMD
+
+// For each control byte: the data bytes of its 4 integers, and the pshufb mask
+// that moves them to 4 32-bit lanes (0x80 = zero byte). Built on first use,
+// only by the SIMD kernels.
+struct ControlTables
+{
+    std::uint8_t lengths[256];
+    std::uint8_t shuffles[256][16];
+
+    ControlTables()
+    {
+        for (int control = 0; control < 256; ++control)
+        {
+            int offset = 0;
+            for (int v = 0; v < 4; ++v)
+            {
+                const int length = ((control >> (v * 2)) & 3) + 1;
+                for (int b = 0; b < 4; ++b)
+                {
+                    shuffles[control][v * 4 + b] = static_cast<std::uint8_t>((b < length) ? offset + b : 0x80);
+                }
+                offset += length;
+            }
+            lengths[control] = static_cast<std::uint8_t>(offset);
+        }
+    }
+};
+
+static const ControlTables & controlTables()
+{
+    static const ControlTables tables;
+    return tables;
+}
+
+#endif // STREAMVBYTE_X86_SIMD
+
+// ========================================================
+// Decoding kernels:
+// ========================================================
+
+//
+// Each kernel decodes whole groups of 4 integers while it can load its
+// vectors without reading past 'dataEnd'. It returns the groups decoded,
+// with 'data' moved past them, and leaves the rest to the scalar loop.
+// 'previous' is the last integer decoded, the base for Delta.
+//
+using DecodeQuadsFunc = int (*)(const std::uint8_t * control, int quadCount, const std::uint8_t *& data,
+                                const std::uint8_t * dataEnd, std::uint32_t * output, Transform transform,
+                                std::uint32_t & previous);
+
+// Decodes one integer at a time. Returns false if the data ran out.
+static bool decodeScalar(const std::uint8_t * control, const int count, const std::uint8_t *& data,
+                         const std::uint8_t * dataEnd, std::uint32_t * output, const Transform transform,
+                         std::uint32_t & previous)
+{
+    const bool delta  = (static_cast<int>(transform) & static_cast<int>(Transform::Delta))  != 0;
+    const bool zigZag = (static_cast<int>(transform) & static_cast<int>(Transform::ZigZag)) != 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const int length = ((control[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+        if (dataEnd - data < length)
+        {
+            return false;
+        }
+
+        // One load and a mask while 4 bytes can be read, byte by byte near the end.
+        std::uint32_t value = 0;
+        if (dataEnd - data >= 4)
+        {
+            value = loadU32(data) & (0xFFFFFFFF >> ((4 - length) * 8));
+        }
+        else
+        {
+            for (int b = 0; b < length; ++b)
+            {
+                value |= std::uint32_t(data[b]) << (b * 8);
+            }
+        }
+        data += length;
+
+        value = zigZag ? zigZagDecode(value) : value;
+        value = delta  ? previous + value    : value;
+        output[i] = value;
+        previous  = value;
+    }
+    return true;
+}
+
+static int decodeQuadsScalar(const std::uint8_t *, int, const std::uint8_t *&, const std::uint8_t *,
+                             std::uint32_t *, Transform, std::uint32_t &)
+{
+    // All done by decodeScalar().
+    return 0;
+}
+
+#if STREAMVBYTE_X86_SIMD
+
+template<bool Delta, bool ZigZag>
+STREAMVBYTE_TARGET("ssse3")
+static int decodeQuadsSSSE3T(const std::uint8_t * control, const int quadCount, const std::uint8_t *& data,
+                             const std::uint8_t * dataEnd, std::uint32_t * output, std::uint32_t & previous)
+{
+    const ControlTables & tables = controlTables();
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i prev = _mm_set1_epi32(static_cast<int>(previous));
+    const std::uint8_t * in = data;
+
+    int q = 0;
+    for (; q < quadCount && dataEnd - in >= 16; ++q)
+    {
+        const int c = control[q];
+        const __m128i bytes   = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tables.shuffles[c]));
+        __m128i x = _mm_shuffle_epi8(bytes, shuffle);
+        in += tables.lengths[c];
+
+        if (ZigZag)
+        {
+            x = _mm_xor_si128(_mm_srli_epi32(x, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(x, one)));
+        }
+        if (Delta)
+        {
+            // Inclusive prefix sum of the 4 lanes, plus the last value of the previous group.
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, prev);
+            prev = _mm_shuffle_epi32(x, 0xFF);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + q * 4), x);
+    }
+
+    if (Delta && q > 0)
+    {
+        previous = static_cast<std::uint32_t>(_mm_cvtsi128_si32(prev));
+    }
+    data = in;
+    return q;
+}
+
+STREAMVBYTE_TARGET("ssse3")
+static int decodeQuadsSSSE3(const std::uint8_t * control, const int quadCount, const std::uint8_t *& data,
+                            const std::uint8_t * dataEnd, std::uint32_t * output, const Transform transform,
+                            std::uint32_t & previous)
+{
+    switch (transform)
+    {
+    case Transform::Delta       : return decodeQuadsSSSE3T<true,  false>(control, quadCount, data, dataEnd, output, previous);
+    case Transform::ZigZag      : return decodeQuadsSSSE3T<false, true >(control, quadCount, data, dataEnd, output, previous);
+    case Transform::DeltaZigZag : return decodeQuadsSSSE3T<true,  true >(control, quadCount, data, dataEnd, output, previous);
+    default                     : return decodeQuadsSSSE3T<false, false>(control, quadCount, data, dataEnd, output, previous);
+    } // switch
+}
+
+// Same as above, two groups of 4 per step, one in each 128-bit half.
+// The second group's bytes start where the first group's end.
+template<bool Delta, bool ZigZag>
+STREAMVBYTE_TARGET("avx2")
+static int decodeQuadsAVX2T(const std::uint8_t * control, const int quadCount, const std::uint8_t *& data,
+                            const std::uint8_t * dataEnd, std::uint32_t * output, std::uint32_t & previous)
+{
+    const ControlTables & tables = controlTables();
+    const __m256i one     = _mm256_set1_epi32(1);
+    const __m256i lastIdx = _mm256_set1_epi32(7);
+    __m256i prev = _mm256_set1_epi32(static_cast<int>(previous));
+    const std::uint8_t * in = data;
+
+    int q = 0;
+    for (; q + 2 <= quadCount && dataEnd - in >= 32; q += 2)
+    {
+        const int c0 = control[q];
+        const int c1 = control[q + 1];
+        const std::uint8_t * in1 = in + tables.lengths[c0];
+
+        const __m256i bytes = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in1)), 1);
+        const __m256i shuffle = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tables.shuffles[c0]))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(tables.shuffles[c1])), 1);
+        __m256i x = _mm256_shuffle_epi8(bytes, shuffle);
+        in = in1 + tables.lengths[c1];
+
+        if (ZigZag)
+        {
+            x = _mm256_xor_si256(_mm256_srli_epi32(x, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(x, one)));
+        }
+        if (Delta)
+        {
+            // Prefix sums within each half, then carry the low half's total into the high half.
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+            const __m256i lowTotal = _mm256_permute2x128_si256(_mm256_shuffle_epi32(x, 0xFF), _mm256_shuffle_epi32(x, 0xFF), 0x08);
+            x = _mm256_add_epi32(_mm256_add_epi32(x, lowTotal), prev);
+            prev = _mm256_permutevar8x32_epi32(x, lastIdx);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + q * 4), x);
+    }
+
+    if (Delta && q > 0)
+    {
+        previous = static_cast<std::uint32_t>(_mm256_cvtsi256_si32(prev));
+    }
+    data = in;
+    return q;
+}
+
+STREAMVBYTE_TARGET("avx2")
+static int decodeQuadsAVX2(const std::uint8_t * control, const int quadCount, const std::uint8_t *& data,
+                           const std::uint8_t * dataEnd, std::uint32_t * output, const Transform transform,
+                           std::uint32_t & previous)
+{
+    int done;
+    switch (transform)
+    {
+    case Transform::Delta       : done = decodeQuadsAVX2T<true,  false>(control, quadCount, data, dataEnd, output, previous); break;
+    case Transform::ZigZag      : done = decodeQuadsAVX2T<false, true >(control, quadCount, data, dataEnd, output, previous); break;
+    case Transform::DeltaZigZag : done = decodeQuadsAVX2T<true,  true >(control, quadCount, data, dataEnd, output, previous); break;
+    default                     : done = decodeQuadsAVX2T<false, false>(control, quadCount, data, dataEnd, output, previous); break;
+    } // switch
+
+    // An odd group out, or the last ones closer than 32 bytes to the end.
+    return done + decodeQuadsSSSE3(control + done, quadCount - done, data, dataEnd,
+                                   output + done * 4, transform, previous);
+}
+
+#endif // STREAMVBYTE_X86_SIMD
+
+// ========================================================
+// Kernel dispatch table:
+// ========================================================
+
+struct Kernels
+{
+    DecodeQuadsFunc decodeQuads;
+};
+
+static Kernels selectKernels(const CpuFeatures & features)
+{
+    Kernels kernels;
+    kernels.decodeQuads = &decodeQuadsScalar;
+
+    #if STREAMVBYTE_X86_SIMD
+    if (features.avx2)
+    {
+        kernels.decodeQuads = &decodeQuadsAVX2;
+    }
+    else if (features.ssse3)
+    {
+        kernels.decodeQuads = &decodeQuadsSSSE3;
+    }
+    #else // !STREAMVBYTE_X86_SIMD
+    (void)features;
+    #endif // STREAMVBYTE_X86_SIMD
+
+    return kernels;
+}
+
+static Kernels & kernelsInstance()
+{
+    static Kernels kernels = selectKernels(getCpuFeatures());
+    return kernels;
+}
+
+void setCpuFeatures(const CpuFeatures & features)
+{
+    const CpuFeatures detected = detectCpuFeatures();
+    CpuFeatures & current = cpuFeaturesInstance();
+
+    current.ssse3 = features.ssse3 && detected.ssse3;
+    current.avx2  = features.avx2  && detected.avx2;
+
+    kernelsInstance() = selectKernels(current);
+}
+
+// ========================================================
+// easyEncode() / easyDecode():
+// ========================================================
+
+int maxEncodedSize(const int count)
+{
+    return StreamHeaderBytes + (count + 3) / 4 + count * 4;
+}
+
+int easyEncode(const std::uint32_t * input, const int count, std::uint8_t * output,
+               const int outSizeBytes, const Transform transform)
+{
+    if ((input == nullptr && count > 0) || output == nullptr)
+    {
+        return -1;
+    }
+    if (count < 0 || outSizeBytes < maxEncodedSize(count) || static_cast<int>(transform) > 3)
+    {
+        return -1;
+    }
+
+    STREAMVBYTE_STATS_ADD(encodeCalls, 1);
+    STREAMVBYTE_STATS_ADD(integersEncoded, count);
+
+    const bool delta  = (static_cast<int>(transform) & static_cast<int>(Transform::Delta))  != 0;
+    const bool zigZag = (static_cast<int>(transform) & static_cast<int>(Transform::ZigZag)) != 0;
+
+    storeU32(output, static_cast<std::uint32_t>(count));
+    output[4] = static_cast<std::uint8_t>(transform);
+
+    std::uint8_t * control = output + StreamHeaderBytes;
+    std::uint8_t * data = control + (count + 3) / 4;
+    std::memset(control, 0, (count + 3) / 4);
+
+    std::uint32_t previous = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        std::uint32_t value = input[i];
+        if (delta)
+        {
+            const std::uint32_t difference = value - previous;
+            previous = value;
+            value = difference;
+        }
+        value = zigZag ? zigZagEncode(value) : value;
+
+        // Stores all 4 bytes and keeps 'length' of them. The output
+        // has room for that since every integer could take 4 bytes.
+        const int length = byteLength(value);
+        storeU32(data, value);
+        data += length;
+        control[i >> 2] |= static_cast<std::uint8_t>((length - 1) << ((i & 3) * 2));
+    }
+
+    STREAMVBYTE_STATS_ADD(dataBytes, data - (control + (count + 3) / 4));
+    return static_cast<int>(data - output);
+}
+
+int getDecodedCount(const std::uint8_t * input, const int inSizeBytes)
+{
+    if (input == nullptr || inSizeBytes < StreamHeaderBytes)
+    {
+        return -1;
+    }
+
+    const std::uint32_t count = loadU32(input);
+    if (count > 0x7FFFFFFF || input[4] > 3)
+    {
+        return -1;
+    }
+    return (static_cast<std::int64_t>(count) + 3) / 4 <= inSizeBytes - StreamHeaderBytes ? static_cast<int>(count) : -1;
+}
+
+int easyDecode(const std::uint8_t * input, const int inSizeBytes, std::uint32_t * output, const int outCount)
+{
+    const int count = getDecodedCount(input, inSizeBytes);
+    if (count < 0 || count > outCount || (output == nullptr && count > 0))
+    {
+        return -1;
+    }
+
+    STREAMVBYTE_STATS_ADD(decodeCalls, 1);
+
+    const Transform transform = static_cast<Transform>(input[4]);
+    const std::uint8_t * control = input + StreamHeaderBytes;
+    const std::uint8_t * data = control + (count + 3) / 4;
+    const std::uint8_t * dataEnd = input + inSizeBytes;
+
+    // Whole groups of 4 in the vector kernels, the rest one by one.
+    std::uint32_t previous = 0;
+    const int quadsDone = kernelsInstance().decodeQuads(control, count / 4, data, dataEnd, output, transform, previous);
+    const int done = quadsDone * 4;
+
+    if (!decodeScalar(control + quadsDone, count - done, data, dataEnd, output + done, transform, previous))
+    {
+        return -1;
+    }
+
+    STREAMVBYTE_STATS_ADD(integersDecoded, count);
+    return count;
+}
+
+} // namespace streamvbyte {}
+
+// ================ End of implementation =================
+#endif // STREAMVBYTE_IMPLEMENTATION
+// ================ End of implementation =================
@@ -0,0 +1,723 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: benchmark.cpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: Throughput benchmarks and regression gate for the data compression algorithms.
+//
+// This source code is in the public domain.
+// You are free to do whatever you want with it.
+//
+// Compile with:
+// c++ -std=c++11 -O3 -Wall -Wextra -Wshadow -pedantic -pthread -I.. benchmark.cpp -o benchmark
+//
+// Usage:
+//  benchmark                        Run every codec over the corpus and print a table.
+//  benchmark --save <file>          Also store the results as the new baseline.
+//  benchmark --check <file>         Compare against a stored baseline. Exits with 1 if the
+//                                   throughput of any case dropped by more than the threshold,
+//                                   if any compressed size grew, or if a case is missing from
+//                                   either side.
+//  benchmark --threshold <percent>  Allowed throughput drop for --check (default 15).
+//  benchmark --fuzz <count>         Also round-trip <count> randomly generated inputs per codec.
+//  benchmark --counters             Also read the hardware performance counters (Linux only) and
+//                                   print cycles/byte, IPC, branch misses and LLC misses per case.
+//
+// Compressed sizes are deterministic, so any growth is a regression. Throughput depends
+// on the machine, so a baseline is only meaningful for the machine that recorded it.
+// Baseline lines may leave the two throughput columns out, and then only the sizes are
+// checked. That is how tests/benchmark_baseline.txt is committed, so it holds anywhere.
+//
+// The counters come from perf_event_open() and only count user space. If the kernel refuses
+// them (perf_event_paranoid, containers, VMs without a virtual PMU) the benchmark says so and
+// carries on with the timings. Counters it lacks are shown as '-'.
+// ================================================================================================
+
+#define RLE_IMPLEMENTATION
+#include "rle.hpp"
+
+#define LZW_IMPLEMENTATION
+#include "lzw.hpp"
+
+#define HUFFMAN_IMPLEMENTATION
+#include "huffman.hpp"
+
+#define RICE_IMPLEMENTATION
+#include "rice.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+    #include <cerrno>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #define BENCHMARK_HAS_PERF_EVENTS 1
+#else // !__linux__
+    #define BENCHMARK_HAS_PERF_EVENTS 0
+#endif // __linux__
+
+#include "corpus.hpp"
+#include "lenna_tga.hpp"
+
+// ========================================================
+// Codec adapters:
+// ========================================================
+
+// Common signature for the four codecs. Encoders return the compressed size
+// in bytes (-1 on failure) and the exact bit count in 'compressedBits'.
+struct Codec
+{
+    const char * name;
+    int (*encode)(const std::uint8_t * input, int inputSize, std::vector<std::uint8_t> & output, int & compressedBits);
+    int (*decode)(const std::uint8_t * input, int inputBytes, int inputBits, std::uint8_t * output, int outputSize);
+};
+
+static int rleEncode(const std::uint8_t * input, const int inputSize, std::vector<std::uint8_t> & output, int & compressedBits)
+{
+    output.resize(inputSize * 4 + 16); // RLE might make things bigger.
+    const int size = rle::easyEncode(input, inputSize, output.data(), static_cast<int>(output.size()));
+    compressedBits = size * 8;
+    return size;
+}
+
+static int rleDecode(const std::uint8_t * input, const int inputBytes, int, std::uint8_t * output, const int outputSize)
+{
+    return rle::easyDecode(input, inputBytes, output, outputSize);
+}
+
+// LZW, Huffman and Rice share the same easyEncode()/easyDecode() signatures.
+#define DEFINE_BIT_CODEC_ADAPTERS(ns, freeFunc)                                                               \
+    static int ns##Encode(const std::uint8_t * input, const int inputSize,                                    \
+                          std::vector<std::uint8_t> & output, int & compressedBits)                           \
+    {                                                                                                         \
+        std::uint8_t * compressed = nullptr;                                                                  \
+        int compressedBytes = 0;                                                                              \
+        ns::easyEncode(input, inputSize, &compressed, &compressedBytes, &compressedBits);                     \
+        output.assign(compressed, compressed + compressedBytes);                                              \
+        freeFunc(compressed);                                                                                 \
+        return compressedBytes;                                                                               \
+    }                                                                                                         \
+    static int ns##Decode(const std::uint8_t * input, const int inputBytes, const int inputBits,              \
+                          std::uint8_t * output, const int outputSize)                                        \
+    {                                                                                                         \
+        return ns::easyDecode(input, inputBytes, inputBits, output, outputSize);                              \
+    }
+
+DEFINE_BIT_CODEC_ADAPTERS(lzw,     LZW_MFREE)
+DEFINE_BIT_CODEC_ADAPTERS(huffman, HUFFMAN_MFREE)
+DEFINE_BIT_CODEC_ADAPTERS(rice,    RICE_MFREE)
+
+#undef DEFINE_BIT_CODEC_ADAPTERS
+
+// Segmented Huffman streams decoded with one thread per hardware thread.
+static int huffmanSegEncode(const std::uint8_t * input, const int inputSize,
+                            std::vector<std::uint8_t> & output, int & compressedBits)
+{
+    std::uint8_t * compressed = nullptr;
+    int compressedBytes = 0;
+    huffman::easyEncodeSegmented(input, inputSize, &compressed, &compressedBytes, &compressedBits);
+    output.assign(compressed, compressed + compressedBytes);
+    HUFFMAN_MFREE(compressed);
+    return compressedBytes;
+}
+
+// Single stream Huffman decoded speculatively with one thread per hardware thread.
+static int huffmanSpecDecode(const std::uint8_t * input, const int inputBytes, const int inputBits,
+                             std::uint8_t * output, const int outputSize)
+{
+    return huffman::easyDecodeParallel(input, inputBytes, inputBits, output, outputSize);
+}
+
+static int huffmanSegDecode(const std::uint8_t * input, const int inputBytes, const int inputBits,
+                            std::uint8_t * output, const int outputSize)
+{
+    return huffman::easyDecodeParallel(input, inputBytes, inputBits, output, outputSize);
+}
+
+static const Codec codecs[] = {
+    { "rle",       &rleEncode,        &rleDecode         },
+    { "lzw",       &lzwEncode,        &lzwDecode         },
+    { "huffman",   &huffmanEncode,    &huffmanDecode     },
+    { "huff_spec", &huffmanEncode,    &huffmanSpecDecode },
+    { "huff_seg",  &huffmanSegEncode, &huffmanSegDecode  },
+    { "rice",      &riceEncode,       &riceDecode        },
+};
+
+// ========================================================
+// Hardware performance counters:
+// ========================================================
+
+enum Counter
+{
+    Cycles,
+    Instructions,
+    BranchMisses,
+    LlcMisses,
+    CounterCount
+};
+
+// Counts of one measured call. -1 for counters that could not be opened.
+struct CounterValues
+{
+    std::int64_t values[CounterCount] = { -1, -1, -1, -1 };
+};
+
+// One perf_event_open() file descriptor per counter, user space only. They also
+// count threads started later, for the parallel Huffman decoders. They are not
+// grouped, so a counter the PMU lacks (LLC misses are often missing in VMs)
+// doesn't take the others down with it.
+class PerfCounters final
+{
+public:
+
+    // No copy/assignment.
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters & operator = (const PerfCounters &) = delete;
+
+    PerfCounters()
+    {
+        for (int c = 0; c < CounterCount; ++c)
+        {
+            fds[c] = -1;
+        }
+    }
+
+    ~PerfCounters()
+    {
+        close();
+    }
+
+    // Opens whatever counters the kernel allows. False, with the reason in
+    // 'error', if none of them could be opened.
+    bool open(std::string & error)
+    {
+        #if BENCHMARK_HAS_PERF_EVENTS
+        static const std::uint64_t configs[CounterCount] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_MISSES // Last level cache misses on most CPUs.
+        };
+
+        int firstErrno = 0;
+        for (int c = 0; c < CounterCount; ++c)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.config         = configs[c];
+            attr.disabled       = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.inherit        = 1;
+
+            fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fds[c] < 0 && firstErrno == 0)
+            {
+                firstErrno = errno;
+            }
+        }
+
+        if (isOpen())
+        {
+            return true;
+        }
+        error = std::strerror(firstErrno);
+        if (firstErrno == EACCES || firstErrno == EPERM)
+        {
+            error += " (see /proc/sys/kernel/perf_event_paranoid)";
+        }
+        else if (firstErrno == ENOENT || firstErrno == EOPNOTSUPP)
+        {
+            error += " (no hardware counters exposed, e.g. in a VM)";
+        }
+        return false;
+        #else // !BENCHMARK_HAS_PERF_EVENTS
+        error = "perf_event_open() is only available on Linux";
+        return false;
+        #endif // BENCHMARK_HAS_PERF_EVENTS
+    }
+
+    bool isOpen() const
+    {
+        for (int c = 0; c < CounterCount; ++c)
+        {
+            if (fds[c] >= 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start()
+    {
+        #if BENCHMARK_HAS_PERF_EVENTS
+        for (int c = 0; c < CounterCount; ++c)
+        {
+            if (fds[c] >= 0)
+            {
+                ioctl(fds[c], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+        #endif // BENCHMARK_HAS_PERF_EVENTS
+    }
+
+    CounterValues stop()
+    {
+        CounterValues counts;
+        #if BENCHMARK_HAS_PERF_EVENTS
+        for (int c = 0; c < CounterCount; ++c)
+        {
+            if (fds[c] >= 0)
+            {
+                ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int c = 0; c < CounterCount; ++c)
+        {
+            std::uint64_t value = 0;
+            if (fds[c] >= 0 && read(fds[c], &value, sizeof(value)) == static_cast<ssize_t>(sizeof(value)))
+            {
+                counts.values[c] = static_cast<std::int64_t>(value);
+            }
+        }
+        #endif // BENCHMARK_HAS_PERF_EVENTS
+        return counts;
+    }
+
+private:
+
+    void close()
+    {
+        #if BENCHMARK_HAS_PERF_EVENTS
+        for (int c = 0; c < CounterCount; ++c)
+        {
+            if (fds[c] >= 0)
+            {
+                ::close(fds[c]);
+                fds[c] = -1;
+            }
+        }
+        #endif // BENCHMARK_HAS_PERF_EVENTS
+    }
+
+    int fds[CounterCount];
+};
+
+// Null unless --counters was given and the kernel allowed at least one counter.
+static PerfCounters * perfCounters = nullptr;
+
+// ========================================================
+// Measurement:
+// ========================================================
+
+struct BenchResult
+{
+    std::string codec;
+    std::string input;
+    int uncompressedSize = 0;
+    int compressedSize   = 0;
+    double encodeMBps    = 0.0;
+    double decodeMBps    = 0.0;
+    bool roundTripOk     = false;
+    CounterValues encodeCounters; // Of the fastest encode run.
+    CounterValues decodeCounters; // Of the fastest decode run.
+};
+
+// Best-of-N timing: repeats the call until at least minSeconds elapsed
+// (and at least minRuns times), keeping the fastest run to filter out noise.
+// Slow cases like LZW get only a handful of runs in that time, so it has to
+// be long enough for the fastest of them to be repeatable within the
+// --check threshold. The counters, if enabled, are those of the fastest run too.
+template<typename Func>
+static double bestSeconds(Func && func, CounterValues & counters, const double minSeconds = 0.25, const int minRuns = 10)
+{
+    using Clock = std::chrono::steady_clock;
+
+    double best  = 1e30;
+    double total = 0.0;
+    for (int run = 0; run < minRuns || total < minSeconds; ++run)
+    {
+        if (perfCounters != nullptr)
+        {
+            perfCounters->start();
+        }
+        const auto startTime = Clock::now();
+        func();
+        const std::chrono::duration<double> elapsed = Clock::now() - startTime;
+        const CounterValues counts = (perfCounters != nullptr) ? perfCounters->stop() : CounterValues{};
+
+        if (elapsed.count() < best)
+        {
+            best     = elapsed.count();
+            counters = counts;
+        }
+        total += elapsed.count();
+    }
+    return best;
+}
+
+static BenchResult runCase(const Codec & codec, const std::string & inputName, const std::vector<std::uint8_t> & input)
+{
+    BenchResult result;
+    result.codec = codec.name;
+    result.input = inputName;
+    result.uncompressedSize = static_cast<int>(input.size());
+
+    const int inputSize = static_cast<int>(input.size());
+    std::vector<std::uint8_t> compressed;
+    std::vector<std::uint8_t> restored(input.size(), 0);
+    int compressedBits = 0;
+
+    const double encodeSeconds = bestSeconds([&]() {
+        result.compressedSize = codec.encode(input.data(), inputSize, compressed, compressedBits);
+    }, result.encodeCounters);
+
+    int restoredSize = 0;
+    const double decodeSeconds = bestSeconds([&]() {
+        restoredSize = codec.decode(compressed.data(), result.compressedSize, compressedBits, restored.data(), inputSize);
+    }, result.decodeCounters);
+
+    const double megabytes = double(inputSize) / (1024.0 * 1024.0);
+    result.encodeMBps  = megabytes / encodeSeconds;
+    result.decodeMBps  = megabytes / decodeSeconds;
+    result.roundTripOk = (restoredSize == inputSize) && (std::memcmp(restored.data(), input.data(), inputSize) == 0);
+    return result;
+}
+
+// Appends "cycles/byte IPC branch-misses/KB LLC-misses/KB" for one side of a case.
+static std::string formatCounters(const CounterValues & counts, const int uncompressedSize)
+{
+    const std::int64_t * v = counts.values;
+    const double kilobytes = double(uncompressedSize) / 1024.0;
+    char text[128];
+    char fields[4][16];
+
+    std::strcpy(fields[0], "-");
+    std::strcpy(fields[1], "-");
+    std::strcpy(fields[2], "-");
+    std::strcpy(fields[3], "-");
+    if (v[Cycles] >= 0)
+    {
+        std::snprintf(fields[0], sizeof(fields[0]), "%.2f", double(v[Cycles]) / double(uncompressedSize));
+    }
+    if (v[Cycles] > 0 && v[Instructions] >= 0)
+    {
+        std::snprintf(fields[1], sizeof(fields[1]), "%.2f", double(v[Instructions]) / double(v[Cycles]));
+    }
+    if (v[BranchMisses] >= 0)
+    {
+        std::snprintf(fields[2], sizeof(fields[2]), "%.1f", double(v[BranchMisses]) / kilobytes);
+    }
+    if (v[LlcMisses] >= 0)
+    {
+        std::snprintf(fields[3], sizeof(fields[3]), "%.2f", double(v[LlcMisses]) / kilobytes);
+    }
+
+    std::snprintf(text, sizeof(text), "%9s %5s %9s %8s", fields[0], fields[1], fields[2], fields[3]);
+    return text;
+}
+
+static void printCounters(const std::vector<BenchResult> & results)
+{
+    std::printf("\nHardware counters of the fastest run, per uncompressed byte/KB:\n");
+    std::printf("%-9s %-16s %9s %5s %9s %8s  %9s %5s %9s %8s\n", "codec", "input",
+                "enc c/B", "IPC", "brmiss/KB", "LLC/KB", "dec c/B", "IPC", "brmiss/KB", "LLC/KB");
+    for (const auto & r : results)
+    {
+        std::printf("%-9s %-16s %s  %s\n", r.codec.c_str(), r.input.c_str(),
+                    formatCounters(r.encodeCounters, r.uncompressedSize).c_str(),
+                    formatCounters(r.decodeCounters, r.uncompressedSize).c_str());
+    }
+}
+
+// ========================================================
+// Baseline file (one whitespace separated line per case):
+// codec input uncompressed_size compressed_size [encode_MBps decode_MBps]
+// ========================================================
+
+static bool saveBaseline(const std::string & fileName, const std::vector<BenchResult> & results)
+{
+    std::ofstream file(fileName);
+    if (!file)
+    {
+        return false;
+    }
+
+    file << "# codec input uncompressed_size compressed_size encode_MBps decode_MBps\n";
+    for (const auto & r : results)
+    {
+        file << r.codec << " " << r.input << " " << r.uncompressedSize << " " << r.compressedSize
+             << " " << r.encodeMBps << " " << r.decodeMBps << "\n";
+    }
+    return true;
+}
+
+static bool loadBaseline(const std::string & fileName, std::vector<BenchResult> & results)
+{
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        // Zero throughput means "not recorded" and is not checked.
+        BenchResult r;
+        std::istringstream fields(line);
+        if (fields >> r.codec >> r.input >> r.uncompressedSize >> r.compressedSize)
+        {
+            if (!(fields >> r.encodeMBps >> r.decodeMBps))
+            {
+                r.encodeMBps = 0.0;
+                r.decodeMBps = 0.0;
+            }
+            results.push_back(r);
+        }
+    }
+    return true;
+}
+
+static const BenchResult * findCase(const std::vector<BenchResult> & results, const BenchResult & which)
+{
+    for (const auto & r : results)
+    {
+        if (r.codec == which.codec && r.input == which.input)
+        {
+            return &r;
+        }
+    }
+    return nullptr;
+}
+
+// Returns the number of regressions found. A case without a baseline line
+// counts as one, so new codec paths can't go ungated, and so does a baseline
+// line that no longer has a case.
+static int checkAgainstBaseline(const std::vector<BenchResult> & results,
+                                const std::vector<BenchResult> & baseline,
+                                const double thresholdPercent)
+{
+    const double minRatio = 1.0 - thresholdPercent / 100.0;
+    int regressions = 0;
+
+    for (const auto & base : baseline)
+    {
+        if (findCase(results, base) == nullptr)
+        {
+            std::printf("REGRESSION: %s/%s is in the baseline but was not run\n", base.codec.c_str(), base.input.c_str());
+            ++regressions;
+        }
+    }
+
+    for (const auto & r : results)
+    {
+        const BenchResult * const base = findCase(baseline, r);
+        if (base == nullptr)
+        {
+            std::printf("REGRESSION: %s/%s has no baseline line\n", r.codec.c_str(), r.input.c_str());
+            ++regressions;
+            continue;
+        }
+
+        if (r.compressedSize > base->compressedSize)
+        {
+            std::printf("REGRESSION: %s/%s compressed size %d -> %d bytes\n",
+                        r.codec.c_str(), r.input.c_str(), base->compressedSize, r.compressedSize);
+            ++regressions;
+        }
+        if (r.encodeMBps < base->encodeMBps * minRatio)
+        {
+            std::printf("REGRESSION: %s/%s encode %.2f -> %.2f MB/s (%.1f%%)\n",
+                        r.codec.c_str(), r.input.c_str(), base->encodeMBps, r.encodeMBps,
+                        (r.encodeMBps / base->encodeMBps - 1.0) * 100.0);
+            ++regressions;
+        }
+        if (r.decodeMBps < base->decodeMBps * minRatio)
+        {
+            std::printf("REGRESSION: %s/%s decode %.2f -> %.2f MB/s (%.1f%%)\n",
+                        r.codec.c_str(), r.input.c_str(), base->decodeMBps, r.decodeMBps,
+                        (r.decodeMBps / base->decodeMBps - 1.0) * 100.0);
+            ++regressions;
+        }
+    }
+    return regressions;
+}
+
+// ========================================================
+// Fuzzing:
+// ========================================================
+
+// Round-trips 'count' inputs of random shape and size through every
+// codec. Returns the number of failures. The seed of a failing case
+// is printed so it can be reproduced with corpus::makeFuzz().
+static int runFuzz(const int count)
+{
+    int failures = 0;
+    corpus::Random rng(0xF022);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const std::uint64_t seed = rng.next();
+        const int size = 1 + rng.nextInt(32768);
+        const std::vector<std::uint8_t> input = corpus::makeFuzz(size, seed);
+
+        for (const auto & codec : codecs)
+        {
+            std::vector<std::uint8_t> compressed;
+            std::vector<std::uint8_t> restored(input.size(), 0);
+            int compressedBits = 0;
+
+            const int compressedSize = codec.encode(input.data(), size, compressed, compressedBits);
+            const int restoredSize = codec.decode(compressed.data(), compressedSize, compressedBits, restored.data(), size);
+
+            if (restoredSize != size || std::memcmp(restored.data(), input.data(), size) != 0)
+            {
+                std::printf("FUZZ FAILURE: %s seed=0x%016llx size=%d\n",
+                            codec.name, static_cast<unsigned long long>(seed), size);
+                ++failures;
+            }
+        }
+    }
+
+    std::printf("Fuzzed %d inputs per codec, %d failure(s).\n", count, failures);
+    return failures;
+}
+
+// ========================================================
+// main() -- Benchmark driver:
+// ========================================================
+
+int main(int argc, const char * argv[])
+{
+    std::string saveFile;
+    std::string checkFile;
+    double thresholdPercent = 15.0;
+    int fuzzCount = 0;
+    bool useCounters = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--save" && i + 1 < argc)
+        {
+            saveFile = argv[++i];
+        }
+        else if (arg == "--check" && i + 1 < argc)
+        {
+            checkFile = argv[++i];
+        }
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            thresholdPercent = std::atof(argv[++i]);
+        }
+        else if (arg == "--fuzz" && i + 1 < argc)
+        {
+            fuzzCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "--counters")
+        {
+            useCounters = true;
+        }
+        else
+        {
+            std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+            return 2;
+        }
+    }
+
+    PerfCounters counters;
+    if (useCounters)
+    {
+        std::string error;
+        if (counters.open(error))
+        {
+            perfCounters = &counters;
+        }
+        else
+        {
+            std::printf("Hardware counters unavailable: %s. Timings only.\n", error.c_str());
+        }
+    }
+
+    std::vector<corpus::Case> inputs = corpus::makeStandardCorpus();
+    inputs.push_back({ "lenna_tga", std::vector<std::uint8_t>(lennaTgaData, lennaTgaData + sizeof(lennaTgaData)) });
+
+    std::printf("%-9s %-16s %10s %10s %7s %12s %12s\n",
+                "codec", "input", "size", "compressed", "ratio", "enc MB/s", "dec MB/s");
+
+    int failures = 0;
+    std::vector<BenchResult> results;
+    for (const auto & codec : codecs)
+    {
+        for (const auto & input : inputs)
+        {
+            const BenchResult r = runCase(codec, input.name, input.data);
+            std::printf("%-9s %-16s %10d %10d %7.3f %12.2f %12.2f%s\n",
+                        r.codec.c_str(), r.input.c_str(), r.uncompressedSize, r.compressedSize,
+                        double(r.compressedSize) / double(r.uncompressedSize),
+                        r.encodeMBps, r.decodeMBps, r.roundTripOk ? "" : "  ROUND TRIP FAILED!");
+            failures += !r.roundTripOk;
+            results.push_back(r);
+        }
+    }
+
+    if (perfCounters != nullptr)
+    {
+        printCounters(results);
+    }
+
+    if (fuzzCount > 0)
+    {
+        failures += runFuzz(fuzzCount);
+    }
+
+    if (!saveFile.empty())
+    {
+        if (!saveBaseline(saveFile, results))
+        {
+            std::cerr << "Failed to write baseline file " << saveFile << "\n";
+            return 2;
+        }
+        std::printf("Baseline saved to %s\n", saveFile.c_str());
+    }
+
+    if (!checkFile.empty())
+    {
+        std::vector<BenchResult> baseline;
+        if (!loadBaseline(checkFile, baseline))
+        {
+            std::cerr << "Failed to read baseline file " << checkFile << "\n";
+            return 2;
+        }
+
+        const int regressions = checkAgainstBaseline(results, baseline, thresholdPercent);
+        std::printf("%d regression(s) beyond %.1f%% versus %s\n", regressions, thresholdPercent, checkFile.c_str());
+        failures += regressions;
+    }
+
+    return (failures == 0) ? 0 : 1;
+}
+
+// ========================================================
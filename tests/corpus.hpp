@@ -0,0 +1,233 @@
+
+// ================================================================================================
+// -*- C++ -*-
+// File: corpus.hpp
+// Author: Guilherme R. Lampert
+// Created on: 17/10/26
+// Brief: Generators for adversarial and realistic test/benchmark data.
+//
+// This source code is in the public domain.
+// You are free to do whatever you want with it.
+//
+// All generators are deterministic for a given seed, so a failing or
+// slow case can always be reproduced from its name and seed alone.
+// ================================================================================================
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace corpus
+{
+
+// ========================================================
+// Tiny deterministic PRNG (xorshift64*):
+// ========================================================
+
+class Random final
+{
+public:
+
+    explicit Random(const std::uint64_t seed)
+        : state(seed != 0 ? seed : 0x9E3779B97F4A7C15ULL)
+    { }
+
+    std::uint64_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform integer in [0, range).
+    int nextInt(const int range)
+    {
+        return static_cast<int>(next() % static_cast<std::uint64_t>(range));
+    }
+
+private:
+
+    std::uint64_t state;
+};
+
+// ========================================================
+// Individual generators:
+// ========================================================
+
+// Uniformly distributed bytes. Nothing to compress, and the
+// worst case for LZW: almost every phrase is new, so the
+// dictionary fills up and gets flushed as fast as possible.
+static std::vector<std::uint8_t> makeRandom(const int sizeBytes, const std::uint64_t seed)
+{
+    Random rng(seed);
+    std::vector<std::uint8_t> data(sizeBytes);
+    for (auto & b : data)
+    {
+        b = static_cast<std::uint8_t>(rng.next() >> 56);
+    }
+    return data;
+}
+
+// A single repeated byte. With 0xFF this is the Rice worst
+// case for small K (long unary codes) and the LZW best case.
+static std::vector<std::uint8_t> makeConstant(const int sizeBytes, const std::uint8_t value)
+{
+    return std::vector<std::uint8_t>(sizeBytes, value);
+}
+
+// Two alternating values: no runs at all, so RLE doubles the size.
+static std::vector<std::uint8_t> makeAlternating(const int sizeBytes)
+{
+    std::vector<std::uint8_t> data(sizeBytes);
+    for (int i = 0; i < sizeBytes; ++i)
+    {
+        data[i] = (i & 1) ? 0xFF : 0x00;
+    }
+    return data;
+}
+
+// Symbol 'i' appears Fibonacci(i) times, in shuffled order.
+// That's the frequency distribution that produces the deepest
+// possible Huffman tree (one extra level per symbol).
+static std::vector<std::uint8_t> makeFibonacci(const int symbolCount, const std::uint64_t seed)
+{
+    std::vector<std::uint8_t> data;
+    std::uint64_t a = 1, b = 1;
+    for (int s = 0; s < symbolCount; ++s)
+    {
+        data.insert(data.end(), static_cast<std::size_t>(a), static_cast<std::uint8_t>(s));
+        const std::uint64_t c = a + b;
+        a = b;
+        b = c;
+    }
+
+    // Fisher-Yates shuffle:
+    Random rng(seed);
+    for (int i = static_cast<int>(data.size()) - 1; i > 0; --i)
+    {
+        const int j = rng.nextInt(i + 1);
+        const std::uint8_t tmp = data[i];
+        data[i] = data[j];
+        data[j] = tmp;
+    }
+    return data;
+}
+
+// Words from a small vocabulary with skewed frequencies,
+// separated by spaces and some punctuation. Log/text-like.
+static std::vector<std::uint8_t> makeText(const int sizeBytes, const std::uint64_t seed)
+{
+    static const char * const words[] = {
+        "the", "of", "and", "to", "in", "is", "was", "that", "for", "on",
+        "with", "error", "request", "server", "time", "data", "user", "id",
+        "compression", "stream", "dictionary", "symbol", "length", "value"
+    };
+    constexpr int wordCount = sizeof(words) / sizeof(words[0]);
+
+    Random rng(seed);
+    std::string text;
+    while (static_cast<int>(text.size()) < sizeBytes)
+    {
+        // Squaring a uniform value skews the picks towards the first words.
+        const int r = rng.nextInt(wordCount * wordCount);
+        text += words[(wordCount - 1) - static_cast<int>(std::sqrt(double(r)))];
+        const int p = rng.nextInt(16);
+        text += (p == 0) ? ". " : (p == 1) ? ", " : (p == 2) ? "\n" : " ";
+    }
+    return std::vector<std::uint8_t>(text.begin(), text.begin() + sizeBytes);
+}
+
+// Small residuals around zero, like the output of a predictor over
+// a slowly varying sensor signal. Typical Rice coder input.
+static std::vector<std::uint8_t> makeResiduals(const int sizeBytes, const std::uint64_t seed)
+{
+    Random rng(seed);
+    std::vector<std::uint8_t> data(sizeBytes);
+    for (auto & b : data)
+    {
+        // Sum of two uniform values gives a triangular distribution.
+        b = static_cast<std::uint8_t>(rng.nextInt(6) + rng.nextInt(6));
+    }
+    return data;
+}
+
+// Random mix of the above: runs, copies of earlier data, noise
+// and skewed symbols, with random segment lengths. Used to fuzz
+// the codecs with shapes nobody thought of writing by hand.
+static std::vector<std::uint8_t> makeFuzz(const int sizeBytes, const std::uint64_t seed)
+{
+    Random rng(seed);
+    std::vector<std::uint8_t> data;
+    data.reserve(sizeBytes);
+
+    while (static_cast<int>(data.size()) < sizeBytes)
+    {
+        const int left = sizeBytes - static_cast<int>(data.size());
+        const int len  = 1 + rng.nextInt(left < 600 ? left : 600);
+
+        switch (rng.nextInt(4))
+        {
+        case 0 : // Run
+            data.insert(data.end(), len, static_cast<std::uint8_t>(rng.next() >> 56));
+            break;
+        case 1 : // Copy of an earlier segment
+            if (!data.empty())
+            {
+                const int from = rng.nextInt(static_cast<int>(data.size()));
+                for (int i = 0; i < len; ++i)
+                {
+                    data.push_back(data[from + (i % (static_cast<int>(data.size()) - from))]);
+                }
+                break;
+            }
+            // fall through
+        case 2 : // Noise
+            for (int i = 0; i < len; ++i)
+            {
+                data.push_back(static_cast<std::uint8_t>(rng.next() >> 56));
+            }
+            break;
+        default : // Skewed small alphabet
+            for (int i = 0; i < len; ++i)
+            {
+                const int r = rng.nextInt(64);
+                data.push_back(static_cast<std::uint8_t>('a' + (r * r) / 512));
+            }
+            break;
+        } // switch
+    }
+
+    data.resize(sizeBytes);
+    return data;
+}
+
+// ========================================================
+// Standard corpus:
+// ========================================================
+
+struct Case
+{
+    std::string name;
+    std::vector<std::uint8_t> data;
+};
+
+// The fixed set of edge cases every codec is checked against.
+// Sizes are kept moderate so the slower codecs finish quickly.
+static std::vector<Case> makeStandardCorpus()
+{
+    std::vector<Case> cases;
+    cases.push_back({ "random_64k",      makeRandom(65536, 1)        });
+    cases.push_back({ "all_ff_64k",      makeConstant(65536, 0xFF)   });
+    cases.push_back({ "all_00_64k",      makeConstant(65536, 0x00)   });
+    cases.push_back({ "alternating_64k", makeAlternating(65536)      });
+    cases.push_back({ "fibonacci_22",    makeFibonacci(22, 2)        });
+    cases.push_back({ "text_64k",        makeText(65536, 3)          });
+    cases.push_back({ "residuals_64k",   makeResiduals(65536, 4)     });
+    cases.push_back({ "fuzz_64k",        makeFuzz(65536, 5)          });
+    cases.push_back({ "single_byte",     makeConstant(1, 0x42)       });
+    return cases;
+}
+
+} // namespace corpus {}
@@ -10,24 +10,55 @@
 // You are free to do whatever you want with it.
 //
 // Compile with:
-// c++ -std=c++11 -O3 -Wall -Wextra -Weffc++ -Wshadow -pedantic -I.. tests.cpp -o tests
+// c++ -std=c++11 -O3 -Wall -Wextra -Weffc++ -Wshadow -pedantic -pthread -I.. tests.cpp -o tests
 // ================================================================================================
 
 #define RLE_IMPLEMENTATION
+#define RLE_ENABLE_STATS
 #include "rle.hpp"
 
 #define LZW_IMPLEMENTATION
+#define LZW_ENABLE_STATS
 #include "lzw.hpp"
 
 #define HUFFMAN_IMPLEMENTATION
+#define HUFFMAN_ENABLE_STATS
 #include "huffman.hpp"
 
 #define RICE_IMPLEMENTATION
+#define RICE_ENABLE_STATS
 #include "rice.hpp"
 
+#define RANGECODER_IMPLEMENTATION
+#define RANGECODER_ENABLE_STATS
+#include "rangecoder.hpp"
+
+#define PFOR_IMPLEMENTATION
+#define PFOR_ENABLE_STATS
+#include "pfor.hpp"
+
+#define STREAMVBYTE_IMPLEMENTATION
+#define STREAMVBYTE_ENABLE_STATS
+#include "streamvbyte.hpp"
+
+#define IMAGEFILTER_IMPLEMENTATION
+#define IMAGEFILTER_ENABLE_STATS
+#include "imagefilter.hpp"
+
+#define SHUFFLE_IMPLEMENTATION
+#define SHUFFLE_ENABLE_STATS
+#include "shuffle.hpp"
+
+#define PIPELINE_IMPLEMENTATION
+#include "pipeline.hpp"
+
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <string>
 #include <vector>
 #include <chrono>
 
@@ -44,12 +75,111 @@
 // 512 randomly shuffled byte values:
 #include "random_512.hpp"
 
+// Generated edge cases (constant, alternating, Fibonacci, text, fuzz...):
+#include "corpus.hpp"
+
 // A couple strings:
 static const std::uint8_t str0[] = "Hello world!";
 static const std::uint8_t str1[] = "The Essential Feature;";
 static const std::uint8_t str2[] = "Hello Dr. Chandra, my name is HAL-9000. I'm ready for my first lesson...";
 static const std::uint8_t str3[] = "\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11\x11";
 
+// ========================================================
+// Scatter/gather decode helper:
+// ========================================================
+
+// Cuts the output in uneven segments (including empty ones) with guard
+// bytes between them, runs the codec's scatter decode over them and
+// checks the gathered result. SegmentType is the codec's OutputSegment.
+template<typename SegmentType, typename DecodeFunc>
+static bool checkScatterDecode(const std::uint8_t * sampleData, const int sampleSize, DecodeFunc decodeFunc)
+{
+    constexpr int guardBytes = 16;
+    constexpr std::uint8_t guardValue = 0xA5;
+
+    const int pattern[] = { 1, 0, 7, 4096, 3, 0, 65536 };
+    std::vector<int> sizes;
+    for (int total = 0, i = 0; total < sampleSize; ++i)
+    {
+        const int size = std::min(pattern[i % 7], sampleSize - total);
+        sizes.push_back(size);
+        total += size;
+    }
+
+    std::vector<std::uint8_t> memory(sampleSize + (sizes.size() + 1) * guardBytes, guardValue);
+    std::vector<SegmentType> segments;
+    std::uint8_t * ptr = memory.data() + guardBytes;
+    for (const int size : sizes)
+    {
+        segments.push_back(SegmentType{ ptr, size });
+        ptr += size + guardBytes;
+    }
+
+    const int decodedSize = decodeFunc(segments.data(), static_cast<int>(segments.size()));
+
+    bool successful = (decodedSize == sampleSize);
+    int offset = 0;
+    for (const auto & segment : segments)
+    {
+        successful &= (std::memcmp(segment.data, sampleData + offset, segment.sizeBytes) == 0);
+        for (int g = 0; g < guardBytes; ++g)
+        {
+            successful &= (segment.data[segment.sizeBytes + g] == guardValue);
+        }
+        offset += segment.sizeBytes;
+    }
+    return successful;
+}
+
+// ========================================================
+// Window decode helper:
+// ========================================================
+
+// Pulls every window out of a codec's WindowDecoder and checks that
+// they are all full except the last and add up to the sample data.
+template<typename WindowDecoderType>
+static bool checkWindowDecode(const std::uint8_t * sampleData, const int sampleSize,
+                              WindowDecoderType & decoder, const int windowSize)
+{
+    std::vector<std::uint8_t> restored;
+    const std::uint8_t * window = nullptr;
+    bool successful = true;
+
+    for (int windowBytes; (windowBytes = decoder.next(&window)) > 0;)
+    {
+        successful &= (windowBytes == windowSize || restored.size() + windowBytes == static_cast<std::size_t>(sampleSize));
+        restored.insert(restored.end(), window, window + windowBytes);
+    }
+
+    successful &= (restored.size() == static_cast<std::size_t>(sampleSize));
+    successful &= (decoder.getBytesDecoded() == sampleSize);
+    successful &= (std::memcmp(restored.data(), sampleData, std::min<std::size_t>(restored.size(), sampleSize)) == 0);
+    return successful;
+}
+
+// ========================================================
+// In-place decode samples:
+// ========================================================
+
+// lenna.tga and the standard corpus, plus the worst case for in-place decoding:
+// highly compressible data followed by data that doesn't compress at all, so the
+// output races ahead early on and the incompressible tail is still unread.
+static std::vector<std::vector<std::uint8_t>> makeInPlaceSamples()
+{
+    std::vector<std::vector<std::uint8_t>> samples;
+    samples.emplace_back(lennaTgaData, lennaTgaData + sizeof(lennaTgaData));
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        samples.push_back(sample.data);
+    }
+
+    std::vector<std::uint8_t> worstCase = corpus::makeConstant(65536, 0x00);
+    const std::vector<std::uint8_t> noise = corpus::makeRandom(65536, 7);
+    worstCase.insert(worstCase.end(), noise.begin(), noise.end());
+    samples.push_back(worstCase);
+    return samples;
+}
+
 // ========================================================
 // Run Length Encoding (RLE) tests:
 // ========================================================
@@ -92,6 +222,32 @@ static void Test_RLE_EncodeDecode(const std::uint8_t * sampleData, const int sam
     // You have to provide big buffers.
 }
 
+static void Test_RLE_ScalarFallback(const std::uint8_t * sampleData, const int sampleSize)
+{
+    std::vector<std::uint8_t> dispatchedBuffer(sampleSize * 4, 0);
+    std::vector<std::uint8_t> scalarBuffer(sampleSize * 4, 0);
+
+    // Compress with the kernels picked for this CPU, then again with the scalar ones:
+    const rle::CpuFeatures detectedFeatures = rle::getCpuFeatures();
+    const int dispatchedSize = rle::easyEncode(sampleData, sampleSize, dispatchedBuffer.data(), dispatchedBuffer.size());
+
+    rle::setCpuFeatures(rle::CpuFeatures{});
+    const int scalarSize = rle::easyEncode(sampleData, sampleSize, scalarBuffer.data(), scalarBuffer.size());
+    rle::setCpuFeatures(detectedFeatures);
+
+    std::cout << "RLE AVX2/AVX-512 kernels    = " << (detectedFeatures.avx2 || detectedFeatures.avx512bw ? "yes" : "no") << "\n";
+
+    if (dispatchedSize != scalarSize ||
+        std::memcmp(dispatchedBuffer.data(), scalarBuffer.data(), scalarSize) != 0)
+    {
+        std::cerr << "RLE COMPRESSION ERROR! Scalar and SIMD outputs differ!\n";
+    }
+    else
+    {
+        std::cout << "RLE scalar fallback matches!\n";
+    }
+}
+
 static void Test_RLE()
 {
     std::cout << "> Testing random512...\n";
@@ -104,7 +260,72 @@ static void Test_RLE()
     Test_RLE_EncodeDecode(str3, sizeof(str3));
 
     std::cout << "> Testing lenna.tga...\n";
+    rle::resetStats();
     Test_RLE_EncodeDecode(lennaTgaData, sizeof(lennaTgaData));
+    const rle::Stats & stats = rle::getStats();
+    std::cout << "RLE runs written / split    = " << stats.runsWritten << " / " << stats.maxLengthRuns << "\n";
+
+    std::cout << "> Testing adversarial corpus...\n";
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        Test_RLE_EncodeDecode(sample.data.data(), sample.data.size());
+    }
+
+    std::cout << "> Testing scatter/gather decode...\n";
+    {
+        std::vector<std::uint8_t> compressed(sizeof(lennaTgaData) * 4, 0);
+        const int compressedSize = rle::easyEncode(lennaTgaData, sizeof(lennaTgaData), compressed.data(), compressed.size());
+        const bool successful = checkScatterDecode<rle::OutputSegment>(lennaTgaData, sizeof(lennaTgaData),
+            [&](const rle::OutputSegment * segments, const int count)
+            {
+                return rle::easyDecode(compressed.data(), compressedSize, segments, count);
+            });
+        std::cout << (successful ? "RLE scatter decode successful!\n" : "RLE SCATTER DECODE ERROR!\n");
+    }
+
+    std::cout << "> Testing window decode...\n";
+    {
+        std::vector<std::uint8_t> compressed(sizeof(lennaTgaData) * 4, 0);
+        const int compressedSize = rle::easyEncode(lennaTgaData, sizeof(lennaTgaData), compressed.data(), compressed.size());
+        rle::WindowDecoder bigWindows(compressed.data(), compressedSize, 1000);
+        rle::WindowDecoder tinyWindows(compressed.data(), compressedSize, 3);
+        const bool successful = checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), bigWindows, 1000) &&
+                                checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), tinyWindows, 3);
+        std::cout << (successful ? "RLE window decode successful!\n" : "RLE WINDOW DECODE ERROR!\n");
+    }
+
+    std::cout << "> Testing in-place decode...\n";
+    {
+        // Long runs then single bytes is the worst case: the output catches up with the input.
+        std::vector<std::vector<std::uint8_t>> samples = makeInPlaceSamples();
+        bool successful = true;
+        int worstMargin = 0;
+        for (const auto & sample : samples)
+        {
+            const int size = static_cast<int>(sample.size());
+            std::vector<std::uint8_t> compressed(size * 4, 0);
+            const int compressedSize = rle::easyEncode(sample.data(), size, compressed.data(), compressed.size());
+            const int margin = rle::inPlaceMargin(compressed.data(), compressedSize);
+            worstMargin = std::max(worstMargin, margin);
+
+            std::vector<std::uint8_t> buffer(size + margin, 0);
+            std::copy(compressed.begin(), compressed.begin() + compressedSize, buffer.end() - compressedSize);
+            successful &= margin >= 0 && rle::easyDecodeInPlace(buffer.data(), buffer.size(), compressedSize) == size &&
+                          std::equal(sample.begin(), sample.end(), buffer.begin());
+
+            // One byte short must be refused rather than decode garbage.
+            if (margin > 0 && size + margin > compressedSize)
+            {
+                std::copy(compressed.begin(), compressed.begin() + compressedSize, buffer.end() - 1 - compressedSize);
+                successful &= rle::easyDecodeInPlace(buffer.data(), buffer.size() - 1, compressedSize) == -1;
+            }
+        }
+        std::cout << "RLE worst in-place margin   = " << worstMargin << " bytes\n";
+        std::cout << (successful ? "RLE in-place decode successful!\n" : "RLE IN-PLACE DECODE ERROR!\n");
+    }
+
+    std::cout << "> Testing scalar fallback...\n";
+    Test_RLE_ScalarFallback(lennaTgaData, sizeof(lennaTgaData));
 }
 
 // ========================================================
@@ -163,7 +384,184 @@ static void Test_LZW()
     Test_LZW_EncodeDecode(str3, sizeof(str3));
 
     std::cout << "> Testing lenna.tga...\n";
+    lzw::resetStats();
     Test_LZW_EncodeDecode(lennaTgaData, sizeof(lennaTgaData));
+    const lzw::Stats & stats = lzw::getStats();
+    std::cout << "LZW codes written           = " << stats.codesWritten << "\n";
+    std::cout << "LZW dictionary probes       = " << stats.dictionaryProbes << "\n";
+    std::cout << "LZW dictionary resets       = " << stats.dictionaryResets << "\n";
+
+    std::cout << "> Testing adversarial corpus...\n";
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        Test_LZW_EncodeDecode(sample.data.data(), sample.data.size());
+    }
+
+    std::cout << "> Testing scatter/gather decode...\n";
+    {
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        lzw::easyEncode(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits);
+        const bool successful = checkScatterDecode<lzw::OutputSegment>(lennaTgaData, sizeof(lennaTgaData),
+            [&](const lzw::OutputSegment * segments, const int count)
+            {
+                return lzw::easyDecode(compressed, compressedBytes, compressedBits, segments, count);
+            });
+        std::cout << (successful ? "LZW scatter decode successful!\n" : "LZW SCATTER DECODE ERROR!\n");
+        LZW_MFREE(compressed);
+    }
+
+    std::cout << "> Testing window decode...\n";
+    {
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        lzw::easyEncode(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits);
+        lzw::WindowDecoder bigWindows(compressed, compressedBytes, compressedBits, 1000);
+        lzw::WindowDecoder tinyWindows(compressed, compressedBytes, compressedBits, 3);
+        const bool successful = checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), bigWindows, 1000) &&
+                                checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), tinyWindows, 3);
+        std::cout << (successful ? "LZW window decode successful!\n" : "LZW WINDOW DECODE ERROR!\n");
+        LZW_MFREE(compressed);
+    }
+
+    std::cout << "> Testing parallel decode from reset points...\n";
+    {
+        std::uint8_t * plain = nullptr;
+        int plainBytes = 0;
+        int plainBits  = 0;
+        lzw::easyEncode(lennaTgaData, sizeof(lennaTgaData), &plain, &plainBytes, &plainBits);
+
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        lzw::ResetPoint * resetPoints = nullptr;
+        int resetPointCount = 0;
+        lzw::easyEncode(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits,
+                        &resetPoints, &resetPointCount);
+
+        // The index is extra: the code stream must be the plain one.
+        bool successful = resetPointCount > 0 && compressedBits == plainBits &&
+                          std::memcmp(compressed, plain, plainBytes) == 0;
+
+        for (const int threadCount : { 1, 2, 4, 0 })
+        {
+            std::vector<std::uint8_t> uncompressed(sizeof(lennaTgaData), 0);
+            const int uncompressedSize = lzw::easyDecodeParallel(compressed, compressedBytes, compressedBits,
+                                                                 resetPoints, resetPointCount,
+                                                                 uncompressed.data(), uncompressed.size(), threadCount);
+            successful &= uncompressedSize == static_cast<int>(sizeof(lennaTgaData)) &&
+                          std::memcmp(uncompressed.data(), lennaTgaData, sizeof(lennaTgaData)) == 0;
+        }
+
+        // Too small to ever fill the dictionary: a single segment.
+        std::uint8_t * small = nullptr;
+        int smallBytes = 0;
+        int smallBits  = 0;
+        lzw::ResetPoint * noPoints = nullptr;
+        int noPointCount = -1;
+        lzw::easyEncode(str3, sizeof(str3), &small, &smallBytes, &smallBits, &noPoints, &noPointCount);
+        std::vector<std::uint8_t> smallOut(sizeof(str3), 0);
+        successful &= noPoints == nullptr && noPointCount == 0 &&
+                      lzw::easyDecodeParallel(small, smallBytes, smallBits, noPoints, noPointCount,
+                                              smallOut.data(), smallOut.size(), 4) == static_cast<int>(sizeof(str3)) &&
+                      std::memcmp(smallOut.data(), str3, sizeof(str3)) == 0;
+
+        std::cout << "LZW reset points = " << resetPointCount << "\n";
+        std::cout << (successful ? "LZW parallel decode successful!\n" : "LZW PARALLEL DECODE ERROR!\n");
+        LZW_MFREE(plain);
+        LZW_MFREE(compressed);
+        LZW_MFREE(resetPoints);
+        LZW_MFREE(small);
+    }
+
+    std::cout << "> Testing LZMW/LZAP dictionary growth...\n";
+    {
+        // Repetitive log lines, where the long phrases pay off.
+        std::string log;
+        corpus::Random random(72);
+        while (log.size() < 200000)
+        {
+            char line[160];
+            std::snprintf(line, sizeof(line), "2026-10-17 12:%02d:%02d INFO [worker-%d] GET /api/v1/items/%d status=200 time=%dms\n",
+                          random.nextInt(60), random.nextInt(60), random.nextInt(8), random.nextInt(1000), random.nextInt(50));
+            log += line;
+        }
+        const auto * logData = reinterpret_cast<const std::uint8_t *>(log.data());
+
+        std::vector<std::pair<const std::uint8_t *, int>> samples = {
+            { logData, static_cast<int>(log.size()) },
+            { lennaTgaData, static_cast<int>(sizeof(lennaTgaData)) },
+            { str3, static_cast<int>(sizeof(str3)) },
+            { random512, static_cast<int>(sizeof(random512)) }
+        };
+        const auto standardCorpus = corpus::makeStandardCorpus();
+        for (const auto & sample : standardCorpus)
+        {
+            samples.emplace_back(sample.data.data(), static_cast<int>(sample.data.size()));
+        }
+
+        bool successful = true;
+        for (const lzw::Mode mode : { lzw::Mode::LZW, lzw::Mode::LZMW, lzw::Mode::LZAP })
+        {
+            for (std::size_t s = 0; s < samples.size(); ++s)
+            {
+                const std::uint8_t * data = samples[s].first;
+                const int size = samples[s].second;
+
+                std::uint8_t * compressed = nullptr;
+                int compressedBytes = 0;
+                int compressedBits  = 0;
+                lzw::resetStats();
+                lzw::easyEncode(data, size, &compressed, &compressedBytes, &compressedBits, mode);
+                const std::uint64_t codes = lzw::getStats().codesWritten;
+
+                std::vector<std::uint8_t> uncompressed(size, 0);
+                successful &= lzw::easyDecode(compressed, compressedBytes, compressedBits,
+                                              uncompressed.data(), uncompressed.size(), mode) == size &&
+                              std::memcmp(uncompressed.data(), data, size) == 0;
+
+                if (s < 2)
+                {
+                    const char * modeName = (mode == lzw::Mode::LZW) ? "LZW " : (mode == lzw::Mode::LZMW) ? "LZMW" : "LZAP";
+                    std::cout << modeName << (s == 0 ? " log   " : " lenna ") << "compressed size bytes = "
+                              << compressedBytes << ", codes = " << codes << "\n";
+                }
+                LZW_MFREE(compressed);
+            }
+        }
+        std::cout << (successful ? "LZMW/LZAP round trips successful!\n" : "LZMW/LZAP ROUND TRIP ERROR!\n");
+    }
+
+    std::cout << "> Testing in-place decode...\n";
+    {
+        bool successful = true;
+        for (const lzw::Mode mode : { lzw::Mode::LZW, lzw::Mode::LZMW, lzw::Mode::LZAP })
+        {
+            for (const auto & sample : makeInPlaceSamples())
+            {
+                const int size = static_cast<int>(sample.size());
+                std::uint8_t * compressed = nullptr;
+                int compressedBytes = 0;
+                int compressedBits  = 0;
+                lzw::easyEncode(sample.data(), size, &compressed, &compressedBytes, &compressedBits, mode);
+
+                std::vector<std::uint8_t> buffer(size + lzw::inPlaceMargin(compressedBytes, mode), 0);
+                std::copy(compressed, compressed + compressedBytes, buffer.end() - compressedBytes);
+                successful &= lzw::easyDecodeInPlace(buffer.data(), buffer.size(), compressedBytes, compressedBits, mode) == size &&
+                              std::equal(sample.begin(), sample.end(), buffer.begin());
+                LZW_MFREE(compressed);
+            }
+        }
+        std::cout << (successful ? "LZW in-place decode successful!\n" : "LZW IN-PLACE DECODE ERROR!\n");
+    }
+
+    std::cout << "> Testing lenna.tga with the scalar bit stream kernels...\n";
+    const lzw::CpuFeatures detectedFeatures = lzw::getCpuFeatures();
+    lzw::setCpuFeatures(lzw::CpuFeatures{});
+    Test_LZW_EncodeDecode(lennaTgaData, sizeof(lennaTgaData));
+    lzw::setCpuFeatures(detectedFeatures);
 }
 
 // ========================================================
@@ -210,6 +608,98 @@ static void Test_Huffman_EncodeDecode(const std::uint8_t * sampleData, const int
     HUFFMAN_MFREE(compressedData);
 }
 
+static void Test_Huffman_Segmented(const std::uint8_t * sampleData, const int sampleSize, const int segmentSize)
+{
+    int compressedSizeBytes = 0;
+    int compressedSizeBits  = 0;
+    std::uint8_t * compressedData = nullptr;
+    std::vector<std::uint8_t> sequentialBuffer(sampleSize, 0);
+    std::vector<std::uint8_t> parallelBuffer(sampleSize, 0);
+
+    // Compress:
+    huffman::easyEncodeSegmented(sampleData, sampleSize, &compressedData,
+                                 &compressedSizeBytes, &compressedSizeBits, segmentSize);
+
+    std::cout << "Huffman segmented size bytes    = " << compressedSizeBytes << "\n";
+
+    // Restore with a single thread and then with several:
+    const int sequentialSize = huffman::easyDecode(compressedData, compressedSizeBytes, compressedSizeBits,
+                                                   sequentialBuffer.data(), sequentialBuffer.size());
+    huffman::resetStats();
+    const int parallelSize = huffman::easyDecodeParallel(compressedData, compressedSizeBytes, compressedSizeBits,
+                                                         parallelBuffer.data(), parallelBuffer.size(), 4);
+
+    // Validate. The worker threads' counts must reach the caller's stats too.
+    if (sequentialSize != sampleSize || parallelSize != sampleSize ||
+        huffman::getStats().bytesDecoded != static_cast<std::uint64_t>(sampleSize) ||
+        std::memcmp(sequentialBuffer.data(), sampleData, sampleSize) != 0 ||
+        std::memcmp(parallelBuffer.data(), sampleData, sampleSize) != 0)
+    {
+        std::cerr << "HUFFMAN COMPRESSION ERROR! Segmented stream corrupted!\n";
+    }
+    else
+    {
+        std::cout << "Huffman segmented compression successful!\n";
+    }
+
+    HUFFMAN_MFREE(compressedData);
+}
+
+static void Test_Huffman_Speculative(const std::uint8_t * sampleData, const int sampleSize, const int threadCount)
+{
+    int compressedSizeBytes = 0;
+    int compressedSizeBits  = 0;
+    std::uint8_t * compressedData = nullptr;
+    std::vector<std::uint8_t> uncompressedBuffer(sampleSize, 0);
+
+    // Compress a plain single stream:
+    huffman::easyEncode(sampleData, sampleSize, &compressedData,
+                        &compressedSizeBytes, &compressedSizeBits);
+
+    // Restore it splitting the stream at arbitrary bit offsets:
+    huffman::resetStats();
+    const int uncompressedSize = huffman::easyDecodeParallel(compressedData, compressedSizeBytes, compressedSizeBits,
+                                                             uncompressedBuffer.data(), uncompressedBuffer.size(),
+                                                             threadCount);
+
+    // Validate:
+    if (uncompressedSize != sampleSize || huffman::getStats().bytesDecoded != static_cast<std::uint64_t>(sampleSize) ||
+        std::memcmp(uncompressedBuffer.data(), sampleData, sampleSize) != 0)
+    {
+        std::cerr << "HUFFMAN COMPRESSION ERROR! Speculative decode with " << threadCount << " threads failed!\n";
+    }
+    else
+    {
+        std::cout << "Huffman speculative decode with " << threadCount << " threads successful!\n";
+    }
+
+    HUFFMAN_MFREE(compressedData);
+}
+
+static void Test_Huffman_Static(const char * name, const huffman::StaticTable & table,
+                                const std::uint8_t * sampleData, const int sampleSize)
+{
+    int compressedSizeBytes = 0;
+    int compressedSizeBits  = 0;
+    std::uint8_t * compressedData = nullptr;
+    std::vector<std::uint8_t> uncompressedBuffer(sampleSize, 0);
+
+    huffman::easyEncodeStatic(table, sampleData, sampleSize, &compressedData, &compressedSizeBytes, &compressedSizeBits);
+    const int uncompressedSize = huffman::easyDecodeStatic(table, compressedData, compressedSizeBytes, compressedSizeBits,
+                                                           uncompressedBuffer.data(), uncompressedBuffer.size());
+
+    if (uncompressedSize == sampleSize && std::memcmp(uncompressedBuffer.data(), sampleData, sampleSize) == 0)
+    {
+        std::cout << "Huffman static (" << name << ") " << sampleSize << " => " << compressedSizeBytes << " bytes, successful!\n";
+    }
+    else
+    {
+        std::cerr << "HUFFMAN STATIC TABLE ERROR! Data corrupted!\n";
+    }
+
+    HUFFMAN_MFREE(compressedData);
+}
+
 static void Test_Huffman()
 {
     std::cout << "> Testing random512...\n";
@@ -222,7 +712,115 @@ static void Test_Huffman()
     Test_Huffman_EncodeDecode(str3, sizeof(str3));
 
     std::cout << "> Testing lenna.tga...\n";
+    huffman::resetStats();
     Test_Huffman_EncodeDecode(lennaTgaData, sizeof(lennaTgaData));
+    const huffman::Stats & stats = huffman::getStats();
+    std::cout << "Huffman tree build ns       = " << stats.treeBuildNanos << "\n";
+    std::cout << "Huffman data emission ns    = " << stats.dataEmitNanos << "\n";
+    std::cout << "Huffman header parse ns     = " << stats.headerParseNanos << "\n";
+    std::cout << "Huffman decode table misses = " << stats.decodeTableMisses << "\n";
+
+    std::cout << "> Testing adversarial corpus...\n";
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        Test_Huffman_EncodeDecode(sample.data.data(), sample.data.size());
+    }
+
+    std::cout << "> Testing lenna.tga with the scalar bit stream kernels...\n";
+    const huffman::CpuFeatures detectedFeatures = huffman::getCpuFeatures();
+    huffman::setCpuFeatures(huffman::CpuFeatures{});
+    Test_Huffman_EncodeDecode(lennaTgaData, sizeof(lennaTgaData));
+    huffman::setCpuFeatures(detectedFeatures);
+
+    std::cout << "> Testing scatter/gather decode...\n";
+    {
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        huffman::easyEncode(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits);
+        const bool successful = checkScatterDecode<huffman::OutputSegment>(lennaTgaData, sizeof(lennaTgaData),
+            [&](const huffman::OutputSegment * segments, const int count)
+            {
+                return huffman::easyDecode(compressed, compressedBytes, compressedBits, segments, count);
+            });
+        std::cout << (successful ? "Huffman scatter decode successful!\n" : "HUFFMAN SCATTER DECODE ERROR!\n");
+        HUFFMAN_MFREE(compressed);
+    }
+
+    // Segmented streams too:
+    {
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        huffman::easyEncodeSegmented(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits, 10000);
+        const bool successful = checkScatterDecode<huffman::OutputSegment>(lennaTgaData, sizeof(lennaTgaData),
+            [&](const huffman::OutputSegment * segments, const int count)
+            {
+                return huffman::easyDecode(compressed, compressedBytes, compressedBits, segments, count);
+            });
+        std::cout << (successful ? "Huffman segmented scatter decode successful!\n" : "HUFFMAN SEGMENTED SCATTER DECODE ERROR!\n");
+        HUFFMAN_MFREE(compressed);
+    }
+
+    std::cout << "> Testing window decode...\n";
+    {
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        huffman::easyEncode(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits);
+        huffman::WindowDecoder bigWindows(compressed, compressedBytes, compressedBits, 1000);
+        huffman::WindowDecoder tinyWindows(compressed, compressedBytes, compressedBits, 3);
+        bool successful = checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), bigWindows, 1000) &&
+                          checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), tinyWindows, 3);
+        HUFFMAN_MFREE(compressed);
+
+        // Windows straddling the segments of a segmented stream:
+        huffman::easyEncodeSegmented(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits, 10000);
+        huffman::WindowDecoder segmentedWindows(compressed, compressedBytes, compressedBits, 4096);
+        successful &= checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), segmentedWindows, 4096);
+        HUFFMAN_MFREE(compressed);
+
+        std::cout << (successful ? "Huffman window decode successful!\n" : "HUFFMAN WINDOW DECODE ERROR!\n");
+    }
+
+    std::cout << "> Testing header-less static tables...\n";
+    {
+        const std::vector<std::uint8_t> text = corpus::makeText(65536, 3);
+        Test_Huffman_Static("ascii", huffman::getAsciiTextTable(), text.data(), text.size());
+        Test_Huffman_Static("ascii", huffman::getAsciiTextTable(), str0, sizeof(str0));
+        Test_Huffman_Static("ascii", huffman::getAsciiTextTable(), lennaTgaData, sizeof(lennaTgaData));
+
+        // A table made for the data at hand, built twice to check it's deterministic.
+        std::uint32_t frequencies[huffman::MaxSymbols] = {};
+        for (const std::uint8_t b : lennaTgaData)
+        {
+            ++frequencies[b];
+        }
+        const huffman::StaticTable lennaTable(frequencies);
+        const huffman::StaticTable lennaTableCopy(frequencies);
+        Test_Huffman_Static("lenna", lennaTable, lennaTgaData, sizeof(lennaTgaData));
+
+        bool sameCodes = true;
+        for (int s = 0; s < huffman::MaxSymbols; ++s)
+        {
+            sameCodes &= (lennaTable.getCode(s) == lennaTableCopy.getCode(s));
+            sameCodes &= (lennaTable.getCode(s).getLength() <= huffman::MaxStaticCodeBits);
+        }
+        std::cout << (sameCodes ? "Huffman static tables are deterministic!\n" : "HUFFMAN STATIC TABLE MISMATCH!\n");
+    }
+
+    std::cout << "> Testing segmented streams...\n";
+    Test_Huffman_Segmented(lennaTgaData, sizeof(lennaTgaData), 16 * 1024);
+    Test_Huffman_Segmented(lennaTgaData, sizeof(lennaTgaData), sizeof(lennaTgaData));
+    Test_Huffman_Segmented(str2, sizeof(str2), 7);
+
+    std::cout << "> Testing speculative decode of single streams...\n";
+    Test_Huffman_Speculative(lennaTgaData, sizeof(lennaTgaData), 4);
+    Test_Huffman_Speculative(lennaTgaData, sizeof(lennaTgaData), 24);
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        Test_Huffman_Speculative(sample.data.data(), sample.data.size(), 8);
+    }
 }
 
 // ========================================================
@@ -281,7 +879,946 @@ static void Test_Rice()
     Test_Rice_EncodeDecode(str3, sizeof(str3));
 
     std::cout << "> Testing lenna.tga...\n";
+    rice::resetStats();
+    Test_Rice_EncodeDecode(lennaTgaData, sizeof(lennaTgaData));
+    const rice::Stats & stats = rice::getStats();
+    std::cout << "Rice bits written / read    = " << stats.bitsWritten << " / " << stats.bitsRead << "\n";
+
+    std::cout << "> Testing adversarial corpus...\n";
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        Test_Rice_EncodeDecode(sample.data.data(), sample.data.size());
+    }
+
+    std::cout << "> Testing scatter/gather decode...\n";
+    {
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        rice::easyEncode(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits);
+        const bool successful = checkScatterDecode<rice::OutputSegment>(lennaTgaData, sizeof(lennaTgaData),
+            [&](const rice::OutputSegment * segments, const int count)
+            {
+                return rice::easyDecode(compressed, compressedBytes, compressedBits, segments, count);
+            });
+        std::cout << (successful ? "Rice scatter decode successful!\n" : "RICE SCATTER DECODE ERROR!\n");
+        RICE_MFREE(compressed);
+    }
+
+    std::cout << "> Testing window decode...\n";
+    {
+        std::uint8_t * compressed = nullptr;
+        int compressedBytes = 0;
+        int compressedBits  = 0;
+        rice::easyEncode(lennaTgaData, sizeof(lennaTgaData), &compressed, &compressedBytes, &compressedBits);
+        rice::WindowDecoder bigWindows(compressed, compressedBytes, compressedBits, 1000);
+        rice::WindowDecoder tinyWindows(compressed, compressedBytes, compressedBits, 3);
+        const bool successful = checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), bigWindows, 1000) &&
+                                checkWindowDecode(lennaTgaData, sizeof(lennaTgaData), tinyWindows, 3);
+        std::cout << (successful ? "Rice window decode successful!\n" : "RICE WINDOW DECODE ERROR!\n");
+        RICE_MFREE(compressed);
+    }
+
+    std::cout << "> Testing the per-K specialized kernels...\n";
+    {
+        bool successful = true;
+        for (int k = 0; k <= rice::MaxKBits; ++k)
+        {
+            // Reference: one encodeByte() call per byte.
+            rice::Encoder reference;
+            rice::Encoder specialized;
+            for (int b = 0; b < static_cast<int>(sizeof(random512)); ++b)
+            {
+                reference.encodeByte(random512[b], k);
+            }
+            specialized.encodeBlock(random512, sizeof(random512), k);
+
+            successful &= (reference.getBitCount() == specialized.getBitCount());
+            successful &= (std::memcmp(reference.getBitStream(), specialized.getBitStream(), reference.getByteCount()) == 0);
+
+            std::uint8_t restored[sizeof(random512)];
+            rice::Decoder decoder(specialized);
+            successful &= (decoder.decodeBlock(restored, sizeof(restored), k) == static_cast<int>(sizeof(restored)));
+            successful &= (std::memcmp(restored, random512, sizeof(restored)) == 0);
+        }
+        std::cout << (successful ? "Rice K kernels match!\n" : "RICE K KERNEL MISMATCH!\n");
+    }
+
+    std::cout << "> Testing the Golomb and Exp-Golomb modes...\n";
+    {
+        // Geometric values with a mean around 4, where the best Golomb M (3) is not a power of two.
+        corpus::Random rng(64);
+        std::vector<std::uint8_t> geometric(20000);
+        for (auto & b : geometric)
+        {
+            int v = 0;
+            while (v < 255 && rng.nextInt(5) != 0)
+            {
+                ++v;
+            }
+            b = static_cast<std::uint8_t>(v);
+        }
+
+        std::vector<std::vector<std::uint8_t>> samples;
+        samples.push_back(geometric);
+        samples.push_back(corpus::makeResiduals(10000, 7));
+        samples.push_back(std::vector<std::uint8_t>(lennaTgaData, lennaTgaData + sizeof(lennaTgaData)));
+        samples.push_back(std::vector<std::uint8_t>(random512, random512 + sizeof(random512)));
+
+        const rice::Mode modes[] = { rice::Mode::Rice, rice::Mode::Golomb, rice::Mode::ExpGolomb, rice::Mode::Best };
+        bool successful = true;
+        for (const auto & sample : samples)
+        {
+            int compressedBits[4] = {};
+            for (int m = 0; m < 4; ++m)
+            {
+                std::uint8_t * compressed = nullptr;
+                int compressedBytes = 0;
+                rice::easyEncode(sample.data(), sample.size(), &compressed, &compressedBytes, &compressedBits[m], modes[m]);
+
+                std::vector<std::uint8_t> restored(sample.size());
+                successful &= (rice::easyDecode(compressed, compressedBytes, compressedBits[m],
+                                                restored.data(), restored.size()) == static_cast<int>(sample.size()));
+                successful &= (restored == sample);
+
+                rice::WindowDecoder tinyWindows(compressed, compressedBytes, compressedBits[m], 3);
+                successful &= checkWindowDecode(sample.data(), sample.size(), tinyWindows, 3);
+                RICE_MFREE(compressed);
+            }
+            successful &= (compressedBits[3] <= compressedBits[0] &&
+                           compressedBits[3] <= compressedBits[1] &&
+                           compressedBits[3] <= compressedBits[2]);
+        }
+
+        // Golomb M = 3 must pay off over both neighbouring Rice divisors.
+        int riceBits = 0;
+        int golombBits = 0;
+        rice::Encoder::findBestKBits(geometric.data(), geometric.size(), rice::MaxKBits, &riceBits);
+        const int M = rice::Encoder::findBestGolombM(geometric.data(), geometric.size(), &golombBits);
+        successful &= (M == 3 && golombBits < riceBits);
+
+        std::cout << (successful ? "Rice Golomb/Exp-Golomb modes successful!\n" : "RICE GOLOMB/EXP-GOLOMB MODE ERROR!\n");
+    }
+
+    std::cout << "> Testing lenna.tga with the scalar bit stream kernels...\n";
+    const rice::CpuFeatures detectedFeatures = rice::getCpuFeatures();
+    rice::setCpuFeatures(rice::CpuFeatures{});
     Test_Rice_EncodeDecode(lennaTgaData, sizeof(lennaTgaData));
+    rice::setCpuFeatures(detectedFeatures);
+}
+
+// ========================================================
+// Range coder tests:
+// ========================================================
+
+static int Test_RangeCoder_EncodeDecode(const std::uint8_t * sampleData, const int sampleSize,
+                                        const rangecoder::Model model, const bool verbose = true)
+{
+    int compressedSizeBytes = 0;
+    int compressedSizeBits  = 0;
+    std::uint8_t * compressedData = nullptr;
+    std::vector<std::uint8_t> uncompressedBuffer(sampleSize, 0);
+
+    rangecoder::easyEncode(sampleData, sampleSize, &compressedData, &compressedSizeBytes, &compressedSizeBits, model);
+    const int uncompressedSize = rangecoder::easyDecode(compressedData, compressedSizeBytes, compressedSizeBits,
+                                                        uncompressedBuffer.data(), uncompressedBuffer.size());
+    RANGECODER_MFREE(compressedData);
+
+    const char * name = (model == rangecoder::Model::Order1) ? "order-1" : "order-0";
+    if (uncompressedSize != sampleSize || std::memcmp(uncompressedBuffer.data(), sampleData, sampleSize) != 0)
+    {
+        std::cerr << "RANGE CODER COMPRESSION ERROR! Data corrupted (" << name << ")!\n";
+        return -1;
+    }
+    if (verbose)
+    {
+        std::cout << "Range coder " << name << " " << sampleSize << " => " << compressedSizeBytes << " bytes, successful!\n";
+    }
+    return compressedSizeBytes;
+}
+
+static void Test_RangeCoder()
+{
+    using rangecoder::Model;
+
+    std::cout << "> Testing strings...\n";
+    Test_RangeCoder_EncodeDecode(str0, sizeof(str0), Model::Order0);
+    Test_RangeCoder_EncodeDecode(str3, sizeof(str3), Model::Order0);
+    Test_RangeCoder_EncodeDecode(str3, sizeof(str3), Model::Order1);
+
+    std::cout << "> Testing lenna.tga...\n";
+    rangecoder::resetStats();
+    Test_RangeCoder_EncodeDecode(lennaTgaData, sizeof(lennaTgaData), Model::Order0);
+    Test_RangeCoder_EncodeDecode(lennaTgaData, sizeof(lennaTgaData), Model::Order1);
+    std::cout << "Range coder carries = " << rangecoder::getStats().carries << "\n";
+
+    std::cout << "> Testing the standard corpus...\n";
+    bool successful = true;
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        successful &= Test_RangeCoder_EncodeDecode(sample.data.data(), sample.data.size(), Model::Order0, false) > 0;
+        successful &= Test_RangeCoder_EncodeDecode(sample.data.data(), sample.data.size(), Model::Order1, false) > 0;
+    }
+    std::cout << (successful ? "Range coder corpus round trips successful!\n" : "RANGE CODER CORPUS ERROR!\n");
+
+    std::cout << "> Testing skewed data against Huffman...\n";
+    {
+        // 1 byte in 50 is not a zero: Huffman can't go below a bit per byte.
+        corpus::Random rng(70);
+        std::vector<std::uint8_t> skewed(65536, 0);
+        for (auto & b : skewed)
+        {
+            b = (rng.nextInt(50) == 0) ? static_cast<std::uint8_t>(1 + rng.nextInt(4)) : 0;
+        }
+
+        std::uint8_t * huffmanData = nullptr;
+        int huffmanBytes = 0;
+        int huffmanBits  = 0;
+        huffman::easyEncode(skewed.data(), skewed.size(), &huffmanData, &huffmanBytes, &huffmanBits);
+        HUFFMAN_MFREE(huffmanData);
+
+        const int rangeBytes = Test_RangeCoder_EncodeDecode(skewed.data(), skewed.size(), Model::Order0);
+        std::cout << "Huffman / range coder = " << huffmanBytes << " / " << rangeBytes << " bytes\n";
+        std::cout << (rangeBytes > 0 && rangeBytes * 2 < huffmanBytes ? "Range coder beats Huffman!\n" : "RANGE CODER ERROR! No gain.\n");
+    }
+}
+
+// ========================================================
+// PFor (patched frame of reference) tests:
+// ========================================================
+
+static bool Test_PFor_EncodeDecode(const std::vector<std::uint32_t> & values)
+{
+    const int count = static_cast<int>(values.size());
+    std::vector<std::uint8_t> encoded(pfor::maxEncodedSize(count));
+    std::vector<std::uint32_t> decoded(count + 1, 0xDEADBEEF);
+
+    const int encodedSize = pfor::easyEncode(values.data(), count, encoded.data(), encoded.size());
+    if (encodedSize < 0)
+    {
+        std::cerr << "PFOR ENCODING ERROR!\n";
+        return false;
+    }
+
+    const int decodedCount = pfor::easyDecode(encoded.data(), encodedSize, decoded.data(), decoded.size());
+    if (decodedCount != count || pfor::getDecodedCount(encoded.data(), encodedSize) != count)
+    {
+        std::cerr << "PFOR COMPRESSION ERROR! Size mismatch!\n";
+        return false;
+    }
+    if (!std::equal(values.begin(), values.end(), decoded.begin()) || decoded[count] != 0xDEADBEEF)
+    {
+        std::cerr << "PFOR COMPRESSION ERROR! Data corrupted!\n";
+        return false;
+    }
+
+    // A truncated stream must be rejected, not read past its end.
+    if (count > 0 && pfor::easyDecode(encoded.data(), encodedSize - 1, decoded.data(), decoded.size()) != -1)
+    {
+        std::cerr << "PFOR COMPRESSION ERROR! Truncated input accepted!\n";
+        return false;
+    }
+    return true;
+}
+
+static void Test_PFor_Samples()
+{
+    corpus::Random rng(66);
+    bool successful = true;
+
+    std::cout << "> Testing every bit width...\n";
+    for (int bits = 0; bits <= 32; ++bits)
+    {
+        std::vector<std::uint32_t> values(pfor::BlockSize * 3);
+        for (auto & v : values)
+        {
+            v = (bits > 0) ? static_cast<std::uint32_t>(rng.next()) >> (32 - bits) : 0;
+        }
+        successful &= Test_PFor_EncodeDecode(values);
+    }
+
+    std::cout << "> Testing short and partial blocks...\n";
+    for (int count : { 0, 1, 5, 127, 129, 1000 })
+    {
+        std::vector<std::uint32_t> values(count);
+        for (auto & v : values)
+        {
+            v = 1000000 + rng.nextInt(300);
+        }
+        successful &= Test_PFor_EncodeDecode(values);
+    }
+
+    std::cout << "> Testing outliers (exceptions)...\n";
+    {
+        std::vector<std::uint32_t> values(10000);
+        for (auto & v : values)
+        {
+            v = (rng.nextInt(50) == 0) ? static_cast<std::uint32_t>(rng.next()) : rng.nextInt(16);
+        }
+        pfor::resetStats();
+        successful &= Test_PFor_EncodeDecode(values);
+
+        // Patching the few outliers must beat widening every value of the block.
+        std::vector<std::uint8_t> encoded(pfor::maxEncodedSize(values.size()));
+        const int encodedSize = pfor::easyEncode(values.data(), values.size(), encoded.data(), encoded.size());
+        std::cout << "PFor 10000 ints with outliers = " << encodedSize << " bytes, "
+                  << pfor::getStats().exceptions << " exceptions\n";
+        successful &= (encodedSize < static_cast<int>(values.size()) * 2);
+    }
+
+    std::cout << "> Testing sorted row ids...\n";
+    {
+        std::vector<std::uint32_t> values(5000);
+        std::uint32_t rowId = 0;
+        for (auto & v : values)
+        {
+            rowId += 1 + rng.nextInt(10);
+            v = rowId;
+        }
+        successful &= Test_PFor_EncodeDecode(values);
+    }
+
+    std::cout << (successful ? "PFor compression successful!\n" : "PFOR COMPRESSION ERROR!\n");
+}
+
+static void Test_PFor()
+{
+    Test_PFor_Samples();
+
+    std::cout << "> Testing with the scalar kernels...\n";
+    const pfor::CpuFeatures detectedFeatures = pfor::getCpuFeatures();
+    pfor::setCpuFeatures(pfor::CpuFeatures{});
+    Test_PFor_Samples();
+    pfor::setCpuFeatures(detectedFeatures);
+}
+
+// ========================================================
+// Stream VByte tests:
+// ========================================================
+
+static bool Test_StreamVByte_EncodeDecode(const std::vector<std::uint32_t> & values, const streamvbyte::Transform transform)
+{
+    const int count = static_cast<int>(values.size());
+    std::vector<std::uint8_t> encoded(streamvbyte::maxEncodedSize(count));
+    std::vector<std::uint32_t> decoded(count + 1, 0xDEADBEEF);
+
+    const int encodedSize = streamvbyte::easyEncode(values.data(), count, encoded.data(), encoded.size(), transform);
+    if (encodedSize < 0)
+    {
+        std::cerr << "STREAM VBYTE ENCODING ERROR!\n";
+        return false;
+    }
+
+    // Decode from an exactly sized copy so reads past the end are caught by the sanitizers.
+    const std::vector<std::uint8_t> exact(encoded.begin(), encoded.begin() + encodedSize);
+    const int decodedCount = streamvbyte::easyDecode(exact.data(), exact.size(), decoded.data(), decoded.size());
+    if (decodedCount != count)
+    {
+        std::cerr << "STREAM VBYTE COMPRESSION ERROR! Size mismatch!\n";
+        return false;
+    }
+    if (!std::equal(values.begin(), values.end(), decoded.begin()) || decoded[count] != 0xDEADBEEF)
+    {
+        std::cerr << "STREAM VBYTE COMPRESSION ERROR! Data corrupted!\n";
+        return false;
+    }
+
+    // A truncated stream must be rejected, not read past its end.
+    if (count > 0 && streamvbyte::easyDecode(exact.data(), exact.size() - 1, decoded.data(), decoded.size()) != -1)
+    {
+        std::cerr << "STREAM VBYTE COMPRESSION ERROR! Truncated input accepted!\n";
+        return false;
+    }
+    return true;
+}
+
+static void Test_StreamVByte_Samples()
+{
+    using streamvbyte::Transform;
+    corpus::Random rng(67);
+    bool successful = true;
+
+    // Mixed byte lengths, with every length combination in a control byte showing up.
+    std::vector<std::uint32_t> mixed(20000);
+    for (auto & v : mixed)
+    {
+        v = static_cast<std::uint32_t>(rng.next()) >> (rng.nextInt(4) * 8);
+    }
+
+    // Sorted postings: small gaps.
+    std::vector<std::uint32_t> postings(20000);
+    std::uint32_t docId = 0;
+    for (auto & v : postings)
+    {
+        docId += 1 + rng.nextInt(300);
+        v = docId;
+    }
+
+    // Signed values of small magnitude, and a walk that goes up and down.
+    std::vector<std::uint32_t> signedValues(20000);
+    std::vector<std::uint32_t> walk(20000);
+    std::int32_t position = 0;
+    for (std::size_t i = 0; i < signedValues.size(); ++i)
+    {
+        signedValues[i] = static_cast<std::uint32_t>(rng.nextInt(200) - 100);
+        position += rng.nextInt(61) - 30;
+        walk[i] = static_cast<std::uint32_t>(position);
+    }
+
+    const Transform transforms[] = { Transform::None, Transform::Delta, Transform::ZigZag, Transform::DeltaZigZag };
+    for (const Transform transform : transforms)
+    {
+        successful &= Test_StreamVByte_EncodeDecode(mixed, transform);
+        successful &= Test_StreamVByte_EncodeDecode(postings, transform);
+        successful &= Test_StreamVByte_EncodeDecode(signedValues, transform);
+        successful &= Test_StreamVByte_EncodeDecode(walk, transform);
+
+        for (int count : { 0, 1, 3, 4, 5, 7, 8, 9, 33 })
+        {
+            successful &= Test_StreamVByte_EncodeDecode(std::vector<std::uint32_t>(mixed.begin(), mixed.begin() + count), transform);
+        }
+    }
+
+    // The transforms should pay off on the data they are meant for.
+    const auto encodedSize = [](const std::vector<std::uint32_t> & values, const Transform transform)
+    {
+        std::vector<std::uint8_t> encoded(streamvbyte::maxEncodedSize(values.size()));
+        return streamvbyte::easyEncode(values.data(), values.size(), encoded.data(), encoded.size(), transform);
+    };
+    const int postingsPlain = encodedSize(postings, Transform::None);
+    const int postingsDelta = encodedSize(postings, Transform::Delta);
+    const int signedPlain   = encodedSize(signedValues, Transform::None);
+    const int signedZigZag  = encodedSize(signedValues, Transform::ZigZag);
+    std::cout << "Stream VByte postings plain/delta = " << postingsPlain << " / " << postingsDelta << " bytes\n";
+    std::cout << "Stream VByte signed plain/zigzag  = " << signedPlain << " / " << signedZigZag << " bytes\n";
+    successful &= (postingsDelta < postingsPlain && signedZigZag < signedPlain);
+
+    std::cout << (successful ? "Stream VByte compression successful!\n" : "STREAM VBYTE COMPRESSION ERROR!\n");
+}
+
+static void Test_StreamVByte()
+{
+    const streamvbyte::CpuFeatures detectedFeatures = streamvbyte::getCpuFeatures();
+
+    std::cout << "> Testing with the detected kernels...\n";
+    Test_StreamVByte_Samples();
+
+    std::cout << "> Testing with the SSSE3 kernels...\n";
+    streamvbyte::CpuFeatures ssse3Only;
+    ssse3Only.ssse3 = true;
+    streamvbyte::setCpuFeatures(ssse3Only);
+    Test_StreamVByte_Samples();
+
+    std::cout << "> Testing with the scalar kernels...\n";
+    streamvbyte::setCpuFeatures(streamvbyte::CpuFeatures{});
+    Test_StreamVByte_Samples();
+
+    streamvbyte::setCpuFeatures(detectedFeatures);
+}
+
+// ========================================================
+// Image filter tests:
+// ========================================================
+
+// lennaTgaData is a run length encoded TGA. Expands its 32-bit pixels,
+// so the filters see the image and not the TGA packets.
+static std::vector<std::uint8_t> decodeLennaPixels(int & width, int & height)
+{
+    const int headerBytes = 18 + lennaTgaData[0]; // Plus the image id, if any.
+    width  = lennaTgaData[12] | (lennaTgaData[13] << 8);
+    height = lennaTgaData[14] | (lennaTgaData[15] << 8);
+
+    std::vector<std::uint8_t> pixels;
+    const std::size_t imageBytes = static_cast<std::size_t>(width) * height * 4;
+    for (int i = headerBytes; i < lennaTgaSizeBytes && pixels.size() < imageBytes;)
+    {
+        const int packet = lennaTgaData[i++];
+        const int count  = (packet & 0x7F) + 1;
+        const bool isRun = (packet & 0x80) != 0;
+        for (int p = 0; p < count; ++p)
+        {
+            const int pixel = isRun ? i : i + p * 4;
+            pixels.insert(pixels.end(), lennaTgaData + pixel, lennaTgaData + pixel + 4);
+        }
+        i += isRun ? 4 : count * 4;
+    }
+    pixels.resize(imageBytes);
+    return pixels;
+}
+
+static bool Test_ImageFilter_RoundTrip(const std::vector<std::uint8_t> & pixels, const int width, const int height,
+                                       const int channels, const imagefilter::Filter filter,
+                                       std::vector<std::uint8_t> * filteredOut = nullptr)
+{
+    std::vector<std::uint8_t> filtered(imagefilter::filteredSize(width, height, channels));
+    std::vector<std::uint8_t> restored(pixels.size());
+
+    const int filteredBytes = imagefilter::easyEncode(pixels.data(), width, height, channels,
+                                                      filtered.data(), filtered.size(), filter);
+    const int restoredBytes = imagefilter::easyDecode(filtered.data(), filtered.size(), width, height, channels,
+                                                      restored.data(), restored.size());
+
+    if (filteredBytes != static_cast<int>(filtered.size()) || restoredBytes != static_cast<int>(pixels.size()) ||
+        restored != pixels)
+    {
+        std::cerr << "IMAGE FILTER ERROR! " << width << "x" << height << "x" << channels
+                  << " filter " << static_cast<int>(filter) << "\n";
+        return false;
+    }
+    if (filteredOut != nullptr)
+    {
+        *filteredOut = filtered;
+    }
+    return true;
+}
+
+static void Test_ImageFilter_Samples()
+{
+    using imagefilter::Filter;
+    const Filter filters[] = { Filter::None, Filter::Sub, Filter::Up, Filter::Average, Filter::Paeth, Filter::Adaptive };
+    bool successful = true;
+
+    // Noisy gradients, every supported pixel size and odd widths.
+    corpus::Random rng(68);
+    for (int channels = 1; channels <= 8; ++channels)
+    {
+        const int width = 37;
+        const int height = 5;
+        std::vector<std::uint8_t> pixels(width * height * channels);
+        for (std::size_t i = 0; i < pixels.size(); ++i)
+        {
+            pixels[i] = static_cast<std::uint8_t>(i / channels + rng.nextInt(8) * (i % 3));
+        }
+        for (const Filter filter : filters)
+        {
+            successful &= Test_ImageFilter_RoundTrip(pixels, width, height, channels, filter);
+        }
+    }
+
+    int width, height;
+    const std::vector<std::uint8_t> lenna = decodeLennaPixels(width, height);
+    for (const Filter filter : filters)
+    {
+        successful &= Test_ImageFilter_RoundTrip(lenna, width, height, 4, filter);
+    }
+
+    std::cout << (successful ? "Image filter round trips successful!\n" : "IMAGE FILTER ERROR!\n");
+}
+
+static void Test_ImageFilter()
+{
+    std::cout << "> Testing round trips...\n";
+    Test_ImageFilter_Samples();
+
+    std::cout << "> Testing with the scalar kernels...\n";
+    const imagefilter::CpuFeatures detectedFeatures = imagefilter::getCpuFeatures();
+    imagefilter::setCpuFeatures(imagefilter::CpuFeatures{});
+    Test_ImageFilter_Samples();
+    imagefilter::setCpuFeatures(detectedFeatures);
+
+    std::cout << "> Testing lenna.tga pixels through Huffman...\n";
+    {
+        int width, height;
+        const std::vector<std::uint8_t> lenna = decodeLennaPixels(width, height);
+        std::vector<std::uint8_t> filtered;
+        imagefilter::resetStats();
+        const bool successful = Test_ImageFilter_RoundTrip(lenna, width, height, 4, imagefilter::Filter::Adaptive, &filtered);
+
+        const auto huffmanSize = [](const std::vector<std::uint8_t> & data)
+        {
+            std::uint8_t * compressed = nullptr;
+            int compressedBytes = 0;
+            int compressedBits  = 0;
+            huffman::easyEncode(data.data(), data.size(), &compressed, &compressedBytes, &compressedBits);
+            HUFFMAN_MFREE(compressed);
+            return compressedBytes;
+        };
+        const int rawSize = huffmanSize(lenna);
+        const int filteredSize = huffmanSize(filtered);
+
+        const imagefilter::Stats & stats = imagefilter::getStats();
+        std::cout << "Huffman of raw / filtered pixels = " << rawSize << " / " << filteredSize << " bytes\n";
+        std::cout << "Rows per filter (None/Sub/Up/Average/Paeth) = " << stats.filterRows[0] << "/" << stats.filterRows[1]
+                  << "/" << stats.filterRows[2] << "/" << stats.filterRows[3] << "/" << stats.filterRows[4] << "\n";
+        std::cout << (successful && filteredSize < rawSize ? "Image filter pays off!\n" : "IMAGE FILTER ERROR! No gain.\n");
+    }
+}
+
+// ========================================================
+// Shuffle tests:
+// ========================================================
+
+using ShuffleFunc = int (*)(const std::uint8_t *, int, int, std::uint8_t *, int);
+
+// Runs both shuffles and checks the result against the scalar kernels
+// as well as the round trip, so the AVX2 kernels must match the layout.
+static bool Test_Shuffle_RoundTrip(const std::vector<std::uint8_t> & data, const int typeSize,
+                                   const ShuffleFunc shuffleFunc, const ShuffleFunc unshuffleFunc)
+{
+    const int size = static_cast<int>(data.size());
+    std::vector<std::uint8_t> shuffled(size + 1, 0xCD);
+    std::vector<std::uint8_t> reference(size + 1, 0xCD);
+    std::vector<std::uint8_t> restored(size + 1, 0xCD);
+
+    const int shuffledBytes = shuffleFunc(data.data(), size, typeSize, shuffled.data(), size);
+
+    const shuffle::CpuFeatures features = shuffle::getCpuFeatures();
+    shuffle::setCpuFeatures(shuffle::CpuFeatures{});
+    shuffleFunc(data.data(), size, typeSize, reference.data(), size);
+    shuffle::setCpuFeatures(features);
+
+    const int restoredBytes = unshuffleFunc(shuffled.data(), size, typeSize, restored.data(), size);
+    restored.resize(size);
+
+    if (shuffledBytes != size || restoredBytes != size || shuffled != reference || restored != data)
+    {
+        std::cerr << "SHUFFLE ERROR! " << size << " bytes, type size " << typeSize << "\n";
+        return false;
+    }
+    return true;
+}
+
+static void Test_Shuffle_Samples()
+{
+    const int typeSizes[] = { 1, 2, 3, 4, 8, 12, 16, 128 };
+    const int sizes[] = { 7, 100, 1021, 4096, 70001 };
+    bool successful = true;
+
+    for (const int size : sizes)
+    {
+        const std::vector<std::uint8_t> data = corpus::makeRandom(size, size);
+        for (const int typeSize : typeSizes)
+        {
+            successful &= Test_Shuffle_RoundTrip(data, typeSize, &shuffle::byteShuffle, &shuffle::byteUnshuffle);
+            successful &= Test_Shuffle_RoundTrip(data, typeSize, &shuffle::bitShuffle, &shuffle::bitUnshuffle);
+        }
+    }
+
+    std::uint8_t byte = 0;
+    successful &= shuffle::byteShuffle(&byte, 1, 0, &byte, 1) == -1;
+    successful &= shuffle::bitShuffle(&byte, 1, shuffle::MaxTypeSize + 1, &byte, 1) == -1;
+    successful &= shuffle::byteUnshuffle(&byte, 2, 1, &byte, 1) == -1;
+
+    std::cout << (successful ? "Shuffle round trips successful!\n" : "SHUFFLE ERROR!\n");
+}
+
+// LZW rather than Huffman: an order-0 coder sees the same byte histogram
+// before and after a byte shuffle; what changes is the order of the bytes.
+static int Test_Shuffle_LzwSize(const std::vector<std::uint8_t> & data)
+{
+    std::uint8_t * compressed = nullptr;
+    int compressedBytes = 0;
+    int compressedBits  = 0;
+    lzw::easyEncode(data.data(), data.size(), &compressed, &compressedBytes, &compressedBits);
+    LZW_MFREE(compressed);
+    return compressedBytes;
+}
+
+static void Test_Shuffle()
+{
+    std::cout << "> Testing round trips...\n";
+    Test_Shuffle_Samples();
+
+    std::cout << "> Testing with the scalar kernels...\n";
+    const shuffle::CpuFeatures detectedFeatures = shuffle::getCpuFeatures();
+    shuffle::setCpuFeatures(shuffle::CpuFeatures{});
+    Test_Shuffle_Samples();
+    shuffle::setCpuFeatures(detectedFeatures);
+
+    std::cout << "> Testing lenna.tga pixels to planes...\n";
+    {
+        int width, height;
+        const std::vector<std::uint8_t> lenna = decodeLennaPixels(width, height);
+        const int pixelCount = width * height;
+        std::vector<std::uint8_t> planes(lenna.size());
+        std::vector<std::uint8_t> pixels(lenna.size());
+
+        bool successful = shuffle::toPlanar(lenna.data(), pixelCount, 4, planes.data(), planes.size()) == int(lenna.size()) &&
+                          shuffle::fromPlanar(planes.data(), pixelCount, 4, pixels.data(), pixels.size()) == int(lenna.size()) &&
+                          pixels == lenna;
+        for (int p = 0; p < pixelCount && successful; p += 97)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                successful &= planes[c * pixelCount + p] == lenna[p * 4 + c];
+            }
+        }
+        std::cout << (successful ? "Planar round trip successful!\n" : "SHUFFLE ERROR! Bad planes.\n");
+    }
+
+    std::cout << "> Testing a slowly varying int32 array through LZW...\n";
+    {
+        // A noisy ramp, as from a sensor or a counter.
+        corpus::Random rng(69);
+        std::vector<std::uint8_t> data(65536 * 4);
+        std::int32_t value = 100000;
+        for (std::size_t i = 0; i < data.size(); i += 4)
+        {
+            value += rng.nextInt(16);
+            std::memcpy(&data[i], &value, 4);
+        }
+
+        std::vector<std::uint8_t> byteShuffled(data.size());
+        std::vector<std::uint8_t> bitShuffled(data.size());
+        shuffle::resetStats();
+        shuffle::byteShuffle(data.data(), data.size(), 4, byteShuffled.data(), byteShuffled.size());
+        shuffle::bitShuffle(data.data(), data.size(), 4, bitShuffled.data(), bitShuffled.size());
+
+        const int rawSize  = Test_Shuffle_LzwSize(data);
+        const int byteSize = Test_Shuffle_LzwSize(byteShuffled);
+        const int bitSize  = Test_Shuffle_LzwSize(bitShuffled);
+        std::cout << "LZW of raw / byte shuffled / bit shuffled = "
+                  << rawSize << " / " << byteSize << " / " << bitSize << " bytes\n";
+        std::cout << "SIMD bytes = " << shuffle::getStats().simdBytes << "\n";
+        std::cout << (byteSize < rawSize && bitSize < rawSize ? "Shuffle pays off!\n" : "SHUFFLE ERROR! No gain.\n");
+    }
+}
+
+// ========================================================
+// Low-memory profile tests:
+// ========================================================
+
+// The workspace overloads must write the same stream as the heap-allocating
+// easyEncode() and decode it back with no other memory than what they are given.
+template<typename HeapEncodeFunc, typename EncodeFunc, typename DecodeFunc>
+static bool Test_LowMemory_RoundTrip(const char * name, const std::uint8_t * sampleData, const int sampleSize,
+                                     const HeapEncodeFunc & heapEncode, const EncodeFunc & encode,
+                                     const DecodeFunc & decode, const int workspaceSizeBytes)
+{
+    std::uint8_t * heapCompressed = nullptr;
+    int heapBytes = 0;
+    int heapBits  = 0;
+    heapEncode(sampleData, sampleSize, &heapCompressed, &heapBytes, &heapBits);
+    const std::vector<std::uint8_t> expected(heapCompressed, heapCompressed + heapBytes);
+    std::free(heapCompressed); // All the codecs default to std::malloc.
+
+    std::vector<std::uint8_t> workspace(workspaceSizeBytes + 1, 0xCD);
+    std::vector<std::uint8_t> compressed(sampleSize * 2 + huffman::MaxTreePrefixBytes, 0);
+    std::vector<std::uint8_t> uncompressed(sampleSize + 1, 0xCD);
+
+    // Off by one byte from the start of the buffer, so the overloads have to align it.
+    int compressedBits = 0;
+    const int compressedBytes = encode(sampleData, sampleSize, compressed.data(), static_cast<int>(compressed.size()),
+                                       &compressedBits, workspace.data() + 1, workspaceSizeBytes);
+    const int uncompressedBytes = decode(compressed.data(), compressedBytes, compressedBits, uncompressed.data(),
+                                         sampleSize, workspace.data() + 1, workspaceSizeBytes);
+
+    if (compressedBytes != heapBytes || compressedBits != heapBits ||
+        !std::equal(expected.begin(), expected.end(), compressed.begin()))
+    {
+        std::cerr << name << " LOW-MEMORY ERROR! Stream differs from easyEncode()!\n";
+        return false;
+    }
+    if (uncompressedBytes != sampleSize || std::memcmp(uncompressed.data(), sampleData, sampleSize) != 0 ||
+        uncompressed[sampleSize] != 0xCD)
+    {
+        std::cerr << name << " LOW-MEMORY ERROR! Data corrupted!\n";
+        return false;
+    }
+    return true;
+}
+
+static void Test_LowMemory_Samples(const char * name, const std::uint8_t * sampleData, const int sampleSize)
+{
+    bool successful = true;
+    for (const lzw::Mode mode : { lzw::Mode::LZW, lzw::Mode::LZMW, lzw::Mode::LZAP })
+    {
+        successful &= Test_LowMemory_RoundTrip("LZW", sampleData, sampleSize,
+            [mode](const std::uint8_t * in, int size, std::uint8_t ** out, int * bytes, int * bits)
+            { lzw::easyEncode(in, size, out, bytes, bits, mode); },
+            [mode](const std::uint8_t * in, int size, std::uint8_t * out, int capacity, int * bits, void * ws, int wsSize)
+            { return lzw::easyEncode(in, size, out, capacity, bits, ws, wsSize, mode); },
+            [mode](const std::uint8_t * in, int bytes, int bits, std::uint8_t * out, int size, void * ws, int wsSize)
+            { return lzw::easyDecode(in, bytes, bits, out, size, ws, wsSize, mode); },
+            lzw::workspaceSize(mode));
+    }
+
+    successful &= Test_LowMemory_RoundTrip("Huffman", sampleData, sampleSize,
+        [](const std::uint8_t * in, int size, std::uint8_t ** out, int * bytes, int * bits)
+        { huffman::easyEncode(in, size, out, bytes, bits); },
+        [](const std::uint8_t * in, int size, std::uint8_t * out, int capacity, int * bits, void * ws, int wsSize)
+        { return huffman::easyEncode(in, size, out, capacity, bits, ws, wsSize); },
+        [](const std::uint8_t * in, int bytes, int bits, std::uint8_t * out, int size, void * ws, int wsSize)
+        { return huffman::easyDecode(in, bytes, bits, out, size, ws, wsSize); },
+        huffman::workspaceSize());
+
+    for (const rice::Mode mode : { rice::Mode::Rice, rice::Mode::Best })
+    {
+        successful &= Test_LowMemory_RoundTrip("Rice", sampleData, sampleSize,
+            [mode](const std::uint8_t * in, int size, std::uint8_t ** out, int * bytes, int * bits)
+            { rice::easyEncode(in, size, out, bytes, bits, mode); },
+            [mode](const std::uint8_t * in, int size, std::uint8_t * out, int capacity, int * bits, void *, int)
+            { return rice::easyEncode(in, size, out, capacity, bits, mode); },
+            [](const std::uint8_t * in, int bytes, int bits, std::uint8_t * out, int size, void *, int)
+            { return rice::easyDecode(in, bytes, bits, out, size); },
+            rice::workspaceSize());
+    }
+
+    for (const rangecoder::Model model : { rangecoder::Model::Order0, rangecoder::Model::Order1 })
+    {
+        successful &= Test_LowMemory_RoundTrip("Range coder", sampleData, sampleSize,
+            [model](const std::uint8_t * in, int size, std::uint8_t ** out, int * bytes, int * bits)
+            { rangecoder::easyEncode(in, size, out, bytes, bits, model); },
+            [model](const std::uint8_t * in, int size, std::uint8_t * out, int capacity, int * bits, void * ws, int wsSize)
+            { return rangecoder::easyEncode(in, size, out, capacity, bits, ws, wsSize, model); },
+            [](const std::uint8_t * in, int bytes, int bits, std::uint8_t * out, int size, void * ws, int wsSize)
+            { return rangecoder::easyDecode(in, bytes, bits, out, size, ws, wsSize); },
+            rangecoder::workspaceSize(model));
+    }
+
+    if (successful)
+    {
+        std::cout << name << " low-memory round trips successful!\n";
+    }
+}
+
+static void Test_LowMemory()
+{
+    std::cout << "> Testing workspace sizes...\n";
+    std::cout << "LZW/LZMW/LZAP = " << lzw::workspaceSize(lzw::Mode::LZW) << "/" << lzw::workspaceSize(lzw::Mode::LZMW)
+              << "/" << lzw::workspaceSize(lzw::Mode::LZAP) << " bytes, Huffman = " << huffman::workspaceSize()
+              << " bytes, Rice = " << rice::workspaceSize() << " bytes, Range coder Order0/Order1 = "
+              << rangecoder::workspaceSize(rangecoder::Model::Order0) << "/"
+              << rangecoder::workspaceSize(rangecoder::Model::Order1) << " bytes\n";
+
+    std::cout << "> Testing round trips against the heap versions...\n";
+    Test_LowMemory_Samples("random512", random512, sizeof(random512));
+    Test_LowMemory_Samples("str3", str3, sizeof(str3));
+    Test_LowMemory_Samples("lenna.tga", lennaTgaData, sizeof(lennaTgaData));
+    for (const auto & sample : corpus::makeStandardCorpus())
+    {
+        Test_LowMemory_Samples(sample.name.c_str(), sample.data.data(), sample.data.size());
+    }
+
+    std::cout << "> Testing image filters with a workspace...\n";
+    {
+        int width, height;
+        const std::vector<std::uint8_t> lenna = decodeLennaPixels(width, height);
+        const int filteredSize = imagefilter::filteredSize(width, height, 4);
+        const int workspaceSize = imagefilter::workspaceSize(width, 4);
+        std::vector<std::uint8_t> expected(filteredSize, 0);
+        std::vector<std::uint8_t> filtered(filteredSize, 0);
+        std::vector<std::uint8_t> restored(lenna.size(), 0);
+        std::vector<std::uint8_t> workspace(workspaceSize, 0xCD);
+
+        bool successful = imagefilter::easyEncode(lenna.data(), width, height, 4, expected.data(), filteredSize) == filteredSize;
+        successful &= imagefilter::easyEncode(lenna.data(), width, height, 4, filtered.data(), filteredSize,
+                                              imagefilter::Filter::Adaptive, workspace.data(), workspaceSize) == filteredSize;
+        successful &= imagefilter::easyDecode(filtered.data(), filteredSize, width, height, 4, restored.data(),
+                                              restored.size(), workspace.data(), workspaceSize) == static_cast<int>(lenna.size());
+        successful &= filtered == expected && restored == lenna;
+
+        // A workspace one byte short must be refused up front.
+        successful &= imagefilter::easyEncode(lenna.data(), width, height, 4, filtered.data(), filteredSize,
+                                              imagefilter::Filter::Adaptive, workspace.data(), workspaceSize - 1) == -1;
+        std::cout << (successful ? "Image filter workspace round trip successful!\n" : "IMAGE FILTER WORKSPACE ERROR!\n");
+    }
+}
+
+// ========================================================
+// Pipeline tests:
+// ========================================================
+
+// Compresses the sample through the pipeline in small blocks, then
+// decompresses the frames back through another pipeline run.
+static void Test_Pipeline_RoundTrip(const char * name, const std::uint8_t * sampleData, const int sampleSize,
+                                    const pipeline::CodecFunc & encoder, const pipeline::CodecFunc & decoder,
+                                    const pipeline::Options & options, const int blockSize)
+{
+    int readOffset = 0;
+    std::vector<std::uint8_t> frames;
+    pipeline::Stats stats;
+
+    const bool encoded = pipeline::run(
+        [&](pipeline::Block & block)
+        {
+            const int n = std::min(blockSize, sampleSize - readOffset);
+            block.assign(sampleData + readOffset, sampleData + readOffset + n);
+            readOffset += n;
+            return true;
+        },
+        encoder,
+        [&](const pipeline::Block & block)
+        {
+            frames.insert(frames.end(), block.begin(), block.end());
+            return true;
+        },
+        options, &stats);
+
+    // Decode from a file, to exercise the frame reader.
+    std::FILE * file = std::tmpfile();
+    std::fwrite(frames.data(), 1, frames.size(), file);
+    std::rewind(file);
+
+    std::vector<std::uint8_t> restored;
+    const bool decoded = pipeline::run(pipeline::makeFrameReader(file), decoder,
+        [&](const pipeline::Block & block)
+        {
+            restored.insert(restored.end(), block.begin(), block.end());
+            return true;
+        },
+        options);
+    std::fclose(file);
+
+    const int expectedBlocks = (sampleSize + blockSize - 1) / blockSize;
+    if (encoded && decoded && static_cast<int>(stats.blocks) == expectedBlocks &&
+        restored.size() == static_cast<std::size_t>(sampleSize) &&
+        std::memcmp(restored.data(), sampleData, sampleSize) == 0)
+    {
+        std::cout << name << " pipeline round trip successful! (" << stats.blocks << " blocks, "
+                  << stats.bytesWritten << " bytes)\n";
+    }
+    else
+    {
+        std::cerr << name << " PIPELINE ERROR! Data corrupted or stage failed!\n";
+    }
+}
+
+static void Test_Pipeline()
+{
+    pipeline::Options options;
+    options.workerCount = 3;
+    options.queueDepth  = 2;
+
+    std::cout << "> Testing lenna.tga with every codec...\n";
+    Test_Pipeline_RoundTrip("RLE", lennaTgaData, sizeof(lennaTgaData),
+                            pipeline::makeByteEncoder(rle::easyEncode, 3),
+                            pipeline::makeByteDecoder(rle::easyDecode), options, 10000);
+    Test_Pipeline_RoundTrip("LZW", lennaTgaData, sizeof(lennaTgaData),
+                            pipeline::makeEncoder(lzw::easyEncode, [](void * p) { LZW_MFREE(p); }),
+                            pipeline::makeDecoder(lzw::easyDecode), options, 10000);
+    Test_Pipeline_RoundTrip("Huffman", lennaTgaData, sizeof(lennaTgaData),
+                            pipeline::makeEncoder(huffman::easyEncode, [](void * p) { HUFFMAN_MFREE(p); }),
+                            pipeline::makeDecoder(huffman::easyDecode), options, 10000);
+    Test_Pipeline_RoundTrip("Rice", lennaTgaData, sizeof(lennaTgaData),
+                            pipeline::makeEncoder(rice::easyEncode, [](void * p) { RICE_MFREE(p); }),
+                            pipeline::makeDecoder(rice::easyDecode), options, 10000);
+    Test_Pipeline_RoundTrip("Range coder", lennaTgaData, sizeof(lennaTgaData),
+                            pipeline::makeEncoder(rangecoder::easyEncode, [](void * p) { RANGECODER_MFREE(p); }),
+                            pipeline::makeDecoder(rangecoder::easyDecode), options, 10000);
+
+    std::cout << "> Testing one worker and one-slot queues...\n";
+    pipeline::Options serial;
+    serial.workerCount = 1;
+    serial.queueDepth  = 1;
+    Test_Pipeline_RoundTrip("Huffman", str3, sizeof(str3),
+                            pipeline::makeEncoder(huffman::easyEncode, [](void * p) { HUFFMAN_MFREE(p); }),
+                            pipeline::makeDecoder(huffman::easyDecode), serial, 5);
+
+    std::cout << "> Testing a failing stage...\n";
+    const bool result = pipeline::run(
+        [](pipeline::Block & block)
+        {
+            block.assign(100, 0xAB); // Endless input; only the error can stop it.
+            return true;
+        },
+        [](const pipeline::Block &, pipeline::Block &)
+        {
+            return false;
+        },
+        [](const pipeline::Block &) { return true; },
+        options);
+    std::cout << (!result ? "Pipeline stopped on error!\n" : "PIPELINE ERROR! Failure not reported!\n");
 }
 
 // ========================================================
@@ -308,6 +1845,13 @@ int main()
     TEST(LZW);
     TEST(Huffman);
     TEST(Rice);
+    TEST(RangeCoder);
+    TEST(PFor);
+    TEST(StreamVByte);
+    TEST(ImageFilter);
+    TEST(Shuffle);
+    TEST(LowMemory);
+    TEST(Pipeline);
 }
 
 // ========================================================